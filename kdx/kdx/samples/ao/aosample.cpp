@@ -0,0 +1,209 @@
+#include "aosample.h"
+#include "sampler.h"
+#include <math.h>
+#include <string.h>
+
+#define BLUR_TILE_SIZE 16
+
+struct MVPMatrices
+{
+	float model[16], view[16], proj[16];
+};
+
+// transpose necessary for D3D11 (and OpenGL)
+static void transposeInto(const float *m, float *out)
+{
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			out[c * 4 + r] = m[r * 4 + c];
+		}
+	}
+}
+
+AoSample::AoSample(RenderDevice &dev, unsigned int width, unsigned int height) : dev_(dev), width_(width), height_(height),
+	prepassvs_(dev, L"prepass.hlsl"), prepassps_(dev, L"prepass.hlsl"), prepassinstancedvs_(dev, L"prepassinstanced.hlsl"),
+	hbaovs_(dev, L"hbao.hlsl"), hbaops_(dev, L"hbao.hlsl"),
+	blitvs_(dev, L"blit.hlsl"), blitps_(dev, L"blit.hlsl"),
+	blurcs_(dev, L"computeblur.hlsl"),
+	pool_(dev), graph_(pool_), prepassnormals_(0), prepassdepth_(0), ao_(0), final_(0),
+	quad_(TOPOLOGY_TRIANGLELIST), ring_(dev)
+{
+	PTvert v;
+	v.pos = fl3(0, 0, 0); v.tex = fl3(0, 1, 0); quad_.addVert(v);
+	v.pos = fl3(1, 0, 0); v.tex = fl3(1, 1, 0); quad_.addVert(v);
+	v.pos = fl3(0, 1, 0); v.tex = fl3(0, 0, 0); quad_.addVert(v);
+	v.pos = fl3(1, 1, 0); v.tex = fl3(1, 0, 0); quad_.addVert(v);
+	quad_.addInd(0).addInd(2).addInd(1).addInd(1).addInd(2).addInd(3);
+	quad_.finalize(dev);
+
+	// matrix for orthographic projection (constant), D3DXMatrixOrthoOffCenterLH(0, 1, 0, 1, 0, 1)
+	const float fsortho[16] = {
+		2, 0, 0, 0,
+		0, 2, 0, 0,
+		0, 0, 1, 0,
+		-1, -1, 0, 1
+	};
+	float fsorthoT[16];
+	transposeInto(fsortho, fsorthoT);
+	BufferDesc desc;
+	desc.usage = USAGE_IMMUTABLE;
+	desc.byteWidth = sizeof(fsorthoT); // only need projection
+	desc.bindFlags = BIND_CONSTANT_BUFFER;
+	fsorthobuffer_ = dev.createBuffer(desc, fsorthoT);
+
+	// WORKNOTE: input element descriptor must exactly match fields in the shader source
+	// and setInputLayout must be called with the correct number of items or else
+	// input layout creation will fail
+	const InputElement ied[] =
+	{
+		{"POSITION", 0, FORMAT_R32G32B32_FLOAT, 0, false},
+		{"TEXCOORD", 0, FORMAT_R32G32B32_FLOAT, 12, false},
+		{"NORMAL", 0, FORMAT_R32G32B32_FLOAT, 24, false}
+	};
+	fslayout_ = hbaovs_.setInputLayout(dev, ied, 2);
+	prepasslayout_ = prepassvs_.setInputLayout(dev, ied, 3);
+	// the same vertex elements and the instance's after them
+	InputElement instancedied[3 + OBJ_INSTANCE_ELEMENTS];
+	memcpy(instancedied, ied, sizeof(ied));
+	memcpy(instancedied + 3, ObjInstanceElements, sizeof(ObjInstanceElements));
+	prepassinstancedlayout_ = prepassinstancedvs_.setInputLayout(dev, instancedied, 3 + OBJ_INSTANCE_ELEMENTS);
+}
+
+AoSample::~AoSample()
+{
+	delete fsorthobuffer_;
+	delete fslayout_;
+	delete prepasslayout_;
+	delete prepassinstancedlayout_;
+}
+
+/*static*/ TextureDesc AoSample::GetDesc(unsigned int width, unsigned int height, RENDER_FORMAT format, unsigned int bindFlags)
+{
+	TextureDesc desc;
+	desc.width = width;
+	desc.height = height;
+	desc.format = format;
+	desc.bindFlags = bindFlags;
+	return desc;
+}
+
+void AoSample::resize(unsigned int width, unsigned int height)
+{
+	// the graph takes targets of the new size from the pool at the next compile
+	width_ = width;
+	height_ = height;
+}
+
+void AoSample::render(const Matrix &view, const Matrix &proj, const std::function<void(RenderContext&)> &drawScene)
+{
+	buildGraph(view, proj, drawScene);
+	graph_.compile();
+	graph_.execute(dev_.getContext());
+	pool_.endFrame();
+	ring_.endFrame();
+}
+
+void AoSample::useInstancedPrepass(RenderContext &context)
+{
+	context.setShader(STAGE_VERTEX, prepassinstancedvs_.get());
+	context.setInputLayout(prepassinstancedlayout_);
+}
+
+void AoSample::usePrepass(RenderContext &context)
+{
+	context.setShader(STAGE_VERTEX, prepassvs_.get());
+	context.setInputLayout(prepasslayout_);
+}
+
+void AoSample::buildGraph(const Matrix &view, const Matrix &proj, const std::function<void(RenderContext&)> &drawScene)
+{
+	graph_.reset();
+	// WORKNOTE: I tried using R11G11B10_FLOAT format here, but it has no sign bit
+	// so normals were positive only
+	// R32G32B32 throws an error on texture creation for some reason
+	// it seems that it is only optionally supported by certain hardware
+	// the view space normals are octahedral encoded instead (normalencoding.hlsli), 4 bytes instead of 16
+	prepassnormals_ = graph_.createTexture("prepass normals", GetDesc(width_, height_, FORMAT_R16G16_SNORM, BIND_RENDER_TARGET | BIND_SHADER_RESOURCE));
+	prepassdepth_ = graph_.createTexture("prepass depth", GetDesc(width_, height_, FORMAT_D16_UNORM, BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE));
+	ao_ = graph_.createTexture("ao", GetDesc(width_, height_, FORMAT_R32_FLOAT, BIND_RENDER_TARGET | BIND_SHADER_RESOURCE));
+	final_ = graph_.createTexture("blurred ao", GetDesc(width_, height_, FORMAT_R32G32B32A32_FLOAT, BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS));
+	const FrameTexture backbuffer = graph_.importTexture("back buffer", dev_.getBackBuffer());
+	const FrameTexture depthbuffer = graph_.importTexture("depth buffer", dev_.getDepthBuffer());
+	graph_.setOutput(backbuffer);
+
+	const float black[4] = { 0.f, 0.f, 0.f, 0.f };
+	const float farDepth = 1.f;
+	const unsigned int prepass = graph_.addPass("prepass", [this, &view, &proj, &drawScene](RenderContext &context) {
+		// matrix stuff
+		MVPMatrices matrices;
+		Matrix identity, invCamPj;
+		proj.getInverse(invCamPj);
+		transposeInto(identity.data(), matrices.model);
+		transposeInto(view.data(), matrices.view);
+		transposeInto(proj.data(), matrices.proj);
+		float invCamPjT[16];
+		transposeInto(invCamPj.data(), invCamPjT); // we can just use the inverse of the transpose here
+
+		// this frame's constants go into the ring, the inverse projection is for the hbao pass
+		matrixrange_ = ring_.allocate(context, matrices);
+		invcampjrange_ = ring_.allocate(context, invCamPjT, sizeof(invCamPjT));
+		// a full ring hands out empty ranges (counted in its failures), binding one would leave the slot null
+		if (!matrixrange_.buffer || !invcampjrange_.buffer) {
+			return;
+		}
+
+		// set the constant buffer in the shader itself (slot 0 for now)
+		ConstantRing::use(context, STAGE_VERTEX, 0, matrixrange_);
+
+		// WORKNOTE: not setting shaders caused driver crash
+		usePrepass(context);
+		context.setShader(STAGE_PIXEL, prepassps_.get());
+
+		// drawing
+		drawScene(context);
+	});
+	graph_.writeTarget(prepass, prepassnormals_, 0, black, false);
+	graph_.writeDepth(prepass, prepassdepth_, &farDepth);
+
+	// draw full screen quad for post process
+	// the red clear only ever showed where the quad didn't reach, which is nowhere, so the graph drops it
+	const float red[4] = { 1.f, 0.f, 0.f, 1.f };
+	const unsigned int hbao = graph_.addPass("hbao", [this](RenderContext &context) {
+		// no scene was drawn without the prepass' ranges either
+		if (!matrixrange_.buffer || !invcampjrange_.buffer) {
+			return;
+		}
+		context.setConstantBuffers(STAGE_VERTEX, 0, 1, &fsorthobuffer_);
+		ConstantRing::use(context, STAGE_PIXEL, 1, invcampjrange_);
+		context.setShader(STAGE_VERTEX, hbaovs_.get());
+		context.setShader(STAGE_PIXEL, hbaops_.get());
+		context.setInputLayout(fslayout_);
+		Sampler::GetDefaultSampler(dev_).use(context, 0);
+		quad_.draw(dev_, context);
+	});
+	graph_.readTexture(hbao, prepassnormals_, STAGE_PIXEL, 0);
+	graph_.readTexture(hbao, prepassdepth_, STAGE_PIXEL, 1);
+	graph_.writeTarget(hbao, ao_, 0, red, true);
+
+	// filter ao results
+	const unsigned int blur = graph_.addPass("blur", [this](RenderContext &context) {
+		context.setShader(STAGE_COMPUTE, blurcs_.get());
+		context.dispatch((unsigned int) ceil(width_ / (double) BLUR_TILE_SIZE), (unsigned int) ceil(height_ / (double) BLUR_TILE_SIZE), 1);
+	});
+	graph_.readTexture(blur, ao_, STAGE_COMPUTE, 0);
+	graph_.writeUav(blur, final_, 0, true);
+
+	// view final results
+	const float green[4] = { 0.f, 1.f, 0.f, 1.f };
+	const unsigned int blit = graph_.addPass("blit", [this](RenderContext &context) {
+		context.setConstantBuffers(STAGE_VERTEX, 0, 1, &fsorthobuffer_);
+		context.setShader(STAGE_VERTEX, blitvs_.get());
+		context.setShader(STAGE_PIXEL, blitps_.get());
+		context.setInputLayout(fslayout_);
+		Sampler::GetDefaultSampler(dev_).use(context, 0);
+		quad_.draw(dev_, context);
+	});
+	graph_.readTexture(blit, final_, STAGE_PIXEL, 0);
+	graph_.writeTarget(blit, backbuffer, 0, green, true);
+	graph_.writeDepth(blit, depthbuffer, &farDepth);
+}
@@ -0,0 +1,71 @@
+#ifndef AOSAMPLE_H
+#define AOSAMPLE_H
+
+#include "renderdevice.h"
+#include "constantring.h"
+#include "framegraph.h"
+#include "matrix.h"
+#include "mesh.hpp"
+#include "objinstances.h"
+#include "shader.h"
+#include <functional>
+
+// the frame of the ao sample (prepass, hbao, compute blur, blit to the back buffer) written against RenderDevice,
+// so main.cpp runs it on the d3d11 device and cpubench runs the same frame headless on the cpu device
+// the passes go through a FrameGraph, which owns the intermediate targets and does the unbinds between them
+class AoSample {
+public:
+	AoSample(RenderDevice &dev, unsigned int width, unsigned int height);
+	virtual ~AoSample();
+
+	void resize(unsigned int width, unsigned int height);
+
+	// drawScene draws the scene's PTN meshes, the prepass shaders and their input layout are bound when it's called
+	// view and proj are the camera's matrices as D3DX builds them (Matrix::data() layout), the model matrix is identity
+	void render(const Matrix &view, const Matrix &proj, const std::function<void(RenderContext&)> &drawScene);
+	// for drawScene, switches to the prepass vertex shader and layout of instanced draws (Obj::drawInstanced) and back
+	void useInstancedPrepass(RenderContext &context);
+	void usePrepass(RenderContext &context);
+
+	// the intermediate targets of the last frame, for reading the results back
+	RenderTexture* getPrepassNormals() const { return graph_.getTexture(prepassnormals_); }
+	RenderTexture* getPrepassDepth() const { return graph_.getTexture(prepassdepth_); }
+	RenderTexture* getAo() const { return graph_.getTexture(ao_); }
+	RenderTexture* getFinal() const { return graph_.getTexture(final_); }
+	FrameGraph& getGraph() { return graph_; }
+	RenderTargetPool& getTargetPool() { return pool_; }
+private:
+	static TextureDesc GetDesc(unsigned int width, unsigned int height, RENDER_FORMAT format, unsigned int bindFlags);
+	// describes the frame to the graph
+	void buildGraph(const Matrix &view, const Matrix &proj, const std::function<void(RenderContext&)> &drawScene);
+
+	RenderDevice &dev_;
+	unsigned int width_, height_;
+
+	VertexShader prepassvs_;
+	PixelShader prepassps_;
+	VertexShader prepassinstancedvs_;
+	VertexShader hbaovs_;
+	PixelShader hbaops_;
+	VertexShader blitvs_;
+	PixelShader blitps_;
+	ComputeShader blurcs_;
+
+	// the graph's targets, a resize keeps the old size around for a few frames
+	RenderTargetPool pool_;
+	FrameGraph graph_;
+	FrameTexture prepassnormals_, prepassdepth_, ao_, final_;
+
+	// full screen quad
+	InterleavedMesh<PTvert, uint8_t> quad_;
+
+	RenderBuffer *fsorthobuffer_;
+	// camera matrices and the inverse projection (used for reconstruction), written every frame
+	ConstantRing ring_;
+	ConstantRange matrixrange_, invcampjrange_;
+	RenderInputLayout *fslayout_;
+	RenderInputLayout *prepasslayout_;
+	RenderInputLayout *prepassinstancedlayout_;
+};
+
+#endif // AOSAMPLE_H
@@ -0,0 +1,257 @@
+#include "aoshaders.h"
+#include <math.h>
+#include <algorithm>
+
+// mul(v, m) with m a column_major hlsl matrix uploaded transposed, like every matrix the sample uploads
+static void mulVector(const float v[4], const float m[16], float out[4])
+{
+	for (int c = 0; c < 4; c++) {
+		out[c] = v[0] * m[c * 4] + v[1] * m[c * 4 + 1] + v[2] * m[c * 4 + 2] + v[3] * m[c * 4 + 3];
+	}
+}
+
+// mul(v, (float3x3) m)
+static void mulVector3(const float v[3], const float m[16], float out[3])
+{
+	for (int c = 0; c < 3; c++) {
+		out[c] = v[0] * m[c * 4] + v[1] * m[c * 4 + 1] + v[2] * m[c * 4 + 2];
+	}
+}
+
+static void normalize3(float v[3])
+{
+	const float invLen = 1.f / sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	v[0] *= invLen;
+	v[1] *= invLen;
+	v[2] *= invLen;
+}
+
+// normalencoding.hlsli
+
+static float signNotZero(float v)
+{
+	return v >= 0.f ? 1.f : -1.f;
+}
+
+static void encodeNormalOct(const float n[3], float e[2])
+{
+	const float invL1 = 1.f / (fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]));
+	e[0] = n[0] * invL1;
+	e[1] = n[1] * invL1;
+	if (n[2] < 0.f) {
+		const float x = (1.f - fabsf(e[1])) * signNotZero(e[0]);
+		const float y = (1.f - fabsf(e[0])) * signNotZero(e[1]);
+		e[0] = x;
+		e[1] = y;
+	}
+}
+
+static void decodeNormalOct(const float e[2], float n[3])
+{
+	n[0] = e[0];
+	n[1] = e[1];
+	n[2] = 1.f - fabsf(e[0]) - fabsf(e[1]);
+	if (n[2] < 0.f) {
+		n[0] = (1.f - fabsf(e[1])) * signNotZero(e[0]);
+		n[1] = (1.f - fabsf(e[0])) * signNotZero(e[1]);
+	}
+	normalize3(n);
+}
+
+// prepass.hlsl
+
+struct PrepassMatrices {
+	float model[16];
+	float view[16];
+	float proj[16];
+};
+
+static void prepassVertexMain(const CpuShaderState &state, const float (*input)[4], float position[4], float *varyings)
+{
+	const PrepassMatrices &m = state.constants<PrepassMatrices>(0);
+	const float pos[4] = { input[0][0], input[0][1], input[0][2], 1.f };
+	float world[4], view[4];
+	mulVector(pos, m.model, world);
+	mulVector(world, m.view, view);
+	mulVector(view, m.proj, position);
+	// WORKNOTE: model and view are rotations (plus uniform scale), so they transform normals as they are
+	float norm[3];
+	mulVector3(input[2], m.model, norm);
+	mulVector3(norm, m.view, varyings);
+}
+
+// prepassinstanced.hlsl, the pixel shader is prepass.hlsl's
+
+static void prepassInstancedVertexMain(const CpuShaderState &state, const float (*input)[4], float position[4], float *varyings)
+{
+	const PrepassMatrices &m = state.constants<PrepassMatrices>(0);
+	const float pos[4] = { input[0][0], input[0][1], input[0][2], 1.f };
+	// the TRANSFORM elements are the columns of the instance's model matrix
+	const float *transform[3] = { input[3], input[4], input[5] };
+	float instancePos[4], world[4], view[4];
+	for (int c = 0; c < 3; c++) {
+		instancePos[c] = pos[0] * transform[c][0] + pos[1] * transform[c][1] + pos[2] * transform[c][2] + pos[3] * transform[c][3];
+	}
+	instancePos[3] = 1.f;
+	mulVector(instancePos, m.model, world);
+	mulVector(world, m.view, view);
+	mulVector(view, m.proj, position);
+	// WORKNOTE: instance transforms are rotations (plus uniform scale) too, so they transform normals as they are
+	float instanceNorm[3], norm[3];
+	for (int c = 0; c < 3; c++) {
+		instanceNorm[c] = input[2][0] * transform[c][0] + input[2][1] * transform[c][1] + input[2][2] * transform[c][2];
+	}
+	mulVector3(instanceNorm, m.model, norm);
+	mulVector3(norm, m.view, varyings);
+}
+
+static void prepassPixelMain(const CpuShaderState &, const float *, const float *varyings, float (*targets)[4])
+{
+	float n[3] = { varyings[0], varyings[1], varyings[2] };
+	normalize3(n);
+	encodeNormalOct(n, targets[0]);
+	targets[0][2] = 0.f;
+	targets[0][3] = 1.f;
+}
+
+// hbao.hlsl and blit.hlsl share the full screen quad vertex shader
+
+static void fullscreenVertexMain(const CpuShaderState &state, const float (*input)[4], float position[4], float *varyings)
+{
+	const float *proj = &state.constants<float>(0);
+	const float pos[4] = { input[0][0], input[0][1], input[0][2], 1.f };
+	mulVector(pos, proj, position);
+	varyings[0] = input[1][0];
+	varyings[1] = input[1][1];
+}
+
+// the taps table of hbao.hlsl is left out, the pixel shader never reads it
+#define HBAO_SAMPLING_RADIUS 0.5f
+#define HBAO_NUM_SAMPLING_DIRECTIONS 8
+#define HBAO_SAMPLING_STEP 0.004f
+#define HBAO_NUM_SAMPLING_STEPS 4
+#define HBAO_TANGENT_BIAS 0.2f
+#define HBAO_PI 3.1415926535897932384626433832795f
+
+// unproject a texture space position with post-projection depth z
+static void hbaoViewPos(const float *invCamPj, float u, float y, float z, float viewPos[3])
+{
+	const float ndc[4] = { 2.f * u - 1.f, 2.f * y - 1.f, z, 1.f };
+	float unproject[4];
+	mulVector(ndc, invCamPj, unproject);
+	viewPos[0] = unproject[0] / unproject[3];
+	viewPos[1] = unproject[1] / unproject[3];
+	viewPos[2] = unproject[2] / unproject[3];
+}
+
+static void hbaoPixelMain(const CpuShaderState &state, const float *, const float *varyings, float (*targets)[4])
+{
+	const float *invCamPj = &state.constants<float>(1);
+	const float u = varyings[0], v = varyings[1];
+
+	// reconstruct the view space position from the depth map
+	float texel[4];
+	state.sample(1, 0, u, v, texel);
+	const float startY = 1.f - v; // texture coordinates for D3D have origin in top left, but in camera space origin is in bottom left
+	float viewPos[3];
+	hbaoViewPos(invCamPj, u, startY, texel[0], viewPos);
+	state.sample(0, 0, u, v, texel);
+	float viewNorm[3];
+	decodeNormalOct(texel, viewNorm);
+
+	float total = 0.f;
+	const float sampleDirectionIncrement = 2 * HBAO_PI / HBAO_NUM_SAMPLING_DIRECTIONS;
+	for (int i = 0; i < HBAO_NUM_SAMPLING_DIRECTIONS; i++) {
+		const float samplingAngle = i * sampleDirectionIncrement;
+		const float sampleDir[2] = { cosf(samplingAngle), sinf(samplingAngle) };
+		const float tangentAngle = acosf(sampleDir[0] * viewNorm[0] + sampleDir[1] * viewNorm[1]) - (0.5f * HBAO_PI) + HBAO_TANGENT_BIAS;
+		float horizonAngle = tangentAngle;
+		float lastDiff[3] = { 0.f, 0.f, 0.f };
+		for (int j = 0; j < HBAO_NUM_SAMPLING_STEPS; j++) {
+			const float sampleOffset[2] = { (j + 1) * HBAO_SAMPLING_STEP * sampleDir[0], (j + 1) * HBAO_SAMPLING_STEP * sampleDir[1] };
+			const float offU = u + sampleOffset[0], offV = v - sampleOffset[1];
+			state.sample(1, 0, offU, offV, texel);
+			float offViewPos[3];
+			hbaoViewPos(invCamPj, offU, startY + sampleOffset[1], texel[0], offViewPos);
+			const float diff[3] = { offViewPos[0] - viewPos[0], offViewPos[1] - viewPos[1], offViewPos[2] - viewPos[2] };
+			if (sqrtf(diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2]) < HBAO_SAMPLING_RADIUS) {
+				lastDiff[0] = diff[0];
+				lastDiff[1] = diff[1];
+				lastDiff[2] = diff[2];
+				// closer objects have smaller z in a LH coordinate system, so diff.z is negated
+				const float elevationAngle = atanf(-diff[2] / sqrtf(diff[0] * diff[0] + diff[1] * diff[1]));
+				horizonAngle = std::max(horizonAngle, elevationAngle);
+			}
+		}
+		const float attenuation = 1.f / (1.f + sqrtf(lastDiff[0] * lastDiff[0] + lastDiff[1] * lastDiff[1] + lastDiff[2] * lastDiff[2]));
+		const float occlusion = std::min(std::max(attenuation * (sinf(horizonAngle) - sinf(tangentAngle)), 0.f), 1.f);
+		total += 1.f - occlusion;
+	}
+	total /= HBAO_NUM_SAMPLING_DIRECTIONS;
+
+	targets[0][0] = total;
+	targets[0][1] = total;
+	targets[0][2] = total;
+	targets[0][3] = 1.f;
+}
+
+// blit.hlsl
+
+static void blitPixelMain(const CpuShaderState &state, const float *, const float *varyings, float (*targets)[4])
+{
+	state.sample(0, 0, varyings[0], varyings[1], targets[0]);
+}
+
+// computeblur.hlsl
+
+#define BLUR_TILE_SIZE 16
+#define BLUR_FILTER_SIZE 5
+#define BLUR_FILTER_OFFSET (BLUR_FILTER_SIZE / 2)
+#define BLUR_NEIGHBOR_SIZE (BLUR_TILE_SIZE + 2 * BLUR_FILTER_OFFSET)
+
+static void computeBlurMain(const CpuShaderState &state, const unsigned int group[3])
+{
+	int width, height;
+	state.getDimensions(0, width, height);
+	const int tileX = group[0] * BLUR_TILE_SIZE, tileY = group[1] * BLUR_TILE_SIZE;
+
+	// copy into shared memory, every thread's share of the loads at once
+	float neighborhood[BLUR_NEIGHBOR_SIZE][BLUR_NEIGHBOR_SIZE];
+	for (int y = 0; y < BLUR_NEIGHBOR_SIZE; y++) {
+		for (int x = 0; x < BLUR_NEIGHBOR_SIZE; x++) {
+			const int readX = std::min(std::max(tileX + x - BLUR_FILTER_OFFSET, 0), width - 1);
+			const int readY = std::min(std::max(tileY + y - BLUR_FILTER_OFFSET, 0), height - 1);
+			float texel[4];
+			state.load(0, readX, readY, texel);
+			neighborhood[x][y] = texel[0];
+		}
+	}
+
+	// GroupMemoryBarrierWithGroupSync, then the convolution of every thread
+	for (int ty = 0; ty < BLUR_TILE_SIZE; ty++) {
+		for (int tx = 0; tx < BLUR_TILE_SIZE; tx++) {
+			float total = 0.f;
+			for (int i = 0; i < BLUR_FILTER_SIZE; i++) {
+				for (int j = 0; j < BLUR_FILTER_SIZE; j++) {
+					total += neighborhood[tx + j][ty + i] * (1.f / (BLUR_FILTER_SIZE * BLUR_FILTER_SIZE));
+				}
+			}
+			const float value[4] = { total, total, total, 1.f };
+			state.store(0, tileX + tx, tileY + ty, value);
+		}
+	}
+}
+
+void RegisterAoShaders(CpuDevice &dev)
+{
+	CpuShaderProgram prepass = { prepassVertexMain, 3, prepassPixelMain, 0 };
+	dev.registerShader(L"prepass.hlsl", prepass);
+	CpuShaderProgram prepassInstanced = { prepassInstancedVertexMain, 3, prepassPixelMain, 0 };
+	dev.registerShader(L"prepassinstanced.hlsl", prepassInstanced);
+	CpuShaderProgram hbao = { fullscreenVertexMain, 2, hbaoPixelMain, 0 };
+	dev.registerShader(L"hbao.hlsl", hbao);
+	CpuShaderProgram blit = { fullscreenVertexMain, 2, blitPixelMain, 0 };
+	dev.registerShader(L"blit.hlsl", blit);
+	CpuShaderProgram blur = { 0, 0, 0, computeBlurMain };
+	dev.registerShader(L"computeblur.hlsl", blur);
+}
@@ -0,0 +1,11 @@
+#ifndef AOSHADERS_H
+#define AOSHADERS_H
+
+#include "cpudevice.h"
+
+// c++ ports of prepass.hlsl (and prepassinstanced.hlsl), hbao.hlsl, blit.hlsl and computeblur.hlsl for the cpu device, registered under the
+// file names AoSample creates its shaders with
+// they follow the hlsl line by line (same constants, same float math), keep them in sync when the .hlsl changes
+void RegisterAoShaders(CpuDevice &dev);
+
+#endif // AOSHADERS_H
@@ -12,16 +12,19 @@ static const uint2 neighborSize = tileSize + 2*filterOffset;
 groupshared float4 neighborhood[neighborSize.x][neighborSize.y];
 
 // TODO: add gaussian filter, separable filters
+// the cpu versions (separable gaussian, running-sum box, depth-aware bilateral) are in src/blur.h
 
 float filterBox(uint x, uint y) {
     return 1.0 / (FILTER_SIZE * FILTER_SIZE);
 }
 
-uint2 clampLocation(uint2 input)
+uint2 clampLocation(int2 input)
 {
 	uint width; uint height;
 	source_texture.GetDimensions(width, height);
-    return clamp(input, uint2(0,0), uint2(width, height)); // assuming that in/out images are same size
+    // signed input so the texels left of/above the image don't wrap around to the far edge,
+    // and clamp to the last texel rather than the size so the border texel is repeated (clamp-to-edge)
+    return uint2(clamp(input, int2(0,0), int2(width - 1, height - 1))); // assuming that in/out images are same size
 }
 
 [numthreads(TILE_SIZE, TILE_SIZE, 1)]
@@ -33,7 +36,7 @@ void ComputeMain( uint3 tile_id : SV_GroupID, uint3 thread_id : SV_GroupThreadID
 	for (uint i = 0; i < neighborSize.y; i+=tileSize.y) {
         for (uint j = 0; j < neighborSize.x; j+=tileSize.x){
             if ((x+j) < neighborSize.x && (y+i) < neighborSize.y) {
-                const uint2 read_coord = clampLocation(uint2(j,i) + pixel - filterOffset);
+                const uint2 read_coord = clampLocation(int2(uint2(j,i) + pixel) - int2(filterOffset));
                 neighborhood[x+j][y+i] = source_texture.Load(int3(read_coord, 0));
             }
         }
@@ -41,7 +44,7 @@ void ComputeMain( uint3 tile_id : SV_GroupID, uint3 thread_id : SV_GroupThreadID
 	
 	GroupMemoryBarrierWithGroupSync();
 
-	float4 total;
+	float4 total = float4(0, 0, 0, 0);
     // next, perform the convolution
     // position of the current pixel in shared memory is thread_id + filterOffset
     const uint2 shared_pixel = thread_id.xy + filterOffset; // guaranteed to be within shared memory bounds
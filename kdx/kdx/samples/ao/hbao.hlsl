@@ -9,8 +9,10 @@ cbuffer InvCamPj : register(b1)
 	matrix invCamPj;
 };
 
+#include "normalencoding.hlsli"
+
 // textures
-Texture2D normal_map : register(t0);
+Texture2D normal_map : register(t0); // octahedral view space normals
 Texture2D depth_map : register(t1);
 
 // samplers
@@ -75,10 +77,11 @@ float4 PixelMain(PSInput input) : SV_TARGET
 	float start_Z = depth_map.Sample(sampler_default, input.tex).r;
 	float start_Y = 1.0 - input.tex.y; // texture coordinates for D3D have origin in top left, but in camera space origin is in bottom left
 	float3 start_Pos = float3(input.tex.x, start_Y, start_Z);
-	float3 ndc_Pos = (2.0 * start_Pos) - 1.0;
+	// WORKNOTE: only x and y get remapped, d3d depth is already in [0, 1] ndc (remapping z as well pulled every reconstructed point towards the camera)
+	float3 ndc_Pos = float3((2.0 * start_Pos.xy) - 1.0, start_Pos.z);
 	float4 unproject = mul(float4(ndc_Pos.x, ndc_Pos.y, ndc_Pos.z, 1.0), invCamPj);
 	float3 viewPos = unproject.xyz / unproject.w;
-	float3 viewNorm = normal_map.Sample(sampler_default, input.tex).xyz;
+	float3 viewNorm = decodeNormalOct(normal_map.Sample(sampler_default, input.tex).xy);
 
 	// WORKNOTE: start_Z was a huge negative value at one point because we had a D16_UNORM depth target
 	// but we set the shader resource view format to R16_FLOAT instead of R16_UNORM
@@ -101,7 +104,7 @@ float4 PixelMain(PSInput input) : SV_TARGET
 
             float off_start_Z = depth_map.Sample(sampler_default, offTex).r;
             float3 off_start_Pos = float3(offTex.x, start_Y + sampleOffset.y, off_start_Z);
-            float3 off_ndc_Pos = (2.0 * off_start_Pos) - 1.0;
+            float3 off_ndc_Pos = float3((2.0 * off_start_Pos.xy) - 1.0, off_start_Pos.z);
             float4 off_unproject = mul(float4(off_ndc_Pos.x, off_ndc_Pos.y, off_ndc_Pos.z, 1.0), invCamPj);
             float3 off_viewPos = off_unproject.xyz / off_unproject.w;
             // we now have the view space position of the offset point
@@ -1,43 +1,29 @@
 #include <Windows.h>
 #include "dxbase.h"
-#include "shader.h"
 #include "camera.h"
 #include "obj.h"
-#include "framebuffer.h"
-#include "sampler.h"
+#include "aosample.h"
 
 #define MOUSE_SENSITIVITY 20.f
 #define MOVESPEED 0.05f
+// the servbots of the instanced field, FIELD_SIZE x FIELD_SIZE of them FIELD_SPACING apart, toggled with FIELD_KEY
+// (off at the start, cpubench's instancing bench has the same field)
+#define FIELD_SIZE 100
+#define FIELD_SPACING 5.f
+#define FIELD_KEY KEY_F
 
 DxBase *window;
 FirstPersonCamera cam;
-
-struct VERTEX
-{
-	FLOAT x, y, z;
-	D3DXCOLOR color;
-};
-
-struct MVPMatrices
-{
-	D3DXMATRIX model, view, proj;
-};
+AoSample *sample;
 
 long OnResize(DxBase &wnd, HWND hwnd, WPARAM wparam, LPARAM lparam)
 {
 	wnd.resize(LOWORD(lparam), HIWORD(lparam));
 	cam.init(45, wnd.getAspect(), 1.f, 500.f);
-	
-	D3D11_VIEWPORT viewport;
-	ZeroMemory(&viewport, sizeof(D3D11_VIEWPORT));
-	viewport.TopLeftX = 0;
-	viewport.TopLeftY = 0;
-	viewport.Width = FLOAT(window->getWidth());
-	viewport.Height = FLOAT(window->getHeight());
-	viewport.MinDepth = 0.f;
-	viewport.MaxDepth = 1.0f; // WORKNOTE: if you don't set these on resize, things mess up; what are the defaults?
-
-	wnd.getDeviceContext().RSSetViewports(1, &viewport);
+	// the viewport is set by AoSample every frame
+	if (sample) {
+		sample->resize(wnd.getWidth(), wnd.getHeight());
+	}
 	return 0;
 }
 
@@ -48,93 +34,35 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	wnd.addMessageHandler(WM_SIZE, OnResize);
 	wnd.showWindow(nShowCmd);
 	
-	ID3D11Device &dev = wnd.getDevice();
-	ID3D11DeviceContext &devcon = wnd.getDeviceContext();
-
-	D3D11_VIEWPORT viewport;
-	ZeroMemory(&viewport, sizeof(D3D11_VIEWPORT));
-	viewport.TopLeftX = 0;
-	viewport.TopLeftY = 0;
-	viewport.Width = FLOAT(window->getWidth());
-	viewport.Height = FLOAT(window->getHeight());
-	viewport.MinDepth = 0.f;
-	viewport.MaxDepth = 1.0f;
-
-	devcon.RSSetViewports(1, &viewport);
+	RenderDevice &dev = wnd.getRenderDevice();
+	RenderContext &devcon = wnd.getRenderContext();
 
 	cam.init(45, wnd.getAspect(), 1.f, 500.f);
 	cam.setPos(fl3(0, 10, -10)); // negative starting position for LH coordinate system
 
-	// shaders
-	VertexShader ssao_vs (dev, L"ssao.hlsl");
-	PixelShader ssao_ps (dev, L"ssao.hlsl");
-	VertexShader prepassvs (dev, L"prepass.hlsl");
-	PixelShader prepassps (dev, L"prepass.hlsl");
-	VertexShader hbao_vs (dev, L"hbao.hlsl");
-	PixelShader hbao_ps (dev, L"hbao.hlsl");
-	VertexShader blit_vs (dev, L"blit.hlsl");
-	PixelShader blit_ps (dev, L"blit.hlsl");
-	ComputeShader blur_cs (dev, L"computeblur.hlsl");
-
-	// framebuffers
-	FramebufferParams params;
-	params.width = wnd.getWidth();
-	params.height = wnd.getHeight();
-	params.numSamples = 1;
-	params.numMrts = 1;
-	// WORKNOTE: I tried using R11G11B10_FLOAT format here, but it has no sign bit
-	// so normals were positive only
-	// R32G32B32 throws an error on texture creation for some reason
-	// it seems that it is only optionally supported by certain hardware
-	params.colorFormats.push_back(DXGI_FORMAT_R32G32B32A32_FLOAT);
-	params.depthEnable = true;
-	params.depthFormat = DXGI_FORMAT_D16_UNORM;
-	Framebuffer prepassfb (dev, params);
-
-	params.depthEnable = false;
-	Framebuffer finalbuf (dev, params);
-
-	params.colorFormats.clear();
-	params.colorFormats.push_back(DXGI_FORMAT_R32_FLOAT);
-	params.depthEnable = false;
-	Framebuffer aobuf (dev, params);
-
-	// depth test on/off state if necessary
-	D3D11_DEPTH_STENCIL_DESC depthOnDesc;
-	ZeroMemory(&depthOnDesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
-	depthOnDesc.DepthEnable = true;
-	depthOnDesc.DepthFunc = D3D11_COMPARISON_LESS;
-	depthOnDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-	depthOnDesc.StencilEnable = false;
-	ID3D11DepthStencilState *depthOnState = 0;
-	dev.CreateDepthStencilState(&depthOnDesc, &depthOnState);
-
-	D3D11_DEPTH_STENCIL_DESC depthOffDesc;
-	ZeroMemory(&depthOffDesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
-	depthOffDesc.DepthEnable = false;
-	depthOffDesc.StencilEnable = false;
-	ID3D11DepthStencilState *depthOffState = 0;
-	dev.CreateDepthStencilState(&depthOffDesc, &depthOffState);
-
-	// temporarily putting my vertex buffer init stuff here
-	VERTEX vertices[] =
-	{
-		{0.0f, 0.5f, 0.0f, D3DXCOLOR(1.0f, 0.0f, 0.0f, 1.0f)},
-		{0.45f, -0.5, 0.0f, D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f)},
-		{-0.45f, -0.5f, 0.0f, D3DXCOLOR(0.0f, 0.0f, 1.0f, 1.0f)}
-	};
-	// try doing it with the mesh class instead
-	InterleavedMesh<VERTEX, UINT8> mesh (D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	mesh.addVert(vertices[0])
-		.addVert(vertices[1])
-		.addVert(vertices[2]);
-	mesh.addInd(0).addInd(1).addInd(2);
-	mesh.finalize(dev);
-
-	Obj servbot (dev, devcon, L"../assets/ServerBot1.obj");
+	// shaders, framebuffers, the full screen quad and the constant buffers of the frame
+	sample = new AoSample(dev, wnd.getWidth(), wnd.getHeight());
+
+	// every Obj's materials go into one table, uploaded once they're all loaded
+	MaterialTable materials;
+	Obj servbot (dev, devcon, L"../assets/ServerBot1.obj", &materials);
+	materials.finalize(dev);
+
+	// a field of copies behind it, drawn instanced and culled to the camera every frame it's shown
+	bool showfield = false;
+	std::vector<ObjInstance> field;
+	for (int z = 0; z < FIELD_SIZE; z++) {
+		for (int x = 0; x < FIELD_SIZE; x++) {
+			Matrix model;
+			model.translate(FIELD_SPACING * (x - FIELD_SIZE / 2), 0.f, 60.f + FIELD_SPACING * z);
+			model.rotate((float) ((x * 37 + z * 101) % 360), 0.f, 1.f, 0.f);
+			field.push_back(ObjInstance::FromMatrix(model));
+		}
+	}
+	ObjInstanceBuffer fieldinstances (dev, (unsigned int) field.size());
 
 	// ground plane
-	InterleavedMesh<PTNvert, UINT8> gquad (D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<PTNvert, uint8_t> gquad (TOPOLOGY_TRIANGLELIST);
 	PTNvert gv;
 	gv.norm = fl3(0, 1, 0);
 	gv.pos = fl3(-50, 0, -50); gv.tex = fl3(0, 1, 0); gquad.addVert(gv);
@@ -144,77 +72,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	gquad.addInd(0).addInd(1).addInd(3).addInd(0).addInd(3).addInd(2);
 	gquad.finalize(dev);
 
-	// full screen quad
-	InterleavedMesh<PTvert, UINT8> quad (D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	PTvert v;
-	v.pos = fl3(0, 0, 0); v.tex = fl3(0, 1, 0); quad.addVert(v);
-	v.pos = fl3(1, 0, 0); v.tex = fl3(1, 1, 0); quad.addVert(v);
-	v.pos = fl3(0, 1, 0); v.tex = fl3(0, 0, 0); quad.addVert(v);
-	v.pos = fl3(1, 1, 0); v.tex = fl3(1, 0, 0); quad.addVert(v);
-	quad.addInd(0).addInd(2).addInd(1).addInd(1).addInd(2).addInd(3);
-	quad.finalize(dev);
-
-	// matrices for othrographic projection (constant)
-	D3DXMATRIX fsorthoMat;
-	D3DXMatrixOrthoOffCenterLH(&fsorthoMat, 0, 1, 0, 1, 0, 1);
-	D3DXMatrixTranspose(&fsorthoMat, &fsorthoMat);
-	ID3D11Buffer *fsorthoBuffer = 0;
-	D3D11_BUFFER_DESC fsorthoDesc;
-	D3D11_SUBRESOURCE_DATA fsorthoSubr;
-	fsorthoDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	fsorthoDesc.ByteWidth = sizeof(D3DXMATRIX); // only need projection
-	fsorthoDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	fsorthoDesc.CPUAccessFlags = 0;
-	fsorthoDesc.MiscFlags = 0;
-	fsorthoDesc.StructureByteStride = 0;
-	ZeroMemory(&fsorthoSubr, sizeof(D3D11_SUBRESOURCE_DATA));
-	fsorthoSubr.pSysMem = &fsorthoMat;
-	dev.CreateBuffer(&fsorthoDesc, &fsorthoSubr, &fsorthoBuffer);
-
-	// create input layout
-	// TODO: should this be a property of the mesh or its own separate thing?
-	D3D11_INPUT_ELEMENT_DESC ied[] = 
-	{
-		//{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		//{"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
-		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"TEXCOORD", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0}
-	};
-	// WORKNOTE: input element descriptor must exactly match fields in the shader source
-	// and setInputLayout must be called with the correct number of items or else
-	// input layout creation will fail
-	ID3D11InputLayout *pFsLayout = ssao_vs.setInputLayout(dev, ied, 2);
-	ID3D11InputLayout *pPrepassLayout = prepassvs.setInputLayout(dev, ied, 3);
-	//devcon.IASetInputLayout(pLayout);
-
-	// struct and buffer for camera matrices
-	MVPMatrices matrices;
-	ID3D11Buffer *matrixBuffer = 0;
-	D3D11_BUFFER_DESC matrixBufferDesc;
-	D3D11_MAPPED_SUBRESOURCE cbufresource;
-	// descriptor for constant buffer object
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MVPMatrices);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-	dev.CreateBuffer(&matrixBufferDesc, NULL, &matrixBuffer);
-
-	// extras for inverse projection matrix (used for reconstruction)
-	D3DXMATRIX invCamPj;
-	ID3D11Buffer *invCamPjBuffer = 0;
-	D3D11_BUFFER_DESC invCamPjBufferDesc;
-	D3D11_MAPPED_SUBRESOURCE invCamPjResource;
-	invCamPjBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	invCamPjBufferDesc.ByteWidth = sizeof(D3DXMATRIX);
-	invCamPjBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	invCamPjBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	invCamPjBufferDesc.MiscFlags = 0;
-	invCamPjBufferDesc.StructureByteStride = 0;
-	dev.CreateBuffer(&invCamPjBufferDesc, NULL, &invCamPjBuffer);
-
 	while (window->isActive()) {
 		window->update();
 
@@ -222,6 +79,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 			window->close();
 			break;
 		}
+		if (window->isKeyPress(FIELD_KEY)) {
+			showfield = !showfield;
+		}
 		if (window->isMousePress(MOUSE_RIGHT)) {
             window->hideCursor();
             window->holdCursor(true);
@@ -258,89 +118,32 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         tomove *= MOVESPEED * window->getdtBetweenUpdates();
         cam.move(tomove);
 
-		// do graphics stuff
-		prepassfb.use(devcon);
-		prepassfb.clear(devcon, D3DXCOLOR(0.0f, 0.0f, 0.0f, 0.0f));
-
 		// matrix stuff
-		cam.toMatrixView(matrices.view);
-		cam.toMatrixProj(matrices.proj);
-		D3DXMatrixIdentity(&matrices.model);
-		D3DXMatrixInverse(&invCamPj, NULL, &matrices.proj);
-
-		// transpose necessary for D3D11 (and OpenGL)
-		D3DXMatrixTranspose(&matrices.model, &matrices.model);
-		D3DXMatrixTranspose(&matrices.view, &matrices.view);
-		D3DXMatrixTranspose(&matrices.proj, &matrices.proj);
-		D3DXMatrixTranspose(&invCamPj, &invCamPj); // we can just use the inverse of the transpose here
-
-		// update the constant buffers
-		devcon.Map(matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &cbufresource);
-		memcpy(cbufresource.pData, &matrices, sizeof(MVPMatrices));
-		devcon.Unmap(matrixBuffer, 0);
-		devcon.Map(invCamPjBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &invCamPjResource);
-		memcpy(invCamPjResource.pData, &invCamPj, sizeof(D3DXMATRIX));
-		devcon.Unmap(invCamPjBuffer, 0);
-
-		// set the constant buffer in the shader itself (slot 0 for now)
-		devcon.VSSetConstantBuffers(0, 1, &matrixBuffer);
-
-		// WORKNOTE: not setting shaders caused driver crash
-		devcon.VSSetShader(prepassvs.get(), 0, 0);
-		devcon.PSSetShader(prepassps.get(), 0, 0);
-
-		devcon.IASetInputLayout(pPrepassLayout);
-
-		// drawing
-		servbot.draw(dev, devcon);
-		gquad.draw(dev, devcon);
-
-		//wnd.useDefaultFramebuffer();
-		//devcon.ClearRenderTargetView(&wnd.getBackBuffer(), D3DXCOLOR(0.0f, 0.0f, 0.0f, 0.0f));
-		//devcon.ClearDepthStencilView(&wnd.getDepthBuffer(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-		aobuf.use(devcon);
-		aobuf.clear(devcon, D3DXCOLOR(1.0f, 0.0f, 0.0f, 1.0f));
-		
-		// draw full screen quad for post process
-		devcon.VSSetConstantBuffers(0, 1, &fsorthoBuffer);
-		devcon.PSSetConstantBuffers(1, 1, &invCamPjBuffer);
-		devcon.VSSetShader(hbao_vs.get(), 0, 0);
-		devcon.PSSetShader(hbao_ps.get(), 0, 0);
-		devcon.IASetInputLayout(pFsLayout);
-
-		prepassfb.useColorResources(devcon, 0, 1);
-		prepassfb.useDepthResource(devcon, 1);
-		Sampler::GetDefaultSampler(dev).use(devcon, 0);
-
-		quad.draw(dev, devcon);
-
-		// filter ao results eventually
-		wnd.useDefaultFramebuffer();
-		devcon.CSSetShader(blur_cs.get(), 0, 0);
-		aobuf.useColorResources(devcon, 0, 1);
-		finalbuf.useColorUAVs(devcon, 0, 1);
-
-		const int2 computeSize = int2(ceil(window->getWidth() / 16.0), ceil(window->getHeight() / 16.0));
-		devcon.Dispatch(computeSize.x, computeSize.y, 1);
-
-		// WORKNOTE: have to unbind the uav before we use the texture as input to blit
-		ID3D11UnorderedAccessView *const nullarr[1] = { nullptr};
-		devcon.CSSetUnorderedAccessViews(0, 1, nullarr, 0);
+		D3DXMATRIX camView, camProj;
+		cam.toMatrixView(camView);
+		cam.toMatrixProj(camProj);
+		Matrix view, proj;
+		view.loadMatrix((const float *) &camView);
+		proj.loadMatrix((const float *) &camProj);
+
+		if (showfield) {
+			fieldinstances.update(dev, devcon, &field[0], field.size(), servbot.getMin(), servbot.getMax(), view, proj);
+		}
 
-		// view final results
-		devcon.ClearRenderTargetView(&wnd.getBackBuffer(), D3DXCOLOR(0.0f, 1.0f, 0.0f, 1.0f));
-		devcon.ClearDepthStencilView(&wnd.getDepthBuffer(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-		devcon.VSSetShader(blit_vs.get(), 0, 0);
-		devcon.PSSetShader(blit_ps.get(), 0, 0);
-		
-		//aobuf.useColorResources(devcon, 0, 1);
-		finalbuf.useColorResources(devcon, 0, 1);
-		quad.draw(dev, devcon);
-		//finalbuf.blit(*window);
+		sample->render(view, proj, [&](RenderContext &context) {
+			servbot.draw(dev, context);
+			gquad.draw(dev, context);
+			if (showfield) {
+				sample->useInstancedPrepass(context);
+				servbot.drawInstanced(dev, context, fieldinstances);
+			}
+		});
 
 		wnd.finishFrame();
 		Sleep(1);
 	}
+	delete sample;
+	sample = 0;
 	delete window;
 	return 0;
 }
\ No newline at end of file
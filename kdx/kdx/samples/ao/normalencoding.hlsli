@@ -0,0 +1,66 @@
+// packed normal encodings for the prepass target, the gpu side of src/normalencoding.h
+// the float2 functions work in [-1, 1] and go straight into an snorm target (R8G8_SNORM, R16G16_SNORM),
+// the 24 bit ones pack two 12 bit values into the rgb of an R8G8B8A8_UNORM target
+
+float2 signNotZero(float2 v)
+{
+	return float2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// octahedral: project onto |x| + |y| + |z| = 1 and fold the lower half over the diagonals, any unit vector
+float2 encodeNormalOct(float3 n)
+{
+	float2 e = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+	if (n.z < 0.0) {
+		e = (1.0 - abs(e.yx)) * signNotZero(e);
+	}
+	return e;
+}
+
+float3 decodeNormalOct(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(e.yx)) * signNotZero(e);
+	}
+	return normalize(n);
+}
+
+// spheremap (lambert azimuthal equal-area) around -z, view space normals only: the pole pointing away from the camera
+// can't be represented, but those normals are never visible
+float2 encodeNormalSpheremap(float3 n)
+{
+	return n.xy * (2.0 / sqrt(max(8.0 - 8.0 * n.z, 1e-12)));
+}
+
+float3 decodeNormalSpheremap(float2 e)
+{
+	float2 fenc = 2.0 * e;
+	float f = dot(fenc, fenc);
+	float g = sqrt(max(1.0 - 0.25 * f, 0.0));
+	return normalize(float3(fenc * g, 0.5 * f - 1.0));
+}
+
+// [-1, 1]^2 as 2 x 12 bits in three 8 bit unorm channels: x low byte, x high nibble | y low nibble, y high byte
+float3 pack24(float2 e)
+{
+	uint2 q = (uint2) (saturate(e * 0.5 + 0.5) * 4095.0 + 0.5);
+	return float3(q.x & 0xff, (q.x >> 8) | ((q.y & 0xf) << 4), q.y >> 4) / 255.0;
+}
+
+float2 unpack24(float3 rgb)
+{
+	uint3 b = (uint3) (rgb * 255.0 + 0.5);
+	uint2 q = uint2(b.x | ((b.y & 0xf) << 8), (b.y >> 4) | (b.z << 4));
+	return q * (2.0 / 4095.0) - 1.0;
+}
+
+float3 encodeNormalOct24(float3 n)
+{
+	return pack24(encodeNormalOct(n));
+}
+
+float3 decodeNormalOct24(float3 rgb)
+{
+	return decodeNormalOct(unpack24(rgb));
+}
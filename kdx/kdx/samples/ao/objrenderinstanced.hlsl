@@ -0,0 +1,93 @@
+// objrender.hlsl for instanced draws (Obj::drawInstanced), every instance has its own model transform and can replace
+// the materials of the Obj with one of the MaterialTable
+// matrices, model applies after the instance's transform
+cbuffer Matrices : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix proj;
+};
+
+// the mesh's material, a range of the table
+cbuffer ObjMaterial : register(b1)
+{
+	float Ns : packoffset(c0);
+	float Ni : packoffset(c0.y);
+	float Tr : packoffset(c0.z);
+	float3 Tf : packoffset(c1);
+	uint illum : packoffset(c1.w);
+	float3 Ka : packoffset(c2);
+	float3 Kd : packoffset(c3);
+	float3 Ks : packoffset(c4);
+	float3 Ke : packoffset(c5);
+};
+
+// the whole table (its first 256 materials), each material is 16 constants laid out like ObjMaterial above
+#define MATERIAL_TABLE_SIZE 256
+#define NO_MATERIAL_OVERRIDE 0xffffffff
+struct MaterialSlot
+{
+	float4 c[16];
+};
+cbuffer MaterialTable : register(b2)
+{
+	MaterialSlot materials[MATERIAL_TABLE_SIZE];
+};
+
+// textures
+Texture2D map_Ka : register(t0);
+Texture2D map_Kd : register(t1);
+Texture2D map_Ks : register(t2);
+// samplers
+SamplerState sampler_default : register(s0);
+
+// vertex shader input, the TRANSFORM and MATERIAL elements step per instance (ObjInstance)
+struct VSInput
+{
+	float4 pos : POSITION;
+	float4 tex : TEXCOORD;
+	float4 norm : NORMAL;
+	// the first three columns of the instance's model matrix
+	float4 transform0 : TRANSFORM0;
+	float4 transform1 : TRANSFORM1;
+	float4 transform2 : TRANSFORM2;
+	uint material : MATERIAL;
+};
+
+struct PSInput
+{
+	float4 pos : SV_POSITION;
+	float4 tex : TEXCOORD;
+	nointerpolation uint material : MATERIAL;
+};
+
+PSInput VertexMain(VSInput input)
+{
+	PSInput output;
+
+	input.pos.w = 1.0f;
+	const float4 instancePos = float4(dot(input.pos, input.transform0), dot(input.pos, input.transform1), dot(input.pos, input.transform2), 1.0f);
+	output.pos = mul(instancePos, model);
+	output.pos = mul(output.pos, view);
+	output.pos = mul(output.pos, proj);
+	output.tex = input.tex;
+	output.material = input.material;
+
+	return output;
+}
+
+float4 PixelMain(PSInput input) : SV_TARGET
+{
+	// the colors of the override, or of the mesh's own material
+	float3 ka = Ka, kd = Kd, ks = Ks;
+	if (input.material != NO_MATERIAL_OVERRIDE) {
+		ka = materials[input.material].c[2].rgb;
+		kd = materials[input.material].c[3].rgb;
+		ks = materials[input.material].c[4].rgb;
+	}
+	float4 final = float4(0, 0, 0, 0);
+	final += float4(ka.r, ka.g, ka.b, 1.0) * map_Ka.Sample(sampler_default, input.tex.xy);
+	final += float4(kd.r, kd.g, kd.b, 1.0) * map_Kd.Sample(sampler_default, input.tex.xy);
+	final += float4(ks.r, ks.g, ks.b, 1.0) * map_Ks.Sample(sampler_default, input.tex.xy);
+	return final;
+}
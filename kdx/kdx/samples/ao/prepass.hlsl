@@ -1,4 +1,7 @@
 // prepass shader for generating depth and normal buffers for ssao
+// normals are stored in view space, octahedral encoded into an R16G16_SNORM target (see normalencoding.hlsli)
+
+#include "normalencoding.hlsli"
 
 // matrices
 cbuffer Matrices : register(b0)
@@ -35,13 +38,13 @@ PSInput VertexMain(VSInput input)
 	output.pos = mul(input.pos, model);
 	output.pos = mul(output.pos, view);
 	output.pos = mul(output.pos, proj);
-	output.norm = input.norm;
+	// WORKNOTE: model and view are rotations (plus uniform scale), so they transform normals as they are
+	output.norm = mul(mul(input.norm, (float3x3) model), (float3x3) view);
 
 	return output;
 }
 
-float3 PixelMain(PSInput input) : SV_TARGET
+float2 PixelMain(PSInput input) : SV_TARGET
 {
-	float3 final = input.norm.xyz;
-	return final;
+	return encodeNormalOct(normalize(input.norm));
 }
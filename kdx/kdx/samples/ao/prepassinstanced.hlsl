@@ -0,0 +1,51 @@
+// prepass.hlsl for instanced draws (Obj::drawInstanced), every instance has its own model transform
+// the pixel shader is the same as prepass.hlsl's
+
+#include "normalencoding.hlsli"
+
+// matrices, model applies after the instance's transform
+cbuffer Matrices : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix proj;
+};
+
+// vertex shader input, the TRANSFORM and MATERIAL elements step per instance (ObjInstance)
+struct VSInput
+{
+	float4 pos : POSITION;
+	float4 tex : TEXCOORD;
+	float3 norm : NORMAL;
+	// the first three columns of the instance's model matrix
+	float4 transform0 : TRANSFORM0;
+	float4 transform1 : TRANSFORM1;
+	float4 transform2 : TRANSFORM2;
+};
+
+struct PSInput
+{
+	float4 pos : SV_POSITION;
+	float3 norm : NORMAL;
+};
+
+PSInput VertexMain(VSInput input)
+{
+	PSInput output;
+
+	input.pos.w = 1.0f;
+	const float4 instancePos = float4(dot(input.pos, input.transform0), dot(input.pos, input.transform1), dot(input.pos, input.transform2), 1.0f);
+	output.pos = mul(instancePos, model);
+	output.pos = mul(output.pos, view);
+	output.pos = mul(output.pos, proj);
+	// WORKNOTE: instance transforms are rotations (plus uniform scale) too, so they transform normals as they are
+	const float3 instanceNorm = float3(dot(input.norm, input.transform0.xyz), dot(input.norm, input.transform1.xyz), dot(input.norm, input.transform2.xyz));
+	output.norm = mul(mul(instanceNorm, (float3x3) model), (float3x3) view);
+
+	return output;
+}
+
+float2 PixelMain(PSInput input) : SV_TARGET
+{
+	return encodeNormalOct(normalize(input.norm));
+}
@@ -0,0 +1,473 @@
+#include "bench.h"
+#include "scene.h"
+#include "ambientocclusion.h"
+#include "depthpyramid.h"
+#include "temporalao.h"
+#include "deinterleave.hpp"
+#include "lineardepth.h"
+#include "raytracedao.h"
+#include "imagemetrics.h"
+#include "blur.h"
+#include "constants.h"
+#include <math.h>
+#include <algorithm>
+#include <unordered_set>
+
+// cpu ao passes over the software prepass of the ao sample scene
+
+#define AO_WIDTH 1920
+#define AO_HEIGHT 1080
+#define AO_BUILD_REPS 10
+#define AO_PYRAMID_LEVELS 6
+// 8x8 pixel blocks whose tap footprint is measured, spread over the screen
+#define AO_FOOTPRINT_BLOCKS 64
+#define AO_CACHE_LINE_FLOATS 16
+// temporal accumulation along the scripted camera path, at a lower resolution since every frame also runs the reference
+#define TEMPORAL_WIDTH 960
+#define TEMPORAL_HEIGHT 540
+#define TEMPORAL_FRAMES 24
+#define TEMPORAL_DIRECTIONS 2
+// presets run every kernel twice, so also at the lower resolution
+#define PRESET_WIDTH 960
+#define PRESET_HEIGHT 540
+#define PRESET_AO_REPS 3
+#define PRESET_BLUR_REPS 5
+// hemisphere rays per pixel of the ray traced reference
+#define REFERENCE_RAYS 16
+
+static float meanDifference(const FloatImage &a, const FloatImage &b)
+{
+	double diff = 0.0;
+	for (int y = 0; y < a.getHeight(); y++) {
+		for (int x = 0; x < a.getWidth(); x++) {
+			diff += fabs(a.at(x, y) - b.at(x, y));
+		}
+	}
+	return (float) (diff / ((double) a.getWidth() * a.getHeight()));
+}
+
+static float rmsDifference(const FloatImage &a, const FloatImage &b)
+{
+	double sum = 0.0;
+	for (int y = 0; y < a.getHeight(); y++) {
+		for (int x = 0; x < a.getWidth(); x++) {
+			const double d = a.at(x, y) - b.at(x, y);
+			sum += d * d;
+		}
+	}
+	return (float) sqrt(sum / ((double) a.getWidth() * a.getHeight()));
+}
+
+// plain bilinear upsample with the same texel alignment as AmbientOcclusion::upsample, to show what the weights buy
+static void bilinearUpsample(const FloatImage &low, FloatImage &out)
+{
+	const float scaleX = (float) low.getWidth() / out.getWidth();
+	const float scaleY = (float) low.getHeight() / out.getHeight();
+	for (int y = 0; y < out.getHeight(); y++) {
+		const float ly = (y + 0.5f) * scaleY - 0.5f;
+		const int ty = (int) floorf(ly);
+		const float fy = ly - ty;
+		for (int x = 0; x < out.getWidth(); x++) {
+			const float lx = (x + 0.5f) * scaleX - 0.5f;
+			const int tx = (int) floorf(lx);
+			const float fx = lx - tx;
+			const float top = (1.f - fx) * low.clampedAt(tx, ty) + fx * low.clampedAt(tx + 1, ty);
+			const float bottom = (1.f - fx) * low.clampedAt(tx, ty + 1) + fx * low.clampedAt(tx + 1, ty + 1);
+			out.at(x, y) = (1.f - fy) * top + fy * bottom;
+		}
+	}
+}
+
+// distinct depth cache lines the hbao taps of an 8x8 block touch, averaged over a spread of blocks
+// walks the same tap pattern as AmbientOcclusion::hbao without doing the math, as a portable stand-in for cache miss counters
+static float hbaoFootprint(const DepthPyramid *pyramid, const AoParams &params, int width, int height)
+{
+	std::unordered_set<unsigned long long> lines;
+	size_t total = 0;
+	const float increment = 2.f * M_PI / params.numDirections;
+	for (int b = 0; b < AO_FOOTPRINT_BLOCKS; b++) {
+		const int bx = ((b % 8) * width / 8 + width / 16) & ~7;
+		const int by = ((b / 8) * height / 8 + height / 16) & ~7;
+		lines.clear();
+		for (int y = by; y < by + 8; y++) {
+			for (int x = bx; x < bx + 8; x++) {
+				const float u = (x + 0.5f) / width, v = (y + 0.5f) / height;
+				for (int i = 0; i < params.numDirections; i++) {
+					const float dx = cosf(i * increment), dy = sinf(i * increment);
+					for (int j = 0; j < params.numSteps; j++) {
+						const float step = (j + 1) * params.samplingStep;
+						const float pixels = sqrtf(step * dx * width * step * dx * width + step * dy * height * step * dy * height);
+						const int level = pyramid ? pyramid->levelForOffset(pixels) : 0;
+						const int levelWidth = (width + (1 << level) - 1) >> level;
+						const int levelHeight = (height + (1 << level) - 1) >> level;
+						int tx = (int) floorf((u + step * dx) * width) >> level;
+						int ty = (int) floorf((v - step * dy) * height) >> level;
+						tx = tx < 0 ? 0 : (tx >= levelWidth ? levelWidth - 1 : tx);
+						ty = ty < 0 ? 0 : (ty >= levelHeight ? levelHeight - 1 : ty);
+						lines.insert(((unsigned long long) level << 48) | ((unsigned long long) ty << 24) | (tx / AO_CACHE_LINE_FLOATS));
+					}
+				}
+			}
+		}
+		total += lines.size();
+	}
+	return (float) total / AO_FOOTPRINT_BLOCKS;
+}
+
+void benchHiZ()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(AO_WIDTH, AO_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+
+	AoInput input;
+	input.normals = &rast.getNormals();
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+
+	DepthPyramid pyramid;
+	const double buildms = timeBest(AO_BUILD_REPS, [&]() { pyramid.build(rast.getDepth(), AO_PYRAMID_LEVELS); });
+	input.pyramid = &pyramid;
+	printf("%dx%d, %d level min/max/avg pyramid built in %.2f ms\n", AO_WIDTH, AO_HEIGHT, pyramid.getNumLevels(), buildms);
+
+	// hbao with the step stretched so the last tap lands radius pixels out, the view space radius grows along with it
+	AmbientOcclusion ao;
+	FloatImage full, mipped;
+	const int radii[] = { 8, 16, 32, 64, 128, 256 };
+	// lines/block is the number of distinct 64 byte depth lines the taps of an 8x8 pixel block read
+	printf("hbao, ms for 1 run\n");
+	printf("radius px\tfull ms\thi-z ms\tfull lines/block\thi-z lines/block\tmean abs diff\n");
+	for (int i = 0; i < 6; i++) {
+		AoParams params;
+		params.samplingStep = (float) radii[i] / (params.numSteps * AO_WIDTH);
+		params.samplingRadius = 0.5f * radii[i] / 16.f;
+		params.useDepthPyramid = false;
+		const double fullms = timeBest(1, [&]() { ao.hbao(input, params, full); });
+		const float fullLines = hbaoFootprint(0, params, AO_WIDTH, AO_HEIGHT);
+		params.useDepthPyramid = true;
+		const double mipms = timeBest(1, [&]() { ao.hbao(input, params, mipped); });
+		const float mipLines = hbaoFootprint(&pyramid, params, AO_WIDTH, AO_HEIGHT);
+		printf("%d\t\t%.1f\t%.1f\t%.1f\t\t\t%.1f\t\t\t%.4f\n", radii[i], fullms, mipms, fullLines, mipLines, meanDifference(full, mipped));
+		if (getenv("CPUBENCH_DUMP") && radii[i] == 64) {
+			saveBenchImage("hbao_full.pgm", full);
+			saveBenchImage("hbao_hiz.pgm", mipped);
+		}
+	}
+}
+
+void benchAoResolution()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(AO_WIDTH, AO_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+
+	AoInput input;
+	input.normals = &rast.getNormals();
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+
+	// default hbao.hlsl parameters, full resolution is the reference
+	AmbientOcclusion ao;
+	AoParams params;
+	FloatImage reference, low, out, bilinear (AO_WIDTH, AO_HEIGHT);
+	const double fullms = timeBest(1, [&]() { ao.hbao(input, params, reference); });
+	printf("%dx%d hbao, ms for 1 run, errors against full resolution\n", AO_WIDTH, AO_HEIGHT);
+	printf("mode\tdownsample\tao\tupsample\ttotal\trms\t\tmean abs\tbilinear rms\n");
+	printf("full\t-\t\t%.1f\t-\t\t%.1f\t-\t\t-\t\t-\n", fullms, fullms);
+
+	const AO_RESOLUTION modes[] = { AO_RESOLUTION_HALF, AO_RESOLUTION_QUARTER };
+	const char *names[] = { "half", "quarter" };
+	for (int i = 0; i < 2; i++) {
+		AoInput reduced;
+		const double downms = timeBest(AO_BUILD_REPS, [&]() { ao.downsample(input, modes[i], reduced); });
+		const double aoms = timeBest(1, [&]() { ao.hbao(reduced, params, low); });
+		const double upms = timeBest(AO_BUILD_REPS, [&]() { ao.upsample(low, reduced, input, out); });
+		bilinearUpsample(low, bilinear);
+		printf("%s\t%.2f\t\t%.1f\t%.2f\t\t%.1f\t%.4f\t\t%.4f\t\t%.4f\n", names[i], downms, aoms, upms, downms + aoms + upms,
+			rmsDifference(out, reference), meanDifference(out, reference), rmsDifference(bilinear, reference));
+		if (getenv("CPUBENCH_DUMP")) {
+			char filename[64];
+			sprintf(filename, "hbao_%s.pgm", names[i]);
+			saveBenchImage(filename, out);
+		}
+	}
+}
+
+void benchTemporalAo()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(TEMPORAL_WIDTH, TEMPORAL_HEIGHT);
+
+	// reference is the default 8 direction hbao every frame, the temporal path runs 2 rotated directions per frame
+	AmbientOcclusion ao;
+	TemporalAo temporal;
+	AoParams refParams, params;
+	params.numDirections = TEMPORAL_DIRECTIONS;
+	temporal.setPeriod(refParams.numDirections / TEMPORAL_DIRECTIONS);
+
+	FloatImage reference, current, accumulated;
+	double refTotal = 0.0, temporalTotal = 0.0, singleRms = 0.0, temporalRms = 0.0;
+	int converged = 0;
+	printf("%dx%d, %d frames along the bench camera path, hbao %d directions vs %d per frame accumulated\n",
+		TEMPORAL_WIDTH, TEMPORAL_HEIGHT, TEMPORAL_FRAMES, refParams.numDirections, TEMPORAL_DIRECTIONS);
+	printf("frame\treference ms\ttemporal ms\tsingle frame rms\ttemporal rms\taccepted\n");
+	for (int frame = 0; frame < TEMPORAL_FRAMES; frame++) {
+		fl3 pos;
+		fl2 rot;
+		benchCameraPath(frame, TEMPORAL_FRAMES, pos, rot);
+		Matrix view, proj;
+		renderBenchPrepass(scene, pos, rot, rast, view, proj);
+		AoInput input;
+		input.normals = &rast.getNormals();
+		input.depth = &rast.getDepth();
+		proj.getInverse(input.invProj);
+
+		const double refms = timeBest(1, [&]() { ao.hbao(input, refParams, reference); });
+		params.rotation = temporal.getRotation(params);
+		const double temporalms = timeBest(1, [&]() {
+			ao.hbao(input, params, current);
+			temporal.accumulate(input, view, proj, current, accumulated);
+		});
+		const TemporalAo::Stats &stats = temporal.getStats();
+		const float single = rmsDifference(current, reference);
+		const float accumulatedRms = rmsDifference(accumulated, reference);
+		const float acceptedPercent = 100.f * stats.accepted / std::max(1u, stats.accepted + stats.rejected);
+		printf("%d\t%.1f\t\t%.1f\t\t%.4f\t\t\t%.4f\t\t%.1f%%\n", frame, refms, temporalms, single, accumulatedRms, acceptedPercent);
+
+		refTotal += refms;
+		temporalTotal += temporalms;
+		// quality is averaged once the history had a full rotation cycle to fill up
+		if (frame >= 2 * refParams.numDirections / TEMPORAL_DIRECTIONS) {
+			singleRms += single;
+			temporalRms += accumulatedRms;
+			converged++;
+		}
+	}
+	printf("average ms: reference %.1f, temporal %.1f\n", refTotal / TEMPORAL_FRAMES, temporalTotal / TEMPORAL_FRAMES);
+	printf("average rms after warm-up: single frame %.4f, temporal %.4f\n", singleRms / converged, temporalRms / converged);
+	if (getenv("CPUBENCH_DUMP")) {
+		saveBenchImage("temporal_reference.pgm", reference);
+		saveBenchImage("temporal_single.pgm", current);
+		saveBenchImage("temporal_accumulated.pgm", accumulated);
+	}
+}
+
+void benchDeinterleave()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(AO_WIDTH, AO_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+
+	AoInput input;
+	input.normals = &rast.getNormals();
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+
+	// the passes on their own
+	std::vector<FloatImage> depthLayers;
+	std::vector<Image<fl3> > normalLayers;
+	FloatImage restored (AO_WIDTH, AO_HEIGHT);
+	const double splitms = timeBest(AO_BUILD_REPS, [&]() {
+		deinterleave(rast.getDepth(), 4, depthLayers);
+		deinterleave(rast.getNormals(), 4, normalLayers);
+	});
+	const double mergems = timeBest(AO_BUILD_REPS, [&]() { reinterleave(depthLayers, 4, restored); });
+	printf("%dx%d, deinterleave depth + normals %.2f ms, reinterleave %.2f ms, round trip %s\n", AO_WIDTH, AO_HEIGHT, splitms, mergems,
+		meanDifference(restored, rast.getDepth()) == 0.f ? "exact" : "MISMATCH");
+
+	// jittered and deinterleaved use the same 16 rotations, so after the usual 4x4 blur both should match the uniform kernel
+	AmbientOcclusion ao;
+	Blur blur;
+	AoParams params;
+	FloatImage uniform, jittered, deinterleaved, blurred;
+	printf("hbao, ms for 1 run\n");
+	printf("sampling\tms\trms vs jittered\tblurred rms vs uniform\n");
+	const char *names[] = { "uniform", "jittered", "deinterleaved" };
+	FloatImage *outs[] = { &uniform, &jittered, &deinterleaved };
+	for (int i = 0; i < 3; i++) {
+		params.sampling = (AO_SAMPLING) i;
+		const double ms = timeBest(1, [&]() { ao.hbao(input, params, *outs[i]); });
+		if (i == 0) {
+			printf("%s\t\t%.1f\t-\t\t-\n", names[i], ms);
+			continue;
+		}
+		blur.box(*outs[i], blurred, 2);
+		printf("%s\t%.1f\t%.4f\t\t%.4f\n", names[i], ms, rmsDifference(*outs[i], jittered), rmsDifference(blurred, uniform));
+		if (getenv("CPUBENCH_DUMP")) {
+			char filename[64];
+			sprintf(filename, "hbao_%s.pgm", names[i]);
+			saveBenchImage(filename, *outs[i]);
+		}
+	}
+}
+
+void benchLinearDepth()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(AO_WIDTH, AO_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+
+	AoInput input;
+	input.normals = &rast.getNormals();
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+
+	LinearDepth linear;
+	const double buildms = timeBest(AO_BUILD_REPS, [&]() { linear.build(rast.getDepth(), input.invProj); });
+	printf("%dx%d, linear depth build %.2f ms, projection %s\n", AO_WIDTH, AO_HEIGHT, buildms,
+		LinearDepth::IsSupported(input.invProj) ? "supported" : "NOT SUPPORTED");
+
+	// exactness against the full unprojection in double precision, relative to the distance from the camera
+	const float *m = input.invProj.data();
+	double maxError = 0.0;
+	for (int y = 0; y < AO_HEIGHT; y++) {
+		for (int x = 0; x < AO_WIDTH; x++) {
+			const double nx = 2.0 * (x + 0.5) / AO_WIDTH - 1.0;
+			const double ny = 1.0 - 2.0 * (y + 0.5) / AO_HEIGHT;
+			const double z = rast.getDepth().at(x, y);
+			double p[4];
+			for (int i = 0; i < 4; i++) {
+				p[i] = m[i] * nx + m[4 + i] * ny + m[8 + i] * z + m[12 + i];
+			}
+			const double px = p[0] / p[3], py = p[1] / p[3], pz = p[2] / p[3];
+			const fl3 q = linear.getPosition(x, y);
+			const double error = sqrt((q.x - px) * (q.x - px) + (q.y - py) * (q.y - py) + (q.z - pz) * (q.z - pz));
+			maxError = std::max(maxError, error / sqrt(px * px + py * py + pz * pz));
+		}
+	}
+	printf("position max relative error vs double unprojection %.2e\n", maxError);
+
+	// the kernels with and without it, the linear input skips the per-tap 4x4 transform and divide
+	AmbientOcclusion ao;
+	AoParams params;
+	AoInput linearInput = input;
+	linearInput.viewZ = &linear.getViewZ();
+	FloatImage unprojected, reconstructed;
+	printf("kernel\tunproject ms\tlinear ms\trms\n");
+	for (int k = 0; k < 2; k++) {
+		const double fullms = timeBest(1, [&]() {
+			k == 0 ? ao.ssao(input, params, unprojected) : ao.hbao(input, params, unprojected);
+		});
+		const double linearms = timeBest(1, [&]() {
+			k == 0 ? ao.ssao(linearInput, params, reconstructed) : ao.hbao(linearInput, params, reconstructed);
+		});
+		printf("%s\t%.1f\t\t%.1f\t\t%.6f\n", k == 0 ? "ssao" : "hbao", fullms, linearms, rmsDifference(unprojected, reconstructed));
+	}
+}
+
+void benchPresets()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(PRESET_WIDTH, PRESET_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+
+	AoInput input;
+	input.normals = &rast.getNormals();
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+
+	// every preset through its specialized kernels and through the runtime loop ones, which have to agree
+	AmbientOcclusion ao;
+	Blur blur;
+	FloatImage generic, specialized, genericBlur, specializedBlur;
+	printf("%dx%d, best of %d (blur %d) ms, generic / specialized\n", PRESET_WIDTH, PRESET_HEIGHT, PRESET_AO_REPS, PRESET_BLUR_REPS);
+	printf("preset\tssao\t\thbao\t\tgaussian\tbox reference\tmax diff\n");
+	for (int i = 0; i < AmbientOcclusion::GetNumPresets(); i++) {
+		const AoPreset &preset = AmbientOcclusion::GetPreset(i);
+		AoParams params;
+		preset.apply(params);
+		double ms[4][2];
+		float diff = 0.f;
+		for (int s = 0; s < 2; s++) {
+			FloatImage &out = s == 0 ? generic : specialized;
+			FloatImage &blurred = s == 0 ? genericBlur : specializedBlur;
+			params.specialized = s == 1;
+			blur.setSpecialized(s == 1);
+			ms[0][s] = timeBest(PRESET_AO_REPS, [&]() { ao.ssao(input, params, out); });
+			ms[1][s] = timeBest(PRESET_AO_REPS, [&]() { ao.hbao(input, params, out); });
+			ms[2][s] = timeBest(PRESET_BLUR_REPS, [&]() { blur.gaussian(out, blurred, preset.blurRadius); });
+			ms[3][s] = timeBest(PRESET_BLUR_REPS, [&]() { blur.boxReference(out, blurred, preset.blurRadius); });
+		}
+		for (int y = 0; y < PRESET_HEIGHT; y++) {
+			for (int x = 0; x < PRESET_WIDTH; x++) {
+				diff = std::max(diff, fabsf(generic.at(x, y) - specialized.at(x, y)));
+				diff = std::max(diff, fabsf(genericBlur.at(x, y) - specializedBlur.at(x, y)));
+			}
+		}
+		printf("%s\t%.0f / %.0f\t%.0f / %.0f\t%.2f / %.2f\t%.2f / %.2f\t%g\n", preset.name, ms[0][0], ms[0][1], ms[1][0], ms[1][1],
+			ms[2][0], ms[2][1], ms[3][0], ms[3][1], diff);
+	}
+}
+
+void benchGroundTruth()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Matrix model;
+	RayTracedAo tracer;
+	tracer.setRaysPerPixel(REFERENCE_RAYS);
+	tracer.setMaxDistance(AoParams().samplingRadius);
+	const double buildms = timeBest(1, [&]() {
+		tracer.clear();
+		tracer.addMesh(&scene.model.verts[0], scene.model.verts.size(), &scene.model.inds[0], scene.model.inds.size(), model);
+		tracer.addMesh(&scene.ground.verts[0], scene.ground.verts.size(), &scene.ground.inds[0], scene.ground.inds.size(), model);
+		tracer.build();
+	});
+	printf("%d triangles, bvh build %.1f ms, %d nodes\n", (int) tracer.getBvh().getNumTriangles(), buildms, (int) tracer.getBvh().getNumNodes());
+
+	Rasterizer rast;
+	rast.resize(AO_WIDTH, AO_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+
+	// two independent references, their difference is the noise floor the screen space scores can't go below
+	FloatImage reference, second;
+	const double tracems = timeBest(1, [&]() { tracer.render(view, proj, AO_WIDTH, AO_HEIGHT, reference); });
+	const double rays = (double) (tracer.getStats().cameraRays + tracer.getStats().aoRays);
+	printf("%dx%d reference, %d rays per pixel: %.0f ms, %.2f Mrays/s\n", AO_WIDTH, AO_HEIGHT, REFERENCE_RAYS, tracems, rays / (tracems * 1000.0));
+	tracer.setSeed(1);
+	tracer.render(view, proj, AO_WIDTH, AO_HEIGHT, second);
+	printf("noise floor (second seed): rmse %.4f ssim %.4f\n", rmse(second, reference), ssim(second, reference));
+
+	AoInput input;
+	input.normals = &rast.getNormals();
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+	AmbientOcclusion ao;
+	Blur blur;
+	FloatImage raw, blurred;
+	printf("preset\tssao rmse\tssao ssim\thbao rmse\thbao ssim\t(after the preset's blur)\n");
+	for (int i = 0; i < AmbientOcclusion::GetNumPresets(); i++) {
+		const AoPreset &preset = AmbientOcclusion::GetPreset(i);
+		AoParams params;
+		preset.apply(params);
+		float scores[2][2];
+		for (int k = 0; k < 2; k++) {
+			k == 0 ? ao.ssao(input, params, raw) : ao.hbao(input, params, raw);
+			blur.gaussian(raw, blurred, preset.blurRadius);
+			scores[k][0] = rmse(blurred, reference);
+			scores[k][1] = ssim(blurred, reference);
+		}
+		printf("%s\t%.4f\t\t%.4f\t\t%.4f\t\t%.4f\n", preset.name, scores[0][0], scores[0][1], scores[1][0], scores[1][1]);
+	}
+	if (getenv("CPUBENCH_DUMP")) {
+		saveBenchImage("reference.pgm", reference);
+	}
+}
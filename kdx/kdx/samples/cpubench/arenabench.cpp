@@ -0,0 +1,290 @@
+#include "bench.h"
+#include "scene.h"
+#include "../ao/aosample.h"
+#include "../ao/aoshaders.h"
+#include "constantring.h"
+#include "cpudevice.h"
+#include "geometryarena.h"
+#include "statecache.h"
+#include <string.h>
+
+// meshes in a shared GeometryArena against a vertex and index buffer each
+// the checks render a set of meshes both ways through the ao sample's prepass on the cpu device, which has to give the
+// same targets, then churn an arena with allocations and frees and compare its buffers against what was put in before
+// and after a defragment
+// the cost is the cpu side of submitting the meshes of a big multi-group file, with no vertex shader bound so the cpu
+// device drops the draws themselves
+
+#define CHECK_MESHES 24
+#define CHECK_WIDTH 256
+#define CHECK_HEIGHT 192
+#define CHURN_STEPS 4000
+#define CHURN_LIVE 300
+#define SUBMIT_MESHES 2000
+#define ARENA_REPS 5
+
+struct BenchMatrices {
+	float model[16], view[16], proj[16];
+};
+
+static void transposeInto(const float *m, float *out)
+{
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			out[c * 4 + r] = m[r * 4 + c];
+		}
+	}
+}
+
+// a box of half size extent around center, 4 vertices per face so the normals are flat
+template<typename IND_TYPE>
+static void buildBox(const fl3 &center, const fl3 &extent, InterleavedMesh<PTNvert, IND_TYPE> &mesh)
+{
+	for (int axis = 0; axis < 3; axis++) {
+		for (int side = -1; side <= 1; side += 2) {
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			const IND_TYPE first = (IND_TYPE) (axis * 8 + (side + 1) * 2);
+			for (int corner = 0; corner < 4; corner++) {
+				PTNvert vert;
+				vert.pos = center;
+				vert.pos[axis] += side * extent[axis];
+				vert.pos[u] += ((corner & 1) ? 1 : -1) * extent[u];
+				vert.pos[v] += ((corner & 2) ? 1 : -1) * extent[v];
+				vert.tex = fl3((float) (corner & 1), (float) (corner >> 1), 0.f);
+				vert.norm[axis] = (float) side;
+				mesh.addVert(vert);
+			}
+			// clockwise seen from outside, flipped for the other side
+			if (side > 0) {
+				mesh.addInd(first).addInd(first + 2).addInd(first + 1).addInd(first + 1).addInd(first + 2).addInd(first + 3);
+			} else {
+				mesh.addInd(first).addInd(first + 1).addInd(first + 2).addInd(first + 1).addInd(first + 3).addInd(first + 2);
+			}
+		}
+	}
+}
+
+// texels of two device textures that differ
+static unsigned int compareTextures(RenderTexture *a, RenderTexture *b)
+{
+	const CpuTexture &ta = *static_cast<CpuTexture *>(a);
+	const CpuTexture &tb = *static_cast<CpuTexture *>(b);
+	unsigned int differ = 0;
+	for (int y = 0; y < ta.getHeight(); y++) {
+		for (int x = 0; x < ta.getWidth(); x++) {
+			differ += memcmp(ta.texel(x, y), tb.texel(x, y), ta.getChannels() * sizeof(float)) != 0;
+		}
+	}
+	return differ;
+}
+
+static void checkDraws()
+{
+	CpuDevice dev (CHECK_WIDTH, CHECK_HEIGHT);
+	RegisterAoShaders(dev);
+	AoSample sample (dev, CHECK_WIDTH, CHECK_HEIGHT);
+	Matrix view, proj;
+	benchViewMatrix(BENCH_CAMERA_POS, BENCH_CAMERA_ROT, view);
+	benchProjMatrix(45.f, CHECK_WIDTH / (float) CHECK_HEIGHT, proj);
+
+	// the same boxes standalone and in an arena, half of them with 16 bit indices that the arena widens
+	GeometryArena arena (dev, sizeof(PTNvert), FORMAT_R32_UINT, 64, 64);
+	std::vector<Mesh<uint16_t> *> standalone, arenaMeshes;
+	std::vector<Mesh<uint32_t> *> standalone32, arenaMeshes32;
+	unsigned int seed = 3;
+	for (int i = 0; i < CHECK_MESHES; i++) {
+		const fl3 center (-12.f + 24.f * benchRandom(seed), 6.f * benchRandom(seed), 10.f * benchRandom(seed));
+		const fl3 extent (0.3f + benchRandom(seed), 0.3f + benchRandom(seed), 0.3f + benchRandom(seed));
+		if (i % 2) {
+			InterleavedMesh<PTNvert, uint16_t> *a = new InterleavedMesh<PTNvert, uint16_t>(TOPOLOGY_TRIANGLELIST);
+			InterleavedMesh<PTNvert, uint16_t> *b = new InterleavedMesh<PTNvert, uint16_t>(TOPOLOGY_TRIANGLELIST);
+			buildBox(center, extent, *a);
+			buildBox(center, extent, *b);
+			a->finalize(dev);
+			b->finalize(dev, arena);
+			standalone.push_back(a);
+			arenaMeshes.push_back(b);
+		} else {
+			InterleavedMesh<PTNvert, uint32_t> *a = new InterleavedMesh<PTNvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
+			InterleavedMesh<PTNvert, uint32_t> *b = new InterleavedMesh<PTNvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
+			buildBox(center, extent, *a);
+			buildBox(center, extent, *b);
+			a->finalize(dev);
+			b->finalize(dev, arena);
+			standalone32.push_back(a);
+			arenaMeshes32.push_back(b);
+		}
+	}
+
+	ConstantRing ring (dev, 4 * CONSTANT_RANGE_ALIGNMENT);
+	BenchMatrices matrices;
+	Matrix model;
+	transposeInto(model.data(), matrices.model);
+	transposeInto(view.data(), matrices.view);
+	transposeInto(proj.data(), matrices.proj);
+	RenderTexture *normals = 0, *depth = 0;
+	unsigned int bufferBinds[2];
+	for (int pass = 0; pass < 2; pass++) {
+		std::vector<Mesh<uint16_t> *> &meshes = pass ? arenaMeshes : standalone;
+		std::vector<Mesh<uint32_t> *> &meshes32 = pass ? arenaMeshes32 : standalone32;
+		StateCache &cache = dev.getStateCache();
+		cache.endFrame();
+		sample.render(view, proj, [&](RenderContext &context) {
+			ConstantRing::use(context, STAGE_VERTEX, 0, ring.allocate(context, matrices));
+			for (size_t i = 0; i < meshes.size(); i++) {
+				meshes32[i]->draw(dev, context);
+				meshes[i]->draw(dev, context);
+			}
+		});
+		ring.endFrame();
+		cache.endFrame();
+		const StateCacheStats &stats = cache.getFrameStats();
+		bufferBinds[pass] = stats.issued[STATE_VERTEX_BUFFER] + stats.issued[STATE_INDEX_BUFFER];
+		if (pass == 0) {
+			TextureDesc normalsDesc = sample.getPrepassNormals()->getDesc();
+			normalsDesc.bindFlags = BIND_SHADER_RESOURCE;
+			TextureDesc depthDesc = sample.getPrepassDepth()->getDesc();
+			depthDesc.bindFlags = BIND_SHADER_RESOURCE;
+			normals = dev.createTexture(normalsDesc);
+			depth = dev.createTexture(depthDesc);
+			dev.getContext().copyTexture(normals, sample.getPrepassNormals());
+			dev.getContext().copyTexture(depth, sample.getPrepassDepth());
+		}
+	}
+	printf("%d boxes through the prepass, own buffers against an arena: %u normal texels and %u depth texels differ, %u vertex and index buffer binds against %u\n",
+		CHECK_MESHES, compareTextures(normals, sample.getPrepassNormals()), compareTextures(depth, sample.getPrepassDepth()),
+		bufferBinds[0], bufferBinds[1]);
+	delete normals;
+	delete depth;
+	// the arena meshes free their ranges, the arena goes last
+	for (size_t i = 0; i < standalone.size(); i++) {
+		delete standalone[i];
+		delete arenaMeshes[i];
+		delete standalone32[i];
+		delete arenaMeshes32[i];
+	}
+}
+
+// what one allocation was given
+struct ChurnEntry {
+	unsigned int handle;
+	std::vector<uint8_t> verts;
+	std::vector<uint32_t> inds;
+};
+
+// allocations whose ranges in the arena's buffers don't hold what was put in
+static unsigned int compareArena(GeometryArena &arena, const std::vector<ChurnEntry> &live)
+{
+	const uint8_t *verts = static_cast<CpuBuffer *>(arena.getVertexBuffer())->data();
+	const uint32_t *inds = (const uint32_t *) static_cast<CpuBuffer *>(arena.getIndexBuffer())->data();
+	unsigned int wrong = 0;
+	for (size_t i = 0; i < live.size(); i++) {
+		const GeometryRange &range = arena.getRange(live[i].handle);
+		const bool vertsRight = live[i].verts.empty() ||
+			memcmp(verts + range.baseVertex * arena.getVertexStride(), &live[i].verts[0], live[i].verts.size()) == 0;
+		const bool indsRight = live[i].inds.empty() ||
+			memcmp(inds + range.startIndex, &live[i].inds[0], live[i].inds.size() * sizeof(uint32_t)) == 0;
+		wrong += !vertsRight || !indsRight;
+	}
+	return wrong;
+}
+
+static void checkChurn()
+{
+	CpuDevice dev (64, 64);
+	const unsigned int stride = sizeof(PTNvert);
+	GeometryArena arena (dev, stride, FORMAT_R32_UINT, 1024, 3072);
+	std::vector<ChurnEntry> live;
+	unsigned int seed = 11;
+	unsigned int wrong = 0, checks = 0, maxTop = 0;
+	size_t allocatedVertices = 0;
+	for (int step = 0; step < CHURN_STEPS; step++) {
+		// about as many frees as allocations once it's full, a mesh like the groups of a file
+		if (live.size() >= CHURN_LIVE || (!live.empty() && benchRandom(seed) < 0.45f)) {
+			const size_t victim = (size_t) (benchRandom(seed) * live.size());
+			arena.free(live[victim].handle);
+			live[victim] = live.back();
+			live.pop_back();
+		} else {
+			ChurnEntry entry;
+			const unsigned int vertexCount = 4 + (unsigned int) (benchRandom(seed) * 500);
+			const unsigned int indexCount = 3 * (1 + (unsigned int) (benchRandom(seed) * 600));
+			entry.verts.resize(vertexCount * stride);
+			for (size_t b = 0; b < entry.verts.size(); b++) {
+				entry.verts[b] = (uint8_t) (benchRandom(seed) * 256);
+			}
+			for (unsigned int k = 0; k < indexCount; k++) {
+				entry.inds.push_back((uint32_t) (benchRandom(seed) * vertexCount));
+			}
+			entry.handle = arena.allocate(&entry.verts[0], vertexCount, stride, &entry.inds[0], indexCount, FORMAT_R32_UINT);
+			allocatedVertices += vertexCount;
+			live.push_back(entry);
+		}
+		const GeometryArenaStats stats = arena.getStats();
+		maxTop = stats.topVertices > maxTop ? stats.topVertices : maxTop;
+		if (step % 97 == 0) {
+			arena.use(dev.getContext());
+			wrong += compareArena(arena, live);
+			checks++;
+		}
+	}
+	arena.use(dev.getContext());
+	wrong += compareArena(arena, live);
+	GeometryArenaStats before = arena.getStats();
+	const unsigned int moved = arena.defragment();
+	arena.use(dev.getContext());
+	const unsigned int wrongAfter = compareArena(arena, live);
+	GeometryArenaStats after = arena.getStats();
+	printf("%d allocations and frees (%.0fk vertices allocated in all, at most %u in the arena, %u grows): %u of %u checks wrong\n",
+		CHURN_STEPS, allocatedVertices / 1000.0, maxTop, after.grows, wrong, checks + 1);
+	printf("  %u live with %u vertices: top at %u vertices and %u indices with %u and %u holes, defragmented (%u moved) to %u and %u with %u and %u holes, %u wrong after\n",
+		before.allocations, before.usedVertices, before.topVertices, before.topIndices, before.freeVertexBlocks, before.freeIndexBlocks,
+		moved, after.topVertices, after.topIndices, after.freeVertexBlocks, after.freeIndexBlocks, wrongAfter);
+}
+
+void benchGeometryArena()
+{
+	checkDraws();
+	checkChurn();
+
+	// submission cost of a file with many groups, each a small mesh
+	CpuDevice dev (64, 64);
+	GeometryArena arena (dev, sizeof(PTNvert));
+	std::vector<Mesh<uint32_t> *> standalone, arenaMeshes;
+	unsigned int seed = 23;
+	for (int i = 0; i < SUBMIT_MESHES; i++) {
+		const fl3 center (benchRandom(seed) * 100.f, benchRandom(seed) * 10.f, benchRandom(seed) * 100.f);
+		const fl3 extent (0.5f, 0.5f, 0.5f);
+		InterleavedMesh<PTNvert, uint32_t> *a = new InterleavedMesh<PTNvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
+		InterleavedMesh<PTNvert, uint32_t> *b = new InterleavedMesh<PTNvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
+		buildBox(center, extent, *a);
+		buildBox(center, extent, *b);
+		a->finalize(dev);
+		b->finalize(dev, arena);
+		standalone.push_back(a);
+		arenaMeshes.push_back(b);
+	}
+	RenderContext &context = dev.getContext();
+	StateCache &cache = dev.getStateCache();
+	printf("%d meshes of a file, cpu submission per frame:\n", SUBMIT_MESHES);
+	for (int method = 0; method < 2; method++) {
+		std::vector<Mesh<uint32_t> *> &meshes = method ? arenaMeshes : standalone;
+		const double ms = timeBest(ARENA_REPS, [&]() {
+			// as if other passes bound their own buffers before
+			cache.invalidate();
+			cache.endFrame();
+			for (size_t i = 0; i < meshes.size(); i++) {
+				meshes[i]->draw(dev, context);
+			}
+		});
+		cache.endFrame();
+		const StateCacheStats &stats = cache.getFrameStats();
+		static const char *names[2] = { "own buffers", "shared arena" };
+		printf("  %-14s %8.3f ms, %6u state calls issued (%u vertex buffer, %u index buffer), %u filtered\n", names[method], ms,
+			stats.getIssued(), stats.issued[STATE_VERTEX_BUFFER], stats.issued[STATE_INDEX_BUFFER], stats.getFiltered());
+	}
+	for (size_t i = 0; i < standalone.size(); i++) {
+		delete standalone[i];
+		delete arenaMeshes[i];
+	}
+}
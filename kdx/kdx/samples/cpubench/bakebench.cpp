@@ -0,0 +1,74 @@
+#include "bench.h"
+#include "scene.h"
+#include "aobaker.h"
+#include "parallel.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// ao baking cost against scene size: the first n spheres of the stand-in scene (or ServerBot) on the ground,
+// every vertex baked against all of them, then a lightmap of the ground quad
+
+#define BAKE_RAYS 64
+#define BAKE_STEPS 3
+#define BAKE_LIGHTMAP_CELL 256
+#define BAKE_CACHE_FILE "bench.aobake"
+
+void benchBake()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Matrix model;
+	AoBaker baker;
+	baker.setRaysPerSample(BAKE_RAYS);
+
+	// prefixes of the model's index list, whole spheres since they were appended one after the other
+	printf("%d rays per sample, %u worker threads\n", BAKE_RAYS, ThreadPool::GetDefaultPool().getNumThreads());
+	printf("triangles\tvertices\tbvh ms\tbake ms\tMrays/s\n");
+	std::vector<float> vertexAo;
+	for (int step = 0; step < BAKE_STEPS; step++) {
+		const size_t indexcount = scene.loadedAsset ? scene.model.inds.size() : scene.model.inds.size() >> (2 * (BAKE_STEPS - 1 - step));
+		size_t vertcount = 0;
+		for (size_t i = 0; i < indexcount; i++) {
+			vertcount = std::max(vertcount, (size_t) scene.model.inds[i] + 1);
+		}
+		const double buildms = timeBest(1, [&]() {
+			baker.clearOccluders();
+			baker.addOccluder(&scene.model.verts[0], vertcount, &scene.model.inds[0], indexcount, model);
+			baker.addOccluder(&scene.ground.verts[0], scene.ground.verts.size(), &scene.ground.inds[0], scene.ground.inds.size(), model);
+			baker.buildOccluders();
+		});
+		const double bakems = timeBest(1, [&]() { baker.bakeVertices(&scene.model.verts[0], vertcount, model, vertexAo); });
+		printf("%d\t\t%d\t\t%.1f\t%.0f\t%.2f\n", (int) baker.getOccluders().getNumTriangles(), (int) vertcount, buildms, bakems,
+			baker.getStats().rays / (bakems * 1000.0));
+		if (scene.loadedAsset) {
+			break;
+		}
+	}
+
+	// the ground quad's lightmap picks up the contact shadows of everything on it
+	FloatImage lightmap;
+	const double lightmapms = timeBest(1, [&]() {
+		baker.bakeLightmap(&scene.ground.verts[0], scene.ground.verts.size(), &scene.ground.inds[0], scene.ground.inds.size(), model,
+			BAKE_LIGHTMAP_CELL, lightmap);
+	});
+	printf("ground lightmap %dx%d, %u texels: %.0f ms, %.2f Mrays/s\n", lightmap.getWidth(), lightmap.getHeight(), baker.getStats().samples,
+		lightmapms, baker.getStats().rays / (lightmapms * 1000.0));
+
+	// cache round trip, a changed mesh has to miss
+	FloatImage stream ((int) vertexAo.size(), 1), loaded;
+	for (size_t i = 0; i < vertexAo.size(); i++) {
+		stream.at((int) i, 0) = vertexAo[i];
+	}
+	const uint64_t hash = AoBaker::HashGeometry(&scene.model.verts[0], scene.model.verts.size(), 0, 0);
+	const bool saved = AoBaker::SaveBake(BAKE_CACHE_FILE, hash, stream);
+	const bool hit = AoBaker::LoadBake(BAKE_CACHE_FILE, hash, loaded) && loaded.getWidth() == stream.getWidth()
+		&& memcmp(loaded.data(), stream.data(), stream.getByteSize()) == 0;
+	scene.model.verts[0].pos.x += 1.f;
+	const bool stale = !AoBaker::LoadBake(BAKE_CACHE_FILE, AoBaker::HashGeometry(&scene.model.verts[0], scene.model.verts.size(), 0, 0), loaded);
+	printf("cache: %s, reload %s, changed mesh %s\n", saved ? "saved" : "SAVE FAILED", hit ? "matches" : "MISMATCH", stale ? "rejected" : "NOT REJECTED");
+	remove(BAKE_CACHE_FILE);
+	if (getenv("CPUBENCH_DUMP")) {
+		saveBenchImage("lightmap.pgm", lightmap);
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// wall clock timer for the cpu benchmarks
+class BenchTimer {
+public:
+	BenchTimer() { reset(); }
+	void reset() { start_ = std::chrono::high_resolution_clock::now(); }
+	double elapsedMillis() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_).count();
+	}
+private:
+	std::chrono::high_resolution_clock::time_point start_;
+};
+
+// runs func reps times and returns the fastest run in milliseconds
+template<typename FUNC>
+double timeBest(int reps, FUNC func)
+{
+	double best = 1e30;
+	for (int i = 0; i < reps; i++) {
+		BenchTimer timer;
+		func();
+		const double ms = timer.elapsedMillis();
+		best = ms < best ? ms : best;
+	}
+	return best;
+}
+
+// deterministic pseudo random numbers so runs are comparable
+inline float benchRandom(unsigned int &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8) * (1.f / 16777216.f);
+}
+
+// individual benchmarks, each one prints its own table
+void benchBlur();
+void benchRaster();
+void benchHiZ();
+void benchAoResolution();
+void benchTemporalAo();
+void benchDeinterleave();
+void benchLinearDepth();
+void benchPresets();
+void benchGroundTruth();
+void benchBake();
+void benchBvh();
+void benchRayKernels();
+void benchNormals();
+void benchNormalEncoding();
+void benchHalfImages();
+void benchRenderDevice();
+void benchRenderQueue();
+void benchFrameGraph();
+void benchTargetPool();
+void benchConstantRing();
+void benchMaterialTable();
+void benchInstancing();
+void benchGeometryArena();
+void benchShaderCache();
+
+#endif // BENCH_H
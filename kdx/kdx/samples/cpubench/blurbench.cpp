@@ -0,0 +1,59 @@
+#include "bench.h"
+#include "blur.h"
+#include <math.h>
+
+// blur cost against radius at 1080p
+// the non-separable reference is what computeblur.hlsl does, it is only run for small radii since it is quadratic
+
+#define BLUR_WIDTH 1920
+#define BLUR_HEIGHT 1080
+#define BLUR_REPS 5
+#define BLUR_MAX_REFERENCE_RADIUS 8
+
+static float maxDifference(const FloatImage &a, const FloatImage &b)
+{
+	float diff = 0.f;
+	for (int y = 0; y < a.getHeight(); y++) {
+		for (int x = 0; x < a.getWidth(); x++) {
+			diff = fmax(diff, fabs(a.at(x, y) - b.at(x, y)));
+		}
+	}
+	return diff;
+}
+
+void benchBlur()
+{
+	// noisy ao-like input over a depth buffer with a hard step down the middle
+	FloatImage ao (BLUR_WIDTH, BLUR_HEIGHT);
+	FloatImage depth (BLUR_WIDTH, BLUR_HEIGHT);
+	unsigned int seed = 1;
+	for (int y = 0; y < BLUR_HEIGHT; y++) {
+		for (int x = 0; x < BLUR_WIDTH; x++) {
+			ao.at(x, y) = benchRandom(seed);
+			depth.at(x, y) = (x < BLUR_WIDTH / 2) ? 10.f + 0.001f * y : 50.f;
+		}
+	}
+
+	Blur blur;
+	FloatImage out, reference;
+	const int radii[] = { 2, 4, 8, 16, 32 };
+	printf("%dx%d, best of %d, ms\n", BLUR_WIDTH, BLUR_HEIGHT, BLUR_REPS);
+	printf("radius\treference\tgaussian\tbox\tbilateral\tbox max err\n");
+	for (int i = 0; i < 5; i++) {
+		const int r = radii[i];
+		double refms = -1.0;
+		float err = -1.f;
+		if (r <= BLUR_MAX_REFERENCE_RADIUS) {
+			refms = timeBest(1, [&]() { blur.boxReference(ao, reference, r); });
+		}
+		const double gaussms = timeBest(BLUR_REPS, [&]() { blur.gaussian(ao, out, r); });
+		const double bilatms = timeBest(BLUR_REPS, [&]() { blur.bilateral(ao, depth, out, r, 1.f); });
+		const double boxms = timeBest(BLUR_REPS, [&]() { blur.box(ao, out, r); });
+		if (r <= BLUR_MAX_REFERENCE_RADIUS) {
+			err = maxDifference(out, reference);
+			printf("%d\t%.2f\t\t%.2f\t\t%.2f\t%.2f\t\t%g\n", r, refms, gaussms, boxms, bilatms, err);
+		} else {
+			printf("%d\t-\t\t%.2f\t\t%.2f\t%.2f\t\t-\n", r, gaussms, boxms, bilatms);
+		}
+	}
+}
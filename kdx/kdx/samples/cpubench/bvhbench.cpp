@@ -0,0 +1,110 @@
+#include "bench.h"
+#include "scene.h"
+#include "bvh.h"
+#include "parallel.h"
+#include "sampling.h"
+#include <atomic>
+
+// bvh build time and query throughput over the bench scene, sah against the median split
+// camera rays through a 960x540 view for closest hits, then ao style short rays from the hit points for any hits
+
+#define BVH_RAY_WIDTH 960
+#define BVH_RAY_HEIGHT 540
+#define BVH_AO_RAYS 8
+#define BVH_AO_DISTANCE 0.5f
+#define BVH_BOX_QUERIES 100000
+#define BVH_BOX_SIZE 1.f
+#define BVH_BUILD_REPS 3
+#define BVH_RAY_GRAIN 4096
+
+void benchBvh()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Matrix model;
+	Matrix view, proj, invViewProj;
+	benchViewMatrix(BENCH_CAMERA_POS, BENCH_CAMERA_ROT, view);
+	benchProjMatrix(DEGTORAD(45), (float) BVH_RAY_WIDTH / BVH_RAY_HEIGHT, proj);
+	Matrix viewProj = proj;
+	viewProj.multMatrix(view);
+	viewProj.getInverse(invViewProj);
+
+	printf("%u worker threads\n", ThreadPool::GetDefaultPool().getNumThreads());
+	printf("build\ttriangles\tnodes\tbuild ms\tsah cost\tclosest Mrays/s\tany Mrays/s\tbox queries/ms\n");
+	const char *names[] = { "sah", "median" };
+	for (int method = 0; method < 2; method++) {
+		Bvh bvh;
+		bvh.setBuildMethod((Bvh::BUILD_METHOD) method);
+		bvh.addTriangles(&scene.model.verts[0], scene.model.verts.size(), &scene.model.inds[0], scene.model.inds.size(), model);
+		bvh.addTriangles(&scene.ground.verts[0], scene.ground.verts.size(), &scene.ground.inds[0], scene.ground.inds.size(), model);
+		const double buildms = timeBest(BVH_BUILD_REPS, [&]() { bvh.build(); });
+
+		// camera rays from the near plane through every pixel center
+		const int numCamera = BVH_RAY_WIDTH * BVH_RAY_HEIGHT;
+		std::vector<fl3> origins (numCamera), dirs (numCamera);
+		for (int y = 0; y < BVH_RAY_HEIGHT; y++) {
+			for (int x = 0; x < BVH_RAY_WIDTH; x++) {
+				const float nx = 2.f * (x + 0.5f) / BVH_RAY_WIDTH - 1.f, ny = 1.f - 2.f * (y + 0.5f) / BVH_RAY_HEIGHT;
+				origins[y * BVH_RAY_WIDTH + x] = invViewProj.multiplyPoint(fl3(nx, ny, 0.f));
+				dirs[y * BVH_RAY_WIDTH + x] = invViewProj.multiplyPoint(fl3(nx, ny, 1.f)) - origins[y * BVH_RAY_WIDTH + x];
+			}
+		}
+		std::vector<Bvh::Hit> hits (numCamera);
+		std::vector<char> found (numCamera);
+		const double closestms = timeBest(1, [&]() {
+			parallelFor(0, numCamera, BVH_RAY_GRAIN, [&](int first, int last) {
+				for (int i = first; i < last; i++) {
+					found[i] = bvh.intersect(origins[i], dirs[i], 1.f, hits[i]);
+				}
+			});
+		});
+
+		// short hemisphere rays off every hit, like the reference ao
+		std::vector<fl3> aoOrigins, aoDirs;
+		for (int i = 0; i < numCamera; i++) {
+			if (!found[i]) {
+				continue;
+			}
+			fl3 n = bvh.getNormal(hits[i].triangle), t, b;
+			if (dot(n, dirs[i]) > 0.f) {
+				n = -n;
+			}
+			tangentFrame(n, t, b);
+			const uint32_t h = hashCoords(i, 0, 0);
+			for (int k = 0; k < BVH_AO_RAYS; k++) {
+				aoOrigins.push_back(origins[i] + dirs[i] * hits[i].t + n * 1e-3f);
+				aoDirs.push_back(cosineHemisphere(k, BVH_AO_RAYS, toUnitFloat(h), toUnitFloat(h * 0x9e3779b9u), n, t, b));
+			}
+		}
+		std::atomic<int> occluded (0);
+		const double anyms = timeBest(1, [&]() {
+			occluded = 0;
+			parallelFor(0, (int) aoOrigins.size(), BVH_RAY_GRAIN, [&](int first, int last) {
+				int count = 0;
+				for (int i = first; i < last; i++) {
+					count += bvh.occluded(aoOrigins[i], aoDirs[i], BVH_AO_DISTANCE) ? 1 : 0;
+				}
+				occluded += count;
+			});
+		});
+
+		// boxes around random camera hits, the size of a small object
+		unsigned int seed = 1;
+		std::vector<uint32_t> overlapping;
+		size_t totalFound = 0;
+		const double boxms = timeBest(1, [&]() {
+			totalFound = 0;
+			for (int q = 0; q < BVH_BOX_QUERIES; q++) {
+				const int i = std::min(numCamera - 1, (int) (benchRandom(seed) * numCamera));
+				const fl3 center = origins[i] + dirs[i] * (found[i] ? hits[i].t : 0.5f);
+				const fl3 half (0.5f * BVH_BOX_SIZE, 0.5f * BVH_BOX_SIZE, 0.5f * BVH_BOX_SIZE);
+				overlapping.clear();
+				totalFound += bvh.overlap(center - half, center + half, overlapping);
+			}
+		});
+
+		printf("%s\t%d\t\t%d\t%.1f\t\t%.1f\t\t%.2f\t\t%.2f\t\t%.0f\n", names[method], (int) bvh.getNumTriangles(), (int) bvh.getNumNodes(),
+			buildms, bvh.getSahCost(), numCamera / (closestms * 1000.0), aoOrigins.size() / (anyms * 1000.0), BVH_BOX_QUERIES / boxms);
+		printf("\t(%d of %d ao rays occluded, %.1f triangles per box)\n", (int) occluded, (int) aoOrigins.size(), (double) totalFound / BVH_BOX_QUERIES);
+	}
+}
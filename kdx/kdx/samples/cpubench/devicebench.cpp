@@ -0,0 +1,156 @@
+#include "bench.h"
+#include "scene.h"
+#include "../ao/aosample.h"
+#include "../ao/aoshaders.h"
+#include "ambientocclusion.h"
+#include "constants.h"
+#include "cpudevice.h"
+#include "imagemetrics.h"
+#include "statecache.h"
+#include <math.h>
+#include <algorithm>
+
+// the ao sample's frame run headless on the cpu device, with the c++ ports of its shaders, against the dedicated
+// cpu passes doing the same work: Rasterizer for the prepass and AmbientOcclusion::hbao for the ao pass
+// the device is the slow general path, the numbers are there to keep both sides honest rather than to race them
+// WORKNOTE: AmbientOcclusion snaps its taps to texels and clamps at the borders, hbao.hlsl filters depth bilinearly
+// through the wrapping default sampler, so the two ao images are close rather than equal
+
+#define DEVICE_WIDTH 1024
+#define DEVICE_HEIGHT 768
+#define DEVICE_REPS 3
+
+// the red channel of a device texture
+static void readTexture(RenderTexture *texture, FloatImage &out)
+{
+	const CpuTexture &cpu = *static_cast<CpuTexture *>(texture);
+	out.resize(cpu.getWidth(), cpu.getHeight());
+	for (int y = 0; y < cpu.getHeight(); y++) {
+		for (int x = 0; x < cpu.getWidth(); x++) {
+			out.at(x, y) = cpu.texel(x, y)[0];
+		}
+	}
+}
+
+// normalencoding.hlsli's octahedral decode, for reading back the prepass target
+static fl3 decodeOct(float ex, float ey)
+{
+	fl3 n (ex, ey, 1.f - fabsf(ex) - fabsf(ey));
+	if (n.z < 0.f) {
+		n.x = (1.f - fabsf(ey)) * (ex >= 0.f ? 1.f : -1.f);
+		n.y = (1.f - fabsf(ex)) * (ey >= 0.f ? 1.f : -1.f);
+	}
+	normalize(n);
+	return n;
+}
+
+void benchRenderDevice()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+
+	CpuDevice dev (DEVICE_WIDTH, DEVICE_HEIGHT);
+	RegisterAoShaders(dev);
+	AoSample sample (dev, DEVICE_WIDTH, DEVICE_HEIGHT);
+	InterleavedMesh<PTNvert, uint32_t> model (TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<PTNvert, uint32_t> ground (TOPOLOGY_TRIANGLELIST);
+	buildBenchMesh(scene.model, dev, model);
+	buildBenchMesh(scene.ground, dev, ground);
+
+	// the reference frame, which also gives the camera matrices
+	Rasterizer rast;
+	rast.resize(DEVICE_WIDTH, DEVICE_HEIGHT);
+	Matrix view, proj, invProj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+	proj.getInverse(invProj);
+
+	const std::function<void(RenderContext&)> drawScene = [&](RenderContext &context) {
+		model.draw(dev, context);
+		ground.draw(dev, context);
+	};
+	CpuContext &context = dev.getCpuContext();
+	const double framems = timeBest(DEVICE_REPS, [&]() { sample.render(view, proj, drawScene); });
+	context.resetStats();
+	sample.render(view, proj, drawScene);
+	const CpuDeviceStats &stats = context.getStats();
+	printf("%dx%d ao sample frame on the cpu device: %.1f ms\n", DEVICE_WIDTH, DEVICE_HEIGHT, framems);
+	printf("draws %llu, dispatches %llu, vertices %llu, triangles %llu, pixels shaded %llu, compute groups %llu\n",
+		(unsigned long long) stats.draws, (unsigned long long) stats.dispatches, (unsigned long long) stats.verticesShaded,
+		(unsigned long long) stats.trianglesRasterized, (unsigned long long) stats.pixelsShaded, (unsigned long long) stats.computeGroups);
+	// state calls of a steady frame through the StateCache, against the same frame with filtering off
+	StateCache &cache = dev.getStateCache();
+	cache.endFrame();
+	sample.render(view, proj, drawScene);
+	cache.endFrame();
+	const StateCacheStats filteredStats = cache.getFrameStats();
+	cache.setEnabled(false);
+	sample.render(view, proj, drawScene);
+	cache.endFrame();
+	const StateCacheStats unfilteredStats = cache.getFrameStats();
+	cache.setEnabled(true);
+	printf("state calls per frame: %u issued, %u filtered (%u without the cache), %u other calls\n", filteredStats.getIssued(),
+		filteredStats.getFiltered(), unfilteredStats.getIssued(), filteredStats.other);
+	for (int i = 0; i < STATE_CALL_COUNT; i++) {
+		if (filteredStats.issued[i] + filteredStats.filtered[i] > 0) {
+			printf("  %-18s %u issued, %u filtered\n", StateCache::GetCallName((STATE_CALL) i), filteredStats.issued[i], filteredStats.filtered[i]);
+		}
+	}
+	const double rastms = timeBest(DEVICE_REPS, [&]() { renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj); });
+	printf("Rasterizer prepass alone: %.1f ms\n", rastms);
+
+	// prepass: depth and normals against the Rasterizer, both round depth to D16
+	FloatImage depth;
+	readTexture(sample.getPrepassDepth(), depth);
+	const CpuTexture &normalTarget = *static_cast<CpuTexture *>(sample.getPrepassNormals());
+	int covered = 0, coverageDiffs = 0, depthDiffs = 0;
+	double angleSum = 0.0;
+	float angleMax = 0.f;
+	Image<fl3> viewNormals (DEVICE_WIDTH, DEVICE_HEIGHT);
+	for (int y = 0; y < DEVICE_HEIGHT; y++) {
+		for (int x = 0; x < DEVICE_WIDTH; x++) {
+			const float ref = rast.getDepth().at(x, y), result = depth.at(x, y);
+			const bool refCovered = ref < 1.f, devCovered = result < 1.f;
+			coverageDiffs += refCovered != devCovered;
+			if (!refCovered || !devCovered) {
+				continue;
+			}
+			covered++;
+			// one d16 step either way is rounding of the interpolated depth, anything more a different surface
+			const bool sameSurface = fabsf(ref - result) <= 1.5f / 65535.f;
+			depthDiffs += !sameSurface;
+			fl3 n = rast.getNormals().at(x, y);
+			normalize(n);
+			viewNormals.at(x, y) = n;
+			// the normals of another surface say nothing about the transform
+			if (!sameSurface) {
+				continue;
+			}
+			const float *e = normalTarget.texel(x, y);
+			const float angle = acosf(std::max(-1.f, std::min(1.f, dot(n, decodeOct(e[0], e[1]))))) * 180.f / M_PI;
+			angleSum += angle;
+			angleMax = std::max(angleMax, angle);
+		}
+	}
+	printf("\nprepass vs Rasterizer: %d covered pixels, %d coverage mismatches, %d depth mismatches (> 1 d16 step), "
+		"normals on the same surface mean %.3f deg, max %.3f deg\n", covered, coverageDiffs, depthDiffs, angleSum / std::max(covered - depthDiffs, 1), angleMax);
+
+	// ao: hbao.hlsl's port against AmbientOcclusion::hbao's defaults (the same constants) on the Rasterizer's prepass
+	FloatImage deviceAo, finalAo, referenceAo;
+	readTexture(sample.getAo(), deviceAo);
+	readTexture(sample.getFinal(), finalAo);
+	AmbientOcclusion ao;
+	AoParams params;
+	AoInput input;
+	input.normals = &viewNormals;
+	input.depth = &rast.getDepth();
+	input.invProj = invProj;
+	const double aoms = timeBest(DEVICE_REPS, [&]() { ao.hbao(input, params, referenceAo); });
+	printf("hbao vs AmbientOcclusion::hbao (%.1f ms): rmse %.4f, ssim %.4f\n", aoms, rmse(deviceAo, referenceAo), ssim(deviceAo, referenceAo));
+
+	if (getenv("CPUBENCH_DUMP")) {
+		saveBenchImage("device_depth.pgm", depth);
+		saveBenchImage("device_ao.pgm", deviceAo);
+		saveBenchImage("device_final.pgm", finalAo);
+		saveBenchImage("device_reference_ao.pgm", referenceAo);
+	}
+}
@@ -0,0 +1,154 @@
+#include "bench.h"
+#include "scene.h"
+#include "../ao/aosample.h"
+#include "../ao/aoshaders.h"
+#include "constants.h"
+#include "cpudevice.h"
+#include "framegraph.h"
+#include "shader.h"
+#include <math.h>
+#include <algorithm>
+
+// the FrameGraph on the cpu device: the ao sample's frame, and a chain of blurs after it with a pass nothing reads
+// every frame is run twice, with the graph's culling, texture sharing and clear dropping on and off, and the two
+// have to come out texel for texel the same
+
+#define GRAPH_WIDTH 320
+#define GRAPH_HEIGHT 240
+#define GRAPH_BLURS 4
+#define GRAPH_REPS 20
+
+// largest difference over all channels of two textures of the same size and format
+static float textureDiff(const RenderTexture *a, const RenderTexture *b)
+{
+	const CpuTexture &ca = *static_cast<const CpuTexture *>(a);
+	const CpuTexture &cb = *static_cast<const CpuTexture *>(b);
+	const int channels = CpuTexture::GetChannelCount(ca.getDesc().format);
+	float diff = 0.f;
+	for (int y = 0; y < ca.getHeight(); y++) {
+		for (int x = 0; x < ca.getWidth(); x++) {
+			for (int c = 0; c < channels; c++) {
+				diff = std::max(diff, fabsf(ca.texel(x, y)[c] - cb.texel(x, y)[c]));
+			}
+		}
+	}
+	return diff;
+}
+
+// a copy of a texture to compare later frames against
+static RenderTexture* snapshot(CpuDevice &dev, RenderTexture *texture)
+{
+	RenderTexture *copy = dev.createTexture(texture->getDesc());
+	dev.getContext().copyTexture(copy, texture);
+	return copy;
+}
+
+static void printStats(const FrameGraph &graph)
+{
+	const FrameGraphStats &stats = graph.getStats();
+	printf("  passes:");
+	for (unsigned int i = 0; i < graph.getPassCount(); i++) {
+		printf(" %s%s", graph.getPassName(i), graph.isCulled(i) ? " (culled)" : "");
+	}
+	printf("\n  %u unbinds inserted, %u clears, %u dropped, %u transient textures on %u device textures, %.2f MB shared (%.2f MB unshared)\n",
+		stats.unbinds, stats.clears, stats.droppedClears, stats.textures, stats.deviceTextures,
+		stats.sharedTransientBytes / (1024.0 * 1024.0), stats.transientBytes / (1024.0 * 1024.0));
+}
+
+// blurs of blurs after the ao, each one reads the last and writes a new texture, plus one whose result is unused
+static FrameTexture buildBlurGraph(FrameGraph &graph, RenderTexture *ao, ComputeShader &blur)
+{
+	graph.reset();
+	TextureDesc desc;
+	desc.width = GRAPH_WIDTH;
+	desc.height = GRAPH_HEIGHT;
+	desc.format = FORMAT_R32G32B32A32_FLOAT;
+	desc.bindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+	const std::function<void(RenderContext&)> dispatch = [&blur](RenderContext &context) {
+		context.setShader(STAGE_COMPUTE, blur.get());
+		context.dispatch((GRAPH_WIDTH + 15) / 16, (GRAPH_HEIGHT + 15) / 16, 1);
+	};
+	FrameTexture last = graph.importTexture("ao", ao);
+	for (int i = 0; i < GRAPH_BLURS; i++) {
+		const FrameTexture next = graph.createTexture("blurred", desc);
+		const unsigned int pass = graph.addPass(i == 0 ? "blur" : "reblur", dispatch);
+		graph.readTexture(pass, last, STAGE_COMPUTE, 0);
+		graph.writeUav(pass, next, 0, true);
+		last = next;
+		if (i == 1) {
+			const FrameTexture unused = graph.createTexture("debug view", desc);
+			const unsigned int debug = graph.addPass("debug", dispatch);
+			graph.readTexture(debug, last, STAGE_COMPUTE, 0);
+			graph.writeUav(debug, unused, 0, true);
+		}
+	}
+	graph.setOutput(last);
+	return last;
+}
+
+void benchFrameGraph()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+
+	CpuDevice dev (GRAPH_WIDTH, GRAPH_HEIGHT);
+	RegisterAoShaders(dev);
+	AoSample sample (dev, GRAPH_WIDTH, GRAPH_HEIGHT);
+	InterleavedMesh<PTNvert, uint32_t> model (TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<PTNvert, uint32_t> ground (TOPOLOGY_TRIANGLELIST);
+	buildBenchMesh(scene.model, dev, model);
+	buildBenchMesh(scene.ground, dev, ground);
+	Matrix view, proj;
+	benchViewMatrix(BENCH_CAMERA_POS, BENCH_CAMERA_ROT, view);
+	benchProjMatrix(DEGTORAD(45), GRAPH_WIDTH / (float) GRAPH_HEIGHT, proj);
+	const std::function<void(RenderContext&)> drawScene = [&](RenderContext &context) {
+		model.draw(dev, context);
+		ground.draw(dev, context);
+	};
+
+	// the ao frame, everything kept and optimized, the back buffer and the blurred ao have to match
+	FrameGraph &graph = sample.getGraph();
+	graph.setOptimize(false);
+	sample.render(view, proj, drawScene);
+	RenderTexture *referenceBack = snapshot(dev, dev.getBackBuffer());
+	RenderTexture *referenceAo = snapshot(dev, sample.getFinal());
+	printf("ao frame %dx%d, everything kept:\n", GRAPH_WIDTH, GRAPH_HEIGHT);
+	printStats(graph);
+	graph.setOptimize(true);
+	sample.render(view, proj, drawScene);
+	printf("ao frame, optimized:\n");
+	printStats(graph);
+	printf("  max difference: back buffer %g, blurred ao %g\n", textureDiff(referenceBack, dev.getBackBuffer()),
+		textureDiff(referenceAo, sample.getFinal()));
+
+	// the blur chain after it, where the culled pass and the shared textures show up
+	ComputeShader blur (dev, L"computeblur.hlsl");
+	RenderTargetPool pool (dev);
+	FrameGraph chain (pool);
+	RenderContext &context = dev.getContext();
+	chain.setOptimize(false);
+	FrameTexture result = buildBlurGraph(chain, sample.getFinal(), blur);
+	chain.compile();
+	chain.execute(context);
+	RenderTexture *referenceChain = snapshot(dev, chain.getTexture(result));
+	printf("%d blurs of the blurred ao and an unused debug pass, everything kept:\n", GRAPH_BLURS);
+	printStats(chain);
+	chain.setOptimize(true);
+	result = buildBlurGraph(chain, sample.getFinal(), blur);
+	chain.compile();
+	chain.execute(context);
+	printf("optimized:\n");
+	printStats(chain);
+	printf("  max difference %g\n", textureDiff(referenceChain, chain.getTexture(result)));
+
+	// what describing and compiling a frame costs, once the device textures exist
+	const double compilems = timeBest(GRAPH_REPS, [&]() {
+		buildBlurGraph(chain, sample.getFinal(), blur);
+		chain.compile();
+	});
+	printf("building and compiling the blur graph: %.1f us\n", compilems * 1000.0);
+
+	delete referenceBack;
+	delete referenceAo;
+	delete referenceChain;
+}
@@ -0,0 +1,191 @@
+#include "bench.h"
+#include "scene.h"
+#include "ambientocclusion.h"
+#include "blur.h"
+#include "cpufeatures.h"
+#include "image16.h"
+#include "imagemetrics.h"
+#include "lineardepth.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// the cpu ao pipeline (linearize, hbao, bilateral blur) at 4k on float images against 16 bit ones:
+// d16 depth as unorm16 (lossless, it was quantized to that already), view z as half, ao and the blurred ao as unorm16
+// the normals are the same Image<fl3> in both, they are not part of what's being compared
+
+#define HALF_WIDTH 3840
+#define HALF_HEIGHT 2160
+#define HALF_REPS 3
+#define HALF_CONVERT_REPS 10
+// what the bilateral blur of the "high" preset runs with
+#define HALF_BLUR_RADIUS 2
+#define HALF_BLUR_SHARPNESS 1.f
+
+// bit mismatches between two arrays of the same type
+template<typename T>
+static int countMismatches(const std::vector<T> &a, const std::vector<T> &b)
+{
+	int count = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		count += memcmp(&a[i], &b[i], sizeof(T)) != 0;
+	}
+	return count;
+}
+
+static void benchConversions(const FloatImage &viewZ, const FloatImage &ao)
+{
+	const size_t count = (size_t) HALF_WIDTH * HALF_HEIGHT;
+	std::vector<uint16_t> packed (count), scalarPacked (count);
+	std::vector<float> widened (count), scalarWidened (count);
+	const HalfConversions *f16c = CpuHasAvx2() ? GetF16cHalfConversions() : 0;
+
+	printf("conversion\t\tscalar Mtexels/s\tsimd Mtexels/s\tsimd != scalar\n");
+	const double mtexels = count / 1e6;
+	{
+		const double scalarms = timeBest(HALF_CONVERT_REPS, [&]() {
+			for (size_t i = 0; i < count; i++) {
+				scalarPacked[i] = floatToHalf(viewZ.data()[i]);
+			}
+		});
+		double simdms = 0.0;
+		if (f16c) {
+			simdms = timeBest(HALF_CONVERT_REPS, [&]() { f16c->toHalf(viewZ.data(), &packed[0], count); });
+		}
+		printf("float -> half\t\t%.0f\t\t\t%s%.0f\t\t%d\n", mtexels / scalarms * 1000., f16c ? "f16c " : "-", f16c ? mtexels / simdms * 1000. : 0.,
+			f16c ? countMismatches(packed, scalarPacked) : 0);
+	}
+	{
+		const double scalarms = timeBest(HALF_CONVERT_REPS, [&]() {
+			for (size_t i = 0; i < count; i++) {
+				scalarWidened[i] = halfToFloat(scalarPacked[i]);
+			}
+		});
+		double simdms = 0.0;
+		if (f16c) {
+			simdms = timeBest(HALF_CONVERT_REPS, [&]() { f16c->toFloat(&scalarPacked[0], &widened[0], count); });
+		}
+		printf("half -> float\t\t%.0f\t\t\t%s%.0f\t\t%d\n", mtexels / scalarms * 1000., f16c ? "f16c " : "-", f16c ? mtexels / simdms * 1000. : 0.,
+			f16c ? countMismatches(widened, scalarWidened) : 0);
+	}
+	{
+		const double scalarms = timeBest(HALF_CONVERT_REPS, [&]() {
+			for (size_t i = 0; i < count; i++) {
+				scalarPacked[i] = floatToUnorm16(ao.data()[i]);
+			}
+		});
+		const double simdms = timeBest(HALF_CONVERT_REPS, [&]() { floatToUnorm16(ao.data(), &packed[0], count); });
+		printf("float -> unorm16\t%.0f\t\t\tsse2 %.0f\t\t%d\n", mtexels / scalarms * 1000., mtexels / simdms * 1000., countMismatches(packed, scalarPacked));
+	}
+	{
+		const double scalarms = timeBest(HALF_CONVERT_REPS, [&]() {
+			for (size_t i = 0; i < count; i++) {
+				scalarWidened[i] = unorm16ToFloat(scalarPacked[i]);
+			}
+		});
+		const double simdms = timeBest(HALF_CONVERT_REPS, [&]() { unorm16ToFloat(&scalarPacked[0], &widened[0], count); });
+		printf("unorm16 -> float\t%.0f\t\t\tsse2 %.0f\t\t%d\n", mtexels / scalarms * 1000., mtexels / simdms * 1000., countMismatches(widened, scalarWidened));
+	}
+}
+
+void benchHalfImages()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(HALF_WIDTH, HALF_HEIGHT);
+	Matrix view, proj, invProj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+	proj.getInverse(invProj);
+	Image<fl3> viewNormals (HALF_WIDTH, HALF_HEIGHT);
+	for (int y = 0; y < HALF_HEIGHT; y++) {
+		for (int x = 0; x < HALF_WIDTH; x++) {
+			const fl3 &n = rast.getNormals().at(x, y);
+			if (dot(n, n) > 0.f) {
+				fl3 v = n;
+				normalize(v);
+				viewNormals.at(x, y) = v;
+			}
+		}
+	}
+	const FloatImage &depth = rast.getDepth();
+	Image16 depth16 (HALF_WIDTH, HALF_HEIGHT, IMAGE16_UNORM);
+	depth16.store(depth);
+	int lossy = 0;
+	for (int y = 0; y < HALF_HEIGHT; y++) {
+		for (int x = 0; x < HALF_WIDTH; x++) {
+			lossy += depth16.at(x, y) != depth.at(x, y);
+		}
+	}
+
+	AoParams params;
+	AmbientOcclusion ao;
+	Blur blur;
+
+	// float pipeline
+	LinearDepth linear;
+	FloatImage ao32, blurred32;
+	AoInput input32;
+	input32.normals = &viewNormals;
+	input32.depth = &depth;
+	input32.viewZ = &linear.getViewZ();
+	input32.invProj = invProj;
+	double ms32[3];
+	ms32[0] = timeBest(HALF_REPS, [&]() { linear.build(depth, invProj); });
+	ms32[1] = timeBest(HALF_REPS, [&]() { ao.hbao(input32, params, ao32); });
+	ms32[2] = timeBest(HALF_REPS, [&]() { blur.bilateral(ao32, linear.getViewZ(), blurred32, HALF_BLUR_RADIUS, HALF_BLUR_SHARPNESS); });
+
+	// 16 bit pipeline
+	LinearDepth linear16;
+	Image16 ao16, blurred16;
+	AoInput input16;
+	input16.normals = &viewNormals;
+	input16.halfViewZ = &linear16.getHalfViewZ();
+	input16.invProj = invProj;
+	double ms16[3];
+	ms16[0] = timeBest(HALF_REPS, [&]() { linear16.build(depth16, invProj); });
+	ms16[1] = timeBest(HALF_REPS, [&]() { ao.hbao(input16, params, ao16); });
+	ms16[2] = timeBest(HALF_REPS, [&]() { blur.bilateral(ao16, linear16.getHalfViewZ(), blurred16, HALF_BLUR_RADIUS, HALF_BLUR_SHARPNESS); });
+
+	// bytes the stages stream through at least once (reads + writes), the blur's intermediate is written and read once
+	// hbao reads every view z texel at least once, the taps around it mostly hit the cache
+	const double pixels = (double) HALF_WIDTH * HALF_HEIGHT;
+	const double normalBytes = pixels * sizeof(fl3);
+	const double bytes32[3] = { pixels * 8, pixels * 8 + normalBytes, pixels * 16 };
+	const double bytes16[3] = { pixels * 4, pixels * 4 + normalBytes, pixels * 8 };
+	const char *stages[3] = { "linearize", "hbao", "bilateral" };
+
+	printf("%dx%d, %s, best of %d\n", HALF_WIDTH, HALF_HEIGHT, scene.loadedAsset ? "ServerBot" : "procedural spheres", HALF_REPS);
+	printf("depth as unorm16: %d of %.0f texels changed\n\n", lossy, pixels);
+	printf("stage\t\tfp32 ms\tfp16 ms\tfp32 MB\tfp16 MB\n");
+	double total32 = 0.0, total16 = 0.0, totalBytes32 = 0.0, totalBytes16 = 0.0;
+	for (int i = 0; i < 3; i++) {
+		printf("%-10s\t%.1f\t%.1f\t%.1f\t%.1f\n", stages[i], ms32[i], ms16[i], bytes32[i] / 1e6, bytes16[i] / 1e6);
+		total32 += ms32[i];
+		total16 += ms16[i];
+		totalBytes32 += bytes32[i];
+		totalBytes16 += bytes16[i];
+	}
+	printf("%-10s\t%.1f\t%.1f\t%.1f\t%.1f\n", "total", total32, total16, totalBytes32 / 1e6, totalBytes16 / 1e6);
+	printf("image memory: fp32 %.1f MB, fp16 %.1f MB (depth, view z, ao, blur intermediate, blurred)\n",
+		pixels * 20 / 1e6, pixels * 10 / 1e6);
+
+	// what the narrow storage costs in accuracy, against the float pipeline
+	FloatImage viewZ16, final16, raw16;
+	linear16.getHalfViewZ().load(viewZ16);
+	ao16.load(raw16);
+	blurred16.load(final16);
+	float maxRelative = 0.f, maxAo = 0.f;
+	for (int y = 0; y < HALF_HEIGHT; y++) {
+		for (int x = 0; x < HALF_WIDTH; x++) {
+			const float z = linear.getViewZ().at(x, y);
+			maxRelative = std::max(maxRelative, fabsf(viewZ16.at(x, y) - z) / fabsf(z));
+			maxAo = std::max(maxAo, fabsf(final16.at(x, y) - blurred32.at(x, y)));
+		}
+	}
+	printf("\nview z max relative error %.2e, hbao rmse %.5f, blurred rmse %.5f, max %.5f, ssim %.5f\n\n", maxRelative, rmse(raw16, ao32),
+		rmse(final16, blurred32), maxAo, ssim(final16, blurred32));
+
+	benchConversions(linear.getViewZ(), ao32);
+}
@@ -0,0 +1,336 @@
+#include "bench.h"
+#include "scene.h"
+#include "../ao/aosample.h"
+#include "../ao/aoshaders.h"
+#include "constantring.h"
+#include "cpudevice.h"
+#include "materialtable.h"
+#include "objinstances.h"
+#include "sampler.h"
+#include "statecache.h"
+#include <math.h>
+#include <string.h>
+
+// instanced drawing of a field of repeated models (ObjInstanceBuffer, Mesh::drawInstanced) against a draw per copy
+// the check renders a small field both ways through the ao sample's prepass on the cpu device, which has to give the
+// same targets, and compares the frustum culling against the box corners in clip space
+// the cost is the cpu side of submitting a frame of the full field, with no vertex shader bound so the cpu device
+// drops the draws themselves: what's timed is the application, the StateCache and the binds
+// WORKNOTE: Obj's parser is msvc only, the model is a stand-in with BOT_MESHES meshes of one material each like
+// ServerBot has, every mesh a box
+
+#define BOT_MESHES 7
+#define FIELD_SIZE 100
+#define FIELD_SPACING 5.f
+#define CHECK_SIZE 8
+#define CHECK_WIDTH 256
+#define CHECK_HEIGHT 192
+#define INSTANCE_REPS 5
+
+struct BenchMatrices {
+	float model[16], view[16], proj[16];
+};
+
+static void transposeInto(const float *m, float *out)
+{
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			out[c * 4 + r] = m[r * 4 + c];
+		}
+	}
+}
+
+// an axis aligned box of half size extent around center, 4 vertices per face so the normals are flat
+static void buildBox(RenderDevice &dev, const fl3 &center, const fl3 &extent, InterleavedMesh<PTNvert, uint16_t> &mesh)
+{
+	for (int axis = 0; axis < 3; axis++) {
+		for (int side = -1; side <= 1; side += 2) {
+			const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			const uint16_t first = (uint16_t) (axis * 8 + (side + 1) * 2);
+			for (int corner = 0; corner < 4; corner++) {
+				PTNvert vert;
+				vert.pos = center;
+				vert.pos[axis] += side * extent[axis];
+				vert.pos[u] += ((corner & 1) ? 1 : -1) * extent[u];
+				vert.pos[v] += ((corner & 2) ? 1 : -1) * extent[v];
+				vert.tex = fl3((float) (corner & 1), (float) (corner >> 1), 0.f);
+				vert.norm[axis] = (float) side;
+				mesh.addVert(vert);
+			}
+			// clockwise seen from outside, flipped for the other side
+			if (side > 0) {
+				mesh.addInd(first).addInd(first + 2).addInd(first + 1).addInd(first + 1).addInd(first + 2).addInd(first + 3);
+			} else {
+				mesh.addInd(first).addInd(first + 1).addInd(first + 2).addInd(first + 1).addInd(first + 3).addInd(first + 2);
+			}
+		}
+	}
+	mesh.finalize(dev);
+}
+
+// size x size copies on a grid spacing apart from origin on, each turned around y, every overrideEvery-th one with a
+// material of the table in place of its own
+static void generateField(int size, float spacing, const fl3 &origin, unsigned int &seed, unsigned int overrideEvery, unsigned int materials,
+	std::vector<Matrix> &models, std::vector<ObjInstance> &instances)
+{
+	models.clear();
+	instances.clear();
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			Matrix model;
+			model.translate(origin.x + spacing * x, origin.y, origin.z + spacing * z);
+			model.rotate(360.f * benchRandom(seed), 0.f, 1.f, 0.f);
+			const bool overridden = overrideEvery && (unsigned int) (z * size + x) % overrideEvery == 0;
+			models.push_back(model);
+			instances.push_back(ObjInstance::FromMatrix(model, overridden ? (unsigned int) (benchRandom(seed) * materials) : OBJ_NO_MATERIAL_OVERRIDE));
+		}
+	}
+}
+
+// the model: its meshes with the materials and textures Obj would bind for them
+struct BenchBot {
+	BenchBot(RenderDevice &dev);
+	~BenchBot();
+	void bindMaterial(RenderDevice &dev, RenderContext &context, int mesh) const;
+
+	InterleavedMesh<PTNvert, uint16_t> *meshes[BOT_MESHES];
+	RenderTexture *textures[BOT_MESHES][3];
+	MaterialTable table;
+	fl3 min, max;
+};
+
+BenchBot::BenchBot(RenderDevice &dev)
+{
+	// a body with a head, arms and legs, about the size of ServerBot
+	const fl3 centers[BOT_MESHES] = { fl3(0, 3, 0), fl3(0, 5, 0), fl3(-1.5f, 3, 0), fl3(1.5f, 3, 0), fl3(-0.5f, 1, 0), fl3(0.5f, 1, 0), fl3(0, 5.2f, -0.6f) };
+	const fl3 extents[BOT_MESHES] = { fl3(1, 1, 0.6f), fl3(0.6f, 0.6f, 0.6f), fl3(0.4f, 1, 0.4f), fl3(0.4f, 1, 0.4f), fl3(0.4f, 1, 0.4f), fl3(0.4f, 1, 0.4f), fl3(0.3f, 0.2f, 0.1f) };
+	TextureDesc desc;
+	desc.width = desc.height = 4;
+	desc.format = FORMAT_R8G8B8A8_UNORM;
+	desc.bindFlags = BIND_SHADER_RESOURCE;
+	unsigned int seed = 99;
+	for (int i = 0; i < BOT_MESHES; i++) {
+		meshes[i] = new InterleavedMesh<PTNvert, uint16_t>(TOPOLOGY_TRIANGLELIST);
+		buildBox(dev, centers[i], extents[i], *meshes[i]);
+		for (int t = 0; t < 3; t++) {
+			textures[i][t] = dev.createTexture(desc);
+		}
+		MaterialConstants material = MaterialConstants();
+		material.Kd = fl3(benchRandom(seed), benchRandom(seed), benchRandom(seed));
+		table.add(material);
+	}
+	// and some for the overrides
+	for (int i = 0; i < 32; i++) {
+		MaterialConstants material = MaterialConstants();
+		material.Kd = fl3(benchRandom(seed), benchRandom(seed), benchRandom(seed));
+		table.add(material);
+	}
+	table.finalize(dev);
+	min = fl3(-1.9f, 0, -1.2f);
+	max = fl3(1.9f, 5.8f, 0.8f);
+}
+
+BenchBot::~BenchBot()
+{
+	for (int i = 0; i < BOT_MESHES; i++) {
+		delete meshes[i];
+		for (int t = 0; t < 3; t++) {
+			delete textures[i][t];
+		}
+	}
+}
+
+// what Obj::bindMaterial binds
+void BenchBot::bindMaterial(RenderDevice &dev, RenderContext &context, int mesh) const
+{
+	table.use(context, STAGE_PIXEL, 1, mesh);
+	context.setShaderResources(STAGE_PIXEL, 0, 3, textures[mesh]);
+	Sampler::GetDefaultSampler(dev).use(context, 0);
+}
+
+// texels of two device textures that differ
+static unsigned int compareTextures(RenderTexture *a, RenderTexture *b)
+{
+	const CpuTexture &ta = *static_cast<CpuTexture *>(a);
+	const CpuTexture &tb = *static_cast<CpuTexture *>(b);
+	unsigned int differ = 0;
+	for (int y = 0; y < ta.getHeight(); y++) {
+		for (int x = 0; x < ta.getWidth(); x++) {
+			differ += memcmp(ta.texel(x, y), tb.texel(x, y), ta.getChannels() * sizeof(float)) != 0;
+		}
+	}
+	return differ;
+}
+
+// whether any corner of the model's box is inside the clip volume, a lower bound of what is visible
+static bool anyCornerInside(const Matrix &model, const fl3 &min, const fl3 &max, const Matrix &view, const Matrix &proj)
+{
+	for (int corner = 0; corner < 8; corner++) {
+		const float p[4] = { (corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z, 1.f };
+		float world[4], eye[4], clip[4];
+		const float *matrices[3] = { model.data(), view.data(), proj.data() };
+		const float *in = p;
+		float *outs[3] = { world, eye, clip };
+		for (int m = 0; m < 3; m++) {
+			for (int c = 0; c < 4; c++) {
+				outs[m][c] = in[0] * matrices[m][c] + in[1] * matrices[m][4 + c] + in[2] * matrices[m][8 + c] + in[3] * matrices[m][12 + c];
+			}
+			in = outs[m];
+		}
+		if (fabsf(clip[0]) <= clip[3] && fabsf(clip[1]) <= clip[3] && clip[2] >= 0.f && clip[2] <= clip[3]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void checkInstancing()
+{
+	CpuDevice dev (CHECK_WIDTH, CHECK_HEIGHT);
+	RegisterAoShaders(dev);
+	AoSample sample (dev, CHECK_WIDTH, CHECK_HEIGHT);
+	BenchBot bot (dev);
+	Matrix view, proj;
+	benchViewMatrix(BENCH_CAMERA_POS, BENCH_CAMERA_ROT, view);
+	benchProjMatrix(45.f, CHECK_WIDTH / (float) CHECK_HEIGHT, proj);
+	unsigned int seed = 5;
+	std::vector<Matrix> models;
+	std::vector<ObjInstance> instances;
+	generateField(CHECK_SIZE, 3.f, fl3(-10.5f, 0.f, 0.f), seed, 0, 0, models, instances);
+
+	// a copy at a time, each with its model matrix in the ring, like Obj::draw per copy would need
+	ConstantRing ring (dev, CHECK_SIZE * CHECK_SIZE * CONSTANT_RANGE_ALIGNMENT * 2);
+	BenchMatrices matrices;
+	transposeInto(view.data(), matrices.view);
+	transposeInto(proj.data(), matrices.proj);
+	sample.render(view, proj, [&](RenderContext &context) {
+		for (size_t i = 0; i < models.size(); i++) {
+			transposeInto(models[i].data(), matrices.model);
+			ConstantRing::use(context, STAGE_VERTEX, 0, ring.allocate(context, matrices));
+			for (int m = 0; m < BOT_MESHES; m++) {
+				bot.meshes[m]->draw(dev, context);
+			}
+		}
+	});
+	ring.endFrame();
+	TextureDesc normalsDesc = sample.getPrepassNormals()->getDesc();
+	normalsDesc.bindFlags = BIND_SHADER_RESOURCE;
+	TextureDesc depthDesc = sample.getPrepassDepth()->getDesc();
+	depthDesc.bindFlags = BIND_SHADER_RESOURCE;
+	RenderTexture *normals = dev.createTexture(normalsDesc);
+	RenderTexture *depth = dev.createTexture(depthDesc);
+	dev.getContext().copyTexture(normals, sample.getPrepassNormals());
+	dev.getContext().copyTexture(depth, sample.getPrepassDepth());
+
+	// all of them in one draw per mesh
+	ObjInstanceBuffer buffer (dev, 16);
+	buffer.update(dev, dev.getContext(), &instances[0], instances.size());
+	sample.render(view, proj, [&](RenderContext &context) {
+		sample.useInstancedPrepass(context);
+		buffer.use(context);
+		for (int m = 0; m < BOT_MESHES; m++) {
+			bot.meshes[m]->drawInstanced(dev, context, buffer.getCount(), 0);
+		}
+	});
+	const CpuTexture &covered = *static_cast<CpuTexture *>(depth);
+	unsigned int coveredTexels = 0;
+	for (int y = 0; y < covered.getHeight(); y++) {
+		for (int x = 0; x < covered.getWidth(); x++) {
+			coveredTexels += covered.texel(x, y)[0] < 1.f;
+		}
+	}
+	printf("%dx%d field through the prepass (%u texels covered), a draw per copy and mesh against %d instanced draws: %u normal texels and %u depth texels differ\n",
+		CHECK_SIZE, CHECK_SIZE, coveredTexels, BOT_MESHES, compareTextures(normals, sample.getPrepassNormals()),
+		compareTextures(depth, sample.getPrepassDepth()));
+	delete normals;
+	delete depth;
+
+	// the culling is conservative: nothing with a corner on screen may go
+	generateField(FIELD_SIZE, FIELD_SPACING, fl3(-FIELD_SIZE * FIELD_SPACING / 2, 0.f, -20.f), seed, 0, 0, models, instances);
+	std::vector<ObjInstance> visible;
+	ObjInstanceBuffer::CullInstances(&instances[0], instances.size(), bot.min, bot.max, view, proj, visible);
+	unsigned int cornerVisible = 0;
+	for (size_t i = 0; i < models.size(); i++) {
+		cornerVisible += anyCornerInside(models[i], bot.min, bot.max, view, proj);
+	}
+	printf("%d copies culled to %u (%u have a corner on screen, %s)\n", FIELD_SIZE * FIELD_SIZE, (unsigned int) visible.size(),
+		cornerVisible, visible.size() >= cornerVisible ? "none of them culled" : "SOME CULLED");
+}
+
+void benchInstancing()
+{
+	checkInstancing();
+
+	// submission cost of the full field
+	CpuDevice dev (64, 64);
+	BenchBot bot (dev);
+	Matrix view, proj;
+	benchViewMatrix(BENCH_CAMERA_POS, BENCH_CAMERA_ROT, view);
+	benchProjMatrix(45.f, 4.f / 3.f, proj);
+	unsigned int seed = 17;
+	std::vector<Matrix> models;
+	std::vector<ObjInstance> instances;
+	generateField(FIELD_SIZE, FIELD_SPACING, fl3(-FIELD_SIZE * FIELD_SPACING / 2, 0.f, -20.f), seed, 10, bot.table.size(), models, instances);
+	RenderContext &context = dev.getContext();
+	StateCache &cache = dev.getStateCache();
+	ConstantRing ring (dev, FIELD_SIZE * FIELD_SIZE * CONSTANT_RANGE_ALIGNMENT * 2);
+	ObjInstanceBuffer buffer (dev);
+	BenchMatrices matrices;
+	transposeInto(view.data(), matrices.view);
+	transposeInto(proj.data(), matrices.proj);
+	std::vector<ObjInstance> visible;
+
+	printf("%d copies of a %d mesh model, cpu submission per frame:\n", FIELD_SIZE * FIELD_SIZE, BOT_MESHES);
+	for (int method = 0; method < 3; method++) {
+		cache.invalidate();
+		cache.endFrame();
+		unsigned int draws = 0;
+		const double ms = timeBest(INSTANCE_REPS, [&]() {
+			cache.endFrame();
+			draws = 0;
+			if (method < 2) {
+				// a draw per copy and mesh, everything or only what's in the frustum
+				visible.clear();
+				if (method == 1) {
+					ObjInstanceBuffer::CullInstances(&instances[0], instances.size(), bot.min, bot.max, view, proj, visible);
+				}
+				const size_t count = method == 1 ? visible.size() : instances.size();
+				for (size_t i = 0; i < count; i++) {
+					const ObjInstance &instance = method == 1 ? visible[i] : instances[i];
+					float model[16] = { 0 };
+					for (int c = 0; c < 3; c++) {
+						memcpy(&model[c * 4], instance.transform[c], 4 * sizeof(float));
+					}
+					model[15] = 1.f;
+					memcpy(matrices.model, model, sizeof(model));
+					ConstantRing::use(context, STAGE_VERTEX, 0, ring.allocate(context, matrices));
+					for (int m = 0; m < BOT_MESHES; m++) {
+						bot.bindMaterial(dev, context, m);
+						bot.meshes[m]->draw(dev, context);
+						draws++;
+					}
+				}
+				ring.endFrame();
+			} else {
+				// culled and uploaded, then a draw per mesh
+				buffer.update(dev, context, &instances[0], instances.size(), bot.min, bot.max, view, proj);
+				buffer.use(context);
+				bot.table.useTable(context, STAGE_PIXEL, 2);
+				for (int m = 0; m < BOT_MESHES; m++) {
+					bot.bindMaterial(dev, context, m);
+					bot.meshes[m]->drawInstanced(dev, context, buffer.getCount(), 0);
+					draws++;
+				}
+			}
+		});
+		cache.endFrame();
+		const StateCacheStats &stats = cache.getFrameStats();
+		static const char *names[3] = { "a draw per copy", "a draw per copy, culled", "instanced, culled" };
+		printf("  %-24s %8.3f ms, %6u draws, %6u state calls issued (%u filtered)", names[method], ms, draws, stats.getIssued(), stats.getFiltered());
+		if (method == 2) {
+			printf(", %u of %u copies uploaded (%.1f KB)", buffer.getStats().visible, buffer.getStats().submitted,
+				buffer.getStats().visible * sizeof(ObjInstance) / 1024.0);
+		}
+		printf("\n");
+	}
+}
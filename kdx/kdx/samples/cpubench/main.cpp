@@ -0,0 +1,60 @@
+#include "bench.h"
+#include "parallel.h"
+#include <string.h>
+
+// console runner for the cpu-side benchmarks
+// usage: cpubench [name], no name runs everything
+
+struct BenchEntry {
+	const char *name;
+	void (*func)();
+};
+
+static const BenchEntry Benches[] = {
+	{ "blur", benchBlur },
+	{ "raster", benchRaster },
+	{ "hiz", benchHiZ },
+	{ "aores", benchAoResolution },
+	{ "temporal", benchTemporalAo },
+	{ "deinterleave", benchDeinterleave },
+	{ "linear", benchLinearDepth },
+	{ "presets", benchPresets },
+	{ "groundtruth", benchGroundTruth },
+	{ "bake", benchBake },
+	{ "bvh", benchBvh },
+	{ "raykernels", benchRayKernels },
+	{ "normals", benchNormals },
+	{ "encoding", benchNormalEncoding },
+	{ "half", benchHalfImages },
+	{ "device", benchRenderDevice },
+	{ "queue", benchRenderQueue },
+	{ "framegraph", benchFrameGraph },
+	{ "pool", benchTargetPool },
+	{ "ring", benchConstantRing },
+	{ "materials", benchMaterialTable },
+	{ "instancing", benchInstancing },
+	{ "arena", benchGeometryArena },
+	{ "shadercache", benchShaderCache },
+};
+
+int main(int argc, char **argv)
+{
+	printf("cpubench: %u worker threads\n", ThreadPool::GetDefaultPool().getNumThreads());
+	bool ran = false;
+	for (size_t i = 0; i < sizeof(Benches) / sizeof(Benches[0]); i++) {
+		if (argc < 2 || strcmp(argv[1], Benches[i].name) == 0) {
+			printf("\n== %s ==\n", Benches[i].name);
+			Benches[i].func();
+			ran = true;
+		}
+	}
+	if (!ran) {
+		printf("unknown benchmark %s, available:", argv[1]);
+		for (size_t i = 0; i < sizeof(Benches) / sizeof(Benches[0]); i++) {
+			printf(" %s", Benches[i].name);
+		}
+		printf("\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "bench.h"
+#include "cpudevice.h"
+#include "materialtable.h"
+#include "statecache.h"
+#include <vector>
+
+// MaterialTable with the materials of a few Objs in it, drawn in random order through the state cache
+// every draw is a dispatch of a compute shader that copies what it sees of the cbuffer in slot 1 out to a uav, so the
+// check is of the range binds as a shader gets them, not of the table's memory
+// WORKNOTE: the layout against objrender.hlsl's packoffsets is checked at compile time in materialtable.h
+
+#define MATERIAL_DRAWS 20000
+
+// what the pixel shader of objrender.hlsl would read, two texels of it
+static void materialReadMain(const CpuShaderState &state, const unsigned int *)
+{
+	const MaterialConstants &material = state.constants<MaterialConstants>(1);
+	const float scalars[4] = { material.Ns, material.Ni, material.Tr, (float) material.illum };
+	const float colors[4] = { material.Kd.r, material.Kd.g, material.Kd.b, material.Ke.r };
+	state.store(0, 0, 0, scalars);
+	state.store(0, 1, 0, colors);
+}
+
+static MaterialConstants randomMaterial(unsigned int &seed)
+{
+	MaterialConstants material = MaterialConstants();
+	material.Ns = benchRandom(seed) * 1000.f;
+	material.Ni = 1.f + benchRandom(seed);
+	material.Tr = benchRandom(seed);
+	material.illum = (uint32_t) (benchRandom(seed) * 3);
+	material.Kd = fl3(benchRandom(seed), benchRandom(seed), benchRandom(seed));
+	material.Ke = fl3(benchRandom(seed), 0.f, 0.f);
+	return material;
+}
+
+void benchMaterialTable()
+{
+	CpuDevice dev (16, 16);
+	const CpuShaderProgram read = { 0, 0, 0, materialReadMain };
+	dev.registerShader(L"materialread.hlsl", read);
+	RenderShader *shader = dev.createShader(STAGE_COMPUTE, L"materialread.hlsl");
+	TextureDesc desc;
+	desc.width = 2;
+	desc.height = 1;
+	desc.format = FORMAT_R32G32B32A32_FLOAT;
+	desc.bindFlags = BIND_UNORDERED_ACCESS;
+	RenderTexture *out = dev.createTexture(desc);
+	const CpuTexture &texels = *static_cast<const CpuTexture *>(out);
+
+	// three Objs loaded into one table, the ServerBot sized one and two more
+	const unsigned int objMaterials[] = { 7, 40, 120 };
+	unsigned int seed = 4242;
+	MaterialTable table;
+	std::vector<unsigned int> first;
+	for (size_t i = 0; i < sizeof(objMaterials) / sizeof(objMaterials[0]); i++) {
+		first.push_back(table.size());
+		for (unsigned int m = 0; m < objMaterials[i]; m++) {
+			table.add(randomMaterial(seed));
+		}
+	}
+	BenchTimer timer;
+	const bool finalized = table.finalize(dev);
+	const double uploadms = timer.elapsedMillis();
+
+	RenderContext &context = dev.getContext();
+	StateCache &cache = dev.getStateCache();
+	cache.invalidate();
+	const StateCacheStats before = cache.getStats();
+	context.setShader(STAGE_COMPUTE, shader);
+	context.setUnorderedAccessViews(0, 1, &out);
+	unsigned int mismatches = 0;
+	for (int i = 0; i < MATERIAL_DRAWS; i++) {
+		// an Obj, one of its materials, and sometimes the same one twice in a row like a sorted queue has
+		const int obj = (int) (benchRandom(seed) * 3);
+		const unsigned int index = first[obj] + (unsigned int) (benchRandom(seed) * objMaterials[obj]);
+		table.use(context, STAGE_COMPUTE, 1, index);
+		if (benchRandom(seed) < 0.5f) {
+			table.use(context, STAGE_COMPUTE, 1, index);
+		}
+		context.dispatch(1, 1, 1);
+		const MaterialConstants &expected = table.get(index);
+		const float *scalars = texels.texel(0, 0);
+		const float *colors = texels.texel(1, 0);
+		mismatches += scalars[0] != expected.Ns || scalars[1] != expected.Ni || scalars[2] != expected.Tr ||
+			scalars[3] != (float) expected.illum || colors[0] != expected.Kd.r || colors[1] != expected.Kd.g ||
+			colors[2] != expected.Kd.b || colors[3] != expected.Ke.r;
+	}
+	const StateCacheStats &after = cache.getStats();
+	printf("%u materials of %d objs in one %.1f KB table (%s, %.3f ms), a cbuffer each would be %u buffers of %d bytes\n",
+		table.size(), (int) first.size(), table.size() * MATERIAL_TABLE_STRIDE / 1024.0, finalized ? "uploaded" : "upload failed",
+		uploadms, table.size(), (int) sizeof(MaterialConstants));
+	printf("%d draws: %u constant binds issued, %u filtered, %u draws saw the wrong material\n", MATERIAL_DRAWS,
+		after.issued[STATE_CONSTANT_BUFFERS] - before.issued[STATE_CONSTANT_BUFFERS],
+		after.filtered[STATE_CONSTANT_BUFFERS] - before.filtered[STATE_CONSTANT_BUFFERS], mismatches);
+
+	delete out;
+	delete shader;
+}
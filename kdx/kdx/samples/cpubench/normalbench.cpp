@@ -0,0 +1,283 @@
+#include "bench.h"
+#include "scene.h"
+#include "ambientocclusion.h"
+#include "imagemetrics.h"
+#include "lineardepth.h"
+#include "normalencoding.h"
+#include "normalreconstruction.h"
+#include "constants.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// normals reconstructed from depth against the rasterized ones, and what dropping the normal target saves,
+// then the packed encodings of normalencoding.h: their error distribution and what a smaller target saves
+// the rasterized normals are the interpolated vertex normals in view space (what prepass.hlsl writes), normalized
+// for the comparison, so part of the error is the faceting of the reconstruction on curved meshes
+
+#define NORMAL_WIDTH 1920
+#define NORMAL_HEIGHT 1080
+#define NORMAL_REPS 5
+// R32G32B32A32_FLOAT, the prepass color target in samples/ao/main.cpp
+#define NORMAL_TARGET_BYTES 16
+#define NORMAL_FPS 60
+// random unit vectors per encoding
+#define NORMAL_ENCODING_SAMPLES (1 << 20)
+
+// angular error statistics over the pixels with geometry, in degrees
+struct NormalError {
+	double mean;
+	float median;
+	float p95;
+	double over10; // fraction of pixels off by more than 10 degrees
+	double over30;
+};
+
+static void compareNormals(const Image<fl3> &reference, const Image<fl3> &normals, NormalError &error)
+{
+	std::vector<float> angles;
+	angles.reserve((size_t) reference.getWidth() * reference.getHeight());
+	double sum = 0.0;
+	int over10 = 0, over30 = 0;
+	for (int y = 0; y < reference.getHeight(); y++) {
+		for (int x = 0; x < reference.getWidth(); x++) {
+			const fl3 &a = reference.at(x, y);
+			if (dot(a, a) == 0.f) {
+				continue;
+			}
+			const float angle = acosf(std::max(-1.f, std::min(1.f, dot(a, normals.at(x, y))))) * 180.f / M_PI;
+			angles.push_back(angle);
+			sum += angle;
+			over10 += angle > 10.f;
+			over30 += angle > 30.f;
+		}
+	}
+	std::sort(angles.begin(), angles.end());
+	const size_t count = std::max<size_t>(angles.size(), 1);
+	error.mean = sum / count;
+	error.median = angles.empty() ? 0.f : angles[angles.size() / 2];
+	error.p95 = angles.empty() ? 0.f : angles[angles.size() * 95 / 100];
+	error.over10 = (double) over10 / count;
+	error.over30 = (double) over30 / count;
+}
+
+// normals a scaled view space normal image for the pgm dumps, 1 facing the camera
+static void normalFacing(const Image<fl3> &normals, FloatImage &out)
+{
+	out.resize(normals.getWidth(), normals.getHeight());
+	for (int y = 0; y < normals.getHeight(); y++) {
+		for (int x = 0; x < normals.getWidth(); x++) {
+			out.at(x, y) = std::max(0.f, -normals.at(x, y).z);
+		}
+	}
+}
+
+void benchNormals()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(NORMAL_WIDTH, NORMAL_HEIGHT);
+	Matrix view, proj, invProj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+	proj.getInverse(invProj);
+
+	// the rasterized view space normals at unit length, what the ao kernels expect
+	Image<fl3> viewNormals (NORMAL_WIDTH, NORMAL_HEIGHT);
+	for (int y = 0; y < NORMAL_HEIGHT; y++) {
+		for (int x = 0; x < NORMAL_WIDTH; x++) {
+			const fl3 &n = rast.getNormals().at(x, y);
+			if (dot(n, n) > 0.f) {
+				fl3 v = n;
+				normalize(v);
+				viewNormals.at(x, y) = v;
+			}
+		}
+	}
+	FloatImage d16 = rast.getDepth();
+
+	// the same frame without the D16 rounding, for how much of the error the depth format is responsible for
+	Rasterizer floatRast;
+	floatRast.resize(NORMAL_WIDTH, NORMAL_HEIGHT);
+	floatRast.setDepthQuantization(false);
+	Matrix floatView, floatProj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, floatRast, floatView, floatProj);
+
+	// prepass cost with and without the normal target
+	const double fullms = timeBest(NORMAL_REPS, [&]() { renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj); });
+	rast.setNormalOutput(false);
+	const double depthms = timeBest(NORMAL_REPS, [&]() { renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj); });
+	rast.setNormalOutput(true);
+	printf("%dx%d prepass: depth + normals %.2f ms, depth only %.2f ms\n", NORMAL_WIDTH, NORMAL_HEIGHT, fullms, depthms);
+
+	LinearDepth linear;
+	linear.build(d16, invProj);
+	NormalReconstruction reconstruction;
+	printf("\ndepth\ttaps\tbuild ms\tmean deg\tmedian deg\tp95 deg\t> 10 deg\t> 30 deg\n");
+	const FloatImage *depths[] = { &d16, &floatRast.getDepth() };
+	const char *depthNames[] = { "d16", "float" };
+	const NORMAL_TAPS taps[] = { NORMAL_TAPS_3, NORMAL_TAPS_5 };
+	for (int d = 0; d < 2; d++) {
+		for (int t = 0; t < 2; t++) {
+			const double ms = timeBest(NORMAL_REPS, [&]() { reconstruction.build(*depths[d], invProj, taps[t]); });
+			NormalError error;
+			compareNormals(viewNormals, reconstruction.getNormals(), error);
+			printf("%s\t%d\t%.2f\t\t%.2f\t\t%.2f\t\t%.2f\t%.2f%%\t\t%.2f%%\n", depthNames[d], taps[t], ms, error.mean, error.median, error.p95,
+				100.0 * error.over10, 100.0 * error.over30);
+			if (getenv("CPUBENCH_DUMP") && d == 0) {
+				FloatImage facing;
+				normalFacing(reconstruction.getNormals(), facing);
+				saveBenchImage(t == 0 ? "normals_3tap.pgm" : "normals_5tap.pgm", facing);
+			}
+		}
+	}
+	const double linearms = timeBest(NORMAL_REPS, [&]() { reconstruction.build(d16, invProj, NORMAL_TAPS_5, &linear.getViewZ()); });
+	printf("d16\t5\t%.2f\t\t(positions from LinearDepth, build not included)\n", linearms);
+	if (getenv("CPUBENCH_DUMP")) {
+		FloatImage facing;
+		normalFacing(viewNormals, facing);
+		saveBenchImage("normals_raster.pgm", facing);
+	}
+
+	// hbao with the rasterized normals and reconstructed ones
+	AmbientOcclusion ao;
+	AoParams params;
+	AoInput input;
+	input.depth = &d16;
+	input.invProj = invProj;
+	FloatImage viewSpace, rebuilt;
+	input.normals = &viewNormals;
+	ao.hbao(input, params, viewSpace);
+	input.normals = 0;
+	ao.hbao(input, params, rebuilt);
+	printf("\nhbao rmse: reconstructed (5 taps) vs view normals %.4f\n", rmse(rebuilt, viewSpace));
+
+	// the target is written once by the prepass and read once by the ao pass, the reconstruction reads depth
+	// the ao pass fetches anyway (its neighbours are in the same cache lines), so all of that traffic goes away
+	printf("\nresolution\tnormal target MB\tsaved MB/frame\tsaved GB/s at %d fps\n", NORMAL_FPS);
+	const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+	for (int i = 0; i < 2; i++) {
+		const double bytes = (double) sizes[i][0] * sizes[i][1] * NORMAL_TARGET_BYTES;
+		printf("%dx%d\t%.1f\t\t\t%.1f\t\t%.2f\n", sizes[i][0], sizes[i][1], bytes / 1e6, 2.0 * bytes / 1e6, 2.0 * bytes * NORMAL_FPS / 1e9);
+	}
+}
+
+// uniformly distributed on the sphere
+static fl3 randomUnitVector(unsigned int &state)
+{
+	const float z = 2.f * benchRandom(state) - 1.f;
+	const float phi = 2.f * M_PI * benchRandom(state);
+	const float r = sqrtf(std::max(0.f, 1.f - z * z));
+	return fl3(r * cosf(phi), r * sinf(phi), z);
+}
+
+static float angleDegrees(const fl3 &a, const fl3 &b)
+{
+	return acosf(std::max(-1.f, std::min(1.f, dot(a, b)))) * 180.f / M_PI;
+}
+
+void benchNormalEncoding()
+{
+	// error distribution over the whole sphere and over the half facing the camera (view z < 0),
+	// the only normals a view space target ever holds
+	std::vector<fl3> normals (NORMAL_ENCODING_SAMPLES);
+	unsigned int state = 7;
+	for (size_t i = 0; i < normals.size(); i++) {
+		normals[i] = randomUnitVector(state);
+	}
+	std::vector<uint32_t> packed (normals.size()), scalarPacked (normals.size());
+	std::vector<fl3> decoded (normals.size());
+
+	printf("encoding\tformat\t\t\tbits\tnormals\t\tmean deg\tp99 deg\t\tmax deg\tsse != scalar\tencode M/s scalar/sse\tdecode M/s scalar/sse\n");
+	for (int e = 0; e < NORMAL_ENCODING_COUNT; e++) {
+		const NORMAL_ENCODING encoding = (NORMAL_ENCODING) e;
+		const NormalEncodingInfo &info = GetNormalEncodingInfo(encoding);
+
+		const double scalarEncodems = timeBest(NORMAL_REPS, [&]() {
+			for (size_t i = 0; i < normals.size(); i++) {
+				scalarPacked[i] = encodeNormal(encoding, normals[i]);
+			}
+		});
+		const double encodems = timeBest(NORMAL_REPS, [&]() { encodeNormals(encoding, &normals[0], &packed[0], normals.size()); });
+		const double scalarDecodems = timeBest(NORMAL_REPS, [&]() {
+			for (size_t i = 0; i < normals.size(); i++) {
+				decoded[i] = decodeNormal(encoding, packed[i]);
+			}
+		});
+		int mismatches = 0;
+		for (size_t i = 0; i < normals.size(); i++) {
+			mismatches += packed[i] != scalarPacked[i];
+		}
+		const double decodems = timeBest(NORMAL_REPS, [&]() { decodeNormals(encoding, &packed[0], &decoded[0], normals.size()); });
+		for (size_t i = 0; i < normals.size(); i++) {
+			mismatches += !(decoded[i] == decodeNormal(encoding, packed[i]));
+		}
+
+		for (int half = 0; half < 2; half++) {
+			std::vector<float> angles;
+			angles.reserve(normals.size());
+			double sum = 0.0;
+			for (size_t i = 0; i < normals.size(); i++) {
+				if (half == 1 && normals[i].z >= 0.f) {
+					continue;
+				}
+				const float angle = angleDegrees(normals[i], decoded[i]);
+				angles.push_back(angle);
+				sum += angle;
+			}
+			std::sort(angles.begin(), angles.end());
+			const double count = (double) normals.size() / 1e6;
+			printf("%-12s\t%-20s\t%d\t%s\t%.4f\t\t%.4f\t\t%.4f", info.name, info.format, info.bits, half == 0 ? "sphere\t" : "facing camera",
+				sum / angles.size(), angles[angles.size() * 99 / 100], angles.back());
+			if (half == 0) {
+				printf("\t%d\t\t%.0f / %.0f\t\t%.0f / %.0f", mismatches, count / scalarEncodems * 1000., count / encodems * 1000.,
+					count / scalarDecodems * 1000., count / decodems * 1000.);
+			}
+			printf("\n");
+		}
+	}
+
+	// what the packed target does to the ao, hbao on the bench scene with the decoded normals against the float ones
+	BenchScene scene;
+	loadBenchScene(scene);
+	Rasterizer rast;
+	rast.resize(NORMAL_WIDTH, NORMAL_HEIGHT);
+	Matrix view, proj;
+	renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+	Image<fl3> viewNormals (NORMAL_WIDTH, NORMAL_HEIGHT);
+	for (int y = 0; y < NORMAL_HEIGHT; y++) {
+		for (int x = 0; x < NORMAL_WIDTH; x++) {
+			const fl3 &n = rast.getNormals().at(x, y);
+			if (dot(n, n) > 0.f) {
+				fl3 v = n;
+				normalize(v);
+				viewNormals.at(x, y) = v;
+			}
+		}
+	}
+	AmbientOcclusion ao;
+	AoParams params;
+	AoInput input;
+	input.depth = &rast.getDepth();
+	proj.getInverse(input.invProj);
+	input.normals = &viewNormals;
+	FloatImage reference, packedAo;
+	ao.hbao(input, params, reference);
+	const size_t pixels = (size_t) NORMAL_WIDTH * NORMAL_HEIGHT;
+	std::vector<uint32_t> target (pixels);
+	Image<fl3> unpacked (NORMAL_WIDTH, NORMAL_HEIGHT);
+	input.normals = &unpacked;
+	printf("\nencoding\thbao rmse vs float normals\tbytes/px\tsaved MB/frame 1080p\t4K\tsaved GB/s at %d fps 1080p\t4K\n", NORMAL_FPS);
+	for (int e = 0; e < NORMAL_ENCODING_COUNT; e++) {
+		const NORMAL_ENCODING encoding = (NORMAL_ENCODING) e;
+		const NormalEncodingInfo &info = GetNormalEncodingInfo(encoding);
+		encodeNormals(encoding, viewNormals.data(), &target[0], pixels);
+		decodeNormals(encoding, &target[0], unpacked.data(), pixels);
+		ao.hbao(input, params, packedAo);
+		// written by the prepass and read by the ao pass, against the R32G32B32A32 target
+		const double saved1080 = 2.0 * 1920 * 1080 * (NORMAL_TARGET_BYTES - info.bytesPerPixel);
+		const double saved4k = 2.0 * 3840 * 2160 * (NORMAL_TARGET_BYTES - info.bytesPerPixel);
+		printf("%-12s\t%.5f\t\t\t\t%d\t\t%.1f\t\t\t%.1f\t%.2f\t\t\t\t%.2f\n", info.name, rmse(reference, packedAo), info.bytesPerPixel,
+			saved1080 / 1e6, saved4k / 1e6, saved1080 * NORMAL_FPS / 1e9, saved4k * NORMAL_FPS / 1e9);
+	}
+}
@@ -0,0 +1,126 @@
+#include "bench.h"
+#include "cpudevice.h"
+#include "framebuffer.h"
+#include "framegraph.h"
+#include "targetpool.h"
+
+// RenderTargetPool through a window's life: the ao sample's targets described to a FrameGraph every frame (compiled
+// only, the passes don't matter here), with a drag resize, a stretch at the new size and a jump back to the old one
+// and a Framebuffer resized back and forth, with and without a pool
+
+#define POOL_STEADY_FRAMES 30
+#define POOL_DRAG_FRAMES 12
+
+static void buildAoTargets(FrameGraph &graph, unsigned int width, unsigned int height)
+{
+	const std::function<void(RenderContext&)> nothing = [](RenderContext &) {};
+	TextureDesc desc;
+	desc.width = width;
+	desc.height = height;
+	graph.reset();
+	desc.format = FORMAT_R16G16_SNORM;
+	desc.bindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+	const FrameTexture normals = graph.createTexture("prepass normals", desc);
+	desc.format = FORMAT_D16_UNORM;
+	desc.bindFlags = BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE;
+	const FrameTexture depth = graph.createTexture("prepass depth", desc);
+	desc.format = FORMAT_R32_FLOAT;
+	desc.bindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+	const FrameTexture ao = graph.createTexture("ao", desc);
+	desc.format = FORMAT_R32G32B32A32_FLOAT;
+	desc.bindFlags = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+	const FrameTexture blurred = graph.createTexture("blurred ao", desc);
+	desc.format = FORMAT_R8G8B8A8_UNORM;
+	desc.bindFlags = BIND_RENDER_TARGET;
+	const FrameTexture output = graph.createTexture("output", desc);
+	graph.setOutput(output);
+
+	const float clear[4] = { 0.f, 0.f, 0.f, 0.f };
+	const unsigned int prepass = graph.addPass("prepass", nothing);
+	graph.writeTarget(prepass, normals, 0, clear, false);
+	graph.writeDepth(prepass, depth, clear);
+	const unsigned int hbao = graph.addPass("hbao", nothing);
+	graph.readTexture(hbao, normals, STAGE_PIXEL, 0);
+	graph.readTexture(hbao, depth, STAGE_PIXEL, 1);
+	graph.writeTarget(hbao, ao, 0, 0, true);
+	const unsigned int blur = graph.addPass("blur", nothing);
+	graph.readTexture(blur, ao, STAGE_COMPUTE, 0);
+	graph.writeUav(blur, blurred, 0, true);
+	const unsigned int blit = graph.addPass("blit", nothing);
+	graph.readTexture(blit, blurred, STAGE_PIXEL, 0);
+	graph.writeTarget(blit, output, 0, 0, true);
+}
+
+// one frame of the window at width x height
+static void poolFrame(FrameGraph &graph, RenderTargetPool &pool, unsigned int width, unsigned int height)
+{
+	buildAoTargets(graph, width, height);
+	graph.compile();
+	pool.endFrame();
+}
+
+static void benchWindow(CpuDevice &dev, unsigned int maxIdleFrames)
+{
+	RenderTargetPool pool (dev, maxIdleFrames);
+	FrameGraph graph (pool);
+	BenchTimer timer;
+	for (int i = 0; i < POOL_STEADY_FRAMES; i++) {
+		poolFrame(graph, pool, 1280, 720);
+	}
+	// dragging the corner, a new size every frame
+	for (int i = 1; i <= POOL_DRAG_FRAMES; i++) {
+		poolFrame(graph, pool, 1280 - i * 24, 720 - i * 12);
+	}
+	const unsigned int dragMisses = pool.getStats().misses;
+	for (int i = 0; i < POOL_STEADY_FRAMES; i++) {
+		poolFrame(graph, pool, 1280 - POOL_DRAG_FRAMES * 24, 720 - POOL_DRAG_FRAMES * 12);
+	}
+	// maximize and restore, two frames each
+	for (int i = 0; i < 4; i++) {
+		poolFrame(graph, pool, (i & 2) ? 1280 - POOL_DRAG_FRAMES * 24 : 1920, (i & 2) ? 720 - POOL_DRAG_FRAMES * 12 : 1080);
+	}
+	for (int i = 0; i < POOL_STEADY_FRAMES; i++) {
+		poolFrame(graph, pool, 1280 - POOL_DRAG_FRAMES * 24, 720 - POOL_DRAG_FRAMES * 12);
+	}
+	const double ms = timer.elapsedMillis();
+	const RenderTargetPoolStats &stats = pool.getStats();
+	const int frames = 3 * POOL_STEADY_FRAMES + POOL_DRAG_FRAMES + 4;
+	printf("  idle frames %2u: %4u hits %3u misses (%u by the end of the drag) %3u evictions, %u targets %.1f MB resident at the end, %.1f MB peak, %.2f ms/frame\n",
+		maxIdleFrames, stats.hits, stats.misses, dragMisses, stats.evictions, stats.targets, stats.bytesResident / (1024.0 * 1024.0),
+		stats.peakBytesResident / (1024.0 * 1024.0), ms / frames);
+}
+
+void benchTargetPool()
+{
+	CpuDevice dev (64, 64);
+	printf("ao targets through a frame graph, %d frames at 1280x720, a %d frame drag, then the new size with a maximize and restore:\n",
+		POOL_STEADY_FRAMES, POOL_DRAG_FRAMES);
+	const unsigned int idleFrames[] = { 0, TARGET_POOL_IDLE_FRAMES, 60 };
+	for (size_t i = 0; i < sizeof(idleFrames) / sizeof(idleFrames[0]); i++) {
+		benchWindow(dev, idleFrames[i]);
+	}
+
+	// a framebuffer toggled between two sizes, what used to recreate every texture on every resize
+	FramebufferParams params;
+	params.width = 1280;
+	params.height = 720;
+	params.numSamples = 1;
+	params.numMrts = 1;
+	params.colorFormats.push_back(FORMAT_R16G16_SNORM);
+	params.depthEnable = true;
+	params.depthFormat = FORMAT_D16_UNORM;
+	const int toggles = 20;
+	RenderTargetPool pool (dev);
+	double ms[2];
+	for (int pooled = 0; pooled < 2; pooled++) {
+		Framebuffer fb (dev, params, pooled ? &pool : 0);
+		BenchTimer timer;
+		for (int i = 0; i < toggles; i++) {
+			fb.resize(dev, (i & 1) ? 1280 : 1920, (i & 1) ? 720 : 1080);
+			pool.endFrame();
+		}
+		ms[pooled] = timer.elapsedMillis();
+	}
+	printf("framebuffer resized %d times between 1280x720 and 1920x1080: %d textures created and %.2f ms without a pool, %u and %.2f ms with one\n",
+		toggles, toggles * 2, ms[0], pool.getStats().misses, ms[1]);
+}
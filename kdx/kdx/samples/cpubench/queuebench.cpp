@@ -0,0 +1,189 @@
+#include "bench.h"
+#include "cpudevice.h"
+#include "renderqueue.h"
+#include "statecache.h"
+#include <algorithm>
+#include <vector>
+
+// RenderQueue's radix sort against std::stable_sort, and the state calls of multi-material scenes submitted in
+// Obj's old order (group names, alphabetical) against sort key order
+// WORKNOTE: the scenes are generated rather than loaded, Obj's parser is msvc only. each group gets a material and
+// each material one of a smaller number of texture sets, which is how the exported obj/mtl pairs tend to look
+
+#define QUEUE_DRAWS 100000
+#define QUEUE_REPS 10
+
+struct QueueItem {
+	uint64_t key;
+	uint32_t payload;
+};
+
+static bool lessKey(const QueueItem &a, const QueueItem &b)
+{
+	return a.key < b.key;
+}
+
+struct QueueScene {
+	const char *name;
+	int groups;
+	int materials;
+	int texturesets;
+};
+
+static const QueueScene Scenes[] = {
+	{ "small", 40, 8, 6 },
+	{ "medium", 400, 25, 20 },
+	{ "large", 4000, 120, 60 },
+};
+
+// binds one draw the way Obj::drawMesh and ObjMesh::draw do
+static void bindDraw(RenderContext &context, RenderBuffer *material, RenderTexture *const *textures, RenderSampler *sampler, RenderBuffer *vertices, RenderBuffer *indices)
+{
+	context.setConstantBuffers(STAGE_PIXEL, 1, 1, &material);
+	context.setShaderResources(STAGE_PIXEL, 0, 1, &textures[0]);
+	context.setShaderResources(STAGE_PIXEL, 1, 1, &textures[1]);
+	context.setShaderResources(STAGE_PIXEL, 2, 1, &textures[2]);
+	context.setSamplers(STAGE_PIXEL, 0, 1, &sampler);
+	context.setVertexBuffer(vertices, 32, 0);
+	context.setIndexBuffer(indices, FORMAT_R32_UINT, 0);
+}
+
+static void benchSceneOrder(CpuDevice &dev, const QueueScene &desc, unsigned int &seed)
+{
+	BufferDesc cbdesc;
+	cbdesc.byteWidth = 64;
+	cbdesc.bindFlags = BIND_CONSTANT_BUFFER;
+	BufferDesc vbdesc;
+	vbdesc.byteWidth = 32;
+	vbdesc.bindFlags = BIND_VERTEX_BUFFER;
+	BufferDesc ibdesc;
+	ibdesc.byteWidth = 4;
+	ibdesc.bindFlags = BIND_INDEX_BUFFER;
+	TextureDesc texdesc;
+	texdesc.width = texdesc.height = 1;
+	texdesc.format = FORMAT_R8G8B8A8_UNORM;
+	texdesc.bindFlags = BIND_SHADER_RESOURCE;
+
+	std::vector<RenderTexture *> textures;
+	for (int i = 0; i < desc.texturesets * 3; i++) {
+		textures.push_back(dev.createTexture(texdesc));
+	}
+	std::vector<RenderBuffer *> materials;
+	std::vector<int> materialsets;
+	for (int i = 0; i < desc.materials; i++) {
+		materials.push_back(dev.createBuffer(cbdesc, 0));
+		materialsets.push_back(i < desc.texturesets ? i : (int) (benchRandom(seed) * desc.texturesets));
+	}
+	// groups in name order, which is the order meshes_ iterates in
+	std::vector<RenderBuffer *> vertices, indices;
+	std::vector<int> groupmaterials;
+	for (int i = 0; i < desc.groups; i++) {
+		vertices.push_back(dev.createBuffer(vbdesc, 0));
+		indices.push_back(dev.createBuffer(ibdesc, 0));
+		groupmaterials.push_back((int) (benchRandom(seed) * desc.materials));
+	}
+	RenderSampler *sampler = dev.createSampler(SamplerDesc());
+	TextureDesc targetdesc;
+	targetdesc.width = targetdesc.height = 64;
+	targetdesc.format = FORMAT_R8G8B8A8_UNORM;
+	targetdesc.bindFlags = BIND_RENDER_TARGET;
+	RenderTexture *target = dev.createTexture(targetdesc);
+	RenderTexture *nouavs[CPU_UAV_SLOTS] = {};
+
+	StateCache &cache = dev.getStateCache();
+	RenderQueue queue;
+	for (int sorted = 0; sorted < 2; sorted++) {
+		queue.clear();
+		for (int i = 0; i < desc.groups; i++) {
+			const int mat = groupmaterials[i];
+			queue.push(RenderQueue::MakeKey(0, 0, mat, materialsets[mat], 0), i);
+		}
+		if (sorted) {
+			queue.sort();
+		}
+		// a frame starts from known outputs, otherwise the cache can't rule out hazards and passes every srv bind on
+		cache.invalidate();
+		cache.setRenderTargets(1, &target, 0);
+		cache.setUnorderedAccessViews(0, CPU_UAV_SLOTS, nouavs);
+		cache.endFrame();
+		int materialswitches = 0, lastmat = -1;
+		for (size_t i = 0; i < queue.size(); i++) {
+			const int group = queue.getPayload(i);
+			const int mat = groupmaterials[group];
+			materialswitches += mat != lastmat;
+			lastmat = mat;
+			bindDraw(cache, materials[mat], &textures[materialsets[mat] * 3], sampler, vertices[group], indices[group]);
+		}
+		cache.endFrame();
+		const StateCacheStats &stats = cache.getFrameStats();
+		printf("%-7s %5d groups %4d materials %3d texture sets, %-8s %5d material switches, %6u state calls issued (%u filtered), %u srv binds\n",
+			desc.name, desc.groups, desc.materials, desc.texturesets, sorted ? "sorted" : "by name", materialswitches, stats.getIssued(),
+			stats.getFiltered(), stats.issued[STATE_SHADER_RESOURCES]);
+	}
+
+	delete target;
+	delete sampler;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		delete vertices[i];
+		delete indices[i];
+	}
+	for (size_t i = 0; i < materials.size(); i++) {
+		delete materials[i];
+	}
+	for (size_t i = 0; i < textures.size(); i++) {
+		delete textures[i];
+	}
+}
+
+void benchRenderQueue()
+{
+	// keys of a busy frame: a few passes and shaders, many materials and texture sets, scattered depth
+	unsigned int seed = 12345;
+	std::vector<QueueItem> items (QUEUE_DRAWS);
+	for (int i = 0; i < QUEUE_DRAWS; i++) {
+		const unsigned int pass = (unsigned int) (benchRandom(seed) * 3);
+		const unsigned int shader = (unsigned int) (benchRandom(seed) * 24);
+		const unsigned int material = (unsigned int) (benchRandom(seed) * 500);
+		const unsigned int textures = (unsigned int) (benchRandom(seed) * 300);
+		const unsigned int depth = RenderQueue::DepthBucket(0.1f + benchRandom(seed) * 200.f, 0.1f, 200.f);
+		items[i].key = RenderQueue::MakeKey(pass, shader, material, textures, depth);
+		items[i].payload = i;
+	}
+
+	RenderQueue queue;
+	const double radixms = timeBest(QUEUE_REPS, [&]() {
+		queue.clear();
+		for (int i = 0; i < QUEUE_DRAWS; i++) {
+			queue.push(items[i].key, items[i].payload);
+		}
+		queue.sort();
+	});
+	const double pushms = timeBest(QUEUE_REPS, [&]() {
+		queue.clear();
+		for (int i = 0; i < QUEUE_DRAWS; i++) {
+			queue.push(items[i].key, items[i].payload);
+		}
+	});
+	std::vector<QueueItem> reference;
+	const double stdms = timeBest(QUEUE_REPS, [&]() {
+		reference = items;
+		std::stable_sort(reference.begin(), reference.end(), lessKey);
+	});
+	// both are stable, so payloads have to match too
+	queue.clear();
+	for (int i = 0; i < QUEUE_DRAWS; i++) {
+		queue.push(items[i].key, items[i].payload);
+	}
+	queue.sort();
+	int mismatches = 0;
+	for (int i = 0; i < QUEUE_DRAWS; i++) {
+		mismatches += queue.getKey(i) != reference[i].key || queue.getPayload(i) != reference[i].payload;
+	}
+	printf("%d draws: radix sort %.2f ms (%.2f ms of it recording), std::stable_sort %.2f ms, %d mismatches\n", QUEUE_DRAWS,
+		radixms, pushms, stdms, mismatches);
+
+	CpuDevice dev (64, 64);
+	for (size_t i = 0; i < sizeof(Scenes) / sizeof(Scenes[0]); i++) {
+		benchSceneOrder(dev, Scenes[i], seed);
+	}
+}
@@ -0,0 +1,31 @@
+#include "bench.h"
+#include "scene.h"
+
+// software prepass (Rasterizer) over the ao sample scene at a few resolutions
+
+#define RASTER_REPS 10
+
+void benchRaster()
+{
+	BenchScene scene;
+	loadBenchScene(scene);
+	const size_t triangles = (scene.ground.inds.size() + scene.model.inds.size()) / 3;
+	printf("%u triangles, best of %d\n", (unsigned int) triangles, RASTER_REPS);
+
+	const int sizes[][2] = { { 1024, 768 }, { 1920, 1080 }, { 3840, 2160 } };
+	printf("resolution\tframe ms\tMtris/s\tdrawn tris\tbin entries\n");
+	for (int i = 0; i < 3; i++) {
+		const int width = sizes[i][0], height = sizes[i][1];
+		Rasterizer rast;
+		rast.resize(width, height);
+		Matrix view, proj;
+		const double ms = timeBest(RASTER_REPS, [&]() {
+			renderBenchPrepass(scene, BENCH_CAMERA_POS, BENCH_CAMERA_ROT, rast, view, proj);
+		});
+		const Rasterizer::Stats &stats = rast.getStats();
+		printf("%dx%d\t%.2f\t\t%.1f\t%u\t\t%u\n", width, height, ms, triangles / (ms * 1000.0), stats.trianglesRasterized, stats.binEntries);
+		if (getenv("CPUBENCH_DUMP") && i == 0) {
+			saveBenchImage("raster_depth.pgm", rast.getDepth());
+		}
+	}
+}
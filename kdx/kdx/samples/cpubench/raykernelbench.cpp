@@ -0,0 +1,335 @@
+#include "bench.h"
+#include "raykernels.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// the 8-wide ray kernels against a double precision reference, then their throughput on one thread
+// the test cases are random boxes and triangles with rays built to land on the awkward spots: axis aligned and
+// parallel rays, origins inside the box or on the triangle plane, hits on edges and corners, tmax right at the hit
+// a disagreement with the reference only counts as an error when the reference isn't within rounding of the
+// decision boundary, the instruction sets also have to agree with the scalar code bit for bit
+
+#define KERNEL_TEST_PACKETS 50000
+#define KERNEL_BOUNDARY_EPSILON 1e-4
+#define KERNEL_BOX_PACKETS 65536
+#define KERNEL_BOX_COUNT 16
+#define KERNEL_TRI_RAYS 16384
+#define KERNEL_TRI_PACKETS 64
+#define KERNEL_REPS 3
+
+static fl3 randomPoint(unsigned int &state, float extent)
+{
+	return fl3((benchRandom(state) * 2.f - 1.f) * extent, (benchRandom(state) * 2.f - 1.f) * extent, (benchRandom(state) * 2.f - 1.f) * extent);
+}
+
+static fl3 randomDirection(unsigned int &state)
+{
+	for (;;) {
+		fl3 d = randomPoint(state, 1.f);
+		const float len = sqrtf(dot(d, d));
+		if (len > 0.1f && len <= 1.f) {
+			return d * (1.f / len);
+		}
+	}
+}
+
+// slab test in doubles, zero direction components handled explicitly instead of through infinities
+// returns the distance to the closest decision boundary in units of the ray length (negative: inside the miss region)
+static double referenceBox(const fl3 &o, const fl3 &d, float tmax, const fl3 &bmin, const fl3 &bmax, double &tnear)
+{
+	const double ro[3] = { o.x, o.y, o.z }, rd[3] = { d.x, d.y, d.z };
+	const double lo[3] = { bmin.x, bmin.y, bmin.z }, hi[3] = { bmax.x, bmax.y, bmax.z };
+	double t0 = 0., t1 = tmax;
+	double outside = 0.; // how far the origin is outside a slab it runs parallel to
+	for (int a = 0; a < 3; a++) {
+		if (rd[a] == 0.) {
+			outside = std::max(outside, std::max(lo[a] - ro[a], ro[a] - hi[a]));
+			continue;
+		}
+		const double ta = (lo[a] - ro[a]) / rd[a], tb = (hi[a] - ro[a]) / rd[a];
+		t0 = std::max(t0, std::min(ta, tb));
+		t1 = std::min(t1, std::max(ta, tb));
+	}
+	tnear = t0;
+	const double margin = (t1 - t0) / (1. + fabs(t0) + fabs(t1));
+	return outside > 0. ? -std::max(outside, fabs(margin)) : margin;
+}
+
+// moller-trumbore in doubles, the margin is the smallest distance of u, v, 1 - u - v, t and tmax - t to their limits,
+// nan when the answer is undefined, tolerance is how far float rounding can move it (grows as the ray turns parallel)
+static double referenceTriangle(const fl3 &o, const fl3 &d, float tmax, const fl3 &a, const fl3 &b, const fl3 &c,
+	double &t, double &u, double &v, double &tolerance)
+{
+	const double e1[3] = { (double) b.x - a.x, (double) b.y - a.y, (double) b.z - a.z };
+	const double e2[3] = { (double) c.x - a.x, (double) c.y - a.y, (double) c.z - a.z };
+	const double rd[3] = { d.x, d.y, d.z };
+	const double s[3] = { (double) o.x - a.x, (double) o.y - a.y, (double) o.z - a.z };
+	const double p[3] = { rd[1] * e2[2] - rd[2] * e2[1], rd[2] * e2[0] - rd[0] * e2[2], rd[0] * e2[1] - rd[1] * e2[0] };
+	const double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+	const double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+	const double scale = sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]) * sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2])
+		* sqrt(rd[0] * rd[0] + rd[1] * rd[1] + rd[2] * rd[2]);
+	t = u = v = 0.;
+	tolerance = 0.;
+	// nearly parallel rays and slivers: float rounding alone decides, never an error either way
+	if (fabs(det) < 1e-4 * scale || scale == 0.) {
+		return NAN;
+	}
+	u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+	v = (rd[0] * q[0] + rd[1] * q[1] + rd[2] * q[2]) / det;
+	t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+	tolerance = KERNEL_BOUNDARY_EPSILON * scale / fabs(det);
+	double margin = std::min(std::min(u, v), 1. - u - v);
+	margin = std::min(margin, t / (1. + fabs(t)));
+	margin = std::min(margin, (tmax - t) / (1. + fabs(t)));
+	return margin;
+}
+
+struct KernelErrors {
+	int tests;
+	int hits;
+	int errors;     // disagreements away from the boundary
+	int boundary;   // disagreements within rounding of it
+	int undefined;  // parallel rays and degenerate triangles, any answer is right
+	int notScalar;  // lanes whose result differs from the scalar kernel at all
+	double maxError; // largest error of t (relative) and u, v on agreeing hits, over the conditioning for triangles
+};
+
+static void checkBoxes(const RayKernels &kernels, const RayKernels &scalar, KernelErrors &errors)
+{
+	memset(&errors, 0, sizeof(errors));
+	unsigned int state = 1234;
+	for (int packet = 0; packet < KERNEL_TEST_PACKETS; packet++) {
+		const fl3 center = randomPoint(state, 2.f);
+		const fl3 half (0.05f + benchRandom(state), 0.05f + benchRandom(state), 0.05f + benchRandom(state));
+		const fl3 bmin = center - half, bmax = center + half;
+		fl3 origins[RAY_PACKET_SIZE], dirs[RAY_PACKET_SIZE];
+		float tmaxs[RAY_PACKET_SIZE];
+		for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+			const int kind = (packet + i) % 6;
+			origins[i] = center + randomPoint(state, 4.f);
+			// aim at a random spot of the box, a corner or an edge, the box is hit or grazed unless tmax cuts it off
+			fl3 target = center + fl3((benchRandom(state) * 2.f - 1.f) * half.x, (benchRandom(state) * 2.f - 1.f) * half.y,
+				(benchRandom(state) * 2.f - 1.f) * half.z);
+			if (kind == 1) {
+				target = fl3(benchRandom(state) < 0.5f ? bmin.x : bmax.x, benchRandom(state) < 0.5f ? bmin.y : bmax.y, target.z);
+			} else if (kind == 2) {
+				target = fl3(benchRandom(state) < 0.5f ? bmin.x : bmax.x, benchRandom(state) < 0.5f ? bmin.y : bmax.y,
+					benchRandom(state) < 0.5f ? bmin.z : bmax.z);
+			}
+			dirs[i] = target - origins[i];
+			if (kind == 3) {
+				// axis aligned, the origin off the slab planes so the reference has a well defined answer
+				const int axis = (packet / 6) % 3;
+				const float sign = benchRandom(state) < 0.5f ? -1.f : 1.f;
+				dirs[i] = fl3(axis == 0 ? sign : 0.f, axis == 1 ? sign : 0.f, axis == 2 ? sign : 0.f);
+			} else if (kind == 4) {
+				origins[i] = center + fl3(half.x * (benchRandom(state) - 0.5f), half.y * (benchRandom(state) - 0.5f), half.z * (benchRandom(state) - 0.5f));
+				dirs[i] = randomDirection(state);
+			} else if (kind == 5) {
+				dirs[i] = randomDirection(state);
+			}
+			tmaxs[i] = benchRandom(state) < 0.25f ? benchRandom(state) * 1.5f : 1e30f;
+		}
+		RayPacket8 rays;
+		rays.load(origins, dirs, tmaxs, RAY_PACKET_SIZE);
+		float tnear[RAY_PACKET_SIZE], scalarNear[RAY_PACKET_SIZE];
+		const int mask = kernels.intersectBox(rays, bmin, bmax, tnear);
+		const int scalarMask = scalar.intersectBox(rays, bmin, bmax, scalarNear);
+		for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+			double refNear;
+			const double margin = referenceBox(origins[i], dirs[i], tmaxs[i], bmin, bmax, refNear);
+			const bool hit = (mask >> i & 1) != 0, refHit = margin >= 0.;
+			errors.tests++;
+			errors.hits += refHit;
+			if (margin != margin) {
+				errors.undefined++;
+			} else if (hit != refHit) {
+				if (fabs(margin) <= KERNEL_BOUNDARY_EPSILON) {
+					errors.boundary++;
+				} else {
+					errors.errors++;
+				}
+			} else if (hit) {
+				errors.maxError = std::max(errors.maxError, fabs(tnear[i] - refNear) / (1. + fabs(refNear)));
+			}
+			if ((mask ^ scalarMask) >> i & 1 || (hit && memcmp(&tnear[i], &scalarNear[i], sizeof(float)) != 0)) {
+				errors.notScalar++;
+			}
+		}
+	}
+}
+
+static void checkTriangles(const RayKernels &kernels, const RayKernels &scalar, KernelErrors &errors)
+{
+	memset(&errors, 0, sizeof(errors));
+	unsigned int state = 5678;
+	for (int packet = 0; packet < KERNEL_TEST_PACKETS; packet++) {
+		fl3 v0[RAY_PACKET_SIZE], v1[RAY_PACKET_SIZE], v2[RAY_PACKET_SIZE];
+		for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+			v0[i] = randomPoint(state, 2.f);
+			v1[i] = v0[i] + randomPoint(state, 1.f);
+			v2[i] = v0[i] + randomPoint(state, 1.f);
+			if ((packet + i) % 16 == 0) {
+				v2[i] = v0[i] + (v1[i] - v0[i]) * benchRandom(state); // degenerate
+			}
+		}
+		TrianglePacket8 tris;
+		tris.load(v0, v1, v2, RAY_PACKET_SIZE);
+
+		// one ray per packet aimed at one of its triangles, the other seven are random hits or misses
+		const int target = packet % RAY_PACKET_SIZE;
+		const int kind = (packet / RAY_PACKET_SIZE) % 5;
+		float a = benchRandom(state), b = benchRandom(state);
+		if (kind == 1) {
+			b = 0.f; // on an edge
+		} else if (kind == 2) {
+			b = 1.f - a; // on the opposite edge
+		} else if (kind == 3) {
+			a = b = 0.f; // on a corner
+		}
+		const fl3 point = v0[target] + (v1[target] - v0[target]) * a + (v2[target] - v0[target]) * b;
+		fl3 origin = point + randomPoint(state, 3.f);
+		fl3 dir = point - origin;
+		if (kind == 4) {
+			// in the triangle's plane, parallel to it
+			origin = v0[target] + (v1[target] - v0[target]) * (benchRandom(state) * 3.f - 1.f);
+			dir = v2[target] - v0[target];
+		}
+		const float tmax = benchRandom(state) < 0.25f ? 0.5f + benchRandom(state) : 1e30f;
+
+		TriangleHits8 hits, scalarHits;
+		const int mask = kernels.intersectTriangles(origin, dir, tmax, tris, hits);
+		const int scalarMask = scalar.intersectTriangles(origin, dir, tmax, tris, scalarHits);
+		for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+			double t, u, v, tolerance;
+			const double margin = referenceTriangle(origin, dir, tmax, v0[i], v1[i], v2[i], t, u, v, tolerance);
+			const bool hit = (mask >> i & 1) != 0, refHit = margin >= 0.;
+			errors.tests++;
+			errors.hits += refHit;
+			if (margin != margin) {
+				errors.undefined++;
+			} else if (hit != refHit) {
+				if (fabs(margin) <= tolerance) {
+					errors.boundary++;
+				} else {
+					errors.errors++;
+				}
+			} else if (hit) {
+				// relative to the conditioning, so badly conditioned hits don't hide the rest
+				const double error = std::max(fabs(hits.t[i] - t) / (1. + fabs(t)), std::max(fabs(hits.u[i] - u), fabs(hits.v[i] - v)));
+				errors.maxError = std::max(errors.maxError, error * KERNEL_BOUNDARY_EPSILON / tolerance);
+			}
+			if ((mask ^ scalarMask) >> i & 1 || (hit && (hits.t[i] != scalarHits.t[i] || hits.u[i] != scalarHits.u[i]
+				|| hits.v[i] != scalarHits.v[i]))) {
+				errors.notScalar++;
+			}
+		}
+	}
+}
+
+void benchRayKernels()
+{
+	const RayKernels *all[] = { GetRayKernels(RAY_KERNEL_SCALAR), GetRayKernels(RAY_KERNEL_SSE), GetRayKernels(RAY_KERNEL_AVX2) };
+	const RayKernels &scalar = *all[RAY_KERNEL_SCALAR];
+	printf("default kernels: %s\n", GetRayKernels().name);
+
+	printf("\nkernel\ttest\tcases\thits\terrors\tboundary\tundefined\tnot scalar\tmax error\n");
+	for (int k = 0; k < 3; k++) {
+		if (!all[k]) {
+			printf("avx2\t(not compiled in or not supported)\n");
+			continue;
+		}
+		KernelErrors box, tri;
+		checkBoxes(*all[k], scalar, box);
+		checkTriangles(*all[k], scalar, tri);
+		printf("%s\tbox\t%d\t%d\t%d\t%d\t%d\t%d\t%.2e\n", all[k]->name, box.tests, box.hits, box.errors, box.boundary, box.undefined,
+			box.notScalar, box.maxError);
+		printf("%s\ttriangle\t%d\t%d\t%d\t%d\t%d\t%d\t%.2e\n", all[k]->name, tri.tests, tri.hits, tri.errors, tri.boundary, tri.undefined,
+			tri.notScalar, tri.maxError);
+	}
+
+	// throughput on one thread, the soa rows use prepacked data, the fl3 rows pack from fl3 arrays on every call
+	unsigned int state = 42;
+	std::vector<fl3> origins (KERNEL_BOX_PACKETS * RAY_PACKET_SIZE), dirs (origins.size());
+	std::vector<float> tmaxs (origins.size(), 1e30f);
+	for (size_t i = 0; i < origins.size(); i++) {
+		origins[i] = randomPoint(state, 4.f);
+		dirs[i] = randomDirection(state);
+	}
+	std::vector<RayPacket8> packets (KERNEL_BOX_PACKETS);
+	for (int i = 0; i < KERNEL_BOX_PACKETS; i++) {
+		packets[i].load(&origins[i * RAY_PACKET_SIZE], &dirs[i * RAY_PACKET_SIZE], &tmaxs[i * RAY_PACKET_SIZE], RAY_PACKET_SIZE);
+	}
+	fl3 boxMin[KERNEL_BOX_COUNT], boxMax[KERNEL_BOX_COUNT];
+	for (int b = 0; b < KERNEL_BOX_COUNT; b++) {
+		const fl3 c = randomPoint(state, 2.f);
+		boxMin[b] = c - fl3(0.5f, 0.5f, 0.5f);
+		boxMax[b] = c + fl3(0.5f, 0.5f, 0.5f);
+	}
+
+	std::vector<fl3> v0 (KERNEL_TRI_PACKETS * RAY_PACKET_SIZE), v1 (v0.size()), v2 (v0.size());
+	for (size_t i = 0; i < v0.size(); i++) {
+		v0[i] = randomPoint(state, 2.f);
+		v1[i] = v0[i] + randomPoint(state, 0.5f);
+		v2[i] = v0[i] + randomPoint(state, 0.5f);
+	}
+	std::vector<TrianglePacket8> triPackets (KERNEL_TRI_PACKETS);
+	for (int i = 0; i < KERNEL_TRI_PACKETS; i++) {
+		triPackets[i].load(&v0[i * RAY_PACKET_SIZE], &v1[i * RAY_PACKET_SIZE], &v2[i * RAY_PACKET_SIZE], RAY_PACKET_SIZE);
+	}
+
+	printf("\nkernel\tlayout\tray/box Mrays/s\tray/triangle Mtests/s\tbox hits\ttriangle hits\n");
+	for (int k = 0; k < 3; k++) {
+		if (!all[k]) {
+			continue;
+		}
+		const RayKernels &kernels = *all[k];
+		for (int layout = 0; layout < 2; layout++) {
+			long long boxHits = 0, triHits = 0;
+			float tnear[RAY_PACKET_SIZE];
+			const double boxms = timeBest(KERNEL_REPS, [&]() {
+				boxHits = 0;
+				RayPacket8 rays;
+				for (int i = 0; i < KERNEL_BOX_PACKETS; i++) {
+					const RayPacket8 *p = &packets[i];
+					if (layout == 1) {
+						rays.load(&origins[i * RAY_PACKET_SIZE], &dirs[i * RAY_PACKET_SIZE], &tmaxs[i * RAY_PACKET_SIZE], RAY_PACKET_SIZE);
+						p = &rays;
+					}
+					for (int b = 0; b < KERNEL_BOX_COUNT; b++) {
+						const int mask = kernels.intersectBox(*p, boxMin[b], boxMax[b], tnear);
+						for (int bits = mask; bits; bits &= bits - 1) {
+							boxHits++;
+						}
+					}
+				}
+			});
+			const double boxRays = (double) KERNEL_BOX_PACKETS * RAY_PACKET_SIZE * KERNEL_BOX_COUNT;
+
+			TriangleHits8 hits;
+			const double trims = timeBest(KERNEL_REPS, [&]() {
+				triHits = 0;
+				TrianglePacket8 tris;
+				for (int r = 0; r < KERNEL_TRI_RAYS; r++) {
+					for (int i = 0; i < KERNEL_TRI_PACKETS; i++) {
+						const TrianglePacket8 *p = &triPackets[i];
+						if (layout == 1) {
+							tris.load(&v0[i * RAY_PACKET_SIZE], &v1[i * RAY_PACKET_SIZE], &v2[i * RAY_PACKET_SIZE], RAY_PACKET_SIZE);
+							p = &tris;
+						}
+						const int mask = kernels.intersectTriangles(origins[r], dirs[r], 1e30f, *p, hits);
+						for (int bits = mask; bits; bits &= bits - 1) {
+							triHits++;
+						}
+					}
+				}
+			});
+			const double triTests = (double) KERNEL_TRI_RAYS * KERNEL_TRI_PACKETS * RAY_PACKET_SIZE;
+			printf("%s\t%s\t%.1f\t%.1f\t%lld\t%lld\n", kernels.name, layout == 0 ? "soa" : "fl3", boxRays / boxms / 1000.,
+				triTests / trims / 1000., boxHits, triHits);
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "constantring.h"
+#include "cpudevice.h"
+#include <string.h>
+#include <deque>
+#include <vector>
+
+// ConstantRing on the cpu device, with its fences completing a few frames late like a gpu that's behind
+// the checks replay random frames and keep the bytes of every range that's still in flight, all of which have to be
+// intact in the buffer at the end of each frame, aligned and inside the buffer
+// the throughput compares per object constants through the ring against a dynamic buffer per object
+
+#define RING_SIZE (64 * 1024)
+#define RING_FRAMES 2000
+#define RING_LATENCY 2
+#define RING_OBJECTS 10000
+#define RING_REPS 5
+
+struct RingCheck {
+	uint64_t fence;
+	ConstantRange range;
+	std::vector<uint8_t> bytes;
+};
+
+static void checkRing(unsigned int latency)
+{
+	CpuDevice dev (16, 16);
+	dev.setFenceLatency(latency);
+	RenderContext &context = dev.getContext();
+	ConstantRing ring (dev, RING_SIZE);
+	unsigned int seed = 777;
+	std::deque<RingCheck> live;
+	unsigned int misaligned = 0, outside = 0, overwritten = 0, checked = 0;
+	// the fence the ring signals for the current frame, it only signals frames that allocated something
+	uint64_t fence = 1;
+	for (int frame = 0; frame < RING_FRAMES; frame++) {
+		// frames of a few to a few hundred objects, mostly a matrix or two each, now and then a big one
+		const int count = 2 + (int) (benchRandom(seed) * benchRandom(seed) * 120);
+		bool allocated = false;
+		for (int i = 0; i < count; i++) {
+			const float r = benchRandom(seed);
+			const unsigned int size = r < 0.9f ? (r < 0.5f ? 64 : 192) : 16 * (1 + (unsigned int) (benchRandom(seed) * 255));
+			RingCheck check;
+			check.fence = fence;
+			check.bytes.resize(size);
+			for (unsigned int b = 0; b < size; b++) {
+				check.bytes[b] = (uint8_t) (benchRandom(seed) * 256);
+			}
+			check.range = ring.allocate(context, &check.bytes[0], size);
+			if (!check.range.buffer) {
+				continue;
+			}
+			allocated = true;
+			misaligned += check.range.offset % CONSTANT_RANGE_ALIGNMENT != 0 || check.range.size % CONSTANT_RANGE_ALIGNMENT != 0;
+			outside += check.range.offset + check.range.size > ring.getSize();
+			live.push_back(check);
+		}
+		// everything the gpu may still read has to be what was written
+		const uint64_t completed = dev.getCompletedFence();
+		while (!live.empty() && live.front().fence <= completed) {
+			live.pop_front();
+		}
+		for (size_t i = 0; i < live.size(); i++) {
+			const CpuBuffer &buffer = *static_cast<const CpuBuffer *>(live[i].range.buffer);
+			overwritten += memcmp(buffer.data() + live[i].range.offset, &live[i].bytes[0], live[i].bytes.size()) != 0;
+			checked++;
+		}
+		ring.endFrame();
+		fence += allocated;
+	}
+	const ConstantRingStats &stats = ring.getStats();
+	printf("  fence latency %u: %u allocations (%.1f MB, %.1f%% padding), %u wraps, %u waits, %u failed, %u in flight checked: %u misaligned, %u outside, %u overwritten\n",
+		latency, stats.allocations, stats.bytes / (1024.0 * 1024.0), 100.0 * stats.padding / (stats.bytes + stats.padding), stats.wraps,
+		stats.waits, stats.failures, checked, misaligned, outside, overwritten);
+}
+
+void benchConstantRing()
+{
+	printf("%d random frames through a %d KB ring:\n", RING_FRAMES, RING_SIZE / 1024);
+	checkRing(0);
+	checkRing(RING_LATENCY);
+	checkRing(8);
+
+	// a frame of objects with a 192 byte cbuffer each (model, view, proj)
+	CpuDevice dev (16, 16);
+	RenderContext &context = dev.getContext();
+	float constants[48];
+	for (int i = 0; i < 48; i++) {
+		constants[i] = (float) i;
+	}
+	BufferDesc desc;
+	desc.byteWidth = sizeof(constants);
+	desc.usage = USAGE_DYNAMIC;
+	desc.bindFlags = BIND_CONSTANT_BUFFER;
+	std::vector<RenderBuffer *> buffers (RING_OBJECTS);
+	for (int i = 0; i < RING_OBJECTS; i++) {
+		buffers[i] = dev.createBuffer(desc, 0);
+	}
+	const double perObjectms = timeBest(RING_REPS, [&]() {
+		for (int i = 0; i < RING_OBJECTS; i++) {
+			constants[0] = (float) i;
+			context.updateBuffer(buffers[i], constants, sizeof(constants));
+			context.setConstantBuffers(STAGE_VERTEX, 0, 1, &buffers[i]);
+		}
+	});
+	// big enough for three frames of it
+	ConstantRing ring (dev, RING_OBJECTS * 256 * 3);
+	const double ringms = timeBest(RING_REPS, [&]() {
+		for (int i = 0; i < RING_OBJECTS; i++) {
+			constants[0] = (float) i;
+			ConstantRing::use(context, STAGE_VERTEX, 0, ring.allocate(context, constants, sizeof(constants)));
+		}
+		ring.endFrame();
+	});
+	printf("%d objects with %d byte constants: a dynamic buffer each %.2f ms (%.1f M/s), ring %.2f ms (%.1f M/s), %u ring waits\n",
+		RING_OBJECTS, (int) sizeof(constants), perObjectms, RING_OBJECTS / perObjectms / 1000.0, ringms, RING_OBJECTS / ringms / 1000.0,
+		ring.getStats().waits);
+	for (int i = 0; i < RING_OBJECTS; i++) {
+		delete buffers[i];
+	}
+}
@@ -0,0 +1,179 @@
+#include "scene.h"
+#include "constants.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_ASSET "../assets/ServerBot1.obj"
+// procedural stand-in, 16x16 spheres of 32x16 quads each is about 260k triangles
+#define BENCH_SPHERE_GRID 16
+#define BENCH_SPHERE_SLICES 32
+#define BENCH_SPHERE_STACKS 16
+
+// parses one face corner, "v", "v/t", "v//n" or "v/t/n"
+static void parseCorner(const char *token, int &v, int &n)
+{
+	int t = 0;
+	v = 0;
+	n = 0;
+	if (sscanf(token, "%d/%d/%d", &v, &t, &n) == 3) {
+		return;
+	}
+	if (sscanf(token, "%d//%d", &v, &n) == 2) {
+		return;
+	}
+	sscanf(token, "%d", &v);
+}
+
+bool loadObjTriangles(const char *filename, BenchMesh &mesh)
+{
+	FILE *file = fopen(filename, "r");
+	if (!file) {
+		return false;
+	}
+	std::vector<fl3> positions, normals;
+	char line[1024];
+	while (fgets(line, sizeof(line), file)) {
+		fl3 val;
+		if (strncmp(line, "v ", 2) == 0 && sscanf(line + 2, "%f %f %f", &val.x, &val.y, &val.z) == 3) {
+			// same RH -> LH flip as Obj::loadFile
+			val.z = -val.z;
+			positions.push_back(val);
+		} else if (strncmp(line, "vn ", 3) == 0 && sscanf(line + 3, "%f %f %f", &val.x, &val.y, &val.z) == 3) {
+			val.z = -val.z;
+			normals.push_back(val);
+		} else if (strncmp(line, "f ", 2) == 0) {
+			char a[64], b[64], c[64];
+			if (sscanf(line + 2, "%63s %63s %63s", a, b, c) != 3) {
+				continue;
+			}
+			const char *corners[3] = { a, b, c };
+			// reversed like Obj, so the triangles are clockwise in the LH space
+			for (int i = 2; i >= 0; i--) {
+				int v, n;
+				parseCorner(corners[i], v, n);
+				PTNvert vert;
+				vert.pos = positions[v - 1];
+				if (n > 0) {
+					vert.norm = normals[n - 1];
+				}
+				mesh.inds.push_back((uint32_t) mesh.verts.size());
+				mesh.verts.push_back(vert);
+			}
+		}
+	}
+	fclose(file);
+	return !mesh.inds.empty();
+}
+
+static void addSphere(BenchMesh &mesh, const fl3 &center, float radius)
+{
+	const uint32_t base = (uint32_t) mesh.verts.size();
+	for (int j = 0; j <= BENCH_SPHERE_STACKS; j++) {
+		const float theta = M_PI * j / BENCH_SPHERE_STACKS;
+		for (int i = 0; i <= BENCH_SPHERE_SLICES; i++) {
+			const float phi = 2.f * M_PI * i / BENCH_SPHERE_SLICES;
+			PTNvert v;
+			v.norm = fl3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			v.pos = center + v.norm * radius;
+			v.tex = fl3((float) i / BENCH_SPHERE_SLICES, (float) j / BENCH_SPHERE_STACKS, 0);
+			mesh.verts.push_back(v);
+		}
+	}
+	const uint32_t row = BENCH_SPHERE_SLICES + 1;
+	for (int j = 0; j < BENCH_SPHERE_STACKS; j++) {
+		for (int i = 0; i < BENCH_SPHERE_SLICES; i++) {
+			const uint32_t a = base + j * row + i;
+			// clockwise seen from outside in the LH space
+			mesh.inds.push_back(a); mesh.inds.push_back(a + 1); mesh.inds.push_back(a + row);
+			mesh.inds.push_back(a + 1); mesh.inds.push_back(a + row + 1); mesh.inds.push_back(a + row);
+		}
+	}
+}
+
+void loadBenchScene(BenchScene &scene)
+{
+	// ground plane, same vertices and indices as gquad in the ao sample
+	PTNvert gv;
+	gv.norm = fl3(0, 1, 0);
+	gv.pos = fl3(-50, 0, -50); gv.tex = fl3(0, 1, 0); scene.ground.verts.push_back(gv);
+	gv.pos = fl3(-50, 0, 50); gv.tex = fl3(0, 0, 0); scene.ground.verts.push_back(gv);
+	gv.pos = fl3(50, 0, -50); gv.tex = fl3(1, 1, 0); scene.ground.verts.push_back(gv);
+	gv.pos = fl3(50, 0, 50); gv.tex = fl3(1, 0, 0); scene.ground.verts.push_back(gv);
+	const uint32_t ginds[] = { 0, 1, 3, 0, 3, 2 };
+	scene.ground.inds.assign(ginds, ginds + 6);
+
+	scene.loadedAsset = loadObjTriangles(BENCH_ASSET, scene.model);
+	if (!scene.loadedAsset) {
+		printf("(%s not found, using %dx%d procedural spheres instead)\n", BENCH_ASSET, BENCH_SPHERE_GRID, BENCH_SPHERE_GRID);
+		for (int z = 0; z < BENCH_SPHERE_GRID; z++) {
+			for (int x = 0; x < BENCH_SPHERE_GRID; x++) {
+				addSphere(scene.model, fl3(-15.f + 2.f * x, 1.f, -5.f + 2.f * z), 0.9f);
+			}
+		}
+	}
+}
+
+void benchCameraPath(int frame, int frameCount, fl3 &pos, fl2 &rot)
+{
+	// piecewise linear through a few keys, the parameter runs from 0 to 1 over the path
+	struct Key { float t; fl3 pos; fl2 rot; };
+	static const Key Keys[] = {
+		{ 0.f, fl3(0, 10, -10), fl2(-30, 0) },
+		{ 0.5f, fl3(2, 9.5f, -8.5f), fl2(-29, -6) },
+		{ 1.f, fl3(3, 9, -7), fl2(-27, -10) }
+	};
+	const float t = frameCount > 1 ? (float) frame / (frameCount - 1) : 0.f;
+	int k = 0;
+	while (k < 1 && t > Keys[k + 1].t) {
+		k++;
+	}
+	const float a = (t - Keys[k].t) / (Keys[k + 1].t - Keys[k].t);
+	pos = Keys[k].pos + (Keys[k + 1].pos - Keys[k].pos) * a;
+	rot = Keys[k].rot + (Keys[k + 1].rot - Keys[k].rot) * a;
+}
+
+void benchViewMatrix(const fl3 &pos, const fl2 &rot, Matrix &view)
+{
+	// translation, then yaw, then pitch (row-vector order), see FirstPersonCamera::toMatrixView
+	view.loadIdentity();
+	view.rotate(rot.x, 1, 0, 0);
+	view.rotate(rot.y, 0, 1, 0);
+	view.translate(-pos);
+}
+
+void benchProjMatrix(float fovy, float aspect, Matrix &proj)
+{
+	// same near/far as the ao sample
+	proj.perspectiveFovLH(fovy, aspect, 1.f, 500.f);
+}
+
+void renderBenchPrepass(const BenchScene &scene, const fl3 &pos, const fl2 &rot, Rasterizer &rast, Matrix &view, Matrix &proj)
+{
+	Matrix model;
+	benchViewMatrix(pos, rot, view);
+	benchProjMatrix(DEGTORAD(45), (float) rast.getWidth() / rast.getHeight(), proj);
+	rast.beginFrame();
+	rast.setTransform(model, view, proj);
+	rast.draw(&scene.model.verts[0], scene.model.verts.size(), &scene.model.inds[0], scene.model.inds.size());
+	rast.draw(&scene.ground.verts[0], scene.ground.verts.size(), &scene.ground.inds[0], scene.ground.inds.size());
+	rast.endFrame();
+}
+
+bool saveBenchImage(const char *filename, const FloatImage &image)
+{
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "P5\n%d %d\n255\n", image.getWidth(), image.getHeight());
+	std::vector<unsigned char> row(image.getWidth());
+	for (int y = 0; y < image.getHeight(); y++) {
+		for (int x = 0; x < image.getWidth(); x++) {
+			const float v = image.at(x, y);
+			row[x] = (unsigned char) (255.f * (v < 0.f ? 0.f : (v > 1.f ? 1.f : v)) + 0.5f);
+		}
+		fwrite(&row[0], 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
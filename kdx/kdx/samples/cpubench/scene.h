@@ -0,0 +1,59 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "image.hpp"
+#include "matrix.h"
+#include "mesh.hpp"
+#include "rasterizer.h"
+#include <stdint.h>
+#include <vector>
+
+// geometry and camera for the cpu benchmarks, mirroring what samples/ao/main.cpp draws
+
+// starting position of the ao sample camera, pitched down towards the models
+#define BENCH_CAMERA_POS fl3(0, 10, -10)
+#define BENCH_CAMERA_ROT fl2(-30, 0)
+
+struct BenchMesh {
+	std::vector<PTNvert> verts;
+	std::vector<uint32_t> inds;
+};
+
+struct BenchScene {
+	BenchMesh ground; // the 100x100 ground quad from the ao sample
+	BenchMesh model; // ServerBot when the asset is there, a procedural stand-in otherwise
+	bool loadedAsset;
+};
+
+// minimal obj reader for positions and normals, with the same handedness flip and winding as Obj
+bool loadObjTriangles(const char *filename, BenchMesh &mesh);
+// loads the ao sample scene, falling back to a grid of spheres of comparable size
+void loadBenchScene(BenchScene &scene);
+
+// scripted camera path for the temporal benches, so every run replays the same frames
+// a slow strafe and turn away from the starting camera, like someone looking around the ao sample
+void benchCameraPath(int frame, int frameCount, fl3 &pos, fl2 &rot);
+
+// first person camera matrices built the same way as FirstPersonCamera::toMatrixView and Camera::toMatrixProj
+void benchViewMatrix(const fl3 &pos, const fl2 &rot, Matrix &view);
+void benchProjMatrix(float fovy, float aspect, Matrix &proj);
+// prepass of the whole scene into rast (already sized) from a camera at pos/rot, view and proj receive the matrices used
+void renderBenchPrepass(const BenchScene &scene, const fl3 &pos, const fl2 &rot, Rasterizer &rast, Matrix &view, Matrix &proj);
+
+// a BenchMesh as a device mesh, for the benches that run the ao sample on the cpu device
+template<typename IND_TYPE>
+void buildBenchMesh(const BenchMesh &source, RenderDevice &dev, InterleavedMesh<PTNvert, IND_TYPE> &mesh)
+{
+	for (size_t i = 0; i < source.verts.size(); i++) {
+		mesh.addVert(source.verts[i]);
+	}
+	for (size_t i = 0; i < source.inds.size(); i++) {
+		mesh.addInd((IND_TYPE) source.inds[i]);
+	}
+	mesh.finalize(dev);
+}
+
+// writes a single channel image as a binary pgm, values are clamped to [0, 1]
+bool saveBenchImage(const char *filename, const FloatImage &image);
+
+#endif // SCENE_H
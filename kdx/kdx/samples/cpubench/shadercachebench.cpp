@@ -0,0 +1,363 @@
+#include "bench.h"
+#include "shadercache.h"
+#include <string.h>
+
+// the ShaderCache on a stub compiler, over the ao sample's shaders: a first start compiles them all, the next one none,
+// and a changed include, define or flag, a damaged cache file or a failed compile only cost what they touch
+// the stub doesn't know hlsl, it expands includes and hashes the source, so the times are the cache's own overhead
+// (preprocessing, hashing, file reads) and not the d3d compiles it saves
+// WORKNOTE: the shaders are read from SHADER_SOURCES when the bench runs from samples/cpubench, stand-ins with the same
+// includes are written otherwise. everything goes into SCRATCH_DIRECTORY and is removed at the end
+
+#define SHADER_SOURCES "../ao/"
+#define SCRATCH_DIRECTORY "shadercachebench"
+#define SHADER_CACHE_REPS 5
+
+// expands #include "name" lines (relative to the file), prepends the defines as #defines and "compiles" to a hash of
+// the result followed by the result itself, a source with COMPILE_ERROR in it fails
+class StubShaderCompiler : public ShaderCompiler {
+public:
+	StubShaderCompiler() : compiles(0) {}
+
+	std::string getVersion() const { return "stub 1"; }
+	bool preprocess(const ShaderCompileRequest &request, std::string &source, std::vector<std::string> &includes, std::string &errors);
+	bool compile(const ShaderCompileRequest &request, const std::string &source, std::vector<uint8_t> &bytecode, std::string &errors);
+
+	unsigned int compiles;
+
+private:
+	bool expand(const std::string &directory, const std::string &filename, std::string &source, std::vector<std::string> &includes,
+		std::string &errors, int depth);
+};
+
+static bool readFile(const std::string &filename, std::string &contents)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	contents.clear();
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		contents.append(buffer, read);
+	}
+	fclose(file);
+	return true;
+}
+
+static bool writeFile(const std::string &filename, const std::string &contents)
+{
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	const bool ok = fwrite(contents.c_str(), 1, contents.size(), file) == contents.size();
+	return fclose(file) == 0 && ok;
+}
+
+bool StubShaderCompiler::expand(const std::string &directory, const std::string &filename, std::string &source,
+	std::vector<std::string> &includes, std::string &errors, int depth)
+{
+	std::string contents;
+	if (depth > 16 || !readFile(directory + filename, contents)) {
+		errors += "can't open " + filename + "\n";
+		return false;
+	}
+	size_t begin = 0;
+	while (begin < contents.size()) {
+		size_t end = contents.find('\n', begin);
+		end = end == std::string::npos ? contents.size() : end + 1;
+		const std::string line = contents.substr(begin, end - begin);
+		const size_t open = line.find('"');
+		const size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+		if (line.compare(0, 8, "#include") == 0 && close != std::string::npos) {
+			// relative to this file, what's nested in it relative to where it is
+			const std::string path = directory + line.substr(open + 1, close - open - 1);
+			const size_t slash = path.find_last_of("/\\");
+			const size_t split = slash == std::string::npos ? 0 : slash + 1;
+			includes.push_back(path);
+			if (!expand(path.substr(0, split), path.substr(split), source, includes, errors, depth + 1)) {
+				return false;
+			}
+		} else {
+			source += line;
+		}
+		begin = end;
+	}
+	return true;
+}
+
+bool StubShaderCompiler::preprocess(const ShaderCompileRequest &request, std::string &source, std::vector<std::string> &includes,
+	std::string &errors)
+{
+	// the names are ascii
+	std::string filename;
+	for (size_t i = 0; i < request.filename.size(); i++) {
+		filename += (char) request.filename[i];
+	}
+	const size_t slash = filename.find_last_of("/\\");
+	const std::string directory = slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+	source.clear();
+	for (size_t i = 0; i < request.defines.size(); i++) {
+		source += "#define " + request.defines[i].name + " " + request.defines[i].value + "\n";
+	}
+	return expand(directory, filename.substr(directory.size()), source, includes, errors, 0);
+}
+
+bool StubShaderCompiler::compile(const ShaderCompileRequest &request, const std::string &source, std::vector<uint8_t> &bytecode,
+	std::string &errors)
+{
+	compiles++;
+	if (source.find("COMPILE_ERROR") != std::string::npos) {
+		errors = "error X3000: COMPILE_ERROR\n";
+		return false;
+	}
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const std::string input = source + request.entryPoint + request.profile;
+	for (size_t i = 0; i < input.size(); i++) {
+		hash = (hash ^ (unsigned char) input[i]) * 0x100000001b3ull;
+	}
+	hash ^= request.flags;
+	bytecode.resize(sizeof(hash) + source.size());
+	memcpy(&bytecode[0], &hash, sizeof(hash));
+	memcpy(&bytecode[sizeof(hash)], source.c_str(), source.size());
+	return true;
+}
+
+// the shaders of AoSample
+struct BenchShader {
+	const char *file;
+	const char *entryPoint;
+	const char *profile;
+};
+
+static const BenchShader SampleShaders[] = {
+	{ "prepass.hlsl", "VertexMain", "vs_5_0" },
+	{ "prepass.hlsl", "PixelMain", "ps_5_0" },
+	{ "prepassinstanced.hlsl", "VertexMain", "vs_5_0" },
+	{ "hbao.hlsl", "VertexMain", "vs_5_0" },
+	{ "hbao.hlsl", "PixelMain", "ps_5_0" },
+	{ "blit.hlsl", "VertexMain", "vs_5_0" },
+	{ "blit.hlsl", "PixelMain", "ps_5_0" },
+	{ "computeblur.hlsl", "ComputeMain", "cs_5_0" }
+};
+#define SAMPLE_SHADER_COUNT (sizeof(SampleShaders) / sizeof(SampleShaders[0]))
+
+static const char *SourceFiles[] = { "prepass.hlsl", "prepassinstanced.hlsl", "hbao.hlsl", "blit.hlsl", "computeblur.hlsl", "normalencoding.hlsli" };
+#define SOURCE_FILE_COUNT (sizeof(SourceFiles) / sizeof(SourceFiles[0]))
+
+static ShaderCompileRequest makeRequest(const std::string &directory, const BenchShader &shader)
+{
+	ShaderCompileRequest request;
+	const std::string filename = directory + shader.file;
+	request.filename.assign(filename.begin(), filename.end());
+	request.entryPoint = shader.entryPoint;
+	request.profile = shader.profile;
+	return request;
+}
+
+// one start of the sample: a cache over the directory and every shader through it
+struct LaunchResult {
+	unsigned int compiles;
+	unsigned int failures;
+	ShaderCacheStats stats;
+	double ms;
+	std::vector<std::vector<uint8_t> > bytecode;
+};
+
+static LaunchResult launch(const char *cacheDirectory, const std::vector<ShaderCompileRequest> &requests)
+{
+	LaunchResult result;
+	StubShaderCompiler compiler;
+	ShaderCache cache (compiler, cacheDirectory);
+	result.failures = 0;
+	result.bytecode.resize(requests.size());
+	BenchTimer timer;
+	for (size_t i = 0; i < requests.size(); i++) {
+		std::string errors;
+		result.failures += !cache.get(requests[i], result.bytecode[i], errors);
+	}
+	result.ms = timer.elapsedMillis();
+	result.compiles = compiler.compiles;
+	result.stats = cache.getStats();
+	return result;
+}
+
+static void printLaunch(const char *name, const LaunchResult &result)
+{
+	printf("  %-38s %2u hits, %2u misses, %2u compiles, %u failed, %u stored, %u rejected, %.3f ms\n", name, result.stats.hits,
+		result.stats.misses, result.compiles, result.failures, result.stats.stored, result.stats.rejected, result.ms);
+}
+
+void benchShaderCache()
+{
+	const std::string scratch = std::string(SCRATCH_DIRECTORY) + "/";
+	const std::string sources = scratch + "src/";
+	const std::string cacheDirectory = scratch + "cache";
+	ShaderCache::MakeDirectory(SCRATCH_DIRECTORY);
+	ShaderCache::MakeDirectory(sources.c_str());
+
+	// the sample's files, or stand-ins that include the same file
+	bool real = true;
+	for (size_t i = 0; i < SOURCE_FILE_COUNT; i++) {
+		std::string contents;
+		if (!readFile(std::string(SHADER_SOURCES) + SourceFiles[i], contents)) {
+			real = false;
+			contents = std::string("// stand-in for ") + SourceFiles[i] + "\n";
+			if (i < 3) {
+				contents += "#include \"normalencoding.hlsli\"\n";
+			}
+			contents += "float4 VertexMain() : SV_POSITION { return 0; }\nfloat4 PixelMain() : SV_TARGET { return 1; }\n";
+		}
+		writeFile(sources + SourceFiles[i], contents);
+	}
+
+	std::vector<ShaderCompileRequest> requests;
+	for (size_t i = 0; i < SAMPLE_SHADER_COUNT; i++) {
+		requests.push_back(makeRequest(sources, SampleShaders[i]));
+	}
+	// what including normalencoding.hlsli costs when it changes
+	unsigned int includers = 0;
+	{
+		StubShaderCompiler compiler;
+		for (size_t i = 0; i < requests.size(); i++) {
+			std::string source, errors;
+			std::vector<std::string> includes;
+			compiler.preprocess(requests[i], source, includes, errors);
+			for (size_t n = 0; n < includes.size(); n++) {
+				includers += includes[n] == sources + "normalencoding.hlsli";
+			}
+		}
+	}
+
+	// every file a run can leave behind, for the cleanup
+	std::vector<std::string> files;
+	for (size_t i = 0; i < SOURCE_FILE_COUNT; i++) {
+		files.push_back(sources + SourceFiles[i]);
+	}
+
+	// a nested include is opened next to the file that includes it, not the shader, where a file of the same name is
+	bool nestedResolved = false;
+	{
+		const std::string library = sources + "lib/";
+		ShaderCache::MakeDirectory(library.c_str());
+		writeFile(sources + "nested.hlsl", "#include \"lib/outer.hlsli\"\n");
+		writeFile(library + "outer.hlsli", "#include \"inner.hlsli\"\n");
+		writeFile(library + "inner.hlsli", "float innerVersion() { return 1; }\n");
+		writeFile(sources + "inner.hlsli", "float innerVersion() { return 0; }\n");
+		ShaderCompileRequest nested;
+		nested.filename.assign(sources.begin(), sources.end());
+		nested.filename += L"nested.hlsl";
+		StubShaderCompiler compiler;
+		std::string source, errors;
+		std::vector<std::string> includes;
+		nestedResolved = compiler.preprocess(nested, source, includes, errors) && includes.size() == 2
+			&& includes[0] == library + "outer.hlsli" && includes[1] == library + "inner.hlsli"
+			&& source.find("return 1;") != std::string::npos;
+		remove((sources + "nested.hlsl").c_str());
+		remove((library + "outer.hlsli").c_str());
+		remove((library + "inner.hlsli").c_str());
+		remove((sources + "inner.hlsli").c_str());
+		remove(library.c_str());
+	}
+	StubShaderCompiler keys;
+	ShaderCache keyCache (keys, cacheDirectory.c_str());
+	std::vector<ShaderCompileRequest> variants;
+	ShaderCompileRequest defined = requests[3];
+	ShaderDefine define;
+	define.name = "HBAO_DIRECTIONS";
+	define.value = "8";
+	defined.defines.push_back(define);
+	variants.push_back(defined);
+	ShaderCompileRequest flagged = requests[3];
+	flagged.flags = 1 << 15; // D3D10_SHADER_OPTIMIZATION_LEVEL3
+	variants.push_back(flagged);
+	ShaderCompileRequest broken;
+	broken.filename.assign(sources.begin(), sources.end());
+	broken.filename += L"broken.hlsl";
+	broken.entryPoint = "PixelMain";
+	broken.profile = "ps_5_0";
+	files.push_back(sources + "broken.hlsl");
+	writeFile(sources + "broken.hlsl", "float4 PixelMain() : SV_TARGET { COMPILE_ERROR }\n");
+	const std::string encoding = sources + "normalencoding.hlsli";
+	std::string original;
+	readFile(encoding, original);
+	for (int edited = 0; edited < 2; edited++) {
+		writeFile(encoding, edited ? original + "// edited\nfloat encodingVersion() { return 2; }\n" : original);
+		std::vector<ShaderCompileRequest> all = requests;
+		all.insert(all.end(), variants.begin(), variants.end());
+		for (size_t i = 0; i < all.size(); i++) {
+			std::string source, errors;
+			std::vector<std::string> includes;
+			keys.preprocess(all[i], source, includes, errors);
+			uint64_t key, check;
+			ShaderCache::Hash(keys.getVersion(), all[i], source, includes, key, check);
+			files.push_back(keyCache.getPath(key));
+		}
+	}
+	writeFile(encoding, original);
+	// a cache left over from an earlier run would make the first start hit
+	for (size_t i = SOURCE_FILE_COUNT + 1; i < files.size(); i++) {
+		remove(files[i].c_str());
+	}
+
+	printf("%u shaders of the ao sample (%s, %u of them include normalencoding.hlsli) through a ShaderCache on a stub compiler:\n",
+		(unsigned int) SAMPLE_SHADER_COUNT, real ? "the sample's files" : "stand-ins", includers);
+	printf("    nested include opened next to the file that includes it: %s\n", nestedResolved ? "yes" : "NO");
+	const LaunchResult cold = launch(cacheDirectory.c_str(), requests);
+	printLaunch("first start", cold);
+	LaunchResult warm;
+	double warmMs = 1e30;
+	for (int rep = 0; rep < SHADER_CACHE_REPS; rep++) {
+		warm = launch(cacheDirectory.c_str(), requests);
+		warmMs = warm.ms < warmMs ? warm.ms : warmMs;
+	}
+	warm.ms = warmMs;
+	printLaunch("next start", warm);
+	unsigned int differ = 0;
+	for (size_t i = 0; i < requests.size(); i++) {
+		differ += warm.bytecode[i] != cold.bytecode[i];
+	}
+	printf("    %u of %u loaded shaders differ from the compiled ones\n", differ, (unsigned int) requests.size());
+
+	// a define and a flag are keys of their own, the second time they're hits too
+	printLaunch("with a define and a flag", launch(cacheDirectory.c_str(), variants));
+	printLaunch("with a define and a flag, again", launch(cacheDirectory.c_str(), variants));
+
+	// the include changes: only what includes it compiles, and the old entries are still there when it changes back
+	writeFile(encoding, original + "// edited\nfloat encodingVersion() { return 2; }\n");
+	const LaunchResult edited = launch(cacheDirectory.c_str(), requests);
+	printLaunch("normalencoding.hlsli edited", edited);
+	writeFile(encoding, original);
+	printLaunch("normalencoding.hlsli back", launch(cacheDirectory.c_str(), requests));
+
+	// a file cut short by a crash is rejected and compiled again
+	{
+		std::string source, errors;
+		std::vector<std::string> includes;
+		keys.preprocess(requests[0], source, includes, errors);
+		uint64_t key, check;
+		ShaderCache::Hash(keys.getVersion(), requests[0], source, includes, key, check);
+		std::string entry;
+		readFile(keyCache.getPath(key), entry);
+		writeFile(keyCache.getPath(key), entry.substr(0, entry.size() / 2));
+	}
+	const LaunchResult damaged = launch(cacheDirectory.c_str(), requests);
+	printLaunch("one file truncated", damaged);
+
+	// failures aren't stored, the next start shows the errors again
+	std::vector<ShaderCompileRequest> failing (1, broken);
+	printLaunch("a shader that doesn't compile", launch(cacheDirectory.c_str(), failing));
+	printLaunch("a shader that doesn't compile, again", launch(cacheDirectory.c_str(), failing));
+	printf("    %s\n", nestedResolved && cold.compiles == requests.size() && warm.compiles == 0 && differ == 0 && edited.compiles == includers
+		&& damaged.compiles == 1 && damaged.stats.rejected == 1 ? "as expected" : "NOT AS EXPECTED");
+
+	for (size_t i = 0; i < files.size(); i++) {
+		remove(files[i].c_str());
+	}
+	// empty by now, remove takes directories on posix (the directories stay on windows)
+	remove(cacheDirectory.c_str());
+	remove(sources.c_str());
+	remove(SCRATCH_DIRECTORY);
+}
@@ -0,0 +1,631 @@
+#include "ambientocclusion.h"
+#include "constants.h"
+#include "deinterleave.hpp"
+#include "lineardepth.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// rows handed to a worker at a time
+#define AO_ROW_GRAIN 8
+#define AO_MAX_TAPS 16
+// jittered modes rotate the taps per pixel of a 4x4 block, the deinterleaved mode evaluates each of them as a layer
+#define AO_INTERLEAVE_FACTOR 4
+#define AO_NUM_PATTERNS (AO_INTERLEAVE_FACTOR * AO_INTERLEAVE_FACTOR)
+// upsample weights: depth differences are relative to the pixel's view depth, normal agreement is raised to this power
+#define AO_UPSAMPLE_DEPTH_EPSILON 0.001f
+#define AO_UPSAMPLE_NORMAL_POWER 8
+
+// same kernel as ssao.hlsl
+static const float SsaoTaps[AO_MAX_TAPS][3] = {
+	{ -0.364452f, -0.014985f, -0.513535f },
+	{ 0.004669f, -0.445692f, -0.165899f },
+	{ 0.607166f, -0.571184f, 0.377880f },
+	{ -0.607685f, -0.352123f, -0.663045f },
+	{ -0.235328f, -0.142338f, 0.925718f },
+	{ -0.023743f, -0.297281f, -0.392438f },
+	{ 0.918790f, 0.056215f, 0.092624f },
+	{ 0.608966f, -0.385235f, -0.108280f },
+	{ -0.802881f, 0.225105f, 0.361339f },
+	{ -0.070376f, 0.303049f, -0.905118f },
+	{ -0.503922f, -0.475265f, 0.177892f },
+	{ 0.035096f, -0.367809f, -0.475295f },
+	{ -0.316874f, -0.374981f, -0.345988f },
+	{ -0.567278f, -0.297800f, -0.271889f },
+	{ -0.123325f, 0.197851f, 0.626759f },
+	{ 0.852626f, -0.061007f, -0.144475f }
+};
+
+AoParams::AoParams() : resolution(AO_RESOLUTION_FULL), tapSize(0.02f), numTaps(16),
+	samplingRadius(0.5f), numDirections(8), samplingStep(0.004f), numSteps(4), tangentBias(0.2f), rotation(0.f),
+	sampling(AO_SAMPLING_UNIFORM), useDepthPyramid(false), pyramidChain(DepthPyramid::CHAIN_MIN), specialized(true),
+	normalTaps(NORMAL_TAPS_5)
+{
+
+}
+
+// 4x4 ordered dither, gives neighboring pixels of the jittered modes well spread rotations
+static const int Bayer4x4[4][4] = {
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 }
+};
+
+// one tap offset, set up once per pattern by AoSampler::makeTap
+struct AoTap {
+	float du, dv; // texture space
+	int level; // depth pyramid level
+	int dx, dy; // in pixels of a deinterleaved layer
+};
+
+// depth lookups and view space reconstruction shared by the kernels
+// the kernels loop over the pixels of the sampler's depth image, which is either the whole frame
+// or one layer of a deinterleaved frame (pixel (x, y) of the layer is (x * stride + originX, y * stride + originY))
+class AoSampler {
+public:
+	AoSampler(const AoInput &input, const AoParams &params, int originX = 0, int originY = 0, int stride = 1, int frameWidth = 0, int frameHeight = 0) :
+		depth_(input.viewZ ? input.viewZ : input.depth), halfDepth_(input.halfViewZ), linear_(input.viewZ != 0 || input.halfViewZ != 0),
+		pyramid_(0), chain_(params.pyramidChain),
+		jittered_(params.sampling != AO_SAMPLING_UNIFORM), originX_(originX), originY_(originY), stride_(stride)
+	{
+		memcpy(invProj_, input.invProj.data(), sizeof(invProj_));
+		LinearDepth::GetRayCoefficients(input.invProj, rays_);
+		width_ = halfDepth_ ? halfDepth_->getWidth() : depth_->getWidth();
+		height_ = halfDepth_ ? halfDepth_->getHeight() : depth_->getHeight();
+		frameWidth_ = stride > 1 ? frameWidth : width_;
+		frameHeight_ = stride > 1 ? frameHeight : height_;
+		if (stride == 1 && params.useDepthPyramid && input.pyramid && input.pyramid->getNumLevels() > 1) {
+			pyramid_ = input.pyramid;
+		}
+		uScale_ = (float) stride / frameWidth_;
+		uBias_ = (originX + 0.5f) / frameWidth_;
+		vScale_ = (float) stride / frameHeight_;
+		vBias_ = (originY + 0.5f) / frameHeight_;
+	}
+
+	// pixels to evaluate
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+
+	// texture coordinates of the center of pixel (x, y) in the frame
+	float getU(int x) const { return x * uScale_ + uBias_; }
+	float getV(int y) const { return y * vScale_ + vBias_; }
+
+	// which of the 16 rotated tap patterns pixel (x, y) uses, always 0 when the taps are uniform
+	int getPattern(int x, int y) const
+	{
+		return jittered_ ? Bayer4x4[(y * stride_ + originY_) & 3][(x * stride_ + originX_) & 3] : 0;
+	}
+
+	// precomputed tap offset (texture space, du to the right and dv up like the shaders' offsets)
+	AoTap makeTap(float du, float dv) const
+	{
+		AoTap tap;
+		tap.du = du;
+		tap.dv = -dv;
+		tap.level = 0;
+		const float px = du * frameWidth_, py = dv * frameHeight_;
+		if (pyramid_) {
+			tap.level = pyramid_->levelForOffset(sqrtf(px * px + py * py));
+		}
+		// a pixel center plus the offset always lands the same number of whole pixels away,
+		// which on a layer rounds to the same number of layer pixels for every pixel of the layer
+		tap.dx = floorDiv((int) floorf(0.5f + px) + stride_ / 2, stride_);
+		tap.dy = floorDiv((int) floorf(0.5f - py) + stride_ / 2, stride_);
+		return tap;
+	}
+
+	// view space position of a tap of pixel (x, y) at texture coordinates (u, v), point sampled
+	// on a layer the tap snaps to the nearest pixel of that layer and is reconstructed at that pixel's center
+	fl3 tap(int x, int y, float u, float v, const AoTap &tap) const
+	{
+		if (stride_ > 1) {
+			x = clampIndex(x + tap.dx, width_);
+			y = clampIndex(y + tap.dy, height_);
+			return position(getU(x), getV(y), depthAt(x, y));
+		}
+		u += tap.du;
+		v += tap.dv;
+		x = (int) floorf(u * frameWidth_);
+		y = (int) floorf(v * frameHeight_);
+		const float z = pyramid_ ? pyramid_->fetch(chain_, tap.level, x, y) : (halfDepth_ ? halfDepth_->clampedAt(x, y) : depth_->clampedAt(x, y));
+		return position(u, v, z);
+	}
+
+	// view space position of pixel (x, y)
+	fl3 center(int x, int y) const
+	{
+		return position(getU(x), getV(y), depthAt(x, y));
+	}
+
+private:
+	static int floorDiv(int a, int b) { return a >= 0 ? a / b : -((b - 1 - a) / b); }
+	static int clampIndex(int i, int size) { return i < 0 ? 0 : (i >= size ? size - 1 : i); }
+
+	// a half is widened per tap, that's a few integer ops against the float image's load
+	float depthAt(int x, int y) const { return halfDepth_ ? halfDepth_->at(x, y) : depth_->at(x, y); }
+
+	// view space position at texture coordinates (u, v)
+	// z is view z with a linear input, then it's just the ray through (u, v) scaled by it
+	// otherwise it's depth and this is the shaders' ndc + invCamPj reconstruction (d3d depth is ndc z as it is)
+	fl3 position(float u, float v, float z) const
+	{
+		if (linear_) {
+			return fl3((rays_[0] * u + rays_[1]) * z, (rays_[2] * v + rays_[3]) * z, z);
+		}
+		const float *m = invProj_;
+		const float nx = 2.f * u - 1.f;
+		const float ny = 1.f - 2.f * v;
+		const float invw = 1.f / (m[3] * nx + m[7] * ny + m[11] * z + m[15]);
+		return fl3((m[0] * nx + m[4] * ny + m[8] * z + m[12]) * invw,
+			(m[1] * nx + m[5] * ny + m[9] * z + m[13]) * invw,
+			(m[2] * nx + m[6] * ny + m[10] * z + m[14]) * invw);
+	}
+
+	const FloatImage *depth_;
+	const Image16 *halfDepth_;
+	bool linear_;
+	const DepthPyramid *pyramid_;
+	DepthPyramid::CHAIN chain_;
+	bool jittered_;
+	float invProj_[16];
+	float rays_[4];
+	int width_, height_;
+	int originX_, originY_, stride_;
+	int frameWidth_, frameHeight_;
+	float uScale_, uBias_, vScale_, vBias_;
+};
+
+// where a pass writes its rows: straight into a FloatImage, or through a float row into an Image16
+class AoTarget {
+public:
+	explicit AoTarget(FloatImage &out) : float_(&out), half_(0) {}
+	explicit AoTarget(Image16 &out) : float_(0), half_(&out) {}
+
+	void resize(int width, int height)
+	{
+		if (float_ && (float_->getWidth() != width || float_->getHeight() != height)) {
+			float_->resize(width, height);
+		}
+		if (half_ && (half_->getWidth() != width || half_->getHeight() != height)) {
+			half_->resize(width, height, half_->getWidth() ? half_->getFormat() : IMAGE16_UNORM);
+		}
+	}
+
+	// scratch holds a row of the target
+	float* beginRow(int y, float *scratch) { return float_ ? ::beginRow(*float_, y, 0, scratch) : ::beginRow(*half_, y, 0, scratch); }
+
+	void endRow(int y, const float *row)
+	{
+		if (half_) {
+			::endRow(*half_, y, 0, half_->getWidth(), row);
+		}
+	}
+
+private:
+	FloatImage *float_;
+	Image16 *half_;
+};
+
+static inline float length3(const fl3 &v)
+{
+	return sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+}
+
+// the kernels are templates on their loop counts, 0 takes the count from params at runtime
+// with a count fixed the compiler unrolls the tap loops and folds the divides by it
+
+template<int NUM_TAPS>
+static void ssaoPass(const AoSampler &sampler, const AoInput &input, const AoParams &params, AoTarget &out)
+{
+	const int width = sampler.getWidth();
+	const int height = sampler.getHeight();
+	const int numTaps = NUM_TAPS ? NUM_TAPS : std::min(params.numTaps, AO_MAX_TAPS);
+	const int numPatterns = params.sampling == AO_SAMPLING_UNIFORM ? 1 : AO_NUM_PATTERNS;
+
+	// tap offsets per pattern, the same for every pixel using it
+	std::vector<AoTap> taps (numPatterns * numTaps);
+	for (int k = 0; k < numPatterns; k++) {
+		const float rotation = params.rotation + 2.f * M_PI * k / AO_NUM_PATTERNS;
+		const float cosRotation = cosf(rotation), sinRotation = sinf(rotation);
+		for (int i = 0; i < numTaps; i++) {
+			taps[k * numTaps + i] = sampler.makeTap(params.tapSize * (cosRotation * SsaoTaps[i][0] - sinRotation * SsaoTaps[i][1]),
+				params.tapSize * (sinRotation * SsaoTaps[i][0] + cosRotation * SsaoTaps[i][1]));
+		}
+	}
+
+	parallelFor(0, height, AO_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<float> scratch (width);
+		for (int y = y0; y < y1; y++) {
+			const float v = sampler.getV(y);
+			float *outRow = out.beginRow(y, &scratch[0]);
+			for (int x = 0; x < width; x++) {
+				const float u = sampler.getU(x);
+				const int first = sampler.getPattern(x, y) * numTaps;
+				const fl3 viewPos = sampler.center(x, y);
+				const fl3 &viewNorm = input.normals->at(x, y);
+
+				float total = 0.f;
+				for (int i = first; i < first + numTaps; i++) {
+					fl3 diff = sampler.tap(x, y, u, v, taps[i]) - viewPos;
+					const float len = length3(diff);
+					diff = len > 0.f ? diff / len : fl3(0, 0, 0);
+					const float occlusion = std::max(0.f, dot(viewNorm, diff));
+					total += 1.f - occlusion;
+				}
+				outRow[x] = total / numTaps;
+			}
+			out.endRow(y, outRow);
+		}
+	});
+}
+
+template<int NUM_DIRECTIONS, int NUM_STEPS>
+static void hbaoPass(const AoSampler &sampler, const AoInput &input, const AoParams &params, AoTarget &out)
+{
+	const int width = sampler.getWidth();
+	const int height = sampler.getHeight();
+	const int numDirections = NUM_DIRECTIONS ? NUM_DIRECTIONS : params.numDirections;
+	const int numSteps = NUM_STEPS ? NUM_STEPS : params.numSteps;
+	const int numPatterns = params.sampling == AO_SAMPLING_UNIFORM ? 1 : AO_NUM_PATTERNS;
+
+	// directions and step levels per pattern, the patterns divide one direction sector between them
+	std::vector<fl2> directions (numPatterns * numDirections);
+	std::vector<AoTap> taps (numPatterns * numDirections * numSteps);
+	const float increment = 2.f * M_PI / numDirections;
+	for (int k = 0; k < numPatterns; k++) {
+		const float rotation = params.rotation + increment * k / AO_NUM_PATTERNS;
+		for (int i = 0; i < numDirections; i++) {
+			const int d = k * numDirections + i;
+			directions[d] = fl2(cosf(i * increment + rotation), sinf(i * increment + rotation));
+			for (int j = 0; j < numSteps; j++) {
+				const float step = (j + 1) * params.samplingStep;
+				taps[d * numSteps + j] = sampler.makeTap(step * directions[d].x, step * directions[d].y);
+			}
+		}
+	}
+
+	parallelFor(0, height, AO_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<float> scratch (width);
+		for (int y = y0; y < y1; y++) {
+			const float v = sampler.getV(y);
+			float *outRow = out.beginRow(y, &scratch[0]);
+			for (int x = 0; x < width; x++) {
+				const float u = sampler.getU(x);
+				const int first = sampler.getPattern(x, y) * numDirections;
+				const fl3 viewPos = sampler.center(x, y);
+				const fl3 &viewNorm = input.normals->at(x, y);
+
+				float total = 0.f;
+				for (int d = first; d < first + numDirections; d++) {
+					const fl2 &dir = directions[d];
+					// the horizon starts at the tangent plane
+					const float cosTangent = std::max(-1.f, std::min(1.f, dir.x * viewNorm.x + dir.y * viewNorm.y));
+					const float tangentAngle = acosf(cosTangent) - 0.5f * M_PI + params.tangentBias;
+					float horizonAngle = tangentAngle;
+					fl3 lastDiff (0, 0, 0);
+					for (int j = 0; j < numSteps; j++) {
+						const fl3 diff = sampler.tap(x, y, u, v, taps[d * numSteps + j]) - viewPos;
+						const float len = length3(diff);
+						if (len < params.samplingRadius) {
+							lastDiff = diff;
+							// closer is smaller z in LH view space, so negative diff.z is a higher elevation
+							const float elevationAngle = atanf(-diff.z / sqrtf(diff.x * diff.x + diff.y * diff.y));
+							horizonAngle = std::max(horizonAngle, elevationAngle);
+						}
+					}
+					const float attenuation = 1.f / (1.f + length3(lastDiff));
+					const float occlusion = std::max(0.f, std::min(1.f, attenuation * (sinf(horizonAngle) - sinf(tangentAngle))));
+					total += 1.f - occlusion;
+				}
+				outRow[x] = total / numDirections;
+			}
+			out.endRow(y, outRow);
+		}
+	});
+}
+
+typedef void (*AoPassFunc)(const AoSampler &sampler, const AoInput &input, const AoParams &params, AoTarget &out);
+
+// the preset registry, every entry instantiates the kernels for its counts
+struct AoPresetKernels {
+	AoPreset preset;
+	AoPassFunc ssao;
+	AoPassFunc hbao;
+};
+
+#define AO_PRESET(name, taps, directions, steps, blurRadius) \
+	{ { name, taps, directions, steps, blurRadius }, ssaoPass<taps>, hbaoPass<directions, steps> }
+
+static const AoPresetKernels Presets[] = {
+	AO_PRESET("low", 8, 4, 4, 1),
+	AO_PRESET("medium", 12, 6, 4, 2),
+	AO_PRESET("high", 16, 8, 4, 2),
+	AO_PRESET("ultra", 16, 12, 6, 3)
+};
+
+#define AO_NUM_PRESETS ((int) (sizeof(Presets) / sizeof(Presets[0])))
+
+void AoPreset::apply(AoParams &params) const
+{
+	params.numTaps = numTaps;
+	params.numDirections = numDirections;
+	params.numSteps = numSteps;
+}
+
+AmbientOcclusion::AmbientOcclusion()
+{
+
+}
+
+AmbientOcclusion::~AmbientOcclusion()
+{
+
+}
+
+void AmbientOcclusion::ssao(const AoInput &input, const AoParams &params, FloatImage &out)
+{
+	evaluate(KERNEL_SSAO, input, params, out);
+}
+
+void AmbientOcclusion::hbao(const AoInput &input, const AoParams &params, FloatImage &out)
+{
+	evaluate(KERNEL_HBAO, input, params, out);
+}
+
+void AmbientOcclusion::ssao(const AoInput &input, const AoParams &params, Image16 &out)
+{
+	evaluate(KERNEL_SSAO, input, params, out);
+}
+
+void AmbientOcclusion::hbao(const AoInput &input, const AoParams &params, Image16 &out)
+{
+	evaluate(KERNEL_HBAO, input, params, out);
+}
+
+void AmbientOcclusion::widen(const AoInput &input, AoInput &widened)
+{
+	widened = input;
+	if (input.halfViewZ) {
+		input.halfViewZ->load(widenedViewZ_);
+		widened.viewZ = &widenedViewZ_;
+		widened.halfViewZ = 0;
+	}
+}
+
+void AmbientOcclusion::evaluate(KERNEL kernel, const AoInput &input, const AoParams &params, Image16 &out)
+{
+	// only the plain full resolution passes write 16 bit rows themselves
+	if (input.normals && params.resolution == AO_RESOLUTION_FULL && params.sampling != AO_SAMPLING_DEINTERLEAVED) {
+		const AoSampler sampler (input, params);
+		AoTarget target (out);
+		runPass(kernel, sampler, input, params, target);
+		return;
+	}
+	evaluate(kernel, input, params, widenedAo_);
+	if (!out.getWidth()) {
+		out.resize(widenedAo_.getWidth(), widenedAo_.getHeight(), IMAGE16_UNORM);
+	}
+	out.store(widenedAo_);
+}
+
+void AmbientOcclusion::evaluate(KERNEL kernel, const AoInput &input, const AoParams &params, FloatImage &out)
+{
+	if (input.halfViewZ && (!input.normals || params.resolution != AO_RESOLUTION_FULL || params.sampling == AO_SAMPLING_DEINTERLEAVED)) {
+		AoInput widened;
+		widen(input, widened);
+		evaluate(kernel, widened, params, out);
+		return;
+	}
+	if (!input.normals) {
+		reconstruction_.build(*input.depth, input.invProj, params.normalTaps, input.viewZ);
+		AoInput withNormals = input;
+		withNormals.normals = &reconstruction_.getNormals();
+		evaluate(kernel, withNormals, params, out);
+		return;
+	}
+	if (params.resolution == AO_RESOLUTION_FULL) {
+		evaluateFrame(kernel, input, params, out);
+	} else {
+		downsample(input, params.resolution, reducedInput_);
+		evaluateFrame(kernel, reducedInput_, params, reducedAo_);
+		upsample(reducedAo_, reducedInput_, input, out);
+	}
+}
+
+void AmbientOcclusion::evaluateFrame(KERNEL kernel, const AoInput &input, const AoParams &params, FloatImage &out)
+{
+	if (params.sampling != AO_SAMPLING_DEINTERLEAVED) {
+		const AoSampler sampler (input, params);
+		AoTarget target (out);
+		runPass(kernel, sampler, input, params, target);
+		return;
+	}
+	const int width = input.depth->getWidth();
+	const int height = input.depth->getHeight();
+
+	// every layer gets one of the 16 rotations, so all of its pixels share their taps
+	deinterleave(*input.normals, AO_INTERLEAVE_FACTOR, layerNormals_);
+	// with a linear input the layers hold view z, the sampler never needs both
+	deinterleave(input.viewZ ? *input.viewZ : *input.depth, AO_INTERLEAVE_FACTOR, layerDepth_);
+	layerAo_.resize(layerDepth_.size());
+	for (int j = 0; j < AO_INTERLEAVE_FACTOR; j++) {
+		for (int i = 0; i < AO_INTERLEAVE_FACTOR; i++) {
+			const int layer = i + j * AO_INTERLEAVE_FACTOR;
+			AoInput layerInput;
+			layerInput.normals = &layerNormals_[layer];
+			layerInput.depth = &layerDepth_[layer];
+			layerInput.viewZ = input.viewZ ? &layerDepth_[layer] : 0;
+			layerInput.invProj = input.invProj;
+			const AoSampler sampler (layerInput, params, i, j, AO_INTERLEAVE_FACTOR, width, height);
+			AoTarget target (layerAo_[layer]);
+			runPass(kernel, sampler, layerInput, params, target);
+		}
+	}
+	if (out.getWidth() != width || out.getHeight() != height) {
+		out.resize(width, height);
+	}
+	reinterleave(layerAo_, AO_INTERLEAVE_FACTOR, out);
+}
+
+void AmbientOcclusion::runPass(KERNEL kernel, const AoSampler &sampler, const AoInput &input, const AoParams &params, AoTarget &out)
+{
+	out.resize(sampler.getWidth(), sampler.getHeight());
+	// the first preset with matching counts has a specialized kernel, anything else runs the generic one
+	AoPassFunc pass = kernel == KERNEL_SSAO ? ssaoPass<0> : hbaoPass<0, 0>;
+	for (int i = 0; params.specialized && i < AO_NUM_PRESETS; i++) {
+		const AoPreset &preset = Presets[i].preset;
+		if (kernel == KERNEL_SSAO && preset.numTaps == std::min(params.numTaps, AO_MAX_TAPS)) {
+			pass = Presets[i].ssao;
+			break;
+		}
+		if (kernel == KERNEL_HBAO && preset.numDirections == params.numDirections && preset.numSteps == params.numSteps) {
+			pass = Presets[i].hbao;
+			break;
+		}
+	}
+	pass(sampler, input, params, out);
+}
+
+/*static*/ int AmbientOcclusion::GetNumPresets()
+{
+	return AO_NUM_PRESETS;
+}
+
+/*static*/ const AoPreset& AmbientOcclusion::GetPreset(int index)
+{
+	return Presets[index].preset;
+}
+
+/*static*/ const AoPreset* AmbientOcclusion::FindPreset(const char *name)
+{
+	for (int i = 0; i < AO_NUM_PRESETS; i++) {
+		if (strcmp(Presets[i].preset.name, name) == 0) {
+			return &Presets[i].preset;
+		}
+	}
+	return 0;
+}
+
+void AmbientOcclusion::downsample(const AoInput &input, AO_RESOLUTION resolution, AoInput &reduced)
+{
+	const int scale = (int) resolution;
+	const int srcWidth = input.depth->getWidth();
+	const int srcHeight = input.depth->getHeight();
+	const int width = (srcWidth + scale - 1) / scale;
+	const int height = (srcHeight + scale - 1) / scale;
+	if (reducedDepth_.getWidth() != width || reducedDepth_.getHeight() != height) {
+		reducedDepth_.resize(width, height);
+		reducedNormals_.resize(width, height);
+	}
+	if (input.viewZ && (reducedViewZ_.getWidth() != width || reducedViewZ_.getHeight() != height)) {
+		reducedViewZ_.resize(width, height);
+	}
+
+	parallelFor(0, height, AO_ROW_GRAIN, [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			const int sy0 = y * scale;
+			const int sy1 = std::min(sy0 + scale, srcHeight);
+			for (int x = 0; x < width; x++) {
+				const int sx0 = x * scale;
+				const int sx1 = std::min(sx0 + scale, srcWidth);
+				const bool closest = ((x + y) & 1) == 0;
+				int bestX = sx0, bestY = sy0;
+				float best = input.depth->at(sx0, sy0);
+				for (int sy = sy0; sy < sy1; sy++) {
+					const float *row = input.depth->row(sy);
+					for (int sx = sx0; sx < sx1; sx++) {
+						if (closest ? row[sx] < best : row[sx] > best) {
+							best = row[sx];
+							bestX = sx;
+							bestY = sy;
+						}
+					}
+				}
+				reducedDepth_.at(x, y) = best;
+				reducedNormals_.at(x, y) = input.normals->at(bestX, bestY);
+				if (input.viewZ) {
+					reducedViewZ_.at(x, y) = input.viewZ->at(bestX, bestY);
+				}
+			}
+		}
+	});
+
+	reduced.normals = &reducedNormals_;
+	reduced.depth = &reducedDepth_;
+	reduced.viewZ = input.viewZ ? &reducedViewZ_ : 0;
+	reduced.halfViewZ = 0;
+	reduced.pyramid = 0;
+	reduced.invProj = input.invProj;
+}
+
+void AmbientOcclusion::upsample(const FloatImage &ao, const AoInput &reduced, const AoInput &full, FloatImage &out)
+{
+	const int width = full.depth->getWidth();
+	const int height = full.depth->getHeight();
+	const int lowWidth = ao.getWidth();
+	const int lowHeight = ao.getHeight();
+	const float scaleX = (float) lowWidth / width;
+	const float scaleY = (float) lowHeight / height;
+	if (out.getWidth() != width || out.getHeight() != height) {
+		out.resize(width, height);
+	}
+	float invProj[16];
+	memcpy(invProj, full.invProj.data(), sizeof(invProj));
+
+	parallelFor(0, height, AO_ROW_GRAIN, [&](int y0, int y1) {
+		// view depth of the low resolution rows in use, converted once per row pair
+		std::vector<float> lowZ (2 * lowWidth);
+		int cachedRow = 0;
+		for (int y = y0; y < y1; y++) {
+			// texel centers of the two grids line up at (i + 0.5) / size
+			const float ly = (y + 0.5f) * scaleY - 0.5f;
+			const int ty = (int) floorf(ly);
+			const float fy = ly - ty;
+			const int ry[2] = { std::max(ty, 0), std::min(ty + 1, lowHeight - 1) };
+			if (y == y0 || ty != cachedRow) {
+				for (int r = 0; r < 2; r++) {
+					for (int x = 0; x < lowWidth; x++) {
+						lowZ[r * lowWidth + x] = reduced.viewZ ? reduced.viewZ->at(x, ry[r]) : viewDepth(invProj, reduced.depth->at(x, ry[r]));
+					}
+				}
+				cachedRow = ty;
+			}
+			for (int x = 0; x < width; x++) {
+				const float lx = (x + 0.5f) * scaleX - 0.5f;
+				const int tx = (int) floorf(lx);
+				const float fx = lx - tx;
+				const int rx[2] = { std::max(tx, 0), std::min(tx + 1, lowWidth - 1) };
+				const float z = full.viewZ ? full.viewZ->at(x, y) : viewDepth(invProj, full.depth->at(x, y));
+				const fl3 &n = full.normals->at(x, y);
+
+				float total = 0.f, weight = 0.f;
+				float nearestDiff = 1e30f, nearest = 1.f;
+				for (int j = 0; j < 2; j++) {
+					for (int i = 0; i < 2; i++) {
+						const float bilinear = (i ? fx : 1.f - fx) * (j ? fy : 1.f - fy);
+						const float dz = fabsf(lowZ[j * lowWidth + rx[i]] - z) / z;
+						const fl3 &ln = reduced.normals->at(rx[i], ry[j]);
+						const float agree = std::max(0.f, n.x * ln.x + n.y * ln.y + n.z * ln.z);
+						float normalWeight = 1.f;
+						for (int k = 0; k < AO_UPSAMPLE_NORMAL_POWER; k++) {
+							normalWeight *= agree;
+						}
+						const float w = bilinear * normalWeight / (AO_UPSAMPLE_DEPTH_EPSILON + dz);
+						const float sample = ao.at(rx[i], ry[j]);
+						total += w * sample;
+						weight += w;
+						if (dz < nearestDiff) {
+							nearestDiff = dz;
+							nearest = sample;
+						}
+					}
+				}
+				// nothing agrees (background or a thin feature missed by the downsample), take the closest depth
+				out.at(x, y) = weight > 1e-6f ? total / weight : nearest;
+			}
+		}
+	});
+}
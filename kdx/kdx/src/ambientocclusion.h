@@ -0,0 +1,169 @@
+#ifndef AMBIENTOCCLUSION_H
+#define AMBIENTOCCLUSION_H
+
+#include "depthpyramid.h"
+#include "image16.h"
+#include "matrix.h"
+#include "normalreconstruction.h"
+#include <vector>
+
+// resolution the kernels run at, as a divisor of the input size
+enum AO_RESOLUTION {
+	AO_RESOLUTION_FULL = 1,
+	AO_RESOLUTION_HALF = 2,
+	AO_RESOLUTION_QUARTER = 4
+};
+
+// how the tap pattern varies over the screen
+enum AO_SAMPLING {
+	AO_SAMPLING_UNIFORM = 0, // every pixel uses the same taps, like the shaders
+	AO_SAMPLING_JITTERED = 1, // the pattern is rotated per pixel of each 4x4 block, evaluated in place
+	AO_SAMPLING_DEINTERLEAVED = 2 // same rotations, evaluated on 16 quarter resolution layers with one rotation each
+};
+
+// tunables of the ao kernels, the defaults are the defines in ssao.hlsl and hbao.hlsl
+struct AoParams {
+	AoParams();
+
+	// below full resolution the kernels run on a depth-aware downsampled copy of the input
+	// and the result is upsampled with a joint bilateral filter, the depth pyramid is not used then
+	AO_RESOLUTION resolution;
+
+	// ssao.hlsl
+	float tapSize; // TAP_SIZE, texture space
+	int numTaps; // NUM_TAPS, up to 16
+
+	// hbao.hlsl
+	float samplingRadius; // SAMPLING_RADIUS, view space
+	int numDirections; // NUM_SAMPLING_DIRECTIONS
+	float samplingStep; // SAMPLING_STEP, texture space
+	int numSteps; // NUM_SAMPLING_STEPS
+	float tangentBias; // TANGENT_BIAS
+
+	// radians, rotates the whole tap pattern (ssao taps, hbao directions) in screen space
+	// TemporalAo changes it every frame so the history sees more distinct taps
+	float rotation;
+
+	// jittered modes need a blur afterwards, the deinterleaved one snaps taps to the pixels of their layer
+	// (taps are reconstructed where they land, so this only moves them by up to 2 pixels)
+	AO_SAMPLING sampling;
+
+	// read far taps from the depth pyramid in AoInput, when there is one
+	bool useDepthPyramid;
+	DepthPyramid::CHAIN pyramidChain;
+
+	// counts that match a preset run a kernel compiled for them (loops unrolled, tap tables sized at compile time),
+	// off forces the runtime loop kernel, only useful for comparing the two
+	bool specialized;
+
+	// neighbour selection for the normals reconstructed from depth when AoInput has none
+	NORMAL_TAPS normalTaps;
+};
+
+// quality level, the kernel counts of a preset are the ones with compile-time specialized kernels
+// blurRadius is the Blur radius (FILTER_SIZE / 2 in computeblur.hlsl) meant to go with it
+struct AoPreset {
+	const char *name;
+	int numTaps;
+	int numDirections;
+	int numSteps;
+	int blurRadius;
+
+	void apply(AoParams &params) const;
+};
+
+// what the ao shaders bind: the prepass targets and the inverse projection
+struct AoInput {
+	AoInput() : normals(0), depth(0), viewZ(0), halfViewZ(0), pyramid(0) {}
+
+	// 0 for a depth only prepass, the kernels then reconstruct view space normals from depth (NormalReconstruction)
+	// WORKNOTE: TemporalAo still needs them, it keeps last frame's normals for its history rejection
+	const Image<fl3> *normals;
+	const FloatImage *depth; // post-projection depth in [0, 1]
+	// optional view space z of depth (LinearDepth), when set the kernels reconstruct positions with ray factors
+	// instead of unprojecting every tap, invProj has to pass LinearDepth::IsSupported
+	const FloatImage *viewZ;
+	// optional view z as half (LinearDepth's Image16 build), read by the kernels in place of viewZ and depth
+	// the reduced resolution and deinterleaved modes widen it into viewZ first, depth is only needed without normals
+	const Image16 *halfViewZ;
+	const DepthPyramid *pyramid; // optional, built from viewZ when that is set and from depth otherwise
+	Matrix invProj;
+};
+
+// view space z of post-projection depth z, exact for perspective and orthographic projections
+inline float viewDepth(const float *invProj, float z)
+{
+	return (invProj[10] * z + invProj[14]) / (invProj[11] * z + invProj[15]);
+}
+
+class AoSampler;
+class AoTarget;
+
+// cpu ports of the ao pixel shaders in samples/ao, writing one occlusion value per pixel of out
+// (1 is unoccluded, same as the aobuf contents)
+//
+// taps are point sampled with clamp-to-edge instead of going through the sample's bilinear/wrap default sampler,
+// filtering depth across silhouettes only invents surfaces and the pyramid levels can't be filtered meaningfully anyway
+class AmbientOcclusion {
+public:
+	AmbientOcclusion();
+	virtual ~AmbientOcclusion();
+
+	void ssao(const AoInput &input, const AoParams &params, FloatImage &out);
+	void hbao(const AoInput &input, const AoParams &params, FloatImage &out);
+	// the same with 16 bit output, written row by row by the full resolution kernels, unorm unless out already has a format
+	// the other modes run on floats and narrow the result
+	void ssao(const AoInput &input, const AoParams &params, Image16 &out);
+	void hbao(const AoInput &input, const AoParams &params, Image16 &out);
+
+	// the two halves of the reduced resolution modes, public so they can be timed and checked on their own
+	// downsample keeps one real sample per block: the closest depth on even checkerboard texels and the farthest
+	// on odd ones (so both sides of an edge survive), together with that texel's normal
+	// reduced points into buffers owned by this object, which stay valid until the next downsample
+	void downsample(const AoInput &input, AO_RESOLUTION resolution, AoInput &reduced);
+	// upsamples ao computed on reduced back to the size of full, weighting the 4 nearest low resolution texels
+	// by bilinear weight, relative view depth difference and normal agreement with the full resolution pixel
+	void upsample(const FloatImage &ao, const AoInput &reduced, const AoInput &full, FloatImage &out);
+
+	// presets in increasing quality, "high" is the defines in the shaders
+	static int GetNumPresets();
+	static const AoPreset& GetPreset(int index);
+	// 0 if there is no preset with that name
+	static const AoPreset* FindPreset(const char *name);
+
+private:
+	enum KERNEL {
+		KERNEL_SSAO,
+		KERNEL_HBAO
+	};
+
+	// reduced resolution around evaluateFrame
+	void evaluate(KERNEL kernel, const AoInput &input, const AoParams &params, FloatImage &out);
+	void evaluate(KERNEL kernel, const AoInput &input, const AoParams &params, Image16 &out);
+	// input with halfViewZ widened into widenedViewZ_, for the modes that only take floats
+	void widen(const AoInput &input, AoInput &widened);
+	// whole frame or deinterleaved layers
+	void evaluateFrame(KERNEL kernel, const AoInput &input, const AoParams &params, FloatImage &out);
+	void runPass(KERNEL kernel, const AoSampler &sampler, const AoInput &input, const AoParams &params, AoTarget &out);
+
+	// normals for inputs without them
+	NormalReconstruction reconstruction_;
+
+	// float copies of 16 bit inputs and outputs
+	FloatImage widenedViewZ_;
+	FloatImage widenedAo_;
+
+	// reduced resolution buffers
+	Image<fl3> reducedNormals_;
+	FloatImage reducedDepth_;
+	FloatImage reducedViewZ_;
+	AoInput reducedInput_;
+	FloatImage reducedAo_;
+
+	// deinterleaved layers
+	std::vector<Image<fl3> > layerNormals_;
+	std::vector<FloatImage> layerDepth_;
+	std::vector<FloatImage> layerAo_;
+};
+
+#endif // AMBIENTOCCLUSION_H
@@ -0,0 +1,228 @@
+#include "aobaker.h"
+#include "parallel.h"
+#include "sampling.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+// vertices and atlas rows handed to a worker at a time
+#define BAKE_VERTEX_GRAIN 256
+#define BAKE_ROW_GRAIN 4
+// rays start this far off the surface along the normal, in world units
+#define BAKE_SURFACE_OFFSET 1e-3f
+#define BAKE_FILE_MAGIC 0x424f414bu // "KAOB"
+#define BAKE_FILE_VERSION 1
+
+struct AoBakeHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t geometryHash;
+	int32_t width;
+	int32_t height;
+};
+
+// fnv-1a, 64 bit
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+AoBaker::AoBaker() : raysPerSample_(64), maxDistance_(1.f), seed_(0)
+{
+	stats_.rays = 0;
+	stats_.samples = 0;
+}
+
+AoBaker::~AoBaker()
+{
+
+}
+
+void AoBaker::clearOccluders()
+{
+	bvh_.clear();
+}
+
+void AoBaker::addOccluder(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model)
+{
+	bvh_.addTriangles(verts, vertcount, inds, indexcount, model);
+}
+
+void AoBaker::buildOccluders()
+{
+	bvh_.build();
+}
+
+float AoBaker::bakePoint(const fl3 &pos, const fl3 &normal, uint32_t seq) const
+{
+	fl3 n = normal;
+	normalize(n);
+	fl3 t, b;
+	tangentFrame(n, t, b);
+	const fl3 origin = pos + n * BAKE_SURFACE_OFFSET;
+	const uint32_t h = hashCoords(seq, 0, seed_);
+	const float shiftA = toUnitFloat(h), shiftB = toUnitFloat(h * 0x9e3779b9u);
+	int escaped = 0;
+	for (int i = 0; i < raysPerSample_; i++) {
+		if (!bvh_.occluded(origin, cosineHemisphere(i, raysPerSample_, shiftA, shiftB, n, t, b), maxDistance_)) {
+			escaped++;
+		}
+	}
+	return (float) escaped / raysPerSample_;
+}
+
+void AoBaker::bakeVertices(const PTNvert *verts, size_t vertcount, const Matrix &model, std::vector<float> &ao)
+{
+	ao.resize(vertcount);
+	parallelFor(0, (int) vertcount, BAKE_VERTEX_GRAIN, [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			ao[i] = bakePoint(model.multiplyPoint(verts[i].pos), model.multiplyVector(verts[i].norm), i);
+		}
+	});
+	stats_.samples = (uint32_t) vertcount;
+	stats_.rays = (uint64_t) vertcount * raysPerSample_;
+}
+
+/*static*/ void AoBaker::GenerateLightmapUvs(size_t indexcount, int cellSize, int &atlasSize, std::vector<fl2> &uvs)
+{
+	const size_t triangles = indexcount / 3;
+	const int cells = (int) ((triangles + 1) / 2);
+	const int cellsPerRow = std::max(1, (int) ceilf(sqrtf((float) cells)));
+	atlasSize = cellsPerRow * cellSize;
+	// corners of the two halves in cell space, the second triangle is the first one mirrored through the cell center
+	static const float Corners[2][3][2] = {
+		{ { 0, 0 }, { 1, 0 }, { 0, 1 } },
+		{ { 1, 1 }, { 0, 1 }, { 1, 0 } }
+	};
+	uvs.resize(triangles * 3);
+	for (size_t tri = 0; tri < triangles; tri++) {
+		const int cell = (int) (tri / 2);
+		const float x0 = (float) (cell % cellsPerRow * cellSize + 1);
+		const float y0 = (float) (cell / cellsPerRow * cellSize + 1);
+		for (int k = 0; k < 3; k++) {
+			const float *corner = Corners[tri % 2][k];
+			uvs[3 * tri + k] = fl2((x0 + corner[0] * (cellSize - 2)) / atlasSize, (y0 + corner[1] * (cellSize - 2)) / atlasSize);
+		}
+	}
+}
+
+void AoBaker::bakeLightmap(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model,
+	int cellSize, FloatImage &lightmap)
+{
+	const size_t triangles = indexcount / 3;
+	int atlasSize;
+	std::vector<fl2> uvs;
+	GenerateLightmapUvs(indexcount, cellSize, atlasSize, uvs);
+	const int cellsPerRow = atlasSize / cellSize;
+	const int inner = cellSize - 2;
+	lightmap.resize(atlasSize, atlasSize, 1.f);
+
+	std::vector<fl3> positions (vertcount), normals (vertcount);
+	for (size_t i = 0; i < vertcount; i++) {
+		positions[i] = model.multiplyPoint(verts[i].pos);
+		normals[i] = model.multiplyVector(verts[i].norm);
+	}
+
+	std::atomic<uint32_t> samples (0);
+	parallelFor(0, atlasSize, BAKE_ROW_GRAIN, [&](int y0, int y1) {
+		uint32_t rowSamples = 0;
+		for (int y = y0; y < y1; y++) {
+			const int j = y % cellSize;
+			if (j == 0 || j == cellSize - 1) {
+				continue; // border rows are copied afterwards
+			}
+			for (int x = 0; x < atlasSize; x++) {
+				const int i = x % cellSize;
+				const size_t first = 2 * (size_t) ((y / cellSize) * cellsPerRow + x / cellSize);
+				if (i == 0 || i == cellSize - 1 || first >= triangles) {
+					continue;
+				}
+				// cell space position of the texel center, then barycentrics in the half it falls in
+				float a = (i - 0.5f) / inner, b = (j - 0.5f) / inner;
+				size_t tri = first;
+				float w[3];
+				if (a + b > 1.f && first + 1 < triangles) {
+					tri = first + 1;
+					w[0] = a + b - 1.f; w[1] = 1.f - a; w[2] = 1.f - b;
+				} else {
+					// an odd triangle out has the whole cell, the texels past its diagonal take the closest point on it
+					const float scale = a + b > 1.f ? 1.f / (a + b) : 1.f;
+					a *= scale;
+					b *= scale;
+					w[0] = 1.f - a - b; w[1] = a; w[2] = b;
+				}
+				fl3 pos, normal;
+				for (int k = 0; k < 3; k++) {
+					const uint32_t v = inds[3 * tri + k];
+					pos += positions[v] * w[k];
+					normal += normals[v] * w[k];
+				}
+				lightmap.at(x, y) = bakePoint(pos, normal, (uint32_t) (y * atlasSize + x));
+				rowSamples++;
+			}
+		}
+		samples += rowSamples;
+	});
+
+	// one texel border around every cell repeats the edge of the inside, so bilinear filtering doesn't reach the next cell
+	for (int y = 0; y < atlasSize; y++) {
+		const int j = y % cellSize;
+		const int sy = j == 0 ? y + 1 : (j == cellSize - 1 ? y - 1 : y);
+		for (int x = 0; x < atlasSize; x++) {
+			const int i = x % cellSize;
+			const int sx = i == 0 ? x + 1 : (i == cellSize - 1 ? x - 1 : x);
+			if (sx != x || sy != y) {
+				lightmap.at(x, y) = lightmap.at(sx, sy);
+			}
+		}
+	}
+	stats_.samples = samples;
+	stats_.rays = (uint64_t) stats_.samples * raysPerSample_;
+}
+
+/*static*/ uint64_t AoBaker::HashGeometry(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hashBytes(verts, vertcount * sizeof(PTNvert), hash);
+	return inds ? hashBytes(inds, indexcount * sizeof(uint32_t), hash) : hash;
+}
+
+/*static*/ bool AoBaker::SaveBake(const char *filename, uint64_t geometryHash, const FloatImage &bake)
+{
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		return false;
+	}
+	AoBakeHeader header;
+	header.magic = BAKE_FILE_MAGIC;
+	header.version = BAKE_FILE_VERSION;
+	header.geometryHash = geometryHash;
+	header.width = bake.getWidth();
+	header.height = bake.getHeight();
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(bake.data(), 1, bake.getByteSize(), file) == bake.getByteSize();
+	fclose(file);
+	return ok;
+}
+
+/*static*/ bool AoBaker::LoadBake(const char *filename, uint64_t geometryHash, FloatImage &bake)
+{
+	FILE *file = fopen(filename, "rb");
+	if (!file) {
+		return false;
+	}
+	AoBakeHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == BAKE_FILE_MAGIC && header.version == BAKE_FILE_VERSION
+		&& header.geometryHash == geometryHash && header.width > 0 && header.height > 0;
+	if (ok) {
+		bake.resize(header.width, header.height);
+		ok = fread(bake.data(), 1, bake.getByteSize(), file) == bake.getByteSize();
+	}
+	fclose(file);
+	return ok;
+}
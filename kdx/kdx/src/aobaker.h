@@ -0,0 +1,66 @@
+#ifndef AOBAKER_H
+#define AOBAKER_H
+
+#include "bvh.h"
+#include "image.hpp"
+#include <stdint.h>
+#include <vector>
+
+// offline ao for static geometry (the ground quad, props), baked once instead of computed every frame
+// cosine weighted hemisphere rays from every vertex or every lightmap texel of a mesh are traced against
+// an occluder bvh, the result is the fraction that escapes within maxDistance (1 is unoccluded, like the ao buffers)
+//
+// bakes are stored in a small cache file next to the mesh, tagged with a hash of the geometry so a changed
+// mesh is rebaked instead of picking up stale data
+class AoBaker {
+public:
+	struct Stats {
+		uint64_t rays;
+		uint32_t samples; // vertices or texels baked
+	};
+
+	AoBaker();
+	virtual ~AoBaker();
+
+	// everything that should shadow the baked meshes, usually including the meshes themselves
+	void clearOccluders();
+	void addOccluder(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model);
+	void buildOccluders();
+
+	// one value per vertex, to go into the mesh as an extra vertex stream
+	void bakeVertices(const PTNvert *verts, size_t vertcount, const Matrix &model, std::vector<float> &ao);
+
+	// lightmap over generated uvs (see GenerateLightmapUvs), lightmap is resized to the atlas
+	void bakeLightmap(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model,
+		int cellSize, FloatImage &lightmap);
+
+	// trivial atlas: every pair of triangles shares a square cell of cellSize texels (a one texel border included),
+	// one triangle in each half, uvs gets one entry per index since the charts don't share vertices
+	static void GenerateLightmapUvs(size_t indexcount, int cellSize, int &atlasSize, std::vector<fl2> &uvs);
+
+	// cache files, a header with the geometry hash and the size followed by the floats
+	// a vertex stream is stored as a vertcount x 1 image
+	static uint64_t HashGeometry(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount);
+	static bool SaveBake(const char *filename, uint64_t geometryHash, const FloatImage &bake);
+	// false if the file is missing, broken or was baked for different geometry
+	static bool LoadBake(const char *filename, uint64_t geometryHash, FloatImage &bake);
+
+	void setRaysPerSample(int rays) { raysPerSample_ = rays; }
+	void setMaxDistance(float distance) { maxDistance_ = distance; }
+	void setSeed(uint32_t seed) { seed_ = seed; }
+
+	const Bvh& getOccluders() const { return bvh_; }
+	const Stats& getStats() const { return stats_; }
+
+private:
+	// ao at a surface point, seq picks the sample's random sequence
+	float bakePoint(const fl3 &pos, const fl3 &normal, uint32_t seq) const;
+
+	Bvh bvh_;
+	int raysPerSample_;
+	float maxDistance_;
+	uint32_t seed_;
+	Stats stats_;
+};
+
+#endif // AOBAKER_H
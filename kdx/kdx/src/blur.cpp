@@ -0,0 +1,338 @@
+#include "blur.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// rows handed to a worker at a time
+#define BLUR_ROW_GRAIN 16
+// columns processed together in the vertical passes, keeps the rows of a strip in cache
+#define BLUR_STRIP_WIDTH 512
+
+static inline int clampIndex(int i, int size)
+{
+	return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+// copies row into padded with radius clamped texels on each side, so the inner loops need no bounds checks
+static inline void padRow(const float *row, int width, int radius, float *padded)
+{
+	for (int i = 0; i < radius; i++) {
+		padded[i] = row[0];
+		padded[radius + width + i] = row[width - 1];
+	}
+	memcpy(padded + radius, row, width * sizeof(float));
+}
+
+// only reallocates when the size changes, the passes overwrite every texel anyway
+static inline void ensureSize(FloatImage &image, int width, int height)
+{
+	if (image.getWidth() != width || image.getHeight() != height) {
+		image.resize(width, height);
+	}
+}
+
+Blur::Blur() : temp_(), temp16_(), weights_(), specialized_(true)
+{
+
+}
+
+Blur::~Blur()
+{
+
+}
+
+void Blur::computeGaussianWeights(int radius, float sigma)
+{
+	if (sigma <= 0.f) {
+		sigma = radius > 0 ? 0.5f * radius : 1.f;
+	}
+	weights_.resize(2 * radius + 1);
+	float total = 0.f;
+	for (int k = -radius; k <= radius; k++) {
+		const float w = expf(-0.5f * (k * k) / (sigma * sigma));
+		weights_[k + radius] = w;
+		total += w;
+	}
+	for (size_t k = 0; k < weights_.size(); k++) {
+		weights_[k] /= total;
+	}
+}
+
+// gaussian passes, RADIUS 0 takes the radius at runtime
+// with the radius fixed the taps unroll into a per-texel sum that stays in registers,
+// the generic version runs tap by tap over the whole row instead so its inner loop still vectorizes
+template<int RADIUS>
+static void gaussianPasses(const FloatImage &src, FloatImage &temp, FloatImage &dst, const float *w, int runtimeRadius)
+{
+	const int radius = RADIUS ? RADIUS : runtimeRadius;
+	const int taps = 2 * radius + 1;
+	const int width = src.getWidth();
+	const int height = src.getHeight();
+
+	// horizontal pass, src -> temp
+	parallelFor(0, height, BLUR_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<float> padded(width + 2 * radius);
+		for (int y = y0; y < y1; y++) {
+			padRow(src.row(y), width, radius, &padded[0]);
+			float *out = temp.row(y);
+			if (RADIUS) {
+				for (int x = 0; x < width; x++) {
+					float total = 0.f;
+					for (int k = 0; k < taps; k++) {
+						total += w[k] * padded[x + k];
+					}
+					out[x] = total;
+				}
+				continue;
+			}
+			for (int x = 0; x < width; x++) {
+				out[x] = 0.f;
+			}
+			// tap-outer loop order keeps the inner loop a straight vectorizable multiply-add
+			for (int k = 0; k < taps; k++) {
+				const float wk = w[k];
+				const float *in = &padded[k];
+				for (int x = 0; x < width; x++) {
+					out[x] += wk * in[x];
+				}
+			}
+		}
+	});
+
+	// vertical pass, temp -> dst, a strip of columns at a time so the 2*radius+1 source rows stay cached
+	parallelFor(0, height, BLUR_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<const float*> rows(taps);
+		for (int x0 = 0; x0 < width; x0 += BLUR_STRIP_WIDTH) {
+			const int count = std::min(BLUR_STRIP_WIDTH, width - x0);
+			for (int y = y0; y < y1; y++) {
+				float *out = dst.row(y) + x0;
+				for (int k = 0; k < taps; k++) {
+					rows[k] = temp.row(clampIndex(y + k - radius, height)) + x0;
+				}
+				if (RADIUS) {
+					for (int x = 0; x < count; x++) {
+						float total = 0.f;
+						for (int k = 0; k < taps; k++) {
+							total += w[k] * rows[k][x];
+						}
+						out[x] = total;
+					}
+					continue;
+				}
+				for (int x = 0; x < count; x++) {
+					out[x] = 0.f;
+				}
+				for (int k = 0; k < taps; k++) {
+					const float wk = w[k];
+					const float *in = rows[k];
+					for (int x = 0; x < count; x++) {
+						out[x] += wk * in[x];
+					}
+				}
+			}
+		}
+	});
+}
+
+void Blur::gaussian(const FloatImage &src, FloatImage &dst, int radius, float sigma)
+{
+	const int width = src.getWidth();
+	const int height = src.getHeight();
+	computeGaussianWeights(radius, sigma);
+	ensureSize(temp_, width, height);
+	ensureSize(dst, width, height);
+	const float *w = &weights_[0];
+
+	switch (specialized_ ? radius : 0) {
+	case 1: gaussianPasses<1>(src, temp_, dst, w, radius); break;
+	case 2: gaussianPasses<2>(src, temp_, dst, w, radius); break;
+	case 3: gaussianPasses<3>(src, temp_, dst, w, radius); break;
+	default: gaussianPasses<0>(src, temp_, dst, w, radius); break;
+	}
+}
+
+void Blur::box(const FloatImage &src, FloatImage &dst, int radius)
+{
+	const int width = src.getWidth();
+	const int height = src.getHeight();
+	ensureSize(temp_, width, height);
+	ensureSize(dst, width, height);
+	const float norm = 1.f / (2 * radius + 1);
+
+	// horizontal pass, one running sum per row
+	parallelFor(0, height, BLUR_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<float> padded(width + 2 * radius + 1);
+		for (int y = y0; y < y1; y++) {
+			padRow(src.row(y), width, radius, &padded[0]);
+			padded[width + 2 * radius] = 0.f; // read by the last slide, never used
+			float *out = temp_.row(y);
+			// WORKNOTE: double accumulator so adding and removing texels along a 4K row doesn't drift
+			double sum = 0.0;
+			for (int k = 0; k <= 2 * radius; k++) {
+				sum += padded[k];
+			}
+			for (int x = 0; x < width; x++) {
+				out[x] = (float) sum * norm;
+				sum += padded[x + 2 * radius + 1] - padded[x];
+			}
+		}
+	});
+
+	// vertical pass, running sums for a strip of columns slid down a block of rows
+	// the sums are re-primed at the top of every block, which bounds float drift and lets blocks run in parallel
+	parallelFor(0, height, BLUR_ROW_GRAIN * 4, [&](int y0, int y1) {
+		float sums[BLUR_STRIP_WIDTH];
+		for (int x0 = 0; x0 < width; x0 += BLUR_STRIP_WIDTH) {
+			const int count = std::min(BLUR_STRIP_WIDTH, width - x0);
+			for (int x = 0; x < count; x++) {
+				sums[x] = 0.f;
+			}
+			for (int k = -radius; k <= radius; k++) {
+				const float *in = temp_.row(clampIndex(y0 + k, height)) + x0;
+				for (int x = 0; x < count; x++) {
+					sums[x] += in[x];
+				}
+			}
+			for (int y = y0; y < y1; y++) {
+				float *out = dst.row(y) + x0;
+				const float *add = temp_.row(clampIndex(y + radius + 1, height)) + x0;
+				const float *sub = temp_.row(clampIndex(y - radius, height)) + x0;
+				for (int x = 0; x < count; x++) {
+					out[x] = sums[x] * norm;
+					sums[x] += add[x] - sub[x];
+				}
+			}
+		}
+	});
+}
+
+// SRC, DEPTH and DST are FloatImage or Image16, temp has the type of dst
+template<typename SRC, typename DEPTH, typename DST>
+static void bilateralPasses(const SRC &src, const DEPTH &depth, DST &temp, DST &dst, int radius, const float *w, float depthSharpness)
+{
+	const int width = src.getWidth();
+	const int height = src.getHeight();
+
+	// horizontal pass
+	parallelFor(0, height, BLUR_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<float> padded(width + 2 * radius);
+		std::vector<float> paddedDepth(width + 2 * radius);
+		std::vector<float> scratch(width);
+		for (int y = y0; y < y1; y++) {
+			padRow(readRow(src, y, 0, width, &scratch[0]), width, radius, &padded[0]);
+			padRow(readRow(depth, y, 0, width, &scratch[0]), width, radius, &paddedDepth[0]);
+			float *out = beginRow(temp, y, 0, &scratch[0]);
+			for (int x = 0; x < width; x++) {
+				const float center = paddedDepth[x + radius];
+				float total = 0.f, weight = 0.f;
+				for (int k = 0; k <= 2 * radius; k++) {
+					const float dz = paddedDepth[x + k] - center;
+					const float wk = w[k] * expf(-dz * dz * depthSharpness);
+					total += wk * padded[x + k];
+					weight += wk;
+				}
+				out[x] = total / weight;
+			}
+			endRow(temp, y, 0, width, out);
+		}
+	});
+
+	// vertical pass, the rows a band of output rows reads are fetched (and widened) once per strip
+	parallelFor(0, height, BLUR_ROW_GRAIN, [&](int y0, int y1) {
+		const int bandRows = y1 - y0 + 2 * radius;
+		std::vector<const float*> inRows(bandRows), depthRows(bandRows);
+		std::vector<float> inScratch((size_t) bandRows * BLUR_STRIP_WIDTH), depthScratch((size_t) bandRows * BLUR_STRIP_WIDTH);
+		float total[BLUR_STRIP_WIDTH];
+		float weight[BLUR_STRIP_WIDTH];
+		float outScratch[BLUR_STRIP_WIDTH];
+		for (int x0 = 0; x0 < width; x0 += BLUR_STRIP_WIDTH) {
+			const int count = std::min(BLUR_STRIP_WIDTH, width - x0);
+			for (int i = 0; i < bandRows; i++) {
+				const int sy = clampIndex(y0 - radius + i, height);
+				inRows[i] = readRow(temp, sy, x0, count, &inScratch[(size_t) i * BLUR_STRIP_WIDTH]);
+				depthRows[i] = readRow(depth, sy, x0, count, &depthScratch[(size_t) i * BLUR_STRIP_WIDTH]);
+			}
+			for (int y = y0; y < y1; y++) {
+				const float *center = depthRows[y - y0 + radius];
+				for (int x = 0; x < count; x++) {
+					total[x] = 0.f;
+					weight[x] = 0.f;
+				}
+				for (int k = 0; k <= 2 * radius; k++) {
+					const float *in = inRows[y - y0 + k];
+					const float *inDepth = depthRows[y - y0 + k];
+					for (int x = 0; x < count; x++) {
+						const float dz = inDepth[x] - center[x];
+						const float wk = w[k] * expf(-dz * dz * depthSharpness);
+						total[x] += wk * in[x];
+						weight[x] += wk;
+					}
+				}
+				float *out = beginRow(dst, y, x0, outScratch);
+				for (int x = 0; x < count; x++) {
+					out[x] = total[x] / weight[x];
+				}
+				endRow(dst, y, x0, count, out);
+			}
+		}
+	});
+}
+
+void Blur::bilateral(const FloatImage &src, const FloatImage &depth, FloatImage &dst, int radius, float depthSharpness, float sigma)
+{
+	computeGaussianWeights(radius, sigma);
+	ensureSize(temp_, src.getWidth(), src.getHeight());
+	ensureSize(dst, src.getWidth(), src.getHeight());
+	bilateralPasses(src, depth, temp_, dst, radius, &weights_[0], depthSharpness);
+}
+
+void Blur::bilateral(const Image16 &src, const Image16 &depth, Image16 &dst, int radius, float depthSharpness, float sigma)
+{
+	computeGaussianWeights(radius, sigma);
+	// the intermediate keeps the format of src, dst too when it has no size yet
+	if (temp16_.getWidth() != src.getWidth() || temp16_.getHeight() != src.getHeight() || temp16_.getFormat() != src.getFormat()) {
+		temp16_.resize(src.getWidth(), src.getHeight(), src.getFormat());
+	}
+	if (dst.getWidth() != src.getWidth() || dst.getHeight() != src.getHeight()) {
+		dst.resize(src.getWidth(), src.getHeight(), dst.getWidth() ? dst.getFormat() : src.getFormat());
+	}
+	bilateralPasses(src, depth, temp16_, dst, radius, &weights_[0], depthSharpness);
+}
+
+// the computeblur.hlsl loops, RADIUS 0 takes the radius at runtime like gaussianPasses
+template<int RADIUS>
+static void boxReferencePass(const FloatImage &src, FloatImage &dst, int runtimeRadius)
+{
+	const int radius = RADIUS ? RADIUS : runtimeRadius;
+	const int width = src.getWidth();
+	const int height = src.getHeight();
+	const float norm = 1.f / ((2 * radius + 1) * (2 * radius + 1));
+
+	parallelFor(0, height, BLUR_ROW_GRAIN, [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			for (int x = 0; x < width; x++) {
+				float total = 0.f;
+				for (int i = -radius; i <= radius; i++) {
+					for (int j = -radius; j <= radius; j++) {
+						total += src.clampedAt(x + j, y + i) * norm;
+					}
+				}
+				dst.at(x, y) = total;
+			}
+		}
+	});
+}
+
+void Blur::boxReference(const FloatImage &src, FloatImage &dst, int radius)
+{
+	// can't filter in place since every output reads its neighbors
+	ensureSize(temp_, src.getWidth(), src.getHeight());
+	switch (specialized_ ? radius : 0) {
+	case 1: boxReferencePass<1>(src, temp_, radius); break;
+	case 2: boxReferencePass<2>(src, temp_, radius); break;
+	case 3: boxReferencePass<3>(src, temp_, radius); break;
+	default: boxReferencePass<0>(src, temp_, radius); break;
+	}
+	dst = temp_;
+}
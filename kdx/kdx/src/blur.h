@@ -0,0 +1,46 @@
+#ifndef BLUR_H
+#define BLUR_H
+
+#include "image16.h"
+
+// cpu blur filters for single channel ao buffers
+// all filters address the source with clamp-to-edge, same as computeblur.hlsl
+// dst may be the same image as src
+class Blur {
+public:
+	Blur();
+	virtual ~Blur();
+
+	// separable gaussian, (2*radius+1) taps per pass instead of (2*radius+1)^2
+	// sigma <= 0 picks radius / 2
+	void gaussian(const FloatImage &src, FloatImage &dst, int radius, float sigma = 0.f);
+
+	// box filter with running sums, cost per pixel does not depend on the radius
+	void box(const FloatImage &src, FloatImage &dst, int radius);
+
+	// depth-aware separable gaussian for ao, taps whose depth differs from the center are weighted down
+	// by exp(-dz^2 * depthSharpness), so depth is whatever units sharpness is tuned for (linear view z works best)
+	void bilateral(const FloatImage &src, const FloatImage &depth, FloatImage &dst, int radius, float depthSharpness, float sigma = 0.f);
+	// the same on 16 bit storage (unorm ao and half view z), computed in floats
+	void bilateral(const Image16 &src, const Image16 &depth, Image16 &dst, int radius, float depthSharpness, float sigma = 0.f);
+
+	// straight port of the non-separable box in computeblur.hlsl, (2*radius+1)^2 taps per pixel
+	// kept as the reference the faster filters are checked against
+	void boxReference(const FloatImage &src, FloatImage &dst, int radius);
+
+	// gaussian and boxReference have kernels compiled for the radii of the ao presets (FILTER_SIZE 3, 5 and 7),
+	// other radii run the generic loops, turning this off forces those for comparisons
+	void setSpecialized(bool specialized) { specialized_ = specialized; }
+
+private:
+	void computeGaussianWeights(int radius, float sigma);
+
+	// intermediate result between the horizontal and vertical passes
+	FloatImage temp_;
+	Image16 temp16_;
+	// normalized 1D kernel, 2*radius+1 entries
+	std::vector<float> weights_;
+	bool specialized_;
+};
+
+#endif // BLUR_H
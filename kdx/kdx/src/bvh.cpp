@@ -0,0 +1,502 @@
+#include "bvh.h"
+#include "parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+#define BVH_DEFAULT_MIN_LEAF_SIZE 2
+#define BVH_DEFAULT_MAX_LEAF_SIZE 16
+#define BVH_NUM_BINS 16
+// sah cost of stepping through an inner node, relative to one triangle test
+#define BVH_TRAVERSAL_COST 1.f
+// ranges below this many triangles are built by one worker
+#define BVH_SUBTREE_SIZE 4096
+// and above this many the bounds and binning passes over them are spread over the pool
+#define BVH_PARALLEL_THRESHOLD 65536
+#define BVH_PARALLEL_GRAIN 8192
+#define BVH_STACK_SIZE 64
+// nodes this deep become leaves whatever their size, so the traversal stacks can't overflow on degenerate input
+// (overlap holds a pending sibling per level plus both children of the deepest inner node)
+#define BVH_MAX_DEPTH (BVH_STACK_SIZE - 1)
+// parallel edges and grazing hits are treated as misses below this determinant
+#define BVH_DETERMINANT_EPSILON 1e-12f
+
+static inline fl3 minPerAxis(const fl3 &a, const fl3 &b)
+{
+	return fl3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+static inline fl3 maxPerAxis(const fl3 &a, const fl3 &b)
+{
+	return fl3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+static inline bool boxesOverlap(const fl3 &aMin, const fl3 &aMax, const fl3 &bMin, const fl3 &bMax)
+{
+	return aMin.x <= bMax.x && bMin.x <= aMax.x && aMin.y <= bMax.y && bMin.y <= aMax.y && aMin.z <= bMax.z && bMin.z <= aMax.z;
+}
+
+// entry distance of the ray into the box, or a value past tmax when it misses
+static inline float intersectBox(const Bvh::Node &node, const fl3 &origin, const fl3 &invDir, float tmax)
+{
+	const float tx0 = (node.min.x - origin.x) * invDir.x, tx1 = (node.max.x - origin.x) * invDir.x;
+	const float ty0 = (node.min.y - origin.y) * invDir.y, ty1 = (node.max.y - origin.y) * invDir.y;
+	const float tz0 = (node.min.z - origin.z) * invDir.z, tz1 = (node.max.z - origin.z) * invDir.z;
+	const float tnear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.f));
+	const float tfar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), tmax));
+	return tnear <= tfar ? tnear : INFINITY;
+}
+
+// bounds of a range of triangles and of their centroids
+struct BvhRange {
+	fl3 min, max;
+	fl3 centroidMin, centroidMax;
+
+	BvhRange() : min(INFINITY, INFINITY, INFINITY), max(-INFINITY, -INFINITY, -INFINITY), centroidMin(min), centroidMax(max) {}
+
+	void merge(const BvhRange &other)
+	{
+		min = minPerAxis(min, other.min);
+		max = maxPerAxis(max, other.max);
+		centroidMin = minPerAxis(centroidMin, other.centroidMin);
+		centroidMax = maxPerAxis(centroidMax, other.centroidMax);
+	}
+};
+
+struct BvhBin {
+	fl3 min, max;
+	uint32_t count;
+
+	BvhBin() : min(INFINITY, INFINITY, INFINITY), max(-INFINITY, -INFINITY, -INFINITY), count(0) {}
+};
+
+// one set of bins per axis
+struct BvhBins {
+	BvhBin bins[3][BVH_NUM_BINS];
+};
+
+static inline float halfArea(const fl3 &min, const fl3 &max)
+{
+	const fl3 d = max - min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// bin of a centroid coordinate, the same mapping for binning and partitioning
+static inline int binIndex(float c, float origin, float scale)
+{
+	return std::min(BVH_NUM_BINS - 1, std::max(0, (int) ((c - origin) * scale)));
+}
+
+Bvh::Bvh() : method_(BUILD_SAH), minLeafSize_(BVH_DEFAULT_MIN_LEAF_SIZE), maxLeafSize_(BVH_DEFAULT_MAX_LEAF_SIZE)
+{
+
+}
+
+Bvh::~Bvh()
+{
+
+}
+
+void Bvh::clear()
+{
+	positions_.clear();
+	triangles_.clear();
+	ids_.clear();
+	nodes_.clear();
+}
+
+void Bvh::addTriangles(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model)
+{
+	addPositions((const char *) &verts[0].pos, sizeof(PTNvert), vertcount, inds, indexcount, model);
+}
+
+void Bvh::addTriangles(const fl3 *positions, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model)
+{
+	addPositions((const char *) positions, sizeof(fl3), vertcount, inds, indexcount, model);
+}
+
+void Bvh::addPositions(const char *positions, size_t stride, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model)
+{
+	std::vector<fl3> transformed (vertcount);
+	for (size_t i = 0; i < vertcount; i++) {
+		transformed[i] = model.multiplyPoint(*(const fl3 *) (positions + i * stride));
+	}
+	positions_.reserve(positions_.size() + indexcount);
+	for (size_t i = 0; i + 2 < indexcount; i += 3) {
+		positions_.push_back(transformed[inds[i]]);
+		positions_.push_back(transformed[inds[i + 1]]);
+		positions_.push_back(transformed[inds[i + 2]]);
+	}
+}
+
+void Bvh::build()
+{
+	const uint32_t count = (uint32_t) (positions_.size() / 3);
+	ids_.resize(count);
+	centroids_.resize(count);
+	boundsMin_.resize(count);
+	boundsMax_.resize(count);
+	parallelFor(0, (int) count, BVH_PARALLEL_GRAIN, [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			const fl3 &a = positions_[3 * i], &b = positions_[3 * i + 1], &c = positions_[3 * i + 2];
+			ids_[i] = i;
+			boundsMin_[i] = minPerAxis(a, minPerAxis(b, c));
+			boundsMax_[i] = maxPerAxis(a, maxPerAxis(b, c));
+			centroids_[i] = (boundsMin_[i] + boundsMax_[i]) * 0.5f;
+		}
+	});
+
+	// split the top of the tree here until the pieces are small enough to be built one per worker
+	nodes_.clear();
+	nodes_.reserve(count > 0 ? 2 * count : 1);
+	nodes_.push_back(Node());
+	std::vector<BuildTask> pending (1), subtrees;
+	pending[0].node = 0;
+	pending[0].first = 0;
+	pending[0].count = count;
+	pending[0].depth = 0;
+	while (!pending.empty()) {
+		const BuildTask task = pending.back();
+		pending.pop_back();
+		if (task.count <= BVH_SUBTREE_SIZE) {
+			subtrees.push_back(task);
+			continue;
+		}
+		BuildTask left, right;
+		if (splitNode(nodes_, task, left, right)) {
+			pending.push_back(right);
+			pending.push_back(left);
+		}
+	}
+
+	// every subtree builds into its own array with its root at 0, then gets appended with its indices offset
+	std::vector<std::vector<Node> > local (subtrees.size());
+	parallelFor(0, (int) subtrees.size(), 1, [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			BuildTask root = subtrees[i];
+			root.node = 0;
+			local[i].push_back(Node());
+			buildSubtree(local[i], root);
+		}
+	});
+	for (size_t i = 0; i < subtrees.size(); i++) {
+		// the local root replaces the placeholder, the rest moves to the end
+		const uint32_t offset = (uint32_t) nodes_.size() - 1;
+		for (size_t k = 0; k < local[i].size(); k++) {
+			Node node = local[i][k];
+			if (node.count == 0) {
+				node.index += offset;
+			}
+			if (k == 0) {
+				nodes_[subtrees[i].node] = node;
+			} else {
+				nodes_.push_back(node);
+			}
+		}
+	}
+
+	// leaf order copies of the triangles, so a leaf's tests walk memory in order
+	triangles_.resize(count);
+	parallelFor(0, (int) count, BVH_PARALLEL_GRAIN, [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			const fl3 *v = &positions_[3 * ids_[i]];
+			triangles_[i].v0 = v[0];
+			triangles_[i].e1 = v[1] - v[0];
+			triangles_[i].e2 = v[2] - v[0];
+		}
+	});
+}
+
+void Bvh::buildSubtree(std::vector<Node> &nodes, const BuildTask &root)
+{
+	// depth first with an explicit stack, children are always appended as a pair so they stay adjacent
+	std::vector<BuildTask> stack (1, root);
+	while (!stack.empty()) {
+		const BuildTask task = stack.back();
+		stack.pop_back();
+		BuildTask left, right;
+		if (splitNode(nodes, task, left, right)) {
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+	}
+}
+
+bool Bvh::splitNode(std::vector<Node> &nodes, const BuildTask &task, BuildTask &left, BuildTask &right)
+{
+	const uint32_t first = task.first;
+	const uint32_t count = task.count;
+	// large ranges only come up at the top of the tree, where the passes over them are spread over the pool
+	const bool parallel = count >= BVH_PARALLEL_THRESHOLD;
+	const int chunks = (int) (count + BVH_PARALLEL_GRAIN - 1) / BVH_PARALLEL_GRAIN;
+
+	auto addRange = [&](int b, int e, BvhRange &range) {
+		for (int i = b; i < e; i++) {
+			const uint32_t id = ids_[first + i];
+			range.min = minPerAxis(range.min, boundsMin_[id]);
+			range.max = maxPerAxis(range.max, boundsMax_[id]);
+			range.centroidMin = minPerAxis(range.centroidMin, centroids_[id]);
+			range.centroidMax = maxPerAxis(range.centroidMax, centroids_[id]);
+		}
+	};
+	BvhRange range;
+	if (parallel) {
+		std::vector<BvhRange> partial (chunks);
+		parallelFor(0, (int) count, BVH_PARALLEL_GRAIN, [&](int b, int e) { addRange(b, e, partial[b / BVH_PARALLEL_GRAIN]); });
+		for (int i = 0; i < chunks; i++) {
+			range.merge(partial[i]);
+		}
+	} else {
+		addRange(0, (int) count, range);
+	}
+	Node &node = nodes[task.node];
+	node.min = range.min;
+	node.max = range.max;
+	node.index = first;
+	node.count = count;
+
+	const fl3 extent = range.centroidMax - range.centroidMin;
+	if (count <= (uint32_t) minLeafSize_ || (extent.x <= 0.f && extent.y <= 0.f && extent.z <= 0.f) || task.depth >= BVH_MAX_DEPTH) {
+		return false;
+	}
+
+	uint32_t mid = first + count / 2;
+	if (method_ == BUILD_MEDIAN) {
+		const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		std::nth_element(ids_.begin() + first, ids_.begin() + mid, ids_.begin() + first + count,
+			[&](uint32_t a, uint32_t b) { return centroids_[a][axis] < centroids_[b][axis]; });
+	} else {
+		fl3 scale;
+		for (int axis = 0; axis < 3; axis++) {
+			scale[axis] = extent[axis] > 0.f ? BVH_NUM_BINS / extent[axis] : 0.f;
+		}
+		auto addBins = [&](int b, int e, BvhBins &bins) {
+			for (int i = b; i < e; i++) {
+				const uint32_t id = ids_[first + i];
+				for (int axis = 0; axis < 3; axis++) {
+					BvhBin &bin = bins.bins[axis][binIndex(centroids_[id][axis], range.centroidMin[axis], scale[axis])];
+					bin.min = minPerAxis(bin.min, boundsMin_[id]);
+					bin.max = maxPerAxis(bin.max, boundsMax_[id]);
+					bin.count++;
+				}
+			}
+		};
+		BvhBins bins;
+		if (parallel) {
+			std::vector<BvhBins> partial (chunks);
+			parallelFor(0, (int) count, BVH_PARALLEL_GRAIN, [&](int b, int e) { addBins(b, e, partial[b / BVH_PARALLEL_GRAIN]); });
+			for (int c = 0; c < chunks; c++) {
+				for (int axis = 0; axis < 3; axis++) {
+					for (int i = 0; i < BVH_NUM_BINS; i++) {
+						BvhBin &bin = bins.bins[axis][i];
+						const BvhBin &other = partial[c].bins[axis][i];
+						bin.min = minPerAxis(bin.min, other.min);
+						bin.max = maxPerAxis(bin.max, other.max);
+						bin.count += other.count;
+					}
+				}
+			}
+		} else {
+			addBins(0, (int) count, bins);
+		}
+
+		// sweep every axis once from each side, the split after bin i costs area * count on both sides
+		float bestCost = INFINITY;
+		int bestAxis = -1, bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			if (extent[axis] <= 0.f) {
+				continue;
+			}
+			const BvhBin *axisBins = bins.bins[axis];
+			float rightCost[BVH_NUM_BINS];
+			BvhBin accumulated;
+			for (int i = BVH_NUM_BINS - 1; i > 0; i--) {
+				accumulated.min = minPerAxis(accumulated.min, axisBins[i].min);
+				accumulated.max = maxPerAxis(accumulated.max, axisBins[i].max);
+				accumulated.count += axisBins[i].count;
+				rightCost[i] = accumulated.count ? halfArea(accumulated.min, accumulated.max) * accumulated.count : 0.f;
+			}
+			accumulated = BvhBin();
+			for (int i = 0; i < BVH_NUM_BINS - 1; i++) {
+				accumulated.min = minPerAxis(accumulated.min, axisBins[i].min);
+				accumulated.max = maxPerAxis(accumulated.max, axisBins[i].max);
+				accumulated.count += axisBins[i].count;
+				if (accumulated.count == 0 || accumulated.count == count) {
+					continue;
+				}
+				const float cost = halfArea(accumulated.min, accumulated.max) * accumulated.count + rightCost[i + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+				}
+			}
+		}
+
+		// traversal step against testing every triangle, both relative to a ray hitting this node
+		const float splitCost = BVH_TRAVERSAL_COST + bestCost / halfArea(range.min, range.max);
+		if (bestAxis < 0 || (splitCost >= count && count <= (uint32_t) maxLeafSize_)) {
+			return false;
+		}
+		const float origin = range.centroidMin[bestAxis], axisScale = scale[bestAxis];
+		mid = (uint32_t) (std::partition(ids_.begin() + first, ids_.begin() + first + count,
+			[&](uint32_t id) { return binIndex(centroids_[id][bestAxis], origin, axisScale) <= bestSplit; }) - ids_.begin());
+	}
+
+	const uint32_t children = (uint32_t) nodes.size();
+	nodes[task.node].index = children;
+	nodes[task.node].count = 0;
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	left.node = children;
+	left.first = first;
+	left.count = mid - first;
+	left.depth = task.depth + 1;
+	right.node = children + 1;
+	right.first = mid;
+	right.count = first + count - mid;
+	right.depth = task.depth + 1;
+	return true;
+}
+
+float Bvh::getSahCost() const
+{
+	if (nodes_.empty()) {
+		return 0.f;
+	}
+	// every node is entered with the probability of its area relative to the root's
+	const float rootArea = halfArea(nodes_[0].min, nodes_[0].max);
+	float cost = 0.f;
+	for (size_t i = 0; i < nodes_.size(); i++) {
+		const Node &node = nodes_[i];
+		cost += halfArea(node.min, node.max) / rootArea * (node.count > 0 ? (float) node.count : BVH_TRAVERSAL_COST);
+	}
+	return cost;
+}
+
+template<bool ANY_HIT>
+bool Bvh::traverse(const fl3 &origin, const fl3 &dir, float tmax, Hit &hit) const
+{
+	if (nodes_.empty() || triangles_.empty()) {
+		return false;
+	}
+	const fl3 invDir (1.f / dir.x, 1.f / dir.y, 1.f / dir.z);
+	bool found = false;
+	hit.t = tmax;
+	if (intersectBox(nodes_[0], origin, invDir, hit.t) > hit.t) {
+		return false;
+	}
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	uint32_t current = 0;
+	for (;;) {
+		const Node &node = nodes_[current];
+		if (node.count > 0) {
+			// moller-trumbore
+			for (uint32_t i = node.index; i < node.index + node.count; i++) {
+				const Triangle &tri = triangles_[i];
+				const fl3 p = cross(dir, tri.e2);
+				const float det = dot(tri.e1, p);
+				if (fabsf(det) < BVH_DETERMINANT_EPSILON) {
+					continue;
+				}
+				const float invDet = 1.f / det;
+				const fl3 s = origin - tri.v0;
+				const float u = dot(s, p) * invDet;
+				if (u < 0.f || u > 1.f) {
+					continue;
+				}
+				const fl3 q = cross(s, tri.e1);
+				const float v = dot(dir, q) * invDet;
+				if (v < 0.f || u + v > 1.f) {
+					continue;
+				}
+				const float t = dot(tri.e2, q) * invDet;
+				if (t > 0.f && t < hit.t) {
+					hit.t = t;
+					hit.triangle = ids_[i];
+					hit.u = u;
+					hit.v = v;
+					found = true;
+					if (ANY_HIT) {
+						return true;
+					}
+				}
+			}
+		} else {
+			// nearer child first, the other one waits on the stack
+			const float t0 = intersectBox(nodes_[node.index], origin, invDir, hit.t);
+			const float t1 = intersectBox(nodes_[node.index + 1], origin, invDir, hit.t);
+			if (t0 <= hit.t && t1 <= hit.t) {
+				const bool leftFirst = t0 <= t1;
+				assert(top < BVH_STACK_SIZE);
+				stack[top++] = leftFirst ? node.index + 1 : node.index;
+				current = leftFirst ? node.index : node.index + 1;
+				continue;
+			}
+			if (t0 <= hit.t) {
+				current = node.index;
+				continue;
+			}
+			if (t1 <= hit.t) {
+				current = node.index + 1;
+				continue;
+			}
+		}
+		if (top == 0) {
+			break;
+		}
+		current = stack[--top];
+	}
+	return found;
+}
+
+fl3 Bvh::getNormal(uint32_t triangle) const
+{
+	const fl3 *v = &positions_[3 * triangle];
+	fl3 n = cross(v[1] - v[0], v[2] - v[0]);
+	normalize(n);
+	return n;
+}
+
+bool Bvh::intersect(const fl3 &origin, const fl3 &dir, float tmax, Hit &hit) const
+{
+	return traverse<false>(origin, dir, tmax, hit);
+}
+
+bool Bvh::occluded(const fl3 &origin, const fl3 &dir, float tmax) const
+{
+	Hit hit;
+	return traverse<true>(origin, dir, tmax, hit);
+}
+
+size_t Bvh::overlap(const fl3 &min, const fl3 &max, std::vector<uint32_t> &triangles) const
+{
+	const size_t before = triangles.size();
+	if (triangles_.empty()) {
+		return 0;
+	}
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node &node = nodes_[stack[--top]];
+		if (!boxesOverlap(node.min, node.max, min, max)) {
+			continue;
+		}
+		if (node.count == 0) {
+			assert(top + 2 <= BVH_STACK_SIZE);
+			stack[top++] = node.index + 1;
+			stack[top++] = node.index;
+			continue;
+		}
+		for (uint32_t i = node.index; i < node.index + node.count; i++) {
+			const Triangle &tri = triangles_[i];
+			const fl3 v1 = tri.v0 + tri.e1, v2 = tri.v0 + tri.e2;
+			if (boxesOverlap(minPerAxis(tri.v0, minPerAxis(v1, v2)), maxPerAxis(tri.v0, maxPerAxis(v1, v2)), min, max)) {
+				triangles.push_back(ids_[i]);
+			}
+		}
+	}
+	return triangles.size() - before;
+}
@@ -0,0 +1,107 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "matrix.h"
+#include <stdint.h>
+#include <vector>
+
+// bounding volume hierarchy over world space triangles, for the cpu ray and box queries (reference ao, baking, picking, culling)
+// triangles are copied in at addTriangles with their model transform applied, build() makes them queryable
+// and keeps their addition order available as triangle ids, so callers can keep per-triangle data of their own
+//
+// the default build is binned sah: the top of the tree is split on the calling thread with the binning passes
+// spread over the pool, then the remaining subtrees are built in parallel and appended
+class Bvh {
+public:
+	enum BUILD_METHOD {
+		BUILD_SAH = 0, // binned surface area heuristic
+		BUILD_MEDIAN = 1 // object median on the widest axis, faster to build and slower to trace
+	};
+
+	// 32 bytes, two per cache line
+	// inner nodes point at their first child (the second one follows it), leaves at their first triangle
+	struct Node {
+		fl3 min;
+		uint32_t index;
+		fl3 max;
+		uint32_t count; // triangles in a leaf, 0 for inner nodes
+	};
+
+	struct Hit {
+		float t;
+		uint32_t triangle; // id, in the order triangles were added
+		float u, v; // barycentrics of vertices 1 and 2
+	};
+
+	Bvh();
+	virtual ~Bvh();
+
+	void clear();
+	// the index array is a triangle list, positions are transformed by model
+	void addTriangles(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model);
+	void addTriangles(const fl3 *positions, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model);
+	void build();
+
+	// closest hit along origin + t * dir for t in (0, tmax), dir doesn't need to be normalized
+	bool intersect(const fl3 &origin, const fl3 &dir, float tmax, Hit &hit) const;
+	// whether anything is hit in (0, tmax), stops at the first hit found
+	bool occluded(const fl3 &origin, const fl3 &dir, float tmax) const;
+	// ids of the triangles whose bounds overlap the box (a conservative broad phase, exact tests are up to the caller)
+	// appended to triangles, returns how many were found
+	size_t overlap(const fl3 &min, const fl3 &max, std::vector<uint32_t> &triangles) const;
+
+	// unit geometric normal of a triangle, wound like the rasterizer's front faces
+	fl3 getNormal(uint32_t triangle) const;
+
+	size_t getNumTriangles() const { return ids_.size(); }
+	size_t getNumNodes() const { return nodes_.size(); }
+	const std::vector<Node>& getNodes() const { return nodes_; }
+	// expected cost of a random ray relative to testing the root box, the quantity sah minimizes
+	float getSahCost() const;
+
+	void setBuildMethod(BUILD_METHOD method) { method_ = method; }
+	// nodes with this many triangles or fewer always become leaves
+	void setMinLeafSize(int minLeafSize) { minLeafSize_ = minLeafSize; }
+	// and nodes with more are always split, unless all their centroids coincide or they are at the depth limit
+	void setMaxLeafSize(int maxLeafSize) { maxLeafSize_ = maxLeafSize; }
+
+private:
+	// triangle in the layout the intersection test wants: a vertex and the two edges leaving it
+	struct Triangle {
+		fl3 v0, e1, e2;
+	};
+
+	// range of ids_ that becomes one node
+	struct BuildTask {
+		uint32_t node; // where it goes, in nodes_ or a subtree's local array
+		uint32_t first;
+		uint32_t count;
+		uint32_t depth; // of the node, the root is 0
+	};
+
+	void addPositions(const char *positions, size_t stride, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model);
+	// sets the bounds of task.node in nodes and either makes it a leaf or partitions its range and appends the two children
+	// returns false for a leaf
+	bool splitNode(std::vector<Node> &nodes, const BuildTask &task, BuildTask &left, BuildTask &right);
+	void buildSubtree(std::vector<Node> &nodes, const BuildTask &root);
+	template<bool ANY_HIT>
+	bool traverse(const fl3 &origin, const fl3 &dir, float tmax, Hit &hit) const;
+
+	// as added
+	std::vector<fl3> positions_;
+	// leaf order after build, ids_ maps back to the addition order
+	std::vector<Triangle> triangles_;
+	std::vector<uint32_t> ids_;
+	std::vector<Node> nodes_;
+
+	// build scratch
+	std::vector<fl3> centroids_;
+	std::vector<fl3> boundsMin_;
+	std::vector<fl3> boundsMax_;
+
+	BUILD_METHOD method_;
+	int minLeafSize_;
+	int maxLeafSize_;
+};
+
+#endif // BVH_H
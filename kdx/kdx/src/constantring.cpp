@@ -0,0 +1,79 @@
+#include "constantring.h"
+#include <assert.h>
+
+ConstantRingStats::ConstantRingStats() : allocations(0), bytes(0), padding(0), wraps(0), waits(0), failures(0)
+{
+
+}
+
+ConstantRing::ConstantRing(RenderDevice &dev, unsigned int size) : dev_(dev), head_(0), tail_(0)
+{
+	size_ = (size + CONSTANT_RANGE_ALIGNMENT - 1) / CONSTANT_RANGE_ALIGNMENT * CONSTANT_RANGE_ALIGNMENT;
+	BufferDesc desc;
+	desc.byteWidth = size_;
+	desc.usage = USAGE_DYNAMIC;
+	desc.bindFlags = BIND_CONSTANT_BUFFER;
+	buffer_ = dev.createBuffer(desc, 0);
+}
+
+ConstantRing::~ConstantRing()
+{
+	delete buffer_;
+}
+
+void ConstantRing::retire()
+{
+	const uint64_t completed = dev_.getCompletedFence();
+	while (!frames_.empty() && frames_.front().fence <= completed) {
+		tail_ = frames_.front().end;
+		frames_.pop_front();
+	}
+}
+
+ConstantRange ConstantRing::allocate(RenderContext &context, const void *data, unsigned int size)
+{
+	const unsigned int aligned = (size + CONSTANT_RANGE_ALIGNMENT - 1) / CONSTANT_RANGE_ALIGNMENT * CONSTANT_RANGE_ALIGNMENT;
+	// a range never wraps, if it doesn't fit before the end of the buffer it starts over at the beginning
+	uint64_t start = head_;
+	if (start % size_ + aligned > size_) {
+		start += size_ - start % size_;
+	}
+	if (start + aligned - tail_ > size_) {
+		retire();
+	}
+	while (start + aligned - tail_ > size_ && !frames_.empty()) {
+		stats_.waits++;
+		dev_.waitForFence(frames_.front().fence);
+		retire();
+	}
+	if (start + aligned - tail_ > size_) {
+		// the current frame alone has more than the ring holds
+		stats_.failures++;
+		const ConstantRange empty = { 0, 0, 0 };
+		return empty;
+	}
+
+	if (start != head_) {
+		stats_.wraps++;
+	}
+	const ConstantRange range = { buffer_, (unsigned int) (start % size_), aligned };
+	context.writeBuffer(buffer_, range.offset, data, size);
+	stats_.allocations++;
+	stats_.bytes += size;
+	stats_.padding += (size_t) (start + aligned - head_) - size;
+	head_ = start + aligned;
+	return range;
+}
+
+void ConstantRing::endFrame()
+{
+	const uint64_t lastEnd = frames_.empty() ? tail_ : frames_.back().end;
+	if (head_ == lastEnd) {
+		return;
+	}
+	Frame frame;
+	frame.fence = dev_.signalFence();
+	frame.end = head_;
+	frames_.push_back(frame);
+	retire();
+}
@@ -0,0 +1,83 @@
+#ifndef CONSTANTRING_H
+#define CONSTANTRING_H
+
+#include "renderdevice.h"
+#include <assert.h>
+#include <deque>
+
+// per frame constants sub-allocated from one big dynamic constant buffer, instead of a dynamic buffer per object that
+// gets mapped with discard every frame
+// allocations are 256 byte aligned ranges (what constant buffer ranges bind at) written with no overwrite maps, and
+// go front to back through the buffer, wrapping around at the end. each frame's ranges are fenced when it ends, and
+// space is only reused once the gpu is past the fence of the frame that had it, waiting for it if the ring runs full
+//
+// WORKNOTE: size it for the constants of the frames the gpu can be behind (3 or so), an allocation that doesn't fit
+// while only the current frame holds the ring fails with an empty range
+
+#define CONSTANT_RING_DEFAULT_SIZE (64 * 1024)
+
+// a range of the ring's buffer, bind it with RenderContext::setConstantBufferRange (or ConstantRing::use)
+struct ConstantRange {
+	RenderBuffer *buffer;
+	unsigned int offset;
+	// rounded up to CONSTANT_RANGE_ALIGNMENT
+	unsigned int size;
+};
+
+struct ConstantRingStats {
+	ConstantRingStats();
+
+	unsigned int allocations;
+	// bytes asked for, and what alignment and skipping the end of the buffer at a wrap added to that
+	size_t bytes, padding;
+	unsigned int wraps;
+	// allocations that had to wait for the gpu to free up space, and ones that didn't fit at all
+	unsigned int waits, failures;
+};
+
+class ConstantRing {
+public:
+	ConstantRing(RenderDevice &dev, unsigned int size = CONSTANT_RING_DEFAULT_SIZE);
+	virtual ~ConstantRing();
+
+	// copies size bytes of constants into the ring
+	ConstantRange allocate(RenderContext &context, const void *data, unsigned int size);
+	template<typename T>
+	ConstantRange allocate(RenderContext &context, const T &constants) { return allocate(context, &constants, sizeof(T)); }
+	static void use(RenderContext &context, SHADER_STAGE stage, unsigned int slot, const ConstantRange &range)
+	{
+		assert(range.buffer && "empty range from a failed allocate");
+		context.setConstantBufferRange(stage, slot, range.buffer, range.offset, range.size);
+	}
+
+	// fences the ranges allocated since the last endFrame
+	void endFrame();
+
+	unsigned int getSize() const { return size_; }
+	// bytes held by the current frame and the ones the gpu hasn't finished
+	unsigned int getUsed() const { return (unsigned int) (head_ - tail_); }
+	unsigned int getFramesInFlight() const { return (unsigned int) frames_.size(); }
+	// counters since the ring was created
+	const ConstantRingStats& getStats() const { return stats_; }
+
+private:
+	struct Frame {
+		uint64_t fence;
+		// where the frame's ranges end, in bytes written since the start
+		uint64_t end;
+	};
+
+	// frees the space of the frames the gpu is done with
+	void retire();
+
+	RenderDevice &dev_;
+	RenderBuffer *buffer_;
+	unsigned int size_;
+	// head_ is where the next range goes and tail_ where the oldest range still in use starts, both count bytes since
+	// the start and are taken modulo size_ for the offset, so head_ - tail_ is what is in use
+	uint64_t head_, tail_;
+	std::deque<Frame> frames_;
+	ConstantRingStats stats_;
+};
+
+#endif // CONSTANTRING_H
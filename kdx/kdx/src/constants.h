@@ -2,6 +2,9 @@
 #define CONSTANTS_H
 // some constants
 // not just for universal mathematical ones, but ones that we use often in the program
+// WORKNOTE: math.h on non-windows compilers already defines these as doubles, we want the float versions everywhere
+#undef M_PI
+#undef M_E
 #define M_PI 3.14159265358979323846f
 #define M_E 2.71828182845904523536f
 #define DEGTORAD(x) M_PI * ((x) / 180.f)
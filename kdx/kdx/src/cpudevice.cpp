@@ -0,0 +1,836 @@
+#include "cpudevice.h"
+#include "image16.h"
+#include "parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+// fractional bits of the snapped vertex positions, d3d11 rasterizes in 16.8 fixed point
+#define SUBPIXEL_BITS 8
+#define SUBPIXEL_ONE (1 << SUBPIXEL_BITS)
+#define SUBPIXEL_HALF (SUBPIXEL_ONE / 2)
+// triangles are clipped to |x|, |y| <= GUARD_BAND * w besides near and far, which keeps the fixed point
+// positions of anything drawn into a 4k target well inside 32 bits and the edge functions inside 64
+#define GUARD_BAND 32.f
+// rows per parallel band, each band walks every triangle of the draw and shades the pixels in its rows
+#define BAND_ROWS 16
+
+CpuTexture::CpuTexture(const TextureDesc &desc) : RenderTexture(desc), channels_(GetChannelCount(desc.format)),
+	texels_((size_t) desc.width * desc.height * GetChannelCount(desc.format), 0.f)
+{
+	assert(desc.numSamples <= 1);
+}
+
+void CpuTexture::load(int x, int y, float out[4]) const
+{
+	const float *t = texel(x, y);
+	out[0] = t[0];
+	out[1] = channels_ > 1 ? t[1] : 0.f;
+	out[2] = channels_ > 2 ? t[2] : 0.f;
+	out[3] = channels_ > 3 ? t[3] : 1.f;
+}
+
+void CpuTexture::store(int x, int y, const float value[4])
+{
+	float *t = texel(x, y);
+	for (int c = 0; c < channels_; c++) {
+		t[c] = Quantize(desc_.format, value[c]);
+	}
+}
+
+void CpuTexture::fill(const float value[4])
+{
+	float texel[4];
+	for (int c = 0; c < channels_; c++) {
+		texel[c] = Quantize(desc_.format, value[c]);
+	}
+	for (size_t i = 0; i < texels_.size(); i += channels_) {
+		memcpy(&texels_[i], texel, channels_ * sizeof(float));
+	}
+}
+
+void CpuTexture::copy(const CpuTexture &src)
+{
+	assert(src.desc_.width == desc_.width && src.desc_.height == desc_.height && src.channels_ == channels_);
+	texels_ = src.texels_;
+}
+
+/*static*/ float CpuTexture::Quantize(RENDER_FORMAT format, float value)
+{
+	// nan converts to 0 in the normalized formats
+	if (value != value) {
+		value = 0.f;
+	}
+	switch (format) {
+	case FORMAT_R16G16B16A16_FLOAT:
+	case FORMAT_R16G16_FLOAT:
+	case FORMAT_R16_FLOAT:
+		return halfToFloat(floatToHalf(value));
+	case FORMAT_R16_UNORM:
+	case FORMAT_D16_UNORM:
+		return unorm16ToFloat(floatToUnorm16(value));
+	case FORMAT_D24_UNORM_S8_UINT:
+		value = std::min(std::max(value, 0.f), 1.f);
+		return (float) ((int) (value * 16777215.0 + 0.5) / 16777215.0);
+	case FORMAT_R8G8B8A8_UNORM:
+		value = std::min(std::max(value, 0.f), 1.f);
+		return (int) (value * 255.f + 0.5f) * (1.f / 255.f);
+	case FORMAT_R16G16_SNORM:
+		// rounded half away from zero like the unorm conversions (floatToUnorm16)
+		value = std::min(std::max(value, -1.f), 1.f);
+		return (int) (value * 32767.f + (value < 0.f ? -0.5f : 0.5f)) * (1.f / 32767.f);
+	case FORMAT_R8G8_SNORM:
+		value = std::min(std::max(value, -1.f), 1.f);
+		return (int) (value * 127.f + (value < 0.f ? -0.5f : 0.5f)) * (1.f / 127.f);
+	default:
+		return value;
+	}
+}
+
+/*static*/ int CpuTexture::GetChannelCount(RENDER_FORMAT format)
+{
+	switch (format) {
+	case FORMAT_R32G32B32A32_FLOAT:
+	case FORMAT_R16G16B16A16_FLOAT:
+	case FORMAT_R8G8B8A8_UNORM:
+		return 4;
+	case FORMAT_R32G32B32_FLOAT:
+		return 3;
+	case FORMAT_R32G32_FLOAT:
+	case FORMAT_R16G16_FLOAT:
+	case FORMAT_R16G16_SNORM:
+	case FORMAT_R8G8_SNORM:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+// texel index i of a size texel wide axis after addressing
+static int addressTexel(int i, int size, RENDER_ADDRESS mode)
+{
+	switch (mode) {
+	case ADDRESS_WRAP:
+		i %= size;
+		return i < 0 ? i + size : i;
+	case ADDRESS_MIRROR:
+		i %= 2 * size;
+		i = i < 0 ? i + 2 * size : i;
+		return i < size ? i : 2 * size - 1 - i;
+	default:
+		return std::min(std::max(i, 0), size - 1);
+	}
+}
+
+void CpuSampler::sample(const CpuTexture &texture, float u, float v, float out[4]) const
+{
+	const int width = texture.getWidth(), height = texture.getHeight();
+	u = u == u ? u : 0.f;
+	v = v == v ? v : 0.f;
+	if (desc_.filter == FILTER_POINT) {
+		const int x = addressTexel((int) floorf(u * width), width, desc_.addressU);
+		const int y = addressTexel((int) floorf(v * height), height, desc_.addressV);
+		texture.load(x, y, out);
+		return;
+	}
+	// WORKNOTE: the weights are exact here, gpus quantize them (d3d11 asks for at least 8 bits of subtexel precision)
+	const float fu = u * width - 0.5f, fv = v * height - 0.5f;
+	const float flu = floorf(fu), flv = floorf(fv);
+	const float wu = fu - flu, wv = fv - flv;
+	const int x0 = addressTexel((int) flu, width, desc_.addressU), x1 = addressTexel((int) flu + 1, width, desc_.addressU);
+	const int y0 = addressTexel((int) flv, height, desc_.addressV), y1 = addressTexel((int) flv + 1, height, desc_.addressV);
+	float t00[4], t10[4], t01[4], t11[4];
+	texture.load(x0, y0, t00);
+	texture.load(x1, y0, t10);
+	texture.load(x0, y1, t01);
+	texture.load(x1, y1, t11);
+	for (int c = 0; c < 4; c++) {
+		const float top = t00[c] + (t10[c] - t00[c]) * wu;
+		const float bottom = t01[c] + (t11[c] - t01[c]) * wu;
+		out[c] = top + (bottom - top) * wv;
+	}
+}
+
+void CpuInputLayout::fetch(const uint8_t *vertex, const uint8_t *instance, float (*out)[4]) const
+{
+	for (size_t i = 0; i < elements_.size(); i++) {
+		out[i][0] = 0.f;
+		out[i][1] = 0.f;
+		out[i][2] = 0.f;
+		out[i][3] = 1.f;
+		const uint8_t *data = elements_[i].perInstance ? instance : vertex;
+		if (!data) {
+			out[i][3] = 0.f;
+			continue;
+		}
+		int count = 0;
+		switch (elements_[i].format) {
+		case FORMAT_R32G32B32A32_FLOAT: count = 4; break;
+		case FORMAT_R32G32B32_FLOAT: count = 3; break;
+		case FORMAT_R32G32_FLOAT: count = 2; break;
+		case FORMAT_R32_FLOAT: count = 1; break;
+		case FORMAT_R32_UINT: {
+			uint32_t value;
+			memcpy(&value, data + elements_[i].offset, sizeof(value));
+			out[i][0] = (float) value;
+			continue;
+		}
+		default: assert(!"unsupported vertex element format"); break;
+		}
+		memcpy(out[i], data + elements_[i].offset, count * sizeof(float));
+	}
+}
+
+// the default sampler state d3d uses for an empty slot
+static SamplerDesc defaultSamplerDesc()
+{
+	SamplerDesc desc;
+	desc.addressU = desc.addressV = desc.addressW = ADDRESS_CLAMP;
+	return desc;
+}
+
+static const CpuSampler& defaultSamplerState()
+{
+	static const CpuSampler sampler (defaultSamplerDesc());
+	return sampler;
+}
+
+void CpuShaderState::sample(int resource, int sampler, float u, float v, float out[4]) const
+{
+	if (!resources[resource]) {
+		out[0] = out[1] = out[2] = out[3] = 0.f;
+		return;
+	}
+	(samplers[sampler] ? *samplers[sampler] : defaultSamplerState()).sample(*resources[resource], u, v, out);
+}
+
+void CpuShaderState::load(int resource, int x, int y, float out[4]) const
+{
+	const CpuTexture *texture = resources[resource];
+	if (!texture || x < 0 || y < 0 || x >= texture->getWidth() || y >= texture->getHeight()) {
+		out[0] = out[1] = out[2] = out[3] = 0.f;
+		return;
+	}
+	texture->load(x, y, out);
+}
+
+void CpuShaderState::getDimensions(int resource, int &width, int &height) const
+{
+	width = resources[resource] ? resources[resource]->getWidth() : 0;
+	height = resources[resource] ? resources[resource]->getHeight() : 0;
+}
+
+void CpuShaderState::store(int uav, int x, int y, const float value[4]) const
+{
+	CpuTexture *texture = uavs[uav];
+	if (texture && x >= 0 && y >= 0 && x < texture->getWidth() && y < texture->getHeight()) {
+		texture->store(x, y, value);
+	}
+}
+
+CpuContext::CpuContext() : numTargets_(0), depth_(0), layout_(0), vertexBuffer_(0), vertexStride_(0), vertexOffset_(0),
+	instanceBuffer_(0), instanceStride_(0), instanceOffset_(0), indexBuffer_(0), indexFormat_(FORMAT_R16_UINT), indexOffset_(0), topology_(TOPOLOGY_TRIANGLELIST)
+{
+	memset(targets_, 0, sizeof(targets_));
+	memset(&viewport_, 0, sizeof(viewport_));
+	memset(shaders_, 0, sizeof(shaders_));
+	memset(state_, 0, sizeof(state_));
+	resetStats();
+}
+
+void CpuContext::setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth)
+{
+	assert(count <= CPU_RENDER_TARGETS);
+	numTargets_ = count;
+	for (unsigned int i = 0; i < count; i++) {
+		targets_[i] = targets ? static_cast<CpuTexture *>(targets[i]) : 0;
+	}
+	depth_ = static_cast<CpuTexture *>(depth);
+}
+
+void CpuContext::setViewport(const Viewport &viewport)
+{
+	viewport_ = viewport;
+}
+
+void CpuContext::setDepthState(RenderDepthState *state)
+{
+	depthState_ = state ? static_cast<CpuDepthState *>(state)->getDesc() : DepthStateDesc();
+}
+
+void CpuContext::clearRenderTarget(RenderTexture *target, const float color[4])
+{
+	static_cast<CpuTexture *>(target)->fill(color);
+}
+
+void CpuContext::clearDepth(RenderTexture *depth, float value)
+{
+	const float texel[4] = { value, 0.f, 0.f, 0.f };
+	static_cast<CpuTexture *>(depth)->fill(texel);
+}
+
+void CpuContext::setShader(SHADER_STAGE stage, RenderShader *shader)
+{
+	assert(!shader || shader->getStage() == stage);
+	shaders_[stage] = static_cast<CpuShader *>(shader);
+}
+
+void CpuContext::setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers)
+{
+	assert(slot + count <= CPU_CONSTANT_SLOTS);
+	for (unsigned int i = 0; i < count; i++) {
+		state_[stage].constantBuffers[slot + i] = buffers ? static_cast<CpuBuffer *>(buffers[i]) : 0;
+		state_[stage].constantOffsets[slot + i] = 0;
+	}
+}
+
+void CpuContext::setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size)
+{
+	assert(slot < CPU_CONSTANT_SLOTS && offset % CONSTANT_RANGE_ALIGNMENT == 0 && size % CONSTANT_RANGE_ALIGNMENT == 0);
+	assert(!buffer || offset + size <= buffer->getDesc().byteWidth);
+	state_[stage].constantBuffers[slot] = static_cast<CpuBuffer *>(buffer);
+	state_[stage].constantOffsets[slot] = offset;
+}
+
+void CpuContext::setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures)
+{
+	assert(slot + count <= CPU_RESOURCE_SLOTS);
+	for (unsigned int i = 0; i < count; i++) {
+		state_[stage].resources[slot + i] = textures ? static_cast<CpuTexture *>(textures[i]) : 0;
+	}
+}
+
+void CpuContext::setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers)
+{
+	assert(slot + count <= CPU_SAMPLER_SLOTS);
+	for (unsigned int i = 0; i < count; i++) {
+		state_[stage].samplers[slot + i] = samplers ? static_cast<CpuSampler *>(samplers[i]) : 0;
+	}
+}
+
+void CpuContext::setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures)
+{
+	assert(slot + count <= CPU_UAV_SLOTS);
+	for (unsigned int i = 0; i < count; i++) {
+		state_[STAGE_COMPUTE].uavs[slot + i] = textures ? static_cast<CpuTexture *>(textures[i]) : 0;
+	}
+}
+
+void CpuContext::setInputLayout(RenderInputLayout *layout)
+{
+	layout_ = static_cast<CpuInputLayout *>(layout);
+}
+
+void CpuContext::setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset)
+{
+	vertexBuffer_ = static_cast<CpuBuffer *>(buffer);
+	vertexStride_ = stride;
+	vertexOffset_ = offset;
+}
+
+void CpuContext::setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset)
+{
+	instanceBuffer_ = static_cast<CpuBuffer *>(buffer);
+	instanceStride_ = stride;
+	instanceOffset_ = offset;
+}
+
+void CpuContext::setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset)
+{
+	indexBuffer_ = static_cast<CpuBuffer *>(buffer);
+	indexFormat_ = format;
+	indexOffset_ = offset;
+}
+
+void CpuContext::setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology)
+{
+	topology_ = topology;
+}
+
+void CpuContext::updateBuffer(RenderBuffer *buffer, const void *data, size_t size)
+{
+	assert(size <= buffer->getDesc().byteWidth);
+	memcpy(static_cast<CpuBuffer *>(buffer)->data(), data, size);
+}
+
+void CpuContext::writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size)
+{
+	assert(offset + size <= buffer->getDesc().byteWidth);
+	memcpy(static_cast<CpuBuffer *>(buffer)->data() + offset, data, size);
+}
+
+void CpuContext::copyTexture(RenderTexture *dst, RenderTexture *src)
+{
+	static_cast<CpuTexture *>(dst)->copy(*static_cast<CpuTexture *>(src));
+}
+
+void CpuContext::generateMips(RenderTexture *)
+{
+	// level 0 only, see the note in cpudevice.h
+}
+
+void CpuContext::resetStats()
+{
+	memset(&stats_, 0, sizeof(stats_));
+}
+
+const CpuContext::ClipVert& CpuContext::clipVert(uint32_t index) const
+{
+	return index < clipVerts_.size() ? clipVerts_[index] : clippedVerts_[index - clipVerts_.size()];
+}
+
+// signed distances to the clip planes, inside is >= 0
+static void clipDistances(const float pos[4], float d[6])
+{
+	d[0] = pos[2];
+	d[1] = pos[3] - pos[2];
+	d[2] = GUARD_BAND * pos[3] - pos[0];
+	d[3] = GUARD_BAND * pos[3] + pos[0];
+	d[4] = GUARD_BAND * pos[3] - pos[1];
+	d[5] = GUARD_BAND * pos[3] + pos[1];
+}
+
+/*static*/ int CpuContext::ClipPolygon(const ClipVert *in, int count, ClipVert *out, int numVaryings)
+{
+	// sutherland-hodgman against one plane after the other, a triangle grows to at most 9 vertices
+	ClipVert buffers[2][9];
+	const ClipVert *src = in;
+	for (int plane = 0; plane < 6 && count > 0; plane++) {
+		ClipVert *dst = plane == 5 ? out : buffers[plane & 1];
+		int written = 0;
+		for (int i = 0; i < count; i++) {
+			const ClipVert &a = src[i], &b = src[(i + 1) % count];
+			float da[6], db[6];
+			clipDistances(a.pos, da);
+			clipDistances(b.pos, db);
+			if (da[plane] >= 0.f) {
+				dst[written++] = a;
+			}
+			if ((da[plane] >= 0.f) != (db[plane] >= 0.f)) {
+				const float t = da[plane] / (da[plane] - db[plane]);
+				ClipVert &v = dst[written++];
+				for (int c = 0; c < 4; c++) {
+					v.pos[c] = a.pos[c] + (b.pos[c] - a.pos[c]) * t;
+				}
+				for (int c = 0; c < numVaryings; c++) {
+					v.varyings[c] = a.varyings[c] + (b.varyings[c] - a.varyings[c]) * t;
+				}
+			}
+		}
+		count = written;
+		src = dst;
+	}
+	return count;
+}
+
+bool CpuContext::setupTriangle(const ClipVert &v0, const ClipVert &v1, const ClipVert &v2, int width, int height, Triangle &tri) const
+{
+	const ClipVert *v[3] = { &v0, &v1, &v2 };
+	int64_t fx[3], fy[3];
+	for (int i = 0; i < 3; i++) {
+		if (v[i]->pos[3] <= 0.f) {
+			return false;
+		}
+		const float invW = 1.f / v[i]->pos[3];
+		const float sx = viewport_.x + (v[i]->pos[0] * invW * 0.5f + 0.5f) * viewport_.width;
+		const float sy = viewport_.y + (0.5f - v[i]->pos[1] * invW * 0.5f) * viewport_.height;
+		// snapped to the fixed point grid, rounding to nearest even
+		fx[i] = (int64_t) nearbyintf(sx * SUBPIXEL_ONE);
+		fy[i] = (int64_t) nearbyintf(sy * SUBPIXEL_ONE);
+		tri.z[i] = viewport_.minDepth + v[i]->pos[2] * invW * (viewport_.maxDepth - viewport_.minDepth);
+		tri.invW[i] = invW;
+		tri.varyings[i] = v[i]->varyings;
+	}
+	// with y pointing down, clockwise on screen is a positive area: back faces and degenerate triangles are culled
+	const int64_t area = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fx[2] - fx[0]) * (fy[1] - fy[0]);
+	if (area <= 0) {
+		return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		const int a = (i + 1) % 3, b = (i + 2) % 3;
+		tri.edgeA[i] = fy[a] - fy[b];
+		tri.edgeB[i] = fx[b] - fx[a];
+		tri.edgeC[i] = -(tri.edgeA[i] * fx[a] + tri.edgeB[i] * fy[a]);
+		// top edges are horizontal going right, left edges go up (clockwise winding, y down)
+		const bool topLeft = (tri.edgeA[i] == 0 && tri.edgeB[i] > 0) || tri.edgeA[i] > 0;
+		tri.edgeMin[i] = topLeft ? 0 : 1;
+	}
+	tri.invArea = 1.f / (float) area;
+
+	// pixels whose centers fall inside the bounds, within the viewport and the targets
+	const int64_t minFX = std::min(fx[0], std::min(fx[1], fx[2])), maxFX = std::max(fx[0], std::max(fx[1], fx[2]));
+	const int64_t minFY = std::min(fy[0], std::min(fy[1], fy[2])), maxFY = std::max(fy[0], std::max(fy[1], fy[2]));
+	const int vpX0 = std::max((int) ceilf(viewport_.x), 0), vpY0 = std::max((int) ceilf(viewport_.y), 0);
+	const int vpX1 = std::min((int) floorf(viewport_.x + viewport_.width), width);
+	const int vpY1 = std::min((int) floorf(viewport_.y + viewport_.height), height);
+	tri.minX = std::max((int) ((minFX - SUBPIXEL_HALF + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS), vpX0);
+	tri.minY = std::max((int) ((minFY - SUBPIXEL_HALF + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS), vpY0);
+	tri.maxX = std::min((int) ((maxFX - SUBPIXEL_HALF) >> SUBPIXEL_BITS), vpX1 - 1);
+	tri.maxY = std::min((int) ((maxFY - SUBPIXEL_HALF) >> SUBPIXEL_BITS), vpY1 - 1);
+	return tri.minX <= tri.maxX && tri.minY <= tri.maxY;
+}
+
+static bool depthPasses(RENDER_COMPARISON func, float incoming, float stored)
+{
+	switch (func) {
+	case COMPARISON_NEVER: return false;
+	case COMPARISON_LESS: return incoming < stored;
+	case COMPARISON_EQUAL: return incoming == stored;
+	case COMPARISON_LESS_EQUAL: return incoming <= stored;
+	case COMPARISON_GREATER: return incoming > stored;
+	case COMPARISON_NOT_EQUAL: return incoming != stored;
+	case COMPARISON_GREATER_EQUAL: return incoming >= stored;
+	default: return true;
+	}
+}
+
+uint64_t CpuContext::rasterizeRows(int y0, int y1, int numVaryings)
+{
+	const CpuPixelMain pixelMain = shaders_[STAGE_PIXEL] ? shaders_[STAGE_PIXEL]->getProgram().pixelMain : 0;
+	const CpuShaderState &state = state_[STAGE_PIXEL];
+	const bool depthTest = depth_ && depthState_.depthEnable;
+	const bool depthWrite = depthTest && depthState_.depthWrite;
+	const RENDER_FORMAT depthFormat = depth_ ? depth_->getDesc().format : FORMAT_UNKNOWN;
+	uint64_t shaded = 0;
+
+	float varyings[CPU_MAX_VARYINGS];
+	float outputs[CPU_RENDER_TARGETS][4];
+	for (size_t t = 0; t < triangles_.size(); t++) {
+		const Triangle &tri = triangles_[t];
+		const int ty0 = std::max(tri.minY, y0), ty1 = std::min(tri.maxY, y1 - 1);
+		for (int y = ty0; y <= ty1; y++) {
+			const int64_t px = (int64_t) tri.minX * SUBPIXEL_ONE + SUBPIXEL_HALF;
+			const int64_t py = (int64_t) y * SUBPIXEL_ONE + SUBPIXEL_HALF;
+			int64_t e[3];
+			for (int i = 0; i < 3; i++) {
+				e[i] = tri.edgeA[i] * px + tri.edgeB[i] * py + tri.edgeC[i];
+			}
+			for (int x = tri.minX; x <= tri.maxX; x++, e[0] += tri.edgeA[0] * SUBPIXEL_ONE, e[1] += tri.edgeA[1] * SUBPIXEL_ONE,
+				e[2] += tri.edgeA[2] * SUBPIXEL_ONE) {
+				if (e[0] < tri.edgeMin[0] || e[1] < tri.edgeMin[1] || e[2] < tri.edgeMin[2]) {
+					continue;
+				}
+				const float b0 = (float) e[0] * tri.invArea, b1 = (float) e[1] * tri.invArea, b2 = (float) e[2] * tri.invArea;
+				float z = b0 * tri.z[0] + b1 * tri.z[1] + b2 * tri.z[2];
+				z = std::min(std::max(z, viewport_.minDepth), viewport_.maxDepth);
+				float storedDepth = z;
+				if (depthTest) {
+					// the incoming depth is converted to the buffer's format before the comparison
+					storedDepth = CpuTexture::Quantize(depthFormat, z);
+					if (!depthPasses(depthState_.depthFunc, storedDepth, depth_->texel(x, y)[0])) {
+						continue;
+					}
+				}
+				if (pixelMain) {
+					// perspective correct interpolation
+					const float w0 = b0 * tri.invW[0], w1 = b1 * tri.invW[1], w2 = b2 * tri.invW[2];
+					const float w = 1.f / (w0 + w1 + w2);
+					for (int c = 0; c < numVaryings; c++) {
+						varyings[c] = (w0 * tri.varyings[0][c] + w1 * tri.varyings[1][c] + w2 * tri.varyings[2][c]) * w;
+					}
+					const float position[4] = { x + 0.5f, y + 0.5f, z, w };
+					pixelMain(state, position, varyings, outputs);
+					for (unsigned int i = 0; i < numTargets_; i++) {
+						if (targets_[i]) {
+							targets_[i]->store(x, y, outputs[i]);
+						}
+					}
+					shaded++;
+				}
+				if (depthWrite) {
+					depth_->texel(x, y)[0] = storedDepth;
+				}
+			}
+		}
+	}
+	return shaded;
+}
+
+void CpuContext::drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	drawIndexedInstanced(indexCount, 1, startIndex, baseVertex, 0);
+}
+
+void CpuContext::drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	const CpuShader *vs = shaders_[STAGE_VERTEX];
+	if (!vs || !vs->getProgram().vertexMain || !layout_ || !vertexBuffer_ || !indexBuffer_ || indexCount == 0 || instanceCount == 0) {
+		return;
+	}
+	stats_.draws++;
+	// every instance goes through the whole pipeline in order, like the gpu keeps them in order
+	const size_t instanceBytes = instanceBuffer_ ? instanceBuffer_->getDesc().byteWidth - instanceOffset_ : 0;
+	for (unsigned int i = 0; i < instanceCount; i++) {
+		const size_t offset = (size_t) (startInstance + i) * instanceStride_;
+		// out of range instances read as 0 like out of range vertices
+		const uint8_t *instance = instanceBuffer_ && offset + instanceStride_ <= instanceBytes ? instanceBuffer_->data() + instanceOffset_ + offset : 0;
+		drawInstance(indexCount, startIndex, baseVertex, instance);
+	}
+}
+
+void CpuContext::drawInstance(unsigned int indexCount, unsigned int startIndex, int baseVertex, const uint8_t *instance)
+{
+	const CpuShader *vs = shaders_[STAGE_VERTEX];
+
+	// fetch the indices
+	const int indexSize = indexFormat_ == FORMAT_R8_UINT ? 1 : (indexFormat_ == FORMAT_R16_UINT ? 2 : 4);
+	const uint8_t *indexData = indexBuffer_->data() + indexOffset_ + (size_t) startIndex * indexSize;
+	assert(indexOffset_ + (size_t) (startIndex + indexCount) * indexSize <= indexBuffer_->getDesc().byteWidth);
+	indices_.resize(indexCount);
+	uint32_t minIndex = 0xffffffff, maxIndex = 0;
+	for (unsigned int i = 0; i < indexCount; i++) {
+		uint32_t index;
+		if (indexSize == 1) {
+			index = indexData[i];
+		} else if (indexSize == 2) {
+			uint16_t index16;
+			memcpy(&index16, indexData + 2 * i, 2);
+			index = index16;
+		} else {
+			memcpy(&index, indexData + 4 * i, 4);
+		}
+		index += baseVertex;
+		indices_[i] = index;
+		minIndex = std::min(minIndex, index);
+		maxIndex = std::max(maxIndex, index);
+	}
+
+	// shade the referenced range of vertices, indices are rebased to it
+	const CpuShaderProgram &program = vs->getProgram();
+	const int numVaryings = program.numVaryings;
+	assert(numVaryings <= CPU_MAX_VARYINGS);
+	const uint32_t vertexCount = maxIndex - minIndex + 1;
+	clipVerts_.resize(vertexCount);
+	const CpuShaderState &vsState = state_[STAGE_VERTEX];
+	const uint8_t *vertexData = vertexBuffer_->data() + vertexOffset_;
+	const size_t vertexBytes = vertexBuffer_->getDesc().byteWidth - vertexOffset_;
+	parallelFor(0, (int) vertexCount, 256, [&](int begin, int end) {
+		float input[CPU_VERTEX_ELEMENTS][4];
+		for (int i = begin; i < end; i++) {
+			const size_t offset = (size_t) (minIndex + i) * vertexStride_;
+			if (offset + vertexStride_ <= vertexBytes) {
+				layout_->fetch(vertexData + offset, instance, input);
+			} else {
+				// out of range vertices read as 0 like in d3d
+				memset(input, 0, sizeof(input));
+			}
+			ClipVert &out = clipVerts_[i];
+			program.vertexMain(vsState, input, out.pos, out.varyings);
+		}
+	});
+	stats_.verticesShaded += vertexCount;
+
+	// assemble and clip, whatever crosses near, far or the guard band is cut into a fan of new triangles
+	clippedVerts_.clear();
+	clippedTris_.clear();
+	const unsigned int triangleCount = topology_ == TOPOLOGY_TRIANGLESTRIP ? (indexCount >= 3 ? indexCount - 2 : 0) : indexCount / 3;
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		uint32_t tri[3];
+		if (topology_ == TOPOLOGY_TRIANGLESTRIP) {
+			// every other strip triangle is flipped to keep the winding
+			tri[0] = indices_[t + (t & 1)] - minIndex;
+			tri[1] = indices_[t + 1 - (t & 1)] - minIndex;
+			tri[2] = indices_[t + 2] - minIndex;
+		} else {
+			tri[0] = indices_[3 * t] - minIndex;
+			tri[1] = indices_[3 * t + 1] - minIndex;
+			tri[2] = indices_[3 * t + 2] - minIndex;
+		}
+		bool inside = true;
+		for (int i = 0; i < 3 && inside; i++) {
+			float d[6];
+			clipDistances(clipVerts_[tri[i]].pos, d);
+			inside = d[0] >= 0.f && d[1] >= 0.f && d[2] >= 0.f && d[3] >= 0.f && d[4] >= 0.f && d[5] >= 0.f;
+		}
+		if (inside) {
+			clippedTris_.insert(clippedTris_.end(), tri, tri + 3);
+			continue;
+		}
+		ClipVert polygon[3], clipped[9];
+		for (int i = 0; i < 3; i++) {
+			polygon[i] = clipVerts_[tri[i]];
+		}
+		const int count = ClipPolygon(polygon, 3, clipped, numVaryings);
+		const uint32_t first = (uint32_t) (clipVerts_.size() + clippedVerts_.size());
+		clippedVerts_.insert(clippedVerts_.end(), clipped, clipped + count);
+		for (int i = 1; i + 1 < count; i++) {
+			clippedTris_.push_back(first);
+			clippedTris_.push_back(first + i);
+			clippedTris_.push_back(first + i + 1);
+		}
+	}
+
+	// triangle setup, then every band of rows rasterizes the triangles in draw order
+	int width = 1 << 30, height = 1 << 30;
+	for (unsigned int i = 0; i < numTargets_; i++) {
+		if (targets_[i]) {
+			width = std::min(width, targets_[i]->getWidth());
+			height = std::min(height, targets_[i]->getHeight());
+		}
+	}
+	if (depth_) {
+		width = std::min(width, depth_->getWidth());
+		height = std::min(height, depth_->getHeight());
+	}
+	if (width == 1 << 30) {
+		return;
+	}
+	triangles_.clear();
+	for (size_t i = 0; i < clippedTris_.size(); i += 3) {
+		Triangle tri;
+		if (setupTriangle(clipVert(clippedTris_[i]), clipVert(clippedTris_[i + 1]), clipVert(clippedTris_[i + 2]), width, height, tri)) {
+			triangles_.push_back(tri);
+		}
+	}
+	stats_.trianglesRasterized += triangles_.size();
+
+	std::atomic<uint64_t> shaded (0);
+	const int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+	parallelFor(0, bands, 1, [&](int begin, int end) {
+		for (int band = begin; band < end; band++) {
+			shaded += rasterizeRows(band * BAND_ROWS, std::min((band + 1) * BAND_ROWS, height), numVaryings);
+		}
+	});
+	stats_.pixelsShaded += shaded;
+}
+
+void CpuContext::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
+{
+	const CpuShader *cs = shaders_[STAGE_COMPUTE];
+	if (!cs || !cs->getProgram().computeMain) {
+		return;
+	}
+	stats_.dispatches++;
+	const CpuComputeMain computeMain = cs->getProgram().computeMain;
+	const CpuShaderState &state = state_[STAGE_COMPUTE];
+	// groups can't synchronize with each other, so they run in any order
+	const int total = (int) (groupsX * groupsY * groupsZ);
+	parallelFor(0, total, 1, [&](int begin, int end) {
+		for (int g = begin; g < end; g++) {
+			const unsigned int group[3] = { g % groupsX, (g / groupsX) % groupsY, g / (groupsX * groupsY) };
+			computeMain(state, group);
+		}
+	});
+	stats_.computeGroups += total;
+}
+
+CpuDevice::CpuDevice(unsigned int width, unsigned int height) : cache_(context_), backbuffer_(0), depthbuffer_(0),
+	lastfence_(0), completedfence_(0), fencelatency_(0), fencewaits_(0)
+{
+	resizeBackBuffer(width, height);
+}
+
+CpuDevice::~CpuDevice()
+{
+	delete backbuffer_;
+	delete depthbuffer_;
+}
+
+RenderBuffer* CpuDevice::createBuffer(const BufferDesc &desc, const void *initialData)
+{
+	CpuBuffer *buffer = new CpuBuffer(desc);
+	if (initialData) {
+		memcpy(buffer->data(), initialData, desc.byteWidth);
+	}
+	return buffer;
+}
+
+RenderTexture* CpuDevice::createTexture(const TextureDesc &desc)
+{
+	return new CpuTexture(desc);
+}
+
+RenderTexture* CpuDevice::loadTexture(const wchar_t *)
+{
+	TextureDesc desc;
+	desc.width = 1;
+	desc.height = 1;
+	desc.format = FORMAT_R8G8B8A8_UNORM;
+	desc.bindFlags = BIND_SHADER_RESOURCE;
+	CpuTexture *texture = new CpuTexture(desc);
+	const float white[4] = { 1.f, 1.f, 1.f, 1.f };
+	texture->fill(white);
+	return texture;
+}
+
+RenderSampler* CpuDevice::createSampler(const SamplerDesc &desc)
+{
+	return new CpuSampler(desc);
+}
+
+RenderDepthState* CpuDevice::createDepthState(const DepthStateDesc &desc)
+{
+	return new CpuDepthState(desc);
+}
+
+RenderShader* CpuDevice::createShader(SHADER_STAGE stage, const wchar_t *filename)
+{
+	std::map<std::wstring, CpuShaderProgram>::const_iterator it = programs_.find(filename);
+	if (it == programs_.end()) {
+		printf("no c++ version of shader %ls registered with the cpu device\n", filename); fflush(stdout);
+		return 0;
+	}
+	const CpuShaderProgram &program = it->second;
+	const bool present = (stage == STAGE_VERTEX && program.vertexMain) || (stage == STAGE_PIXEL && program.pixelMain) ||
+		(stage == STAGE_COMPUTE && program.computeMain);
+	if (!present) {
+		printf("c++ version of shader %ls has no entry point for stage %d\n", filename, (int) stage); fflush(stdout);
+		return 0;
+	}
+	return new CpuShader(stage, program);
+}
+
+RenderInputLayout* CpuDevice::createInputLayout(const InputElement *elements, unsigned int count, RenderShader *)
+{
+	if (count > CPU_VERTEX_ELEMENTS) {
+		return 0;
+	}
+	return new CpuInputLayout(elements, count);
+}
+
+uint64_t CpuDevice::signalFence()
+{
+	return ++lastfence_;
+}
+
+uint64_t CpuDevice::getCompletedFence()
+{
+	if (lastfence_ > completedfence_ + fencelatency_) {
+		completedfence_ = lastfence_ - fencelatency_;
+	}
+	return completedfence_;
+}
+
+void CpuDevice::waitForFence(uint64_t fence)
+{
+	assert(fence <= lastfence_);
+	if (getCompletedFence() < fence) {
+		completedfence_ = fence;
+		fencewaits_++;
+	}
+}
+
+void CpuDevice::resizeBackBuffer(unsigned int width, unsigned int height)
+{
+	delete backbuffer_;
+	delete depthbuffer_;
+
+	TextureDesc desc;
+	desc.width = width;
+	desc.height = height;
+	desc.format = FORMAT_R8G8B8A8_UNORM;
+	desc.bindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+	backbuffer_ = new CpuTexture(desc);
+
+	desc.format = FORMAT_D16_UNORM;
+	desc.bindFlags = BIND_DEPTH_STENCIL;
+	depthbuffer_ = new CpuTexture(desc);
+}
+
+void CpuDevice::registerShader(const wchar_t *filename, const CpuShaderProgram &program)
+{
+	programs_[filename] = program;
+}
@@ -0,0 +1,306 @@
+#ifndef CPUDEVICE_H
+#define CPUDEVICE_H
+
+#include "renderdevice.h"
+#include "statecache.h"
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// cpu reference backend of RenderDevice, so frames written against the device run headless (and without windows)
+//
+// draws go through a generic half-space rasterizer following the d3d11 rules the samples rely on: 16.8 fixed point
+// vertices, top-left fill rule, clockwise front faces with back face culling, clipping to 0 <= z <= w, the depth test
+// done with the incoming depth converted to the depth buffer's format, perspective correct attributes
+// the shaders are c++ functions registered per shader file (registerShader), the .hlsl files are never read
+//
+// texels are kept as floats but every write is rounded to the precision of the texture's format, so what the c++
+// shaders read back is what the gpu would have stored (snorm16 normals, d16 depth, unorm8 back buffer)
+//
+// WORKNOTE: this is meant to be correct rather than fast, the dedicated cpu passes (Rasterizer, AmbientOcclusion) are
+// the fast versions of the same work. no msaa, no mips (generateMips is a no-op and sampling reads level 0), no blending
+
+#define CPU_CONSTANT_SLOTS 14
+#define CPU_RESOURCE_SLOTS 16
+#define CPU_SAMPLER_SLOTS 16
+#define CPU_UAV_SLOTS 8
+#define CPU_RENDER_TARGETS 8
+#define CPU_VERTEX_ELEMENTS 16
+// floats a vertex shader can pass on to the pixel shader besides SV_POSITION
+#define CPU_MAX_VARYINGS 16
+
+class CpuBuffer : public RenderBuffer {
+public:
+	CpuBuffer(const BufferDesc &desc) : RenderBuffer(desc), data_(desc.byteWidth) {}
+	virtual ~CpuBuffer() {}
+	uint8_t* data() { return data_.empty() ? 0 : &data_[0]; }
+	const uint8_t* data() const { return data_.empty() ? 0 : &data_[0]; }
+private:
+	std::vector<uint8_t> data_;
+};
+
+class CpuTexture : public RenderTexture {
+public:
+	CpuTexture(const TextureDesc &desc);
+	virtual ~CpuTexture() {}
+
+	int getWidth() const { return (int) desc_.width; }
+	int getHeight() const { return (int) desc_.height; }
+	// channels of the format, depth formats have one
+	int getChannels() const { return channels_; }
+
+	// reads fill the channels the format lacks from (0, 0, 0, 1), like a shader load
+	void load(int x, int y, float out[4]) const;
+	// rounds value to the format's precision, only the format's channels are used
+	void store(int x, int y, const float value[4]);
+	void fill(const float value[4]);
+	// CopyResource, same size and format
+	void copy(const CpuTexture &src);
+
+	// raw texels, channels floats each, already rounded to the format
+	const float* texel(int x, int y) const { return &texels_[((size_t) y * desc_.width + x) * channels_]; }
+	float* texel(int x, int y) { return &texels_[((size_t) y * desc_.width + x) * channels_]; }
+
+	// the value a texel of this format stores for value
+	static float Quantize(RENDER_FORMAT format, float value);
+	static int GetChannelCount(RENDER_FORMAT format);
+private:
+	int channels_;
+	std::vector<float> texels_;
+};
+
+class CpuSampler : public RenderSampler {
+public:
+	CpuSampler(const SamplerDesc &desc) : desc_(desc) {}
+	virtual ~CpuSampler() {}
+
+	// Texture2D::Sample at level 0
+	void sample(const CpuTexture &texture, float u, float v, float out[4]) const;
+private:
+	SamplerDesc desc_;
+};
+
+class CpuDepthState : public RenderDepthState {
+public:
+	CpuDepthState(const DepthStateDesc &desc) : desc_(desc) {}
+	virtual ~CpuDepthState() {}
+	const DepthStateDesc& getDesc() const { return desc_; }
+private:
+	DepthStateDesc desc_;
+};
+
+class CpuInputLayout : public RenderInputLayout {
+public:
+	CpuInputLayout(const InputElement *elements, unsigned int count) : elements_(elements, elements + count) {}
+	virtual ~CpuInputLayout() {}
+	// element i of the vertex (or for per-instance elements the instance) widened to a float4, in the order of the
+	// layout. uints are converted to their float value, a null instance reads as 0
+	void fetch(const uint8_t *vertex, const uint8_t *instance, float (*out)[4]) const;
+	unsigned int getElementCount() const { return (unsigned int) elements_.size(); }
+private:
+	std::vector<InputElement> elements_;
+};
+
+// what a c++ shader sees of its stage's registers (cbuffer b#, Texture2D t#, SamplerState s#, RWTexture2D u#)
+struct CpuShaderState {
+	const CpuBuffer *constantBuffers[CPU_CONSTANT_SLOTS];
+	// where the cbuffer starts in the buffer, for ranges bound with setConstantBufferRange
+	unsigned int constantOffsets[CPU_CONSTANT_SLOTS];
+	const CpuTexture *resources[CPU_RESOURCE_SLOTS];
+	const CpuSampler *samplers[CPU_SAMPLER_SLOTS];
+	CpuTexture *uavs[CPU_UAV_SLOTS];
+
+	// the cbuffer in slot as the struct the shader declares, matrices in it are column_major like hlsl's default
+	template<typename T>
+	const T& constants(int slot) const { return *(const T *) (constantBuffers[slot]->data() + constantOffsets[slot]); }
+
+	// resource.Sample(sampler, uv)
+	void sample(int resource, int sampler, float u, float v, float out[4]) const;
+	// resource.Load(int3(x, y, 0)), out of bounds reads give 0
+	void load(int resource, int x, int y, float out[4]) const;
+	void getDimensions(int resource, int &width, int &height) const;
+	// uav[int2(x, y)] = value, out of bounds writes are dropped
+	void store(int uav, int x, int y, const float value[4]) const;
+};
+
+// vertex shaders get the elements of the bound input layout (widened to float4 like the input assembler does),
+// write SV_POSITION to position and their other outputs to varyings
+typedef void (*CpuVertexMain)(const CpuShaderState &state, const float (*input)[4], float position[4], float *varyings);
+// pixel shaders get SV_POSITION (pixel center, depth, w) and the perspective correct varyings,
+// and write one float4 per bound render target
+typedef void (*CpuPixelMain)(const CpuShaderState &state, const float position[4], const float *varyings, float (*targets)[4]);
+// compute shaders run a whole thread group per call, groupshared memory is a local array then and
+// GroupMemoryBarrierWithGroupSync the boundary between two loops over the group's threads
+typedef void (*CpuComputeMain)(const CpuShaderState &state, const unsigned int group[3]);
+
+// the c++ side of one shader file, the entry points it doesn't have are 0
+struct CpuShaderProgram {
+	CpuVertexMain vertexMain;
+	int numVaryings;
+	CpuPixelMain pixelMain;
+	CpuComputeMain computeMain;
+};
+
+class CpuShader : public RenderShader {
+public:
+	CpuShader(SHADER_STAGE stage, const CpuShaderProgram &program) : RenderShader(stage), program_(program) {}
+	virtual ~CpuShader() {}
+	const CpuShaderProgram& getProgram() const { return program_; }
+private:
+	CpuShaderProgram program_;
+};
+
+// draw and dispatch counters, reset with resetStats
+struct CpuDeviceStats {
+	uint64_t draws;
+	uint64_t dispatches;
+	uint64_t verticesShaded;
+	uint64_t trianglesRasterized; // after culling and clipping
+	uint64_t pixelsShaded;
+	uint64_t computeGroups;
+};
+
+class CpuContext : public RenderContext {
+public:
+	CpuContext();
+	virtual ~CpuContext() {}
+
+	virtual void setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth);
+	virtual void setViewport(const Viewport &viewport);
+	virtual void setDepthState(RenderDepthState *state);
+	virtual void clearRenderTarget(RenderTexture *target, const float color[4]);
+	virtual void clearDepth(RenderTexture *depth, float value);
+
+	virtual void setShader(SHADER_STAGE stage, RenderShader *shader);
+	virtual void setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers);
+	virtual void setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size);
+	virtual void setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures);
+	virtual void setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers);
+	virtual void setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures);
+
+	virtual void setInputLayout(RenderInputLayout *layout);
+	virtual void setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset);
+	virtual void setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset);
+	virtual void setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset);
+	virtual void setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology);
+
+	virtual void updateBuffer(RenderBuffer *buffer, const void *data, size_t size);
+	virtual void writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size);
+	virtual void copyTexture(RenderTexture *dst, RenderTexture *src);
+	virtual void generateMips(RenderTexture *texture);
+
+	virtual void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	virtual void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	virtual void dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
+
+	const CpuDeviceStats& getStats() const { return stats_; }
+	void resetStats();
+
+private:
+	// clip space vertex with its varyings
+	struct ClipVert {
+		float pos[4];
+		float varyings[CPU_MAX_VARYINGS];
+	};
+
+	// screen space triangle, edges in 16.8 fixed point
+	struct Triangle {
+		// edge i (opposite vertex i) at fixed point position (x, y) is edgeA * x + edgeB * y + edgeC, positive inside,
+		// a pixel is covered when all three reach edgeMin (0 on top and left edges, 1 elsewhere: the top-left rule)
+		int64_t edgeA[3], edgeB[3], edgeC[3];
+		int64_t edgeMin[3];
+		int minX, minY, maxX, maxY;
+		float invArea;
+		float z[3];
+		float invW[3];
+		const float *varyings[3];
+	};
+
+	const ClipVert& clipVert(uint32_t index) const;
+	static int ClipPolygon(const ClipVert *in, int count, ClipVert *out, int numVaryings);
+	bool setupTriangle(const ClipVert &v0, const ClipVert &v1, const ClipVert &v2, int width, int height, Triangle &tri) const;
+	uint64_t rasterizeRows(int y0, int y1, int numVaryings);
+	// one instance of an indexed draw, the whole pipeline
+	void drawInstance(unsigned int indexCount, unsigned int startIndex, int baseVertex, const uint8_t *instance);
+
+	CpuTexture *targets_[CPU_RENDER_TARGETS];
+	unsigned int numTargets_;
+	CpuTexture *depth_;
+	Viewport viewport_;
+	DepthStateDesc depthState_;
+
+	const CpuShader *shaders_[NUM_SHADER_STAGES];
+	CpuShaderState state_[NUM_SHADER_STAGES];
+
+	const CpuInputLayout *layout_;
+	const CpuBuffer *vertexBuffer_;
+	unsigned int vertexStride_, vertexOffset_;
+	const CpuBuffer *instanceBuffer_;
+	unsigned int instanceStride_, instanceOffset_;
+	const CpuBuffer *indexBuffer_;
+	RENDER_FORMAT indexFormat_;
+	unsigned int indexOffset_;
+	PRIMITIVE_TOPOLOGY topology_;
+
+	// vertex shader outputs and triangle setup of the current draw, kept between draws for their memory
+	// clippedTris_ indexes clipVerts_ and, from clipVerts_.size() on, the vertices clipping made in clippedVerts_
+	std::vector<uint32_t> indices_;
+	std::vector<ClipVert> clipVerts_;
+	std::vector<ClipVert> clippedVerts_;
+	std::vector<uint32_t> clippedTris_;
+	std::vector<Triangle> triangles_;
+
+	CpuDeviceStats stats_;
+};
+
+class CpuDevice : public RenderDevice {
+public:
+	// the size of the headless back buffer (R8G8B8A8_UNORM) and its D16 depth buffer
+	CpuDevice(unsigned int width, unsigned int height);
+	virtual ~CpuDevice();
+
+	virtual RenderBuffer* createBuffer(const BufferDesc &desc, const void *initialData);
+	virtual RenderTexture* createTexture(const TextureDesc &desc);
+	// WORKNOTE: there's no image decoder here, files load as a 1x1 white texture (the prepass and ao don't sample them)
+	virtual RenderTexture* loadTexture(const wchar_t *filename);
+	virtual RenderSampler* createSampler(const SamplerDesc &desc);
+	virtual RenderDepthState* createDepthState(const DepthStateDesc &desc);
+	// looks the file up in the registered programs, 0 (with a message) when it or the stage's entry point is missing
+	virtual RenderShader* createShader(SHADER_STAGE stage, const wchar_t *filename);
+	virtual RenderInputLayout* createInputLayout(const InputElement *elements, unsigned int count, RenderShader *vertexShader);
+
+	virtual RenderContext& getContext() { return cache_; }
+	virtual StateCache& getStateCache() { return cache_; }
+	// the context behind the state cache, binds made on it directly need a StateCache::invalidate
+	CpuContext& getCpuContext() { return context_; }
+
+	// everything runs when it's called, so fences complete right away, unless a latency is set: then a fence only
+	// completes once that many more have been signaled (or it's waited for), like a gpu running frames behind
+	virtual uint64_t signalFence();
+	virtual uint64_t getCompletedFence();
+	virtual void waitForFence(uint64_t fence);
+	void setFenceLatency(unsigned int fences) { fencelatency_ = fences; }
+	// waitForFence calls that had to wait
+	unsigned int getFenceWaits() const { return fencewaits_; }
+
+	virtual RenderTexture* getBackBuffer() { return backbuffer_; }
+	virtual RenderTexture* getDepthBuffer() { return depthbuffer_; }
+	void resizeBackBuffer(unsigned int width, unsigned int height);
+
+	// the c++ version of a shader file, under the name the code passes to createShader
+	void registerShader(const wchar_t *filename, const CpuShaderProgram &program);
+
+private:
+	CpuContext context_;
+	StateCache cache_;
+	CpuTexture *backbuffer_;
+	CpuTexture *depthbuffer_;
+	std::map<std::wstring, CpuShaderProgram> programs_;
+
+	uint64_t lastfence_, completedfence_;
+	unsigned int fencelatency_;
+	unsigned int fencewaits_;
+};
+
+#endif // CPUDEVICE_H
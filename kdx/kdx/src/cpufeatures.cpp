@@ -0,0 +1,32 @@
+#include "cpufeatures.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static bool detectAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0, f16c = (info[2] & (1 << 29)) != 0;
+	if (!osxsave || !avx || !f16c || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__)
+	return __builtin_cpu_supports("avx2") != 0 && __builtin_cpu_supports("f16c") != 0;
+#else
+	return false;
+#endif
+}
+
+bool CpuHasAvx2()
+{
+	static const bool supported = detectAvx2();
+	return supported;
+}
@@ -0,0 +1,9 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// runtime checks for the instruction sets the per-file /arch:AVX2 code needs, the rest of kdx has to run on sse2 cpus
+
+// avx2 and f16c (every avx2 cpu has f16c, but it's checked anyway), with the os saving the ymm registers on context switches
+bool CpuHasAvx2();
+
+#endif // CPUFEATURES_H
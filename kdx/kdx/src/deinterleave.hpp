@@ -0,0 +1,58 @@
+#ifndef DEINTERLEAVE_H
+#define DEINTERLEAVE_H
+
+#include "image.hpp"
+#include "parallel.h"
+#include <vector>
+
+// interleaved rendering helpers
+// deinterleave splits an image into factor*factor layers of (size / factor) rounded up, layer i + j * factor holding
+// pixels (x * factor + i, y * factor + j), so a kernel that reads the same layer it writes has coherent taps
+// pixels past the right/bottom border are clamped copies of the last column/row
+
+template<typename T>
+void deinterleave(const Image<T> &src, int factor, std::vector<Image<T> > &layers)
+{
+	const int width = (src.getWidth() + factor - 1) / factor;
+	const int height = (src.getHeight() + factor - 1) / factor;
+	layers.resize(factor * factor);
+	for (size_t i = 0; i < layers.size(); i++) {
+		if (layers[i].getWidth() != width || layers[i].getHeight() != height) {
+			layers[i].resize(width, height);
+		}
+	}
+	// one task per layer row, each reads factor source rows that stay in cache for the factor layers
+	parallelFor(0, height, 4, [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			for (int j = 0; j < factor; j++) {
+				for (int i = 0; i < factor; i++) {
+					T *out = layers[i + j * factor].row(y);
+					for (int x = 0; x < width; x++) {
+						out[x] = src.clampedAt(x * factor + i, y * factor + j);
+					}
+				}
+			}
+		}
+	});
+}
+
+// inverse of deinterleave, dst has to be sized already (the layers don't know the exact original size)
+template<typename T>
+void reinterleave(const std::vector<Image<T> > &layers, int factor, Image<T> &dst)
+{
+	const int width = dst.getWidth();
+	parallelFor(0, dst.getHeight(), 16, [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			const int j = y % factor;
+			T *out = dst.row(y);
+			for (int i = 0; i < factor; i++) {
+				const T *in = layers[i + j * factor].row(y / factor);
+				for (int x = i, lx = 0; x < width; x += factor, lx++) {
+					out[x] = in[lx];
+				}
+			}
+		}
+	});
+}
+
+#endif // DEINTERLEAVE_H
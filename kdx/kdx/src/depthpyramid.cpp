@@ -0,0 +1,131 @@
+#include "depthpyramid.h"
+#include "parallel.h"
+#include <string.h>
+#include <algorithm>
+#include <emmintrin.h>
+
+// output rows handed to a worker at a time
+#define PYRAMID_ROW_GRAIN 16
+
+DepthPyramid::DepthPyramid() : logMaxOffset_(3)
+{
+
+}
+
+DepthPyramid::~DepthPyramid()
+{
+
+}
+
+void DepthPyramid::build(const FloatImage &depth, int maxLevels)
+{
+	int width = depth.getWidth();
+	int height = depth.getHeight();
+	if (base_.getWidth() != width || base_.getHeight() != height) {
+		base_.resize(width, height);
+	}
+	memcpy(base_.data(), depth.data(), depth.getByteSize());
+
+	int levels = 1;
+	while (levels < maxLevels && (width > 1 || height > 1)) {
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+		levels++;
+	}
+	min_.resize(levels - 1);
+	max_.resize(levels - 1);
+	avg_.resize(levels - 1);
+
+	// levels depend on each other, the rows within a level are reduced in parallel
+	for (int i = 0; i < levels - 1; i++) {
+		const FloatImage &minSrc = i == 0 ? base_ : min_[i - 1];
+		const FloatImage &maxSrc = i == 0 ? base_ : max_[i - 1];
+		const FloatImage &avgSrc = i == 0 ? base_ : avg_[i - 1];
+		width = (minSrc.getWidth() + 1) / 2;
+		height = (minSrc.getHeight() + 1) / 2;
+		if (min_[i].getWidth() != width || min_[i].getHeight() != height) {
+			min_[i].resize(width, height);
+			max_[i].resize(width, height);
+			avg_[i].resize(width, height);
+		}
+		reduce(minSrc, maxSrc, avgSrc, min_[i], max_[i], avg_[i]);
+	}
+}
+
+void DepthPyramid::reduce(const FloatImage &minSrc, const FloatImage &maxSrc, const FloatImage &avgSrc,
+	FloatImage &minDst, FloatImage &maxDst, FloatImage &avgDst)
+{
+	const int srcWidth = minSrc.getWidth();
+	const int srcHeight = minSrc.getHeight();
+	const int width = minDst.getWidth();
+	// outputs whose 2x2 footprint is fully inside the source, 4 of them per simd iteration
+	const int inner = srcWidth / 2;
+	const int simdEnd = inner & ~3;
+
+	parallelFor(0, minDst.getHeight(), PYRAMID_ROW_GRAIN, [&](int y0, int y1) {
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		for (int y = y0; y < y1; y++) {
+			// odd sizes repeat the last row/column, so the border texels still cover the whole source
+			const int sy0 = 2 * y;
+			const int sy1 = std::min(2 * y + 1, srcHeight - 1);
+			const float *min0 = minSrc.row(sy0), *min1 = minSrc.row(sy1);
+			const float *max0 = maxSrc.row(sy0), *max1 = maxSrc.row(sy1);
+			const float *avg0 = avgSrc.row(sy0), *avg1 = avgSrc.row(sy1);
+			float *minOut = minDst.row(y);
+			float *maxOut = maxDst.row(y);
+			float *avgOut = avgDst.row(y);
+
+			int x = 0;
+			for (; x < simdEnd; x += 4) {
+				const int sx = 2 * x;
+				// 8 source texels per row, split into the even and odd columns of each 2x2
+				__m128 a = _mm_loadu_ps(min0 + sx), b = _mm_loadu_ps(min0 + sx + 4);
+				__m128 c = _mm_loadu_ps(min1 + sx), d = _mm_loadu_ps(min1 + sx + 4);
+				__m128 top = _mm_min_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+				__m128 bottom = _mm_min_ps(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_ps(minOut + x, _mm_min_ps(top, bottom));
+
+				a = _mm_loadu_ps(max0 + sx); b = _mm_loadu_ps(max0 + sx + 4);
+				c = _mm_loadu_ps(max1 + sx); d = _mm_loadu_ps(max1 + sx + 4);
+				top = _mm_max_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+				bottom = _mm_max_ps(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_ps(maxOut + x, _mm_max_ps(top, bottom));
+
+				a = _mm_loadu_ps(avg0 + sx); b = _mm_loadu_ps(avg0 + sx + 4);
+				c = _mm_loadu_ps(avg1 + sx); d = _mm_loadu_ps(avg1 + sx + 4);
+				top = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+				bottom = _mm_add_ps(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_ps(avgOut + x, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+			}
+			for (; x < width; x++) {
+				const int sx0 = 2 * x;
+				const int sx1 = std::min(2 * x + 1, srcWidth - 1);
+				minOut[x] = std::min(std::min(min0[sx0], min0[sx1]), std::min(min1[sx0], min1[sx1]));
+				maxOut[x] = std::max(std::max(max0[sx0], max0[sx1]), std::max(max1[sx0], max1[sx1]));
+				avgOut[x] = 0.25f * ((avg0[sx0] + avg0[sx1]) + (avg1[sx0] + avg1[sx1]));
+			}
+		}
+	});
+}
+
+const FloatImage& DepthPyramid::getLevel(CHAIN chain, int level) const
+{
+	if (level == 0) {
+		return base_;
+	}
+	switch (chain) {
+	case CHAIN_MIN: return min_[level - 1];
+	case CHAIN_MAX: return max_[level - 1];
+	default: return avg_[level - 1];
+	}
+}
+
+int DepthPyramid::levelForOffset(float pixels) const
+{
+	// floor(log2(pixels)) - logMaxOffset, clamped to the levels we have
+	int level = -logMaxOffset_;
+	for (int offset = (int) pixels; offset > 1; offset >>= 1) {
+		level++;
+	}
+	return std::max(0, std::min(level, getNumLevels() - 1));
+}
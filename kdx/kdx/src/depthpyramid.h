@@ -0,0 +1,51 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include "image.hpp"
+#include <vector>
+
+// hierarchical depth (hi-z) built from the prepass depth
+// every level halves the previous one (rounding up) and keeps the min, max and average of each 2x2 footprint,
+// level 0 is a copy of the source and is shared by all three chains
+//
+// ao kernels read far taps from a coarser level (see levelForOffset) so the taps of neighboring pixels
+// land in the same cache lines, like the mip selection in scalable ambient obscurance
+class DepthPyramid {
+public:
+	enum CHAIN {
+		CHAIN_MIN = 0, // closest depth in the footprint
+		CHAIN_MAX = 1, // farthest depth
+		CHAIN_AVG = 2
+	};
+
+	DepthPyramid();
+	virtual ~DepthPyramid();
+
+	// rebuilds every level from depth, stops at 1x1 or after maxLevels levels (including level 0)
+	void build(const FloatImage &depth, int maxLevels = 6);
+
+	int getNumLevels() const { return (int) min_.size() + 1; }
+	const FloatImage& getLevel(CHAIN chain, int level) const;
+
+	// level a tap offset pixels away from its center pixel should read
+	// offsets below 2^logMaxOffset pixels stay on level 0
+	int levelForOffset(float pixels) const;
+	void setLogMaxOffset(int logMaxOffset) { logMaxOffset_ = logMaxOffset; }
+
+	// depth at full resolution pixel (x, y) read from the given level, clamped to the edges
+	float fetch(CHAIN chain, int level, int x, int y) const
+	{
+		return getLevel(chain, level).clampedAt(x >> level, y >> level);
+	}
+
+private:
+	void reduce(const FloatImage &minSrc, const FloatImage &maxSrc, const FloatImage &avgSrc,
+		FloatImage &minDst, FloatImage &maxDst, FloatImage &avgDst);
+
+	FloatImage base_;
+	// levels 1 and up
+	std::vector<FloatImage> min_, max_, avg_;
+	int logMaxOffset_;
+};
+
+#endif // DEPTHPYRAMID_H
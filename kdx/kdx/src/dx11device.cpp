@@ -0,0 +1,664 @@
+#include "dx11device.h"
+#include "dxbase.h"
+#include <D3DX11.h>
+#include <assert.h>
+#include <stdio.h>
+
+// the most slots a single bind call passes, the samples use a handful
+#define MAX_BIND_SLOTS 16
+// where the ShaderCache keeps the compiled shaders, relative to the working directory like the shader files
+#define SHADER_CACHE_DIRECTORY "shadercache"
+
+Dx11Texture::Dx11Texture(const TextureDesc &desc, ID3D11Texture2D *tex) : RenderTexture(desc), texture(tex), resourceview(0), targetview(0), uav(0), depthview(0)
+{
+
+}
+
+Dx11Texture::~Dx11Texture()
+{
+	if (resourceview) resourceview->Release();
+	if (targetview) targetview->Release();
+	if (uav) uav->Release();
+	if (depthview) depthview->Release();
+	if (texture) texture->Release();
+}
+
+void Dx11Context::setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth)
+{
+	assert(count <= D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT);
+	ID3D11RenderTargetView *views[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+	for (unsigned int i = 0; i < count; i++) {
+		views[i] = targets && targets[i] ? static_cast<Dx11Texture *>(targets[i])->targetview : NULL;
+	}
+	devcon_.OMSetRenderTargets(count, count > 0 ? views : NULL, depth ? static_cast<Dx11Texture *>(depth)->depthview : NULL);
+}
+
+void Dx11Context::setViewport(const Viewport &viewport)
+{
+	D3D11_VIEWPORT vp;
+	vp.TopLeftX = viewport.x;
+	vp.TopLeftY = viewport.y;
+	vp.Width = viewport.width;
+	vp.Height = viewport.height;
+	vp.MinDepth = viewport.minDepth;
+	vp.MaxDepth = viewport.maxDepth;
+	devcon_.RSSetViewports(1, &vp);
+}
+
+void Dx11Context::setDepthState(RenderDepthState *state)
+{
+	devcon_.OMSetDepthStencilState(state ? static_cast<Dx11DepthState *>(state)->get() : NULL, 0);
+}
+
+void Dx11Context::clearRenderTarget(RenderTexture *target, const float color[4])
+{
+	devcon_.ClearRenderTargetView(static_cast<Dx11Texture *>(target)->targetview, color);
+}
+
+void Dx11Context::clearDepth(RenderTexture *depth, float value)
+{
+	devcon_.ClearDepthStencilView(static_cast<Dx11Texture *>(depth)->depthview, D3D11_CLEAR_DEPTH, value, 0);
+}
+
+Dx11Context::Dx11Context(ID3D11DeviceContext &devcon) : devcon_(devcon), devcon1_(0), constantranges_(false), nooverwriteconstants_(false)
+{
+	devcon_.QueryInterface(__uuidof(ID3D11DeviceContext1), (void **) &devcon1_);
+}
+
+Dx11Context::~Dx11Context()
+{
+	if (devcon1_) devcon1_->Release();
+}
+
+void Dx11Context::setOptions(const D3D11_FEATURE_DATA_D3D11_OPTIONS &options)
+{
+	constantranges_ = devcon1_ && options.ConstantBufferOffsetting;
+	nooverwriteconstants_ = options.MapNoOverwriteOnDynamicConstantBuffer != FALSE;
+}
+
+void Dx11Context::setShader(SHADER_STAGE stage, RenderShader *shader)
+{
+	Dx11Shader *dxshader = static_cast<Dx11Shader *>(shader);
+	assert(!shader || shader->getStage() == stage);
+	switch (stage) {
+	case STAGE_VERTEX:
+		devcon_.VSSetShader(dxshader ? dxshader->getVertexShader() : NULL, 0, 0);
+		break;
+	case STAGE_PIXEL:
+		devcon_.PSSetShader(dxshader ? dxshader->getPixelShader() : NULL, 0, 0);
+		break;
+	case STAGE_COMPUTE:
+		devcon_.CSSetShader(dxshader ? dxshader->getComputeShader() : NULL, 0, 0);
+		break;
+	}
+}
+
+void Dx11Context::setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers)
+{
+	assert(count <= MAX_BIND_SLOTS);
+	ID3D11Buffer *dxbuffers[MAX_BIND_SLOTS];
+	for (unsigned int i = 0; i < count; i++) {
+		dxbuffers[i] = buffers && buffers[i] ? static_cast<Dx11Buffer *>(buffers[i])->get() : NULL;
+	}
+	switch (stage) {
+	case STAGE_VERTEX: devcon_.VSSetConstantBuffers(slot, count, dxbuffers); break;
+	case STAGE_PIXEL: devcon_.PSSetConstantBuffers(slot, count, dxbuffers); break;
+	case STAGE_COMPUTE: devcon_.CSSetConstantBuffers(slot, count, dxbuffers); break;
+	}
+}
+
+void Dx11Context::setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size)
+{
+	// WORKNOTE: ranges need the d3d11.1 runtime (windows 8, or 7 with the platform update), DxBase refuses to start without them
+	assert(constantranges_ && offset % CONSTANT_RANGE_ALIGNMENT == 0 && size % CONSTANT_RANGE_ALIGNMENT == 0);
+	if (!constantranges_) {
+		return;
+	}
+	ID3D11Buffer *dxbuffer = buffer ? static_cast<Dx11Buffer *>(buffer)->get() : NULL;
+	// in constants of 16 bytes
+	const UINT first = offset / 16, count = size / 16;
+	switch (stage) {
+	case STAGE_VERTEX: devcon1_->VSSetConstantBuffers1(slot, 1, &dxbuffer, &first, &count); break;
+	case STAGE_PIXEL: devcon1_->PSSetConstantBuffers1(slot, 1, &dxbuffer, &first, &count); break;
+	case STAGE_COMPUTE: devcon1_->CSSetConstantBuffers1(slot, 1, &dxbuffer, &first, &count); break;
+	}
+}
+
+void Dx11Context::setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures)
+{
+	assert(count <= MAX_BIND_SLOTS);
+	ID3D11ShaderResourceView *views[MAX_BIND_SLOTS];
+	for (unsigned int i = 0; i < count; i++) {
+		views[i] = textures && textures[i] ? static_cast<Dx11Texture *>(textures[i])->resourceview : NULL;
+	}
+	switch (stage) {
+	case STAGE_VERTEX: devcon_.VSSetShaderResources(slot, count, views); break;
+	case STAGE_PIXEL: devcon_.PSSetShaderResources(slot, count, views); break;
+	case STAGE_COMPUTE: devcon_.CSSetShaderResources(slot, count, views); break;
+	}
+}
+
+void Dx11Context::setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers)
+{
+	assert(count <= MAX_BIND_SLOTS);
+	ID3D11SamplerState *states[MAX_BIND_SLOTS];
+	for (unsigned int i = 0; i < count; i++) {
+		states[i] = samplers && samplers[i] ? static_cast<Dx11Sampler *>(samplers[i])->get() : NULL;
+	}
+	switch (stage) {
+	case STAGE_VERTEX: devcon_.VSSetSamplers(slot, count, states); break;
+	case STAGE_PIXEL: devcon_.PSSetSamplers(slot, count, states); break;
+	case STAGE_COMPUTE: devcon_.CSSetSamplers(slot, count, states); break;
+	}
+}
+
+void Dx11Context::setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures)
+{
+	assert(count <= MAX_BIND_SLOTS);
+	ID3D11UnorderedAccessView *views[MAX_BIND_SLOTS];
+	for (unsigned int i = 0; i < count; i++) {
+		views[i] = textures && textures[i] ? static_cast<Dx11Texture *>(textures[i])->uav : NULL;
+	}
+	devcon_.CSSetUnorderedAccessViews(slot, count, views, 0);
+}
+
+void Dx11Context::setInputLayout(RenderInputLayout *layout)
+{
+	devcon_.IASetInputLayout(layout ? static_cast<Dx11InputLayout *>(layout)->get() : NULL);
+}
+
+void Dx11Context::setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset)
+{
+	ID3D11Buffer *dxbuffer = buffer ? static_cast<Dx11Buffer *>(buffer)->get() : NULL;
+	devcon_.IASetVertexBuffers(0, 1, &dxbuffer, &stride, &offset);
+}
+
+void Dx11Context::setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset)
+{
+	ID3D11Buffer *dxbuffer = buffer ? static_cast<Dx11Buffer *>(buffer)->get() : NULL;
+	devcon_.IASetVertexBuffers(1, 1, &dxbuffer, &stride, &offset);
+}
+
+void Dx11Context::setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset)
+{
+	devcon_.IASetIndexBuffer(buffer ? static_cast<Dx11Buffer *>(buffer)->get() : NULL, Dx11Device::GetFormat(format), offset);
+}
+
+void Dx11Context::setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology)
+{
+	devcon_.IASetPrimitiveTopology(topology == TOPOLOGY_TRIANGLESTRIP ? D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void Dx11Context::updateBuffer(RenderBuffer *buffer, const void *data, size_t size)
+{
+	ID3D11Buffer *dxbuffer = static_cast<Dx11Buffer *>(buffer)->get();
+	assert(size <= buffer->getDesc().byteWidth);
+	if (buffer->getDesc().usage == USAGE_DYNAMIC) {
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(devcon_.Map(dxbuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+			assert(!"map of a dynamic buffer failed");
+			return;
+		}
+		memcpy(mapped.pData, data, size);
+		devcon_.Unmap(dxbuffer, 0);
+	} else {
+		// WORKNOTE: constant buffers can only be updated as a whole through UpdateSubresource
+		devcon_.UpdateSubresource(dxbuffer, 0, NULL, data, 0, 0);
+	}
+}
+
+void Dx11Context::writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size)
+{
+	Dx11Buffer *dx = static_cast<Dx11Buffer *>(buffer);
+	ID3D11Buffer *dxbuffer = dx->get();
+	const BufferDesc &desc = buffer->getDesc();
+	assert(desc.usage != USAGE_IMMUTABLE && offset + size <= desc.byteWidth);
+	if (desc.usage == USAGE_DEFAULT) {
+		D3D11_BOX box = { (UINT) offset, 0, 0, (UINT) (offset + size), 1, 1 };
+		devcon_.UpdateSubresource(dxbuffer, 0, &box, data, 0, 0);
+		return;
+	}
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if ((desc.bindFlags & BIND_CONSTANT_BUFFER) && !nooverwriteconstants_) {
+		// no overwrite maps of dynamic constant buffers need MapNoOverwriteOnDynamicConstantBuffer, without it the
+		// whole buffer is discarded and written again from its shadow (ranges bound before keep the old contents)
+		if (dx->shadow.size() != desc.byteWidth) {
+			dx->shadow.resize(desc.byteWidth, 0);
+		}
+		memcpy(&dx->shadow[offset], data, size);
+		if (FAILED(devcon_.Map(dxbuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+			assert(!"map of a dynamic constant buffer failed");
+			return;
+		}
+		memcpy(mapped.pData, &dx->shadow[0], dx->shadow.size());
+		devcon_.Unmap(dxbuffer, 0);
+		return;
+	}
+	if (FAILED(devcon_.Map(dxbuffer, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped))) {
+		assert(!"map of a dynamic buffer failed");
+		return;
+	}
+	memcpy((char *) mapped.pData + offset, data, size);
+	devcon_.Unmap(dxbuffer, 0);
+}
+
+void Dx11Context::copyTexture(RenderTexture *dst, RenderTexture *src)
+{
+	devcon_.CopyResource(static_cast<Dx11Texture *>(dst)->texture, static_cast<Dx11Texture *>(src)->texture);
+}
+
+void Dx11Context::generateMips(RenderTexture *texture)
+{
+	devcon_.GenerateMips(static_cast<Dx11Texture *>(texture)->resourceview);
+}
+
+void Dx11Context::drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	devcon_.DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void Dx11Context::drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	devcon_.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void Dx11Context::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
+{
+	devcon_.Dispatch(groupsX, groupsY, groupsZ);
+}
+
+Dx11Device::Dx11Device(ID3D11Device &dev, ID3D11DeviceContext &devcon) : dev_(dev), context_(devcon), cache_(context_),
+	backbuffer_(0), depthbuffer_(0), lastfence_(0), completedfence_(0), shadercompiler_(), shadercache_(shadercompiler_, SHADER_CACHE_DIRECTORY)
+{
+	// the query fails on a d3d11.0 runtime, which has none of them
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory(&options, sizeof(options));
+	dev_.CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	context_.setOptions(options);
+}
+
+Dx11Device::~Dx11Device()
+{
+	delete backbuffer_;
+	delete depthbuffer_;
+	for (size_t i = 0; i < fences_.size(); i++) {
+		fences_[i].second->Release();
+	}
+	for (size_t i = 0; i < freequeries_.size(); i++) {
+		freequeries_[i]->Release();
+	}
+}
+
+uint64_t Dx11Device::signalFence()
+{
+	ID3D11Query *query = 0;
+	if (!freequeries_.empty()) {
+		query = freequeries_.back();
+		freequeries_.pop_back();
+	} else {
+		D3D11_QUERY_DESC desc;
+		desc.Query = D3D11_QUERY_EVENT;
+		desc.MiscFlags = 0;
+		dev_.CreateQuery(&desc, &query);
+	}
+	context_.get().End(query);
+	fences_.push_back(std::make_pair(++lastfence_, query));
+	return lastfence_;
+}
+
+void Dx11Device::pollFences(bool flush)
+{
+	// event queries complete in order, so the first one still pending ends the search
+	while (!fences_.empty()) {
+		BOOL done = FALSE;
+		if (context_.get().GetData(fences_.front().second, &done, sizeof(done), flush ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK || !done) {
+			return;
+		}
+		completedfence_ = fences_.front().first;
+		freequeries_.push_back(fences_.front().second);
+		fences_.pop_front();
+	}
+}
+
+uint64_t Dx11Device::getCompletedFence()
+{
+	pollFences(false);
+	return completedfence_;
+}
+
+void Dx11Device::waitForFence(uint64_t fence)
+{
+	assert(fence <= lastfence_);
+	while (completedfence_ < fence) {
+		pollFences(true);
+	}
+}
+
+RenderBuffer* Dx11Device::createBuffer(const BufferDesc &desc, const void *initialData)
+{
+	D3D11_BUFFER_DESC bufdesc;
+	ZeroMemory(&bufdesc, sizeof(D3D11_BUFFER_DESC));
+	bufdesc.ByteWidth = (UINT) desc.byteWidth;
+	bufdesc.BindFlags = desc.bindFlags;
+	switch (desc.usage) {
+	case USAGE_IMMUTABLE:
+		bufdesc.Usage = D3D11_USAGE_IMMUTABLE;
+		break;
+	case USAGE_DYNAMIC:
+		bufdesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufdesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		break;
+	default:
+		bufdesc.Usage = D3D11_USAGE_DEFAULT;
+		break;
+	}
+
+	D3D11_SUBRESOURCE_DATA subr;
+	ZeroMemory(&subr, sizeof(D3D11_SUBRESOURCE_DATA));
+	subr.pSysMem = initialData;
+
+	ID3D11Buffer *buffer = 0;
+	HRESULT result = dev_.CreateBuffer(&bufdesc, initialData ? &subr : NULL, &buffer);
+	if (FAILED(result)) {
+		return 0;
+	}
+	return new Dx11Buffer(desc, buffer);
+}
+
+RenderTexture* Dx11Device::createTexture(const TextureDesc &desc)
+{
+	const DXGI_FORMAT format = GetFormat(desc.format);
+	const bool depth = (desc.bindFlags & BIND_DEPTH_STENCIL) != 0;
+	const bool multisampled = desc.numSamples > 1;
+
+	D3D11_TEXTURE2D_DESC texdesc;
+	ZeroMemory(&texdesc, sizeof(D3D11_TEXTURE2D_DESC));
+	texdesc.Width = desc.width;
+	texdesc.Height = desc.height;
+	texdesc.MipLevels = desc.mipLevels;
+	texdesc.ArraySize = 1;
+	// WORKNOTE: for depth buffer to be accessible both as depth buffer and shader resource,
+	// it needs to be typeless, with the shader resource view and depth stencil view
+	// each setting their own type params to determine how to interpret the data
+	texdesc.Format = depth && (desc.bindFlags & BIND_SHADER_RESOURCE) ? GetDepthResourceFormat(format) : format;
+	texdesc.SampleDesc.Count = desc.numSamples;
+	texdesc.SampleDesc.Quality = 0;
+	texdesc.Usage = D3D11_USAGE_DEFAULT;
+	texdesc.BindFlags = desc.bindFlags;
+
+	ID3D11Texture2D *texture = 0;
+	if (FAILED(dev_.CreateTexture2D(&texdesc, NULL, &texture))) {
+		return 0;
+	}
+	Dx11Texture *result = new Dx11Texture(desc, texture);
+
+	if (desc.bindFlags & BIND_SHADER_RESOURCE) {
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		ZeroMemory(&srvDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+		srvDesc.Format = depth ? GetShaderResourceViewFormat(format) : format;
+		srvDesc.ViewDimension = multisampled ? D3D11_SRV_DIMENSION_TEXTURE2DMS : D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = desc.mipLevels;
+		dev_.CreateShaderResourceView(texture, &srvDesc, &result->resourceview);
+	}
+	if (desc.bindFlags & BIND_RENDER_TARGET) {
+		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
+		ZeroMemory(&rtvDesc, sizeof(D3D11_RENDER_TARGET_VIEW_DESC));
+		rtvDesc.Format = format;
+		rtvDesc.ViewDimension = multisampled ? D3D11_RTV_DIMENSION_TEXTURE2DMS : D3D11_RTV_DIMENSION_TEXTURE2D;
+		rtvDesc.Texture2D.MipSlice = 0;
+		dev_.CreateRenderTargetView(texture, &rtvDesc, &result->targetview);
+	}
+	if (desc.bindFlags & BIND_UNORDERED_ACCESS) {
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+		ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+		uavDesc.Format = format;
+		uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+		uavDesc.Texture2D.MipSlice = 0;
+		dev_.CreateUnorderedAccessView(texture, &uavDesc, &result->uav);
+	}
+	if (depth) {
+		D3D11_DEPTH_STENCIL_VIEW_DESC targetDesc;
+		ZeroMemory(&targetDesc, sizeof(D3D11_DEPTH_STENCIL_VIEW_DESC));
+		targetDesc.Format = format;
+		targetDesc.ViewDimension = multisampled ? D3D11_DSV_DIMENSION_TEXTURE2DMS : D3D11_DSV_DIMENSION_TEXTURE2D;
+		targetDesc.Texture2D.MipSlice = 0;
+		dev_.CreateDepthStencilView(texture, &targetDesc, &result->depthview);
+	}
+	return result;
+}
+
+RenderTexture* Dx11Device::loadTexture(const wchar_t *filename)
+{
+	ID3D11ShaderResourceView *view = 0;
+	HRESULT result = D3DX11CreateShaderResourceViewFromFile(&dev_, filename, NULL, NULL, &view, NULL);
+	if (FAILED(result)) {
+		return 0;
+	}
+	ID3D11Texture2D *texture = 0;
+	view->GetResource((ID3D11Resource **) &texture);
+	D3D11_TEXTURE2D_DESC texdesc;
+	texture->GetDesc(&texdesc);
+
+	// WORKNOTE: the file's format isn't one of RENDER_FORMAT in general, the view carries the real one
+	TextureDesc desc;
+	desc.width = texdesc.Width;
+	desc.height = texdesc.Height;
+	desc.mipLevels = texdesc.MipLevels;
+	desc.bindFlags = BIND_SHADER_RESOURCE;
+	Dx11Texture *loaded = new Dx11Texture(desc, texture);
+	loaded->resourceview = view;
+	return loaded;
+}
+
+RenderSampler* Dx11Device::createSampler(const SamplerDesc &desc)
+{
+	static const D3D11_TEXTURE_ADDRESS_MODE AddressModes[] = { D3D11_TEXTURE_ADDRESS_WRAP, D3D11_TEXTURE_ADDRESS_MIRROR, D3D11_TEXTURE_ADDRESS_CLAMP };
+	D3D11_SAMPLER_DESC samplerdesc;
+	ZeroMemory(&samplerdesc, sizeof(D3D11_SAMPLER_DESC));
+	samplerdesc.Filter = desc.filter == FILTER_POINT ? D3D11_FILTER_MIN_MAG_MIP_POINT : D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerdesc.AddressU = AddressModes[desc.addressU];
+	samplerdesc.AddressV = AddressModes[desc.addressV];
+	samplerdesc.AddressW = AddressModes[desc.addressW];
+	samplerdesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	samplerdesc.MinLOD = 0;
+	samplerdesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	ID3D11SamplerState *sampler = 0;
+	if (FAILED(dev_.CreateSamplerState(&samplerdesc, &sampler))) {
+		return 0;
+	}
+	return new Dx11Sampler(sampler);
+}
+
+RenderDepthState* Dx11Device::createDepthState(const DepthStateDesc &desc)
+{
+	D3D11_DEPTH_STENCIL_DESC depthdesc;
+	ZeroMemory(&depthdesc, sizeof(D3D11_DEPTH_STENCIL_DESC));
+	depthdesc.DepthEnable = desc.depthEnable;
+	depthdesc.DepthWriteMask = desc.depthWrite ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	// RENDER_COMPARISON is in the order of D3D11_COMPARISON_FUNC, which starts at 1
+	depthdesc.DepthFunc = (D3D11_COMPARISON_FUNC) (desc.depthFunc + 1);
+	depthdesc.StencilEnable = false;
+
+	ID3D11DepthStencilState *state = 0;
+	if (FAILED(dev_.CreateDepthStencilState(&depthdesc, &state))) {
+		return 0;
+	}
+	return new Dx11DepthState(state);
+}
+
+RenderShader* Dx11Device::createShader(SHADER_STAGE stage, const wchar_t *filename)
+{
+	static const char *EntryPoints[NUM_SHADER_STAGES] = { "VertexMain", "PixelMain", "ComputeMain" };
+	static const char *Profiles[NUM_SHADER_STAGES] = { "vs_5_0", "ps_5_0", "cs_5_0" };
+
+	ShaderCompileRequest request;
+	request.filename = filename;
+	request.entryPoint = EntryPoints[stage];
+	request.profile = Profiles[stage];
+	std::vector<uint8_t> bytecode;
+	std::string errors;
+	if (!shadercache_.get(request, bytecode, errors)) {
+		if (!errors.empty()) {
+			OutputShaderErrorMessage(errors);
+		} else {
+			DxBase::ThrowError(L"Missing Shader File");
+		}
+		return 0;
+	}
+
+	ID3D11DeviceChild *shader = 0;
+	HRESULT result = E_FAIL;
+	switch (stage) {
+	case STAGE_VERTEX:
+		result = dev_.CreateVertexShader(&bytecode[0], bytecode.size(), NULL, (ID3D11VertexShader **) &shader);
+		break;
+	case STAGE_PIXEL:
+		result = dev_.CreatePixelShader(&bytecode[0], bytecode.size(), NULL, (ID3D11PixelShader **) &shader);
+		break;
+	case STAGE_COMPUTE:
+		result = dev_.CreateComputeShader(&bytecode[0], bytecode.size(), NULL, (ID3D11ComputeShader **) &shader);
+		break;
+	}
+	if (FAILED(result)) {
+		DxBase::ThrowError(L"shader init failed");
+		return 0;
+	}
+	return new Dx11Shader(stage, bytecode, shader);
+}
+
+RenderInputLayout* Dx11Device::createInputLayout(const InputElement *elements, unsigned int count, RenderShader *vertexShader)
+{
+	assert(count <= D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT);
+	D3D11_INPUT_ELEMENT_DESC ied[D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT];
+	for (unsigned int i = 0; i < count; i++) {
+		ied[i].SemanticName = elements[i].semantic;
+		ied[i].SemanticIndex = elements[i].semanticIndex;
+		ied[i].Format = GetFormat(elements[i].format);
+		ied[i].InputSlot = elements[i].perInstance ? 1 : 0;
+		ied[i].AlignedByteOffset = elements[i].offset;
+		ied[i].InputSlotClass = elements[i].perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		ied[i].InstanceDataStepRate = elements[i].perInstance ? 1 : 0;
+	}
+	const std::vector<uint8_t> &bytecode = static_cast<Dx11Shader *>(vertexShader)->getBytecode();
+	ID3D11InputLayout *layout = 0;
+	if (FAILED(dev_.CreateInputLayout(ied, count, &bytecode[0], bytecode.size(), &layout))) {
+		return 0;
+	}
+	return new Dx11InputLayout(layout);
+}
+
+void Dx11Device::setBackBuffer(ID3D11Texture2D *colortex, ID3D11RenderTargetView *color, ID3D11Texture2D *depthtex, ID3D11DepthStencilView *depth)
+{
+	delete backbuffer_;
+	delete depthbuffer_;
+	backbuffer_ = 0;
+	depthbuffer_ = 0;
+	if (colortex) {
+		D3D11_TEXTURE2D_DESC texdesc;
+		colortex->GetDesc(&texdesc);
+		TextureDesc desc;
+		desc.width = texdesc.Width;
+		desc.height = texdesc.Height;
+		desc.format = FORMAT_R8G8B8A8_UNORM;
+		desc.bindFlags = BIND_RENDER_TARGET;
+		colortex->AddRef();
+		color->AddRef();
+		backbuffer_ = new Dx11Texture(desc, colortex);
+		backbuffer_->targetview = color;
+	}
+	if (depthtex) {
+		D3D11_TEXTURE2D_DESC texdesc;
+		depthtex->GetDesc(&texdesc);
+		TextureDesc desc;
+		desc.width = texdesc.Width;
+		desc.height = texdesc.Height;
+		desc.format = FORMAT_D16_UNORM;
+		desc.bindFlags = BIND_DEPTH_STENCIL;
+		depthtex->AddRef();
+		depth->AddRef();
+		depthbuffer_ = new Dx11Texture(desc, depthtex);
+		depthbuffer_->depthview = depth;
+	}
+}
+
+/*static*/ DXGI_FORMAT Dx11Device::GetFormat(RENDER_FORMAT format)
+{
+	switch (format) {
+	case FORMAT_R32G32B32A32_FLOAT: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case FORMAT_R32G32B32_FLOAT: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case FORMAT_R32G32_FLOAT: return DXGI_FORMAT_R32G32_FLOAT;
+	case FORMAT_R32_FLOAT: return DXGI_FORMAT_R32_FLOAT;
+	case FORMAT_R16G16B16A16_FLOAT: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case FORMAT_R16G16_FLOAT: return DXGI_FORMAT_R16G16_FLOAT;
+	case FORMAT_R16_FLOAT: return DXGI_FORMAT_R16_FLOAT;
+	case FORMAT_R16G16_SNORM: return DXGI_FORMAT_R16G16_SNORM;
+	case FORMAT_R16_UNORM: return DXGI_FORMAT_R16_UNORM;
+	case FORMAT_R8G8B8A8_UNORM: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case FORMAT_R8G8_SNORM: return DXGI_FORMAT_R8G8_SNORM;
+	case FORMAT_R8_UINT: return DXGI_FORMAT_R8_UINT;
+	case FORMAT_R16_UINT: return DXGI_FORMAT_R16_UINT;
+	case FORMAT_R32_UINT: return DXGI_FORMAT_R32_UINT;
+	case FORMAT_D16_UNORM: return DXGI_FORMAT_D16_UNORM;
+	case FORMAT_D24_UNORM_S8_UINT: return DXGI_FORMAT_D24_UNORM_S8_UINT;
+	case FORMAT_D32_FLOAT: return DXGI_FORMAT_D32_FLOAT;
+	default: return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+// functions to convert the depth format into the specific formats for the base resource
+// and the shader resource view (the depth render target just uses the normal depth format)
+// see https://stackoverflow.com/questions/20256815/how-to-check-the-content-of-the-depth-stencil-buffer
+/*static*/ DXGI_FORMAT Dx11Device::GetDepthResourceFormat(DXGI_FORMAT depthformat)
+{
+	DXGI_FORMAT resformat = DXGI_FORMAT_UNKNOWN;
+	switch (depthformat)
+	{
+	case DXGI_FORMAT_D16_UNORM:
+			resformat = DXGI_FORMAT_R16_TYPELESS;
+			break;
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+			resformat = DXGI_FORMAT_R24G8_TYPELESS;
+			break;
+	case DXGI_FORMAT_D32_FLOAT:
+			resformat = DXGI_FORMAT_R32_TYPELESS;
+			break;
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+			resformat = DXGI_FORMAT_R32G8X24_TYPELESS;
+			break;
+	}
+
+	return resformat;
+}
+
+/*static*/ DXGI_FORMAT Dx11Device::GetShaderResourceViewFormat(DXGI_FORMAT depthformat)
+{
+	DXGI_FORMAT srvformat = DXGI_FORMAT_UNKNOWN;
+    switch (depthformat)
+    {
+    case DXGI_FORMAT_D16_UNORM:
+            srvformat = DXGI_FORMAT_R16_UNORM;
+            break;
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+            srvformat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+            break;
+    case DXGI_FORMAT_D32_FLOAT:
+            srvformat = DXGI_FORMAT_R32_FLOAT;
+            break;
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+            srvformat = DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS;
+            break;
+    }
+    return srvformat;
+}
+
+/*static*/ void Dx11Device::OutputShaderErrorMessage(const std::string &errors)
+{
+	FILE *file;
+	fopen_s(&file, "shader_errors.txt", "w");
+	fwrite(errors.c_str(), sizeof(char), errors.size(), file);
+	fclose(file);
+
+	DxBase::ThrowError(L"Error Compiling Shader");
+}
@@ -0,0 +1,177 @@
+#ifndef DX11DEVICE_H
+#define DX11DEVICE_H
+
+#include "dx11shadercompiler.h"
+#include "renderdevice.h"
+#include "shadercache.h"
+#include "statecache.h"
+#include <D3D11.h>
+#include <d3d11_1.h>
+#include <deque>
+#include <vector>
+
+// d3d11 backend of RenderDevice, owned by DxBase, which hands it the swap chain's targets
+
+class Dx11Buffer : public RenderBuffer {
+public:
+	Dx11Buffer(const BufferDesc &desc, ID3D11Buffer *buffer) : RenderBuffer(desc), buffer_(buffer) {}
+	virtual ~Dx11Buffer() { buffer_->Release(); }
+	ID3D11Buffer* get() { return buffer_; }
+	// what writeBuffer wrote to a dynamic constant buffer, when the driver can't map those without discarding
+	std::vector<uint8_t> shadow;
+private:
+	ID3D11Buffer *buffer_;
+};
+
+// a texture with the views its bind flags asked for (null otherwise)
+class Dx11Texture : public RenderTexture {
+public:
+	Dx11Texture(const TextureDesc &desc, ID3D11Texture2D *texture);
+	virtual ~Dx11Texture();
+
+	ID3D11Texture2D *texture;
+	ID3D11ShaderResourceView *resourceview;
+	ID3D11RenderTargetView *targetview;
+	ID3D11UnorderedAccessView *uav;
+	ID3D11DepthStencilView *depthview;
+};
+
+class Dx11Sampler : public RenderSampler {
+public:
+	Dx11Sampler(ID3D11SamplerState *sampler) : sampler_(sampler) {}
+	virtual ~Dx11Sampler() { sampler_->Release(); }
+	ID3D11SamplerState* get() { return sampler_; }
+private:
+	ID3D11SamplerState *sampler_;
+};
+
+class Dx11Shader : public RenderShader {
+public:
+	Dx11Shader(SHADER_STAGE stage, const std::vector<uint8_t> &bytecode, ID3D11DeviceChild *shader) : RenderShader(stage), bytecode_(bytecode), shader_(shader) {}
+	virtual ~Dx11Shader() { shader_->Release(); }
+	const std::vector<uint8_t>& getBytecode() { return bytecode_; }
+	ID3D11VertexShader* getVertexShader() { return (ID3D11VertexShader *) shader_; }
+	ID3D11PixelShader* getPixelShader() { return (ID3D11PixelShader *) shader_; }
+	ID3D11ComputeShader* getComputeShader() { return (ID3D11ComputeShader *) shader_; }
+private:
+	std::vector<uint8_t> bytecode_;
+	ID3D11DeviceChild *shader_;
+};
+
+class Dx11InputLayout : public RenderInputLayout {
+public:
+	Dx11InputLayout(ID3D11InputLayout *layout) : layout_(layout) {}
+	virtual ~Dx11InputLayout() { layout_->Release(); }
+	ID3D11InputLayout* get() { return layout_; }
+private:
+	ID3D11InputLayout *layout_;
+};
+
+class Dx11DepthState : public RenderDepthState {
+public:
+	Dx11DepthState(ID3D11DepthStencilState *state) : state_(state) {}
+	virtual ~Dx11DepthState() { state_->Release(); }
+	ID3D11DepthStencilState* get() { return state_; }
+private:
+	ID3D11DepthStencilState *state_;
+};
+
+class Dx11Context : public RenderContext {
+public:
+	Dx11Context(ID3D11DeviceContext &devcon);
+	virtual ~Dx11Context();
+
+	virtual void setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth);
+	virtual void setViewport(const Viewport &viewport);
+	virtual void setDepthState(RenderDepthState *state);
+	virtual void clearRenderTarget(RenderTexture *target, const float color[4]);
+	virtual void clearDepth(RenderTexture *depth, float value);
+
+	virtual void setShader(SHADER_STAGE stage, RenderShader *shader);
+	virtual void setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers);
+	virtual void setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size);
+	virtual void setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures);
+	virtual void setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers);
+	virtual void setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures);
+
+	virtual void setInputLayout(RenderInputLayout *layout);
+	virtual void setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset);
+	virtual void setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset);
+	virtual void setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset);
+	virtual void setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology);
+
+	virtual void updateBuffer(RenderBuffer *buffer, const void *data, size_t size);
+	virtual void writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size);
+	virtual void copyTexture(RenderTexture *dst, RenderTexture *src);
+	virtual void generateMips(RenderTexture *texture);
+
+	virtual void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	virtual void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	virtual void dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
+
+	ID3D11DeviceContext& get() { return devcon_; }
+	// the d3d11.1 options the device reported, all false on a d3d11.0 runtime
+	void setOptions(const D3D11_FEATURE_DATA_D3D11_OPTIONS &options);
+	bool hasConstantRanges() const { return constantranges_; }
+private:
+	ID3D11DeviceContext &devcon_;
+	// the d3d11.1 interface for constant buffer ranges, null on a d3d11.0 runtime
+	ID3D11DeviceContext1 *devcon1_;
+	bool constantranges_;
+	bool nooverwriteconstants_;
+};
+
+class Dx11Device : public RenderDevice {
+public:
+	Dx11Device(ID3D11Device &dev, ID3D11DeviceContext &devcon);
+	virtual ~Dx11Device();
+
+	virtual RenderBuffer* createBuffer(const BufferDesc &desc, const void *initialData);
+	virtual RenderTexture* createTexture(const TextureDesc &desc);
+	virtual RenderTexture* loadTexture(const wchar_t *filename);
+	virtual RenderSampler* createSampler(const SamplerDesc &desc);
+	virtual RenderDepthState* createDepthState(const DepthStateDesc &desc);
+	virtual RenderShader* createShader(SHADER_STAGE stage, const wchar_t *filename);
+	virtual RenderInputLayout* createInputLayout(const InputElement *elements, unsigned int count, RenderShader *vertexShader);
+
+	virtual RenderContext& getContext() { return cache_; }
+	virtual StateCache& getStateCache() { return cache_; }
+
+	// event queries, one per fence in flight
+	virtual uint64_t signalFence();
+	virtual uint64_t getCompletedFence();
+	virtual void waitForFence(uint64_t fence);
+
+	virtual RenderTexture* getBackBuffer() { return backbuffer_; }
+	virtual RenderTexture* getDepthBuffer() { return depthbuffer_; }
+	// wraps the swap chain's targets (adding a reference to each), all null releases them before a resize
+	void setBackBuffer(ID3D11Texture2D *colortex, ID3D11RenderTargetView *color, ID3D11Texture2D *depthtex, ID3D11DepthStencilView *depth);
+
+	ID3D11Device& get() { return dev_; }
+	// setConstantBufferRange works, which the samples' constant rings need
+	bool hasConstantRanges() const { return context_.hasConstantRanges(); }
+
+	static DXGI_FORMAT GetFormat(RENDER_FORMAT format);
+private:
+	static DXGI_FORMAT GetDepthResourceFormat(DXGI_FORMAT depthformat);
+	static DXGI_FORMAT GetShaderResourceViewFormat(DXGI_FORMAT depthformat);
+	static void OutputShaderErrorMessage(const std::string &errors);
+	// retires the fences whose queries are done, flushing the context first when flush is set
+	void pollFences(bool flush);
+
+	ID3D11Device &dev_;
+	Dx11Context context_;
+	StateCache cache_;
+	Dx11Texture *backbuffer_;
+	Dx11Texture *depthbuffer_;
+
+	uint64_t lastfence_, completedfence_;
+	std::deque<std::pair<uint64_t, ID3D11Query *>> fences_;
+	std::vector<ID3D11Query *> freequeries_;
+
+	// createShader loads the bytecode from here when nothing it's compiled from changed since the last start
+	Dx11ShaderCompiler shadercompiler_;
+	ShaderCache shadercache_;
+};
+
+#endif // DX11DEVICE_H
@@ -0,0 +1,143 @@
+#include "dx11shadercompiler.h"
+#include <D3DX11.h>
+#include <stdio.h>
+#include <map>
+
+// opens each include relative to the directory of the file that includes it like d3dx does, and records the paths it
+// opened them at
+class RecordingInclude : public ID3D10Include {
+public:
+	RecordingInclude(const std::string &directory, std::vector<std::string> &includes) : directory_(directory), includes_(includes) {}
+
+	STDMETHOD(Open)(D3D10_INCLUDE_TYPE type, LPCSTR filename, LPCVOID parent, LPCVOID *data, UINT *bytes)
+	{
+		// parent is the buffer of the including file, null for the shader file itself
+		std::map<const void *, std::string>::const_iterator including = directories_.find(parent);
+		const std::string path = (including == directories_.end() ? directory_ : including->second) + filename;
+		FILE *file = fopen(path.c_str(), "rb");
+		if (!file) {
+			return E_FAIL;
+		}
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		char *buffer = new char[size > 0 ? size : 1];
+		const bool ok = fread(buffer, 1, size, file) == (size_t) size;
+		fclose(file);
+		if (!ok) {
+			delete[] buffer;
+			return E_FAIL;
+		}
+		includes_.push_back(path);
+		const size_t slash = path.find_last_of("/\\");
+		directories_[buffer] = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+		*data = buffer;
+		*bytes = (UINT) size;
+		return S_OK;
+	}
+
+	STDMETHOD(Close)(LPCVOID data)
+	{
+		directories_.erase(data);
+		delete[] (const char *) data;
+		return S_OK;
+	}
+
+private:
+	std::string directory_;
+	std::vector<std::string> &includes_;
+	// the directory of each include that's open, what the includes nested in it are relative to
+	std::map<const void *, std::string> directories_;
+};
+
+static std::string narrow(const std::wstring &wide)
+{
+	const int size = WideCharToMultiByte(CP_ACP, 0, wide.c_str(), -1, NULL, 0, NULL, NULL);
+	if (size <= 1) {
+		return std::string();
+	}
+	std::string result (size - 1, '\0');
+	WideCharToMultiByte(CP_ACP, 0, wide.c_str(), -1, &result[0], size, NULL, NULL);
+	return result;
+}
+
+// the request's defines as d3dx takes them, null terminated
+static void getMacros(const ShaderCompileRequest &request, std::vector<D3D10_SHADER_MACRO> &macros)
+{
+	for (size_t i = 0; i < request.defines.size(); i++) {
+		D3D10_SHADER_MACRO macro = { request.defines[i].name.c_str(), request.defines[i].value.c_str() };
+		macros.push_back(macro);
+	}
+	D3D10_SHADER_MACRO terminator = { NULL, NULL };
+	macros.push_back(terminator);
+}
+
+// takes over the blob
+static void blobToString(ID3D10Blob *blob, std::string &out)
+{
+	if (!blob) {
+		return;
+	}
+	// the messages end in a terminator
+	const char *text = (const char *) blob->GetBufferPointer();
+	const size_t size = blob->GetBufferSize();
+	out.assign(text, size > 0 && text[size - 1] == '\0' ? size - 1 : size);
+	blob->Release();
+}
+
+Dx11ShaderCompiler::Dx11ShaderCompiler()
+{
+
+}
+
+Dx11ShaderCompiler::~Dx11ShaderCompiler()
+{
+
+}
+
+std::string Dx11ShaderCompiler::getVersion() const
+{
+	char version[32];
+	sprintf_s(version, "d3dx11 %d", D3DX11_SDK_VERSION);
+	return version;
+}
+
+bool Dx11ShaderCompiler::preprocess(const ShaderCompileRequest &request, std::string &source, std::vector<std::string> &includes,
+	std::string &errors)
+{
+	const std::string filename = narrow(request.filename);
+	const size_t slash = filename.find_last_of("/\\");
+	RecordingInclude include (slash == std::string::npos ? std::string() : filename.substr(0, slash + 1), includes);
+	std::vector<D3D10_SHADER_MACRO> macros;
+	getMacros(request, macros);
+
+	ID3D10Blob *text = 0;
+	ID3D10Blob *messages = 0;
+	HRESULT result = D3DX11PreprocessShaderFromFile(request.filename.c_str(), &macros[0], &include, NULL, &text, &messages, NULL);
+	// a missing file has no messages
+	blobToString(messages, errors);
+	if (FAILED(result)) {
+		return false;
+	}
+	blobToString(text, source);
+	return true;
+}
+
+bool Dx11ShaderCompiler::compile(const ShaderCompileRequest &request, const std::string &source, std::vector<uint8_t> &bytecode,
+	std::string &errors)
+{
+	// the includes and defines are in the source already
+	const std::string filename = narrow(request.filename);
+	ID3D10Blob *blob = 0;
+	ID3D10Blob *messages = 0;
+	HRESULT result = D3DX11CompileFromMemory(source.c_str(), source.size(), filename.c_str(), NULL, NULL, request.entryPoint.c_str(),
+		request.profile.c_str(), request.flags, 0, NULL, &blob, &messages, NULL);
+	blobToString(messages, errors);
+	if (FAILED(result)) {
+		return false;
+	}
+	const uint8_t *data = (const uint8_t *) blob->GetBufferPointer();
+	bytecode.assign(data, data + blob->GetBufferSize());
+	blob->Release();
+	return true;
+}
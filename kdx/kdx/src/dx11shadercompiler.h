@@ -0,0 +1,19 @@
+#ifndef DX11SHADERCOMPILER_H
+#define DX11SHADERCOMPILER_H
+
+#include "shadercompiler.h"
+
+// the d3dx11 hlsl compiler behind the ShaderCompiler interface, includes are opened relative to the shader file
+class Dx11ShaderCompiler : public ShaderCompiler {
+public:
+	Dx11ShaderCompiler();
+	virtual ~Dx11ShaderCompiler();
+
+	virtual std::string getVersion() const;
+	virtual bool preprocess(const ShaderCompileRequest &request, std::string &source, std::vector<std::string> &includes,
+		std::string &errors);
+	virtual bool compile(const ShaderCompileRequest &request, const std::string &source, std::vector<uint8_t> &bytecode,
+		std::string &errors);
+};
+
+#endif // DX11SHADERCOMPILER_H
@@ -1,5 +1,6 @@
 #include "dxbase.h"
 #include <tchar.h>
+#include <stdlib.h>
 
 DxBase::DxBase(HINSTANCE hInstance, unsigned int width, unsigned int height) : hInstance_(hInstance), width_(width), height_(height)
 {
@@ -405,7 +406,8 @@ long DxBase::OnMouseUpR(DxBase &wnd, HWND hwnd, WPARAM wparam, LPARAM lparam)
 
 void DxBase::useDefaultFramebuffer()
 {
-	devicecontext_->OMSetRenderTargets(1, &backbuffer_, depthbuffer_);
+	RenderTexture *backbuffer = renderdevice_->getBackBuffer();
+	renderdevice_->getContext().setRenderTargets(1, &backbuffer, renderdevice_->getDepthBuffer());
 }
 
 void DxBase::createRenderTargets()
@@ -434,6 +436,7 @@ void DxBase::createRenderTargets()
 	device_->CreateTexture2D(&depthDesc, NULL, &depthbuffertex_);
 	// WORKNOTE: look into depth/stencil state for more complex usage
 	device_->CreateDepthStencilView(depthbuffertex_, NULL, &depthbuffer_);
+	renderdevice_->setBackBuffer(backbuffertex_, backbuffer_, depthbuffertex_, depthbuffer_);
 	// for now, just permanently bind this default depth buffer to output merger
 	// set this render target as the back buffer
 	useDefaultFramebuffer();
@@ -463,6 +466,12 @@ void DxBase::initD3D()
 		NULL, 
 		&devicecontext_);
 
+	renderdevice_ = new Dx11Device(*device_, *devicecontext_);
+	// the constant rings bind ranges of one buffer, there's no whole buffer fallback for them
+	if (!renderdevice_->hasConstantRanges()) {
+		ThrowError(L"Constant buffer offsetting is not supported, it needs the Direct3D 11.1 runtime (Windows 8, or 7 with the platform update)");
+		exit(1);
+	}
 	createRenderTargets();
 }
 
@@ -470,7 +479,8 @@ void DxBase::resizeD3D()
 {
 	// release all existing buffers in the swap chain + the depth buffer
 	// TODO: resizing is messing up the depth buffer
-	devicecontext_->OMSetRenderTargets(0, 0, 0);
+	renderdevice_->getContext().setRenderTargets(0, 0, 0);
+	renderdevice_->setBackBuffer(0, 0, 0, 0);
 	backbuffer_->Release();
 	backbuffertex_->Release();
 	depthbuffer_->Release();
@@ -483,6 +493,7 @@ void DxBase::resizeD3D()
 
 void DxBase::finishD3D()
 {
+	delete renderdevice_;
 	swapchain_->Release();
 	backbuffer_->Release();
 	backbuffertex_->Release();
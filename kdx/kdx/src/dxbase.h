@@ -4,6 +4,7 @@
 #include <Windows.h>
 #include <map>
 #include "utils.h"
+#include "dx11device.h"
 
 #include <D3D11.h>
 #include <D3DX11.h>
@@ -55,7 +56,7 @@ public:
 	typedef long (* MessageHandler)(DxBase &, HWND, WPARAM, LPARAM);
 	MessageHandler addMessageHandler(long message, MessageHandler handler);
 
-	void finishFrame() { swapBuffers(); swapIODeviceBuffers(); }
+	void finishFrame() { swapBuffers(); swapIODeviceBuffers(); renderdevice_->getStateCache().endFrame(); }
 private:
 	void swapBuffers();
 	void swapIODeviceBuffers();
@@ -118,18 +119,21 @@ private:
 	ID3D11RenderTargetView *backbuffer_;
 	ID3D11Texture2D *depthbuffertex_;
 	ID3D11DepthStencilView *depthbuffer_;
+	// the RenderDevice the portable code draws through, wrapping device_ and devicecontext_
+	Dx11Device *renderdevice_;
 
 	void createRenderTargets();
 	void initD3D();
 	void resizeD3D();
 	void finishD3D();
-
-	friend class Framebuffer; // give framebuffer access to swapchain for blits
 public:
 	ID3D11Device& getDevice() { return *device_; }
+	// binds made on the raw context bypass the render device's StateCache, call invalidate on it afterwards
 	ID3D11DeviceContext& getDeviceContext() { return *devicecontext_; }
 	ID3D11RenderTargetView& getBackBuffer() { return *backbuffer_; }
 	ID3D11DepthStencilView& getDepthBuffer() { return *depthbuffer_; }
+	RenderDevice& getRenderDevice() { return *renderdevice_; }
+	RenderContext& getRenderContext() { return renderdevice_->getContext(); }
 	void useDefaultFramebuffer();
 };
 
@@ -1,60 +1,60 @@
 #ifndef FRAMEBUFFER_H
 #define FRAMEBUFFER_H
 
-#include <D3D11.h>
+#include "renderdevice.h"
+#include "targetpool.h"
 #include <vector>
 
-class DxBase;
-struct D3DXCOLOR;
-
 // initialization parameters
 struct FramebufferParams {
-	UINT width, height;
-	UINT numSamples;
-	UINT numMrts;
+	unsigned int width, height;
+	unsigned int numSamples;
+	unsigned int numMrts;
 	bool depthEnable;
-	std::vector<DXGI_FORMAT> colorFormats;
-	DXGI_FORMAT depthFormat;
+	std::vector<RENDER_FORMAT> colorFormats;
+	RENDER_FORMAT depthFormat;
 };
 
 class Framebuffer {
 public:
-	Framebuffer(ID3D11Device &dev, FramebufferParams &params);
+	// with a pool the textures are acquired from it and given back on resize and destruction, so resizing back and
+	// forth (or between framebuffers of the same sizes) doesn't recreate them
+	Framebuffer(RenderDevice &dev, const FramebufferParams &params, RenderTargetPool *pool = 0);
 	virtual ~Framebuffer();
 
 	// for binding as an output framebuffer
-	void use(ID3D11DeviceContext &devcon);
+	void use(RenderContext &context);
 	// for binding as an input shader resource
-	void useColorResources(ID3D11DeviceContext &devcon, UINT slot, UINT count);
-	void useDepthResource(ID3D11DeviceContext &devcon, UINT slot);
+	void useColorResources(RenderContext &context, unsigned int slot, unsigned int count);
+	void useDepthResource(RenderContext &context, unsigned int slot);
 	// for binding as an unordered access view
-	void useColorUAVs(ID3D11DeviceContext &devcon, UINT slot, UINT count);
+	void useColorUAVs(RenderContext &context, unsigned int slot, unsigned int count);
 
 	// WORKNOTE: Blitting using CopyResource is much more limited than glBlitFramebuffer
 	// in terms of compatibility in formats between the source and destination buffers
 	// copying to another framebuffer
-	void blit(ID3D11DeviceContext &devcon, Framebuffer &other);
+	void blit(RenderContext &context, Framebuffer &other);
 	// copying to default framebuffer
-	void blit(DxBase &base);
+	void blit(RenderDevice &dev);
+
+	void resize(RenderDevice &dev, unsigned int width, unsigned int height);
+	void clear(RenderContext &context, const float color[4]);
 
-	void resize(ID3D11Device &dev, UINT width, UINT height);
-	void clear(ID3D11DeviceContext &devcon, const D3DXCOLOR &color);
+	// the textures themselves, for reading back the results on the cpu device
+	RenderTexture* getColorTexture(unsigned int index) { return colortextures_[index]; }
+	RenderTexture* getDepthTexture() { return depthtexture_; }
+	unsigned int getWidth() const { return params_.width; }
+	unsigned int getHeight() const { return params_.height; }
 private:
-	bool init(ID3D11Device &dev);
+	bool init(RenderDevice &dev);
 	void free();
 
-	static DXGI_FORMAT GetDepthResourceFormat(DXGI_FORMAT depthformat);
-	static DXGI_FORMAT GetShaderResourceViewFormat(DXGI_FORMAT depthformat);
-
-	ID3D11Texture2D **colortextures_;
-	ID3D11ShaderResourceView **colorviews_;
-	ID3D11RenderTargetView **colortargets_;
-	ID3D11UnorderedAccessView **coloruavs_;
-
-	ID3D11Texture2D *depthtexture_;
-	ID3D11ShaderResourceView *depthview_;
-	ID3D11DepthStencilView *depthtarget_;
+	// WORKNOTE: the views (render target, shader resource, uav, depth) are part of the device's texture now,
+	// the typeless depth format juggling went with them into Dx11Device
+	std::vector<RenderTexture*> colortextures_;
+	RenderTexture *depthtexture_;
 
 	FramebufferParams params_;
+	RenderTargetPool *pool_;
 };
-#endif // FRAMEBUFFER_H
+#endif // FRAMEBUFFER_H
\ No newline at end of file
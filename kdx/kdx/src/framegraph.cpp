@@ -0,0 +1,366 @@
+#include "framegraph.h"
+#include <assert.h>
+#include <string.h>
+
+static unsigned int idOf(const RenderTexture *texture)
+{
+	return texture ? texture->getId() : 0;
+}
+
+FrameGraphStats::FrameGraphStats() : passes(0), culledPasses(0), textures(0), deviceTextures(0), unbinds(0), clears(0),
+	droppedClears(0), transientBytes(0), sharedTransientBytes(0), missingTextures(0)
+{
+
+}
+
+FrameGraph::FrameGraph(RenderTargetPool &pool) : pool_(pool), optimize_(true), depthid_(0)
+{
+	memset(resourceids_, 0, sizeof(resourceids_));
+	memset(uavids_, 0, sizeof(uavids_));
+	memset(targetids_, 0, sizeof(targetids_));
+}
+
+FrameGraph::~FrameGraph()
+{
+	for (size_t i = 0; i < textures_.size(); i++) {
+		pool_.release(textures_[i].texture);
+	}
+}
+
+/*static*/ bool FrameGraph::SameDesc(const TextureDesc &a, const TextureDesc &b)
+{
+	return a.width == b.width && a.height == b.height && a.mipLevels == b.mipLevels && a.numSamples == b.numSamples &&
+		a.format == b.format && a.bindFlags == b.bindFlags;
+}
+
+void FrameGraph::reset()
+{
+	passes_.clear();
+	resources_.clear();
+}
+
+FrameTexture FrameGraph::createTexture(const char *name, const TextureDesc &desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = 0;
+	resource.output = false;
+	resource.first = resource.last = -1;
+	resource.texture = -1;
+	resources_.push_back(resource);
+	return (FrameTexture) resources_.size();
+}
+
+FrameTexture FrameGraph::importTexture(const char *name, RenderTexture *texture)
+{
+	const FrameTexture handle = createTexture(name, texture->getDesc());
+	resources_[handle - 1].imported = texture;
+	return handle;
+}
+
+void FrameGraph::setOutput(FrameTexture texture)
+{
+	resources_[texture - 1].output = true;
+}
+
+unsigned int FrameGraph::addPass(const char *name, const std::function<void(RenderContext&)> &execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.culled = false;
+	passes_.push_back(pass);
+	return (unsigned int) passes_.size() - 1;
+}
+
+void FrameGraph::addAccess(unsigned int pass, const Access &access)
+{
+	assert(access.texture > 0 && access.texture <= resources_.size());
+	passes_[pass].accesses.push_back(access);
+}
+
+void FrameGraph::readTexture(unsigned int pass, FrameTexture texture, SHADER_STAGE stage, unsigned int slot)
+{
+	assert(slot < FRAME_GRAPH_SLOTS);
+	const Access access = { texture, ACCESS_READ, stage, slot, false, { 0.f, 0.f, 0.f, 0.f }, false };
+	addAccess(pass, access);
+}
+
+void FrameGraph::writeTarget(unsigned int pass, FrameTexture texture, unsigned int slot, const float *clearColor, bool covers)
+{
+	assert(slot < FRAME_GRAPH_TARGETS);
+	Access access = { texture, ACCESS_TARGET, STAGE_PIXEL, slot, clearColor != 0, { 0.f, 0.f, 0.f, 0.f }, covers };
+	if (clearColor) {
+		memcpy(access.clearColor, clearColor, sizeof(access.clearColor));
+	}
+	addAccess(pass, access);
+}
+
+void FrameGraph::writeDepth(unsigned int pass, FrameTexture texture, const float *clearValue)
+{
+	const Access access = { texture, ACCESS_DEPTH, STAGE_PIXEL, 0, clearValue != 0, { clearValue ? *clearValue : 0.f, 0.f, 0.f, 0.f }, false };
+	addAccess(pass, access);
+}
+
+void FrameGraph::writeUav(unsigned int pass, FrameTexture texture, unsigned int slot, bool covers)
+{
+	assert(slot < FRAME_GRAPH_UAV_SLOTS);
+	const Access access = { texture, ACCESS_UAV, STAGE_COMPUTE, slot, false, { 0.f, 0.f, 0.f, 0.f }, covers };
+	addAccess(pass, access);
+}
+
+void FrameGraph::compile()
+{
+	stats_ = FrameGraphStats();
+	stats_.passes = (unsigned int) passes_.size();
+	cull();
+	allocate();
+}
+
+void FrameGraph::cull()
+{
+	// backwards from the outputs: a pass runs if it writes something that is still needed after it, then what it
+	// reads is needed before it. a write that clears or covers ends the need for the earlier contents
+	std::vector<bool> needed (resources_.size());
+	for (size_t i = 0; i < resources_.size(); i++) {
+		needed[i] = resources_[i].output;
+	}
+	for (int p = (int) passes_.size() - 1; p >= 0; p--) {
+		Pass &pass = passes_[p];
+		pass.culled = true;
+		for (size_t a = 0; a < pass.accesses.size(); a++) {
+			const Access &access = pass.accesses[a];
+			if (access.type != ACCESS_READ && (needed[access.texture - 1] || !optimize_)) {
+				pass.culled = false;
+			}
+		}
+		if (pass.culled) {
+			stats_.culledPasses++;
+			continue;
+		}
+		for (size_t a = 0; a < pass.accesses.size(); a++) {
+			const Access &access = pass.accesses[a];
+			if (access.type != ACCESS_READ && (access.clear || access.covers)) {
+				needed[access.texture - 1] = false;
+			}
+		}
+		for (size_t a = 0; a < pass.accesses.size(); a++) {
+			const Access &access = pass.accesses[a];
+			if (access.type == ACCESS_READ) {
+				needed[access.texture - 1] = true;
+			}
+		}
+	}
+}
+
+void FrameGraph::allocate()
+{
+	// lifetimes over the passes that run
+	for (size_t p = 0; p < passes_.size(); p++) {
+		if (passes_[p].culled) {
+			continue;
+		}
+		for (size_t a = 0; a < passes_[p].accesses.size(); a++) {
+			Resource &resource = resources_[passes_[p].accesses[a].texture - 1];
+			resource.first = resource.first < 0 ? (int) p : resource.first;
+			resource.last = (int) p;
+		}
+	}
+
+	// last frame's device textures go back first, so the acquires below get the same ones again
+	for (size_t i = 0; i < textures_.size(); i++) {
+		pool_.release(textures_[i].texture);
+	}
+	textures_.clear();
+
+	// in order of first use, each transient texture takes a device texture with its desc that is free by then,
+	// or a new one from the pool
+	for (size_t p = 0; p < passes_.size(); p++) {
+		for (size_t i = 0; i < resources_.size(); i++) {
+			Resource &resource = resources_[i];
+			if (resource.imported || resource.first != (int) p) {
+				continue;
+			}
+			int found = -1;
+			for (size_t t = 0; t < textures_.size() && found < 0 && optimize_; t++) {
+				if (textures_[t].last < (int) p && SameDesc(textures_[t].texture->getDesc(), resource.desc)) {
+					found = (int) t;
+				}
+			}
+			if (found < 0) {
+				DeviceTexture texture;
+				texture.texture = pool_.acquire(resource.desc);
+				if (!texture.texture) {
+					stats_.missingTextures++;
+					continue;
+				}
+				textures_.push_back(texture);
+				found = (int) textures_.size() - 1;
+				stats_.sharedTransientBytes += textureMemory(resource.desc);
+			}
+			textures_[found].last = resource.last;
+			resource.texture = found;
+			stats_.textures++;
+			stats_.transientBytes += textureMemory(resource.desc);
+		}
+	}
+	stats_.deviceTextures = (unsigned int) textures_.size();
+}
+
+RenderTexture* FrameGraph::getTexture(FrameTexture texture) const
+{
+	if (texture == 0 || texture > resources_.size()) {
+		return 0;
+	}
+	const Resource &resource = resources_[texture - 1];
+	if (resource.imported) {
+		return resource.imported;
+	}
+	return resource.texture >= 0 ? textures_[resource.texture].texture : 0;
+}
+
+void FrameGraph::unbindHazards(RenderContext &context, const Pass &pass)
+{
+	bool bindsTargets = false;
+	for (size_t a = 0; a < pass.accesses.size(); a++) {
+		bindsTargets = bindsTargets || pass.accesses[a].type == ACCESS_TARGET || pass.accesses[a].type == ACCESS_DEPTH;
+	}
+	RenderTexture *const none = 0;
+	bool unbindTargets = false;
+	for (size_t a = 0; a < pass.accesses.size(); a++) {
+		const Access &access = pass.accesses[a];
+		const unsigned int id = idOf(getTexture(access.texture));
+		if (access.type == ACCESS_READ) {
+			// read after a write: out of the uav slots and the render targets
+			for (int slot = 0; slot < FRAME_GRAPH_UAV_SLOTS; slot++) {
+				if (uavids_[slot] == id) {
+					context.setUnorderedAccessViews(slot, 1, &none);
+					uavids_[slot] = 0;
+					stats_.unbinds++;
+				}
+			}
+			for (int slot = 0; slot < FRAME_GRAPH_TARGETS; slot++) {
+				unbindTargets = unbindTargets || targetids_[slot] == id;
+			}
+			unbindTargets = unbindTargets || depthid_ == id;
+			continue;
+		}
+		// write after a read: out of every shader resource slot
+		for (int stage = 0; stage < NUM_SHADER_STAGES; stage++) {
+			for (int slot = 0; slot < FRAME_GRAPH_SLOTS; slot++) {
+				if (resourceids_[stage][slot] == id) {
+					context.setShaderResources((SHADER_STAGE) stage, slot, 1, &none);
+					resourceids_[stage][slot] = 0;
+					stats_.unbinds++;
+				}
+			}
+		}
+		// and out of the other kind of output
+		if (access.type == ACCESS_UAV) {
+			for (int slot = 0; slot < FRAME_GRAPH_TARGETS; slot++) {
+				unbindTargets = unbindTargets || targetids_[slot] == id;
+			}
+			unbindTargets = unbindTargets || depthid_ == id;
+			for (int slot = 0; slot < FRAME_GRAPH_UAV_SLOTS; slot++) {
+				if (uavids_[slot] == id && slot != (int) access.slot) {
+					context.setUnorderedAccessViews(slot, 1, &none);
+					uavids_[slot] = 0;
+					stats_.unbinds++;
+				}
+			}
+		} else {
+			for (int slot = 0; slot < FRAME_GRAPH_UAV_SLOTS; slot++) {
+				if (uavids_[slot] == id) {
+					context.setUnorderedAccessViews(slot, 1, &none);
+					uavids_[slot] = 0;
+					stats_.unbinds++;
+				}
+			}
+		}
+	}
+	// a pass with targets of its own replaces the old ones anyway
+	if (unbindTargets && !bindsTargets) {
+		context.setRenderTargets(0, 0, 0);
+		memset(targetids_, 0, sizeof(targetids_));
+		depthid_ = 0;
+		stats_.unbinds++;
+	}
+}
+
+void FrameGraph::execute(RenderContext &context)
+{
+	for (size_t p = 0; p < passes_.size(); p++) {
+		const Pass &pass = passes_[p];
+		if (pass.culled) {
+			continue;
+		}
+		bool complete = true;
+		for (size_t a = 0; a < pass.accesses.size() && complete; a++) {
+			complete = getTexture(pass.accesses[a].texture) != 0;
+		}
+		if (!complete) {
+			continue;
+		}
+		unbindHazards(context, pass);
+
+		// output merger
+		RenderTexture *targets[FRAME_GRAPH_TARGETS] = {};
+		RenderTexture *depth = 0;
+		unsigned int numTargets = 0;
+		bool bindsTargets = false;
+		for (size_t a = 0; a < pass.accesses.size(); a++) {
+			const Access &access = pass.accesses[a];
+			if (access.type == ACCESS_TARGET) {
+				targets[access.slot] = getTexture(access.texture);
+				numTargets = access.slot + 1 > numTargets ? access.slot + 1 : numTargets;
+				bindsTargets = true;
+			} else if (access.type == ACCESS_DEPTH) {
+				depth = getTexture(access.texture);
+				bindsTargets = true;
+			}
+		}
+		if (bindsTargets) {
+			context.setRenderTargets(numTargets, targets, depth);
+			for (int slot = 0; slot < FRAME_GRAPH_TARGETS; slot++) {
+				targetids_[slot] = idOf(targets[slot]);
+			}
+			depthid_ = idOf(depth);
+			const TextureDesc &desc = (numTargets > 0 ? targets[0] : depth)->getDesc();
+			const Viewport viewport = { 0.f, 0.f, (float) desc.width, (float) desc.height, 0.f, 1.f };
+			context.setViewport(viewport);
+		}
+
+		// clears, a covered target gets overwritten anyway
+		for (size_t a = 0; a < pass.accesses.size(); a++) {
+			const Access &access = pass.accesses[a];
+			if (!access.clear) {
+				continue;
+			}
+			if (access.covers && optimize_) {
+				stats_.droppedClears++;
+			} else if (access.type == ACCESS_DEPTH) {
+				context.clearDepth(getTexture(access.texture), access.clearColor[0]);
+				stats_.clears++;
+			} else {
+				context.clearRenderTarget(getTexture(access.texture), access.clearColor);
+				stats_.clears++;
+			}
+		}
+
+		// inputs and uavs
+		for (size_t a = 0; a < pass.accesses.size(); a++) {
+			const Access &access = pass.accesses[a];
+			RenderTexture *texture = getTexture(access.texture);
+			if (access.type == ACCESS_READ) {
+				context.setShaderResources(access.stage, access.slot, 1, &texture);
+				resourceids_[access.stage][access.slot] = idOf(texture);
+			} else if (access.type == ACCESS_UAV) {
+				context.setUnorderedAccessViews(access.slot, 1, &texture);
+				uavids_[access.slot] = idOf(texture);
+			}
+		}
+
+		pass.execute(context);
+	}
+}
@@ -0,0 +1,151 @@
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+#include "renderdevice.h"
+#include "targetpool.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// a frame written as passes that declare which textures they read and write, rebuilt every frame:
+//   reset, create/import textures, add passes with their reads and writes, compile, execute
+//
+// compile culls the passes nothing that is an output depends on, and places the transient textures: two textures with
+// the same desc whose lifetimes (first to last pass using them) don't overlap share one device texture. the device
+// textures come from a RenderTargetPool and go back to it at the next compile
+// execute binds each pass's targets, viewport, shader resources and uavs before calling it, and unbinds what would
+// be a read/write hazard first (a texture that was an output and is now read, or the other way around), which d3d11
+// otherwise resolves by silently dropping the input bind. a clear of a target the pass covers completely is dropped
+//
+// WORKNOTE: a transient texture that shares its device texture with an earlier one starts out with the earlier one's
+// contents, its first write has to clear it or cover it. binds made outside the graph to its textures aren't seen
+
+// textures of the frame being built, 0 is none
+typedef unsigned int FrameTexture;
+
+// slots the graph binds, per stage for shader resources
+#define FRAME_GRAPH_SLOTS 16
+#define FRAME_GRAPH_UAV_SLOTS 8
+#define FRAME_GRAPH_TARGETS 8
+
+struct FrameGraphStats {
+	FrameGraphStats();
+
+	unsigned int passes, culledPasses;
+	// transient textures of the passes that run, and the device textures behind them
+	unsigned int textures, deviceTextures;
+	// binds the graph removed before a texture went from output to input or back
+	unsigned int unbinds;
+	unsigned int clears, droppedClears;
+	// memory of the transient textures if each had its own, and what they take with sharing
+	size_t transientBytes;
+	size_t sharedTransientBytes;
+	// transient textures the pool couldn't create, the passes using them are skipped
+	unsigned int missingTextures;
+};
+
+class FrameGraph {
+public:
+	FrameGraph(RenderTargetPool &pool);
+	virtual ~FrameGraph();
+
+	// starts describing a new frame, the textures and passes of the last one are dropped
+	void reset();
+
+	// a texture that only lives for this frame, allocated by compile
+	FrameTexture createTexture(const char *name, const TextureDesc &desc);
+	// a texture owned by someone else (the back buffer), it is never shared
+	FrameTexture importTexture(const char *name, RenderTexture *texture);
+	// what the frame is for, passes that contribute to no output are culled
+	void setOutput(FrameTexture texture);
+
+	// passes run in the order they are added. execute sets the shaders, constant buffers and samplers, and draws or
+	// dispatches, everything declared below is bound when it is called
+	unsigned int addPass(const char *name, const std::function<void(RenderContext&)> &execute);
+	void readTexture(unsigned int pass, FrameTexture texture, SHADER_STAGE stage, unsigned int slot);
+	// clearColor can be null to keep the contents. covers says the pass writes every texel, so the earlier contents
+	// (and the clear) don't matter
+	void writeTarget(unsigned int pass, FrameTexture texture, unsigned int slot, const float *clearColor, bool covers);
+	// clearValue can be null to keep the contents
+	void writeDepth(unsigned int pass, FrameTexture texture, const float *clearValue);
+	void writeUav(unsigned int pass, FrameTexture texture, unsigned int slot, bool covers);
+
+	// culls the passes and allocates the transient textures
+	void compile();
+	void execute(RenderContext &context);
+
+	// the device texture behind a handle once compiled, 0 if no pass that runs uses it
+	// it stays valid (and keeps its contents) until the next compile
+	RenderTexture* getTexture(FrameTexture texture) const;
+	unsigned int getPassCount() const { return (unsigned int) passes_.size(); }
+	const char* getPassName(unsigned int pass) const { return passes_[pass].name.c_str(); }
+	bool isCulled(unsigned int pass) const { return passes_[pass].culled; }
+	// counters of the last compile and execute
+	const FrameGraphStats& getStats() const { return stats_; }
+
+	// off runs every pass and clear and gives every texture its own device texture, for checking that culling,
+	// sharing and dropped clears don't change the frame
+	void setOptimize(bool optimize) { optimize_ = optimize; }
+
+private:
+	enum ACCESS {
+		ACCESS_READ = 0,
+		ACCESS_TARGET,
+		ACCESS_DEPTH,
+		ACCESS_UAV
+	};
+	struct Access {
+		FrameTexture texture;
+		ACCESS type;
+		SHADER_STAGE stage;
+		unsigned int slot;
+		bool clear;
+		float clearColor[4];
+		bool covers;
+	};
+	struct Pass {
+		std::string name;
+		std::function<void(RenderContext&)> execute;
+		std::vector<Access> accesses;
+		bool culled;
+	};
+	struct Resource {
+		std::string name;
+		TextureDesc desc;
+		RenderTexture *imported;
+		bool output;
+		// passes of the first and last use, and the index into textures_
+		int first, last;
+		int texture;
+	};
+	struct DeviceTexture {
+		RenderTexture *texture;
+		// last pass of the transient texture that has it so far this frame
+		int last;
+	};
+
+	static bool SameDesc(const TextureDesc &a, const TextureDesc &b);
+	void addAccess(unsigned int pass, const Access &access);
+	void cull();
+	void allocate();
+	// unbinds from the tracked binds whatever the pass is about to use the other way around
+	void unbindHazards(RenderContext &context, const Pass &pass);
+
+	RenderTargetPool &pool_;
+	bool optimize_;
+	std::vector<Pass> passes_;
+	// indexed by FrameTexture - 1
+	std::vector<Resource> resources_;
+	// the device textures behind the transient textures, held until the next compile
+	std::vector<DeviceTexture> textures_;
+
+	// what the graph has bound, by texture id
+	unsigned int resourceids_[NUM_SHADER_STAGES][FRAME_GRAPH_SLOTS];
+	unsigned int uavids_[FRAME_GRAPH_UAV_SLOTS];
+	unsigned int targetids_[FRAME_GRAPH_TARGETS];
+	unsigned int depthid_;
+
+	FrameGraphStats stats_;
+};
+
+#endif // FRAMEGRAPH_H
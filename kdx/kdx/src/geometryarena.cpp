@@ -0,0 +1,289 @@
+#include "geometryarena.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+GeometryArenaStats::GeometryArenaStats() : allocations(0), usedVertices(0), topVertices(0), usedIndices(0), topIndices(0),
+	freeVertexBlocks(0), freeIndexBlocks(0), grows(0), defragments(0), uploaded(0)
+{
+
+}
+
+GeometryArena::GeometryArena(RenderDevice &dev, unsigned int vertexStride, RENDER_FORMAT indexFormat,
+	unsigned int vertexCapacity, unsigned int indexCapacity) : dev_(dev), stride_(vertexStride), indexformat_(indexFormat),
+	indexsize_(formatSize(indexFormat)), vertextop_(0), indextop_(0), vertexbuffer_(0), indexbuffer_(0),
+	vertexdirtybegin_(0), vertexdirtyend_(0), indexdirtybegin_(0), indexdirtyend_(0), grows_(0), defragments_(0), uploaded_(0)
+{
+	assert(indexFormat == FORMAT_R16_UINT || indexFormat == FORMAT_R32_UINT);
+	vertices_.resize((size_t) std::max(vertexCapacity, 1u) * stride_);
+	indices_.resize((size_t) std::max(indexCapacity, 1u) * indexsize_);
+}
+
+GeometryArena::~GeometryArena()
+{
+	delete vertexbuffer_;
+	delete indexbuffer_;
+}
+
+/*static*/ unsigned int GeometryArena::AllocateBlock(std::map<unsigned int, unsigned int> &blocks, unsigned int &top, unsigned int count)
+{
+	if (count == 0) {
+		return 0;
+	}
+	for (std::map<unsigned int, unsigned int>::iterator iter = blocks.begin(); iter != blocks.end(); iter++) {
+		if (iter->second < count) {
+			continue;
+		}
+		const unsigned int offset = iter->first;
+		const unsigned int rest = iter->second - count;
+		blocks.erase(iter);
+		if (rest > 0) {
+			blocks[offset + count] = rest;
+		}
+		return offset;
+	}
+	const unsigned int offset = top;
+	top += count;
+	return offset;
+}
+
+/*static*/ void GeometryArena::FreeBlock(std::map<unsigned int, unsigned int> &blocks, unsigned int &top, unsigned int offset, unsigned int count)
+{
+	if (count == 0) {
+		return;
+	}
+	// merge with the hole after it and the one before it
+	std::map<unsigned int, unsigned int>::iterator next = blocks.find(offset + count);
+	if (next != blocks.end()) {
+		count += next->second;
+		blocks.erase(next);
+	}
+	std::map<unsigned int, unsigned int>::iterator prev = blocks.lower_bound(offset);
+	if (prev != blocks.begin()) {
+		prev--;
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			count += prev->second;
+			blocks.erase(prev);
+		}
+	}
+	// a hole that reaches the top just lowers it
+	if (offset + count == top) {
+		top = offset;
+	} else {
+		blocks[offset] = count;
+	}
+}
+
+/*static*/ void GeometryArena::MarkDirty(size_t &begin, size_t &end, size_t offset, size_t size)
+{
+	if (size == 0) {
+		return;
+	}
+	if (begin == end) {
+		begin = offset;
+		end = offset + size;
+	} else {
+		begin = std::min(begin, offset);
+		end = std::max(end, offset + size);
+	}
+}
+
+unsigned int GeometryArena::allocate(const void *verts, unsigned int vertexCount, unsigned int vertexStride,
+	const void *inds, unsigned int indexCount, RENDER_FORMAT indexFormat)
+{
+	if (vertexStride != stride_) {
+		assert(false && "the mesh's vertices aren't the arena's layout");
+		return GEOMETRY_ARENA_INVALID;
+	}
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	range.baseVertex = AllocateBlock(freevertices_, vertextop_, vertexCount);
+	range.startIndex = AllocateBlock(freeindices_, indextop_, indexCount);
+
+	// double the copies when the top went past them, the buffers follow on the next use
+	if ((size_t) vertextop_ * stride_ > vertices_.size()) {
+		vertices_.resize(std::max(vertices_.size() * 2, (size_t) vertextop_ * stride_));
+	}
+	if ((size_t) indextop_ * indexsize_ > indices_.size()) {
+		indices_.resize(std::max(indices_.size() * 2, (size_t) indextop_ * indexsize_));
+	}
+
+	if (vertexCount > 0) {
+		memcpy(&vertices_[(size_t) range.baseVertex * stride_], verts, (size_t) vertexCount * stride_);
+		MarkDirty(vertexdirtybegin_, vertexdirtyend_, (size_t) range.baseVertex * stride_, (size_t) vertexCount * stride_);
+	}
+	if (indexCount > 0) {
+		const unsigned int sourcesize = formatSize(indexFormat);
+		const uint8_t *source = (const uint8_t *) inds;
+		uint8_t *dest = &indices_[(size_t) range.startIndex * indexsize_];
+		for (unsigned int i = 0; i < indexCount; i++) {
+			uint32_t index;
+			if (sourcesize == 1) {
+				index = source[i];
+			} else if (sourcesize == 2) {
+				index = ((const uint16_t *) source)[i];
+			} else {
+				index = ((const uint32_t *) source)[i];
+			}
+			if (indexsize_ == 2) {
+				assert(index <= 0xffff && "the index doesn't fit the arena's format");
+				((uint16_t *) dest)[i] = (uint16_t) index;
+			} else {
+				((uint32_t *) dest)[i] = index;
+			}
+		}
+		MarkDirty(indexdirtybegin_, indexdirtyend_, (size_t) range.startIndex * indexsize_, (size_t) indexCount * indexsize_);
+	}
+
+	unsigned int handle;
+	if (!freehandles_.empty()) {
+		handle = freehandles_.back();
+		freehandles_.pop_back();
+		ranges_[handle] = range;
+		live_[handle] = true;
+	} else {
+		handle = (unsigned int) ranges_.size();
+		ranges_.push_back(range);
+		live_.push_back(true);
+	}
+	return handle;
+}
+
+void GeometryArena::free(unsigned int allocation)
+{
+	if (allocation >= ranges_.size() || !live_[allocation]) {
+		return;
+	}
+	const GeometryRange &range = ranges_[allocation];
+	FreeBlock(freevertices_, vertextop_, range.baseVertex, range.vertexCount);
+	FreeBlock(freeindices_, indextop_, range.startIndex, range.indexCount);
+	live_[allocation] = false;
+	freehandles_.push_back(allocation);
+}
+
+// orders handles by where their range of one of the buffers starts
+struct GeometryRangeOrder {
+	GeometryRangeOrder(const std::vector<GeometryRange> &ranges, bool indices) : ranges(ranges), indices(indices) {}
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		return indices ? ranges[a].startIndex < ranges[b].startIndex : ranges[a].baseVertex < ranges[b].baseVertex;
+	}
+	const std::vector<GeometryRange> &ranges;
+	bool indices;
+};
+
+unsigned int GeometryArena::defragment()
+{
+	std::vector<unsigned int> handles;
+	for (unsigned int i = 0; i < ranges_.size(); i++) {
+		if (live_[i]) {
+			handles.push_back(i);
+		}
+	}
+	std::vector<bool> moved (ranges_.size(), false);
+
+	// in order of where they are, so every move is down and doesn't overwrite one that hasn't moved yet
+	std::sort(handles.begin(), handles.end(), GeometryRangeOrder(ranges_, false));
+	unsigned int top = 0;
+	for (size_t i = 0; i < handles.size(); i++) {
+		GeometryRange &range = ranges_[handles[i]];
+		if (range.vertexCount == 0) {
+			continue;
+		}
+		if (range.baseVertex != top) {
+			memmove(&vertices_[(size_t) top * stride_], &vertices_[(size_t) range.baseVertex * stride_], (size_t) range.vertexCount * stride_);
+			range.baseVertex = top;
+			moved[handles[i]] = true;
+		}
+		top += range.vertexCount;
+	}
+	vertextop_ = top;
+
+	std::sort(handles.begin(), handles.end(), GeometryRangeOrder(ranges_, true));
+	top = 0;
+	for (size_t i = 0; i < handles.size(); i++) {
+		GeometryRange &range = ranges_[handles[i]];
+		if (range.indexCount == 0) {
+			continue;
+		}
+		if (range.startIndex != top) {
+			memmove(&indices_[(size_t) top * indexsize_], &indices_[(size_t) range.startIndex * indexsize_], (size_t) range.indexCount * indexsize_);
+			range.startIndex = top;
+			moved[handles[i]] = true;
+		}
+		top += range.indexCount;
+	}
+	indextop_ = top;
+
+	freevertices_.clear();
+	freeindices_.clear();
+	unsigned int count = 0;
+	for (size_t i = 0; i < moved.size(); i++) {
+		count += moved[i] ? 1 : 0;
+	}
+	if (count > 0) {
+		MarkDirty(vertexdirtybegin_, vertexdirtyend_, 0, (size_t) vertextop_ * stride_);
+		MarkDirty(indexdirtybegin_, indexdirtyend_, 0, (size_t) indextop_ * indexsize_);
+	}
+	defragments_++;
+	return count;
+}
+
+bool GeometryArena::upload(RenderContext &context, RenderBuffer *&buffer, const std::vector<uint8_t> &data, RENDER_BIND bind,
+	size_t &dirtybegin, size_t &dirtyend)
+{
+	if (!buffer || buffer->getDesc().byteWidth < data.size()) {
+		BufferDesc desc;
+		desc.usage = USAGE_DEFAULT;
+		desc.byteWidth = data.size();
+		desc.bindFlags = bind;
+		RenderBuffer *created = dev_.createBuffer(desc, &data[0]);
+		if (!created) {
+			return false;
+		}
+		if (buffer) {
+			grows_++;
+		}
+		delete buffer;
+		buffer = created;
+		uploaded_ += data.size();
+	} else if (dirtybegin != dirtyend) {
+		context.writeBuffer(buffer, dirtybegin, &data[dirtybegin], dirtyend - dirtybegin);
+		uploaded_ += dirtyend - dirtybegin;
+	}
+	dirtybegin = dirtyend = 0;
+	return true;
+}
+
+bool GeometryArena::use(RenderContext &context)
+{
+	if (!upload(context, vertexbuffer_, vertices_, BIND_VERTEX_BUFFER, vertexdirtybegin_, vertexdirtyend_) ||
+		!upload(context, indexbuffer_, indices_, BIND_INDEX_BUFFER, indexdirtybegin_, indexdirtyend_)) {
+		return false;
+	}
+	context.setVertexBuffer(vertexbuffer_, stride_, 0);
+	context.setIndexBuffer(indexbuffer_, indexformat_, 0);
+	return true;
+}
+
+GeometryArenaStats GeometryArena::getStats() const
+{
+	GeometryArenaStats stats;
+	for (size_t i = 0; i < ranges_.size(); i++) {
+		if (live_[i]) {
+			stats.allocations++;
+			stats.usedVertices += ranges_[i].vertexCount;
+			stats.usedIndices += ranges_[i].indexCount;
+		}
+	}
+	stats.topVertices = vertextop_;
+	stats.topIndices = indextop_;
+	stats.freeVertexBlocks = (unsigned int) freevertices_.size();
+	stats.freeIndexBlocks = (unsigned int) freeindices_.size();
+	stats.grows = grows_;
+	stats.defragments = defragments_;
+	stats.uploaded = uploaded_;
+	return stats;
+}
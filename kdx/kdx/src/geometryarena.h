@@ -0,0 +1,109 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include "renderdevice.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+// the geometry of many meshes with the same vertex layout in one vertex buffer and one index buffer, each mesh is a
+// range of both and draws with its start index and base vertex. the buffers are bound once for all of them (the
+// StateCache drops the repeats) instead of once per mesh
+//
+// the arena keeps a cpu copy of both buffers: allocations only write that copy and the changed span is uploaded on the
+// next use, growing recreates the buffers from it and defragment compacts it and uploads everything once
+// WORKNOTE: the copy doubles the memory of the geometry, the meshes keep theirs too (getInds/getPositions)
+
+// what allocate returns when the geometry doesn't fit the arena's layout
+#define GEOMETRY_ARENA_INVALID 0xffffffff
+
+struct GeometryRange {
+	unsigned int baseVertex;
+	unsigned int vertexCount;
+	unsigned int startIndex;
+	unsigned int indexCount;
+};
+
+struct GeometryArenaStats {
+	GeometryArenaStats();
+
+	unsigned int allocations;
+	// in use and up to the end of the last allocation, in vertices and indices
+	unsigned int usedVertices, topVertices;
+	unsigned int usedIndices, topIndices;
+	// holes below the top
+	unsigned int freeVertexBlocks, freeIndexBlocks;
+	// buffer recreations, defragment passes, bytes written by uploads
+	unsigned int grows;
+	unsigned int defragments;
+	size_t uploaded;
+};
+
+class GeometryArena {
+public:
+	// indexFormat is FORMAT_R16_UINT or FORMAT_R32_UINT, the capacities are where the buffers start, they double when
+	// an allocation doesn't fit
+	GeometryArena(RenderDevice &dev, unsigned int vertexStride, RENDER_FORMAT indexFormat = FORMAT_R32_UINT,
+		unsigned int vertexCapacity = 65536, unsigned int indexCapacity = 196608);
+	virtual ~GeometryArena();
+
+	// copies the geometry in, indices of any format are converted to the arena's (they have to fit it), they stay
+	// relative to the mesh's first vertex. returns the allocation's handle, GEOMETRY_ARENA_INVALID if vertexStride isn't
+	// the arena's
+	unsigned int allocate(const void *verts, unsigned int vertexCount, unsigned int vertexStride,
+		const void *inds, unsigned int indexCount, RENDER_FORMAT indexFormat);
+	// returns the ranges to the free lists, neighbouring holes are merged
+	void free(unsigned int allocation);
+	// moves every allocation down to close the holes, the handles stay valid but their ranges change
+	// returns the number of allocations that moved
+	unsigned int defragment();
+
+	// uploads what changed and binds the buffers, false when they couldn't be created
+	bool use(RenderContext &context);
+	const GeometryRange& getRange(unsigned int allocation) const { return ranges_[allocation]; }
+
+	unsigned int getVertexStride() const { return stride_; }
+	RENDER_FORMAT getIndexFormat() const { return indexformat_; }
+	RenderBuffer* getVertexBuffer() const { return vertexbuffer_; }
+	RenderBuffer* getIndexBuffer() const { return indexbuffer_; }
+	GeometryArenaStats getStats() const;
+
+private:
+	// free blocks by offset, first fit, the end is the top when nothing fits
+	static unsigned int AllocateBlock(std::map<unsigned int, unsigned int> &blocks, unsigned int &top, unsigned int count);
+	static void FreeBlock(std::map<unsigned int, unsigned int> &blocks, unsigned int &top, unsigned int offset, unsigned int count);
+	// recreates buffer from data when it's smaller than that, otherwise writes the dirty span
+	bool upload(RenderContext &context, RenderBuffer *&buffer, const std::vector<uint8_t> &data, RENDER_BIND bind,
+		size_t &dirtybegin, size_t &dirtyend);
+	static void MarkDirty(size_t &begin, size_t &end, size_t offset, size_t size);
+
+	RenderDevice &dev_;
+	unsigned int stride_;
+	RENDER_FORMAT indexformat_;
+	unsigned int indexsize_;
+
+	// cpu copies, sized to the capacities
+	std::vector<uint8_t> vertices_;
+	std::vector<uint8_t> indices_;
+	unsigned int vertextop_, indextop_;
+	std::map<unsigned int, unsigned int> freevertices_;
+	std::map<unsigned int, unsigned int> freeindices_;
+
+	// by handle, freed handles are reused
+	std::vector<GeometryRange> ranges_;
+	std::vector<bool> live_;
+	std::vector<unsigned int> freehandles_;
+
+	RenderBuffer *vertexbuffer_;
+	RenderBuffer *indexbuffer_;
+	// byte spans of the copies that the buffers don't have yet, begin == end when there are none
+	size_t vertexdirtybegin_, vertexdirtyend_;
+	size_t indexdirtybegin_, indexdirtyend_;
+
+	unsigned int grows_;
+	unsigned int defragments_;
+	size_t uploaded_;
+};
+
+#endif // GEOMETRYARENA_H
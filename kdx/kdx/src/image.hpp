@@ -0,0 +1,55 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <vector>
+#include <stddef.h>
+
+// cpu-side 2D image, row-major and tightly packed
+// used as the cpu equivalent of the single-mip render targets in the samples
+template<typename T>
+class Image {
+public:
+	Image() : width_(0), height_(0) {}
+	Image(int width, int height, const T &fill = T()) : width_(width), height_(height), pixels_((size_t) width * height, fill) {}
+
+	void resize(int width, int height, const T &fill = T())
+	{
+		width_ = width;
+		height_ = height;
+		pixels_.assign((size_t) width * height, fill);
+	}
+
+	void fill(const T &value)
+	{
+		pixels_.assign(pixels_.size(), value);
+	}
+
+	int getWidth() const { return width_; }
+	int getHeight() const { return height_; }
+	size_t getByteSize() const { return pixels_.size() * sizeof(T); }
+
+	T* data() { return pixels_.empty() ? 0 : &pixels_[0]; }
+	const T* data() const { return pixels_.empty() ? 0 : &pixels_[0]; }
+
+	T* row(int y) { return &pixels_[(size_t) y * width_]; }
+	const T* row(int y) const { return &pixels_[(size_t) y * width_]; }
+
+	T& at(int x, int y) { return pixels_[(size_t) y * width_ + x]; }
+	const T& at(int x, int y) const { return pixels_[(size_t) y * width_ + x]; }
+
+	// same addressing as a Load with clamp-to-edge, i.e. out of range coordinates read the nearest border texel
+	const T& clampedAt(int x, int y) const
+	{
+		x = x < 0 ? 0 : (x >= width_ ? width_ - 1 : x);
+		y = y < 0 ? 0 : (y >= height_ ? height_ - 1 : y);
+		return pixels_[(size_t) y * width_ + x];
+	}
+
+private:
+	int width_, height_;
+	std::vector<T> pixels_;
+};
+
+typedef Image<float> FloatImage;
+
+#endif // IMAGE_H
@@ -0,0 +1,135 @@
+#include "image16.h"
+#include "cpufeatures.h"
+#include <emmintrin.h>
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t u = floatAsBits(value);
+	const uint32_t sign = (u >> 16) & 0x8000;
+	u &= 0x7fffffff;
+	if (u >= 0x47800000) {
+		// 65536 and up, inf and nan (quieted, keeping the top of the payload like f16c)
+		if (u > 0x7f800000) {
+			return (uint16_t) (sign | 0x7e00 | ((u >> 13) & 0x3ff));
+		}
+		return (uint16_t) (sign | 0x7c00);
+	}
+	if (u < 0x38800000) {
+		// below the smallest normal half (2^-14), adding 0.5 lines the half denormal up with the bottom of the
+		// float mantissa and the fpu does the rounding
+		return (uint16_t) (sign | (floatAsBits(bitsAsFloat(u) + 0.5f) - 0x3f000000));
+	}
+	// rebias the exponent and round the 13 dropped mantissa bits to nearest even, a carry out of the mantissa bumps
+	// the exponent, up to infinity from 65520 on
+	u += 0xc8000fff + ((u >> 13) & 1);
+	return (uint16_t) (sign | (u >> 13));
+}
+
+uint16_t floatToUnorm16(float value)
+{
+	// the operand order of maxps / minps, so nan clamps to 0 here as well
+	value = value > 0.f ? value : 0.f;
+	value = value < 1.f ? value : 1.f;
+	return (uint16_t) (int) (value * 65535.f + 0.5f);
+}
+
+void floatToHalf(const float *src, uint16_t *dst, size_t count)
+{
+	if (CpuHasAvx2() && GetF16cHalfConversions()) {
+		GetF16cHalfConversions()->toHalf(src, dst, count);
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = floatToHalf(src[i]);
+	}
+}
+
+void halfToFloat(const uint16_t *src, float *dst, size_t count)
+{
+	if (CpuHasAvx2() && GetF16cHalfConversions()) {
+		GetF16cHalfConversions()->toFloat(src, dst, count);
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = halfToFloat(src[i]);
+	}
+}
+
+void floatToUnorm16(const float *src, uint16_t *dst, size_t count)
+{
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+	const __m128 scale = _mm_set1_ps(65535.f), half = _mm_set1_ps(0.5f);
+	// sse2 has no unsigned saturating 32 -> 16 pack, so the values are moved into the signed range and back
+	const __m128i bias = _mm_set1_epi32(0x8000);
+	const __m128i unbias = _mm_set1_epi16((short) 0x8000);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+		const __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), zero), one);
+		const __m128i qa = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, scale), half)), bias);
+		const __m128i qb = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half)), bias);
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(_mm_packs_epi32(qa, qb), unbias));
+	}
+	for (; i < count; i++) {
+		dst[i] = floatToUnorm16(src[i]);
+	}
+}
+
+void unorm16ToFloat(const uint16_t *src, float *dst, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.f / 65535.f);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m128i q = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(q, zero)), scale));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(q, zero)), scale));
+	}
+	for (; i < count; i++) {
+		dst[i] = unorm16ToFloat(src[i]);
+	}
+}
+
+void Image16::loadRow(int y, int x0, int count, float *out) const
+{
+	if (format_ == IMAGE16_HALF) {
+		halfToFloat(texels_.row(y) + x0, out, count);
+	} else {
+		unorm16ToFloat(texels_.row(y) + x0, out, count);
+	}
+}
+
+void Image16::storeRow(int y, int x0, int count, const float *in)
+{
+	if (format_ == IMAGE16_HALF) {
+		floatToHalf(in, texels_.row(y) + x0, count);
+	} else {
+		floatToUnorm16(in, texels_.row(y) + x0, count);
+	}
+}
+
+void Image16::load(FloatImage &out) const
+{
+	if (out.getWidth() != getWidth() || out.getHeight() != getHeight()) {
+		out.resize(getWidth(), getHeight());
+	}
+	const size_t count = (size_t) getWidth() * getHeight();
+	if (format_ == IMAGE16_HALF) {
+		halfToFloat(texels_.data(), out.data(), count);
+	} else {
+		unorm16ToFloat(texels_.data(), out.data(), count);
+	}
+}
+
+void Image16::store(const FloatImage &src)
+{
+	if (src.getWidth() != getWidth() || src.getHeight() != getHeight()) {
+		texels_.resize(src.getWidth(), src.getHeight());
+	}
+	const size_t count = (size_t) getWidth() * getHeight();
+	if (format_ == IMAGE16_HALF) {
+		floatToHalf(src.data(), texels_.data(), count);
+	} else {
+		floatToUnorm16(src.data(), texels_.data(), count);
+	}
+}
@@ -0,0 +1,150 @@
+#ifndef IMAGE16_H
+#define IMAGE16_H
+
+#include "image.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 16 bit single channel cpu images, half the bytes of a FloatImage for the buffers that need neither a float's range
+// nor its precision: the d16 depth buffer is unorm16 to begin with, view z fits a half, ao is [0, 1]
+//
+// the kernels taking them still compute in float registers, rows are widened into a float scratch row on read and
+// narrowed on write (readRow, beginRow and endRow below), so a kernel templated on its images serves both storages
+enum IMAGE16_FORMAT {
+	IMAGE16_HALF = 0, // ieee half, DXGI_FORMAT_R16_FLOAT
+	IMAGE16_UNORM // [0, 1] in steps of 1 / 65535, DXGI_FORMAT_R16_UNORM (and D16_UNORM)
+};
+
+inline uint32_t floatAsBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline float bitsAsFloat(uint32_t bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// round to nearest even with overflow to infinity, same as vcvtps2ph and the gpu
+uint16_t floatToHalf(float value);
+// clamps to [0, 1] first (nan becomes 0), rounds half away from zero like the d3d float -> unorm conversion
+uint16_t floatToUnorm16(float value);
+
+// the widening ones are inline, kernels with scattered reads (the ao taps) call them per texel
+inline float halfToFloat(uint16_t half)
+{
+	uint32_t u = (uint32_t) (half & 0x7fff) << 13;
+	const uint32_t exponent = u & 0x0f800000;
+	u += 0x38000000;
+	if (exponent == 0x0f800000) {
+		// inf and nan, nans come out quiet like f16c
+		u += 0x38000000;
+		if (u & 0x007fffff) {
+			u |= 0x00400000;
+		}
+	} else if (exponent == 0) {
+		// denormal, renormalized by the fpu
+		u = floatAsBits(bitsAsFloat(u + 0x00800000) - bitsAsFloat(0x38800000));
+	}
+	return bitsAsFloat(u | (uint32_t) (half & 0x8000) << 16);
+}
+
+inline float unorm16ToFloat(uint16_t unorm)
+{
+	return unorm * (1.f / 65535.f);
+}
+
+// the same over arrays: f16c for the half ones on avx2 cpus, sse2 for unorm16, bit identical to the single value functions
+void floatToHalf(const float *src, uint16_t *dst, size_t count);
+void halfToFloat(const uint16_t *src, float *dst, size_t count);
+void floatToUnorm16(const float *src, uint16_t *dst, size_t count);
+void unorm16ToFloat(const uint16_t *src, float *dst, size_t count);
+
+// the f16c loops of image16avx2.cpp, 0 when that was built without avx2
+// the array functions above use them when the cpu has avx2 (CpuHasAvx2), exposed for the benchmarks
+struct HalfConversions {
+	void (*toHalf)(const float *src, uint16_t *dst, size_t count);
+	void (*toFloat)(const uint16_t *src, float *dst, size_t count);
+};
+
+const HalfConversions* GetF16cHalfConversions();
+
+class Image16 {
+public:
+	Image16() : texels_(), format_(IMAGE16_HALF) {}
+	Image16(int width, int height, IMAGE16_FORMAT format) : texels_(width, height), format_(format) {}
+
+	void resize(int width, int height, IMAGE16_FORMAT format)
+	{
+		texels_.resize(width, height);
+		format_ = format;
+	}
+
+	IMAGE16_FORMAT getFormat() const { return format_; }
+	int getWidth() const { return texels_.getWidth(); }
+	int getHeight() const { return texels_.getHeight(); }
+	size_t getByteSize() const { return texels_.getByteSize(); }
+
+	uint16_t* row(int y) { return texels_.row(y); }
+	const uint16_t* row(int y) const { return texels_.row(y); }
+
+	// single texels, widened and narrowed
+	float at(int x, int y) const { return widen(texels_.at(x, y)); }
+	float clampedAt(int x, int y) const { return widen(texels_.clampedAt(x, y)); }
+	void set(int x, int y, float value) { texels_.at(x, y) = format_ == IMAGE16_HALF ? floatToHalf(value) : floatToUnorm16(value); }
+
+	// count texels of row y starting at x0
+	void loadRow(int y, int x0, int count, float *out) const;
+	void storeRow(int y, int x0, int count, const float *in);
+
+	// whole images, load and store resize their destination
+	void load(FloatImage &out) const;
+	void store(const FloatImage &src);
+
+private:
+	float widen(uint16_t texel) const { return format_ == IMAGE16_HALF ? halfToFloat(texel) : unorm16ToFloat(texel); }
+
+	Image<uint16_t> texels_;
+	IMAGE16_FORMAT format_;
+};
+
+// row access for kernels templated on their storage: FloatImage rows are used in place,
+// Image16 rows go through scratch, which has to hold count floats
+inline const float* readRow(const FloatImage &image, int y, int x0, int, float *)
+{
+	return image.row(y) + x0;
+}
+
+inline const float* readRow(const Image16 &image, int y, int x0, int count, float *scratch)
+{
+	image.loadRow(y, x0, count, scratch);
+	return scratch;
+}
+
+// the row to write results into, endRow stores it
+inline float* beginRow(FloatImage &image, int y, int x0, float *)
+{
+	return image.row(y) + x0;
+}
+
+inline float* beginRow(Image16 &, int, int, float *scratch)
+{
+	return scratch;
+}
+
+inline void endRow(FloatImage &, int, int, int, const float *)
+{
+
+}
+
+inline void endRow(Image16 &image, int y, int x0, int count, const float *row)
+{
+	image.storeRow(y, x0, count, row);
+}
+
+#endif // IMAGE16_H
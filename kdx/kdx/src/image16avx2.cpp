@@ -0,0 +1,46 @@
+#include "image16.h"
+
+// f16c half conversions, built with /arch:AVX2 like raykernelsavx2.cpp and only handed out on avx2 cpus
+// WORKNOTE: without the flag they compile away and the scalar conversions are used everywhere
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// rounding immediate 0 is round to nearest even, what floatToHalf does
+static void toHalfF16c(const float *src, uint16_t *dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_si128((__m128i*) (dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), 0));
+	}
+	for (; i < count; i++) {
+		dst[i] = floatToHalf(src[i]);
+	}
+}
+
+static void toFloatF16c(const uint16_t *src, float *dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (src + i))));
+	}
+	for (; i < count; i++) {
+		dst[i] = halfToFloat(src[i]);
+	}
+}
+
+static const HalfConversions F16cConversions = { toHalfF16c, toFloatF16c };
+
+const HalfConversions* GetF16cHalfConversions()
+{
+	return &F16cConversions;
+}
+
+#else
+
+const HalfConversions* GetF16cHalfConversions()
+{
+	return 0;
+}
+
+#endif // __AVX2__
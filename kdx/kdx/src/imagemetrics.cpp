@@ -0,0 +1,63 @@
+#include "imagemetrics.h"
+#include "blur.h"
+#include <math.h>
+
+// window and stabilizing constants from the ssim paper, (k * dynamic range)^2 with k1 = 0.01 and k2 = 0.03
+#define SSIM_RADIUS 5
+#define SSIM_SIGMA 1.5f
+#define SSIM_C1 (0.01f * 0.01f)
+#define SSIM_C2 (0.03f * 0.03f)
+
+float rmse(const FloatImage &a, const FloatImage &b)
+{
+	double total = 0.0;
+	for (int y = 0; y < a.getHeight(); y++) {
+		const float *ra = a.row(y), *rb = b.row(y);
+		for (int x = 0; x < a.getWidth(); x++) {
+			const double d = ra[x] - rb[x];
+			total += d * d;
+		}
+	}
+	return (float) sqrt(total / ((double) a.getWidth() * a.getHeight()));
+}
+
+float ssim(const FloatImage &a, const FloatImage &b, FloatImage *ssimMap)
+{
+	const int width = a.getWidth();
+	const int height = a.getHeight();
+	// the local moments are gaussian blurs of the images and their products
+	FloatImage aa (width, height), bb (width, height), ab (width, height);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			aa.at(x, y) = a.at(x, y) * a.at(x, y);
+			bb.at(x, y) = b.at(x, y) * b.at(x, y);
+			ab.at(x, y) = a.at(x, y) * b.at(x, y);
+		}
+	}
+	Blur blur;
+	FloatImage muA, muB;
+	blur.gaussian(a, muA, SSIM_RADIUS, SSIM_SIGMA);
+	blur.gaussian(b, muB, SSIM_RADIUS, SSIM_SIGMA);
+	blur.gaussian(aa, aa, SSIM_RADIUS, SSIM_SIGMA);
+	blur.gaussian(bb, bb, SSIM_RADIUS, SSIM_SIGMA);
+	blur.gaussian(ab, ab, SSIM_RADIUS, SSIM_SIGMA);
+	if (ssimMap && (ssimMap->getWidth() != width || ssimMap->getHeight() != height)) {
+		ssimMap->resize(width, height);
+	}
+
+	double total = 0.0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const float ma = muA.at(x, y), mb = muB.at(x, y);
+			const float varA = aa.at(x, y) - ma * ma;
+			const float varB = bb.at(x, y) - mb * mb;
+			const float cov = ab.at(x, y) - ma * mb;
+			const float s = ((2.f * ma * mb + SSIM_C1) * (2.f * cov + SSIM_C2)) / ((ma * ma + mb * mb + SSIM_C1) * (varA + varB + SSIM_C2));
+			if (ssimMap) {
+				ssimMap->at(x, y) = s;
+			}
+			total += s;
+		}
+	}
+	return (float) (total / ((double) width * height));
+}
@@ -0,0 +1,17 @@
+#ifndef IMAGEMETRICS_H
+#define IMAGEMETRICS_H
+
+#include "image.hpp"
+
+// error metrics between single channel images of the same size, for scoring ao passes against a reference
+// both expect values in [0, 1] like the ao buffers
+
+// root mean square difference
+float rmse(const FloatImage &a, const FloatImage &b);
+
+// mean structural similarity (Wang et al. 2004) with the usual 11x11 gaussian window of sigma 1.5,
+// 1 for identical images, it penalizes lost contrast and structure rather than an overall offset like rmse does
+// ssimMap receives the per pixel values when given
+float ssim(const FloatImage &a, const FloatImage &b, FloatImage *ssimMap = 0);
+
+#endif // IMAGEMETRICS_H
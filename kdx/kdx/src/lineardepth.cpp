@@ -0,0 +1,100 @@
+#include "lineardepth.h"
+#include "ambientocclusion.h"
+#include "parallel.h"
+#include <math.h>
+
+// rows handed to a worker at a time
+#define LINEAR_ROW_GRAIN 32
+
+LinearDepth::LinearDepth()
+{
+
+}
+
+LinearDepth::~LinearDepth()
+{
+
+}
+
+// IN and OUT are FloatImage or Image16, the math is in floats either way
+template<typename IN, typename OUT>
+static void linearize(const IN &depth, const float *m, OUT &viewZ)
+{
+	const int width = depth.getWidth();
+	parallelFor(0, depth.getHeight(), LINEAR_ROW_GRAIN, [&](int y0, int y1) {
+		std::vector<float> inScratch (width), outScratch (width);
+		for (int y = y0; y < y1; y++) {
+			const float *in = readRow(depth, y, 0, width, &inScratch[0]);
+			float *out = beginRow(viewZ, y, 0, &outScratch[0]);
+			for (int x = 0; x < width; x++) {
+				out[x] = viewDepth(m, in[x]);
+			}
+			endRow(viewZ, y, 0, width, out);
+		}
+	});
+}
+
+void LinearDepth::build(const FloatImage &depth, const Matrix &invProj)
+{
+	const int width = depth.getWidth();
+	const int height = depth.getHeight();
+	if (viewZ_.getWidth() != width || viewZ_.getHeight() != height) {
+		viewZ_.resize(width, height);
+	}
+	buildRays(width, height, invProj);
+	linearize(depth, invProj.data(), viewZ_);
+}
+
+void LinearDepth::build(const Image16 &depth, const Matrix &invProj)
+{
+	const int width = depth.getWidth();
+	const int height = depth.getHeight();
+	if (halfViewZ_.getWidth() != width || halfViewZ_.getHeight() != height) {
+		halfViewZ_.resize(width, height, IMAGE16_HALF);
+	}
+	buildRays(width, height, invProj);
+	linearize(depth, invProj.data(), halfViewZ_);
+}
+
+void LinearDepth::buildRays(int width, int height, const Matrix &invProj)
+{
+	float coeffs[4];
+	GetRayCoefficients(invProj, coeffs);
+	rayX_.resize(width);
+	rayY_.resize(height);
+	for (int x = 0; x < width; x++) {
+		rayX_[x] = coeffs[0] * ((x + 0.5f) / width) + coeffs[1];
+	}
+	for (int y = 0; y < height; y++) {
+		rayY_[y] = coeffs[2] * ((y + 0.5f) / height) + coeffs[3];
+	}
+}
+
+/*static*/ void LinearDepth::GetRayCoefficients(const Matrix &invProj, float coeffs[4])
+{
+	// with no shear, invProj * (nx, ny, z, 1) has x = m[0] * nx + m[12], y = m[5] * ny + m[13] and a constant z of m[14]
+	// before the divide by w, which cancels out of x / z and y / z
+	// nx = 2u - 1 and ny = 1 - 2v
+	const float *m = invProj.data();
+	coeffs[0] = 2.f * m[0] / m[14];
+	coeffs[1] = (m[12] - m[0]) / m[14];
+	coeffs[2] = -2.f * m[5] / m[14];
+	coeffs[3] = (m[5] + m[13]) / m[14];
+}
+
+/*static*/ bool LinearDepth::IsSupported(const Matrix &invProj)
+{
+	// everything outside the diagonal, the translation column and the z/w terms has to vanish
+	const float *m = invProj.data();
+	if (m[14] == 0.f) {
+		return false;
+	}
+	const float scale = fabsf(m[0]) + fabsf(m[5]) + fabsf(m[14]);
+	const int zeros[] = { 1, 2, 3, 4, 6, 7, 8, 9, 10 };
+	for (int i = 0; i < 9; i++) {
+		if (fabsf(m[zeros[i]]) > 1e-6f * scale) {
+			return false;
+		}
+	}
+	return true;
+}
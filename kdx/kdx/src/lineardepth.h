@@ -0,0 +1,51 @@
+#ifndef LINEARDEPTH_H
+#define LINEARDEPTH_H
+
+#include "image16.h"
+#include "matrix.h"
+#include <vector>
+
+// linearization pass for the ao inputs: view space z once per pixel plus one ray factor per column and per row,
+// so a view space position is (rayX * z, rayY * z, z) instead of an ndc vector times invCamPj and a divide
+//
+// this holds for the projections the samples use (perspective without shear, see IsSupported),
+// where view x / z only depends on the column and view y / z only on the row
+class LinearDepth {
+public:
+	LinearDepth();
+	virtual ~LinearDepth();
+
+	// depth is post-projection [0, 1], invProj the inverse of the projection it was rendered with
+	void build(const FloatImage &depth, const Matrix &invProj);
+	// the same on 16 bit storage, depth of any Image16 format (unorm is the d16 buffer as it is) and view z as half
+	// in getHalfViewZ, getViewZ and getPosition keep the last float build's results
+	void build(const Image16 &depth, const Matrix &invProj);
+
+	const FloatImage& getViewZ() const { return viewZ_; }
+	const Image16& getHalfViewZ() const { return halfViewZ_; }
+	float getRayX(int x) const { return rayX_[x]; }
+	float getRayY(int y) const { return rayY_[y]; }
+
+	// view space position of pixel (x, y)
+	fl3 getPosition(int x, int y) const
+	{
+		const float z = viewZ_.at(x, y);
+		return fl3(rayX_[x] * z, rayY_[y] * z, z);
+	}
+
+	// the ray factors are linear in texture coordinates, for positions between pixel centers:
+	// rayX(u) = coeffs[0] * u + coeffs[1], rayY(v) = coeffs[2] * v + coeffs[3] (v grows downwards like texture coordinates)
+	static void GetRayCoefficients(const Matrix &invProj, float coeffs[4]);
+	// whether invProj is a projection the factorization is exact for
+	static bool IsSupported(const Matrix &invProj);
+
+private:
+	void buildRays(int width, int height, const Matrix &invProj);
+
+	FloatImage viewZ_;
+	Image16 halfViewZ_;
+	std::vector<float> rayX_;
+	std::vector<float> rayY_;
+};
+
+#endif // LINEARDEPTH_H
@@ -0,0 +1,57 @@
+#include "materialtable.h"
+#include <assert.h>
+#include <string.h>
+
+MaterialTable::MaterialTable() : buffer_(0), uploaded_(0)
+{
+
+}
+
+MaterialTable::~MaterialTable()
+{
+	delete buffer_;
+}
+
+unsigned int MaterialTable::add(const MaterialConstants &constants)
+{
+	materials_.push_back(constants);
+	return (unsigned int) materials_.size() - 1;
+}
+
+bool MaterialTable::finalize(RenderDevice &dev)
+{
+	if (uploaded_ == materials_.size()) {
+		return buffer_ != 0 || materials_.empty();
+	}
+	// the rest of each material's range is zeros
+	std::vector<uint8_t> data (materials_.size() * MATERIAL_TABLE_STRIDE, 0);
+	for (size_t i = 0; i < materials_.size(); i++) {
+		memcpy(&data[i * MATERIAL_TABLE_STRIDE], &materials_[i], sizeof(MaterialConstants));
+	}
+	BufferDesc desc;
+	desc.usage = USAGE_IMMUTABLE;
+	desc.byteWidth = data.size();
+	desc.bindFlags = BIND_CONSTANT_BUFFER;
+	RenderBuffer *buffer = dev.createBuffer(desc, &data[0]);
+	if (!buffer) {
+		return false;
+	}
+	delete buffer_;
+	buffer_ = buffer;
+	uploaded_ = (unsigned int) materials_.size();
+	return true;
+}
+
+void MaterialTable::use(RenderContext &context, SHADER_STAGE stage, unsigned int slot, unsigned int index) const
+{
+	assert(index < uploaded_);
+	context.setConstantBufferRange(stage, slot, buffer_, index * MATERIAL_TABLE_STRIDE, MATERIAL_TABLE_STRIDE);
+}
+
+void MaterialTable::useTable(RenderContext &context, SHADER_STAGE stage, unsigned int slot) const
+{
+	if (!uploaded_) {
+		return;
+	}
+	context.setConstantBufferRange(stage, slot, buffer_, 0, getBoundCount() * MATERIAL_TABLE_STRIDE);
+}
@@ -0,0 +1,86 @@
+#ifndef MATERIALTABLE_H
+#define MATERIALTABLE_H
+
+#include "renderdevice.h"
+#include "utils.h"
+#include <stddef.h>
+#include <vector>
+
+// the material parameters of an mtl file, laid out like the ObjMaterial cbuffer in objrender.hlsl
+// we need padding to make vectors not straddle 16 byte boundaries
+// http://msdn.microsoft.com/en-us/library/windows/desktop/bb509632%28v=vs.85%29.aspx
+struct MaterialConstants {
+	float Ns; // specular coefficient
+	float Ni; // index of refraction
+	union {
+		float d, Tr; // transparency (can have both notations)
+	};
+	float padding0;
+	fl3 Tf; // transmission filter (allows only certain colors through)
+
+	uint32_t illum; // illumination model
+	// 0 means constant illumination (color = Kd)
+	// 1 means lambertian model (diffuse and ambient only)
+	// 2 means lambert + blinn-phong (diffuse, specular, and ambient)
+	// there's more at http://en.wikipedia.org/wiki/Wavefront_.obj_file
+	// but these are the basics
+
+	fl3 Ka; // ambient color
+	float padding1;
+	fl3 Kd; // diffuse color
+	float padding2;
+	fl3 Ks; // specular color
+	float padding3;
+	fl3 Ke; // emissive color
+	float padding4;
+};
+
+// the packoffsets of objrender.hlsl, in bytes (c# is 16 bytes, .y/.z/.w 4 more each)
+static_assert(offsetof(MaterialConstants, Ns) == 0, "Ns is at packoffset(c0)");
+static_assert(offsetof(MaterialConstants, Ni) == 4, "Ni is at packoffset(c0.y)");
+static_assert(offsetof(MaterialConstants, Tr) == 8, "Tr is at packoffset(c0.z)");
+static_assert(offsetof(MaterialConstants, Tf) == 16, "Tf is at packoffset(c1)");
+static_assert(offsetof(MaterialConstants, illum) == 28, "illum is at packoffset(c1.w)");
+static_assert(offsetof(MaterialConstants, Ka) == 32, "Ka is at packoffset(c2)");
+static_assert(offsetof(MaterialConstants, Kd) == 48, "Kd is at packoffset(c3)");
+static_assert(offsetof(MaterialConstants, Ks) == 64, "Ks is at packoffset(c4)");
+static_assert(offsetof(MaterialConstants, Ke) == 80, "Ke is at packoffset(c5)");
+static_assert(sizeof(MaterialConstants) == 96, "the ObjMaterial cbuffer is 6 constants");
+
+// each material's place in the table, one constant buffer range apart
+#define MATERIAL_TABLE_STRIDE CONSTANT_RANGE_ALIGNMENT
+// the materials one cbuffer can see (4096 constants)
+#define MATERIAL_TABLE_BOUND_SIZE 256
+
+// the materials of any number of Objs in one immutable constant buffer, a draw binds its material by index as a range
+// of it (the cbuffer in objrender.hlsl stays as it is), instead of a constant buffer per material
+// WORKNOTE: bigger than the 64 KB a cbuffer can see is fine, each range is only one material (d3d11.1 ranges)
+class MaterialTable {
+public:
+	MaterialTable();
+	virtual ~MaterialTable();
+
+	// returns the material's index
+	unsigned int add(const MaterialConstants &constants);
+	// uploads the table if materials were added since the last finalize, call it once every Obj using it is loaded
+	bool finalize(RenderDevice &dev);
+	// binds the material as the cbuffer in slot
+	void use(RenderContext &context, SHADER_STAGE stage, unsigned int slot, unsigned int index) const;
+	// binds the table as an array of materials (the first MATERIAL_TABLE_BOUND_SIZE of them), for shaders that pick
+	// the material themselves like the material overrides of objrenderinstanced.hlsl
+	void useTable(RenderContext &context, SHADER_STAGE stage, unsigned int slot) const;
+
+	unsigned int size() const { return (unsigned int) materials_.size(); }
+	// the materials useTable binds
+	unsigned int getBoundCount() const { return uploaded_ < MATERIAL_TABLE_BOUND_SIZE ? uploaded_ : MATERIAL_TABLE_BOUND_SIZE; }
+	const MaterialConstants& get(unsigned int index) const { return materials_[index]; }
+	RenderBuffer* getBuffer() const { return buffer_; }
+
+private:
+	std::vector<MaterialConstants> materials_;
+	RenderBuffer *buffer_;
+	// materials in buffer_
+	unsigned int uploaded_;
+};
+
+#endif // MATERIALTABLE_H
@@ -23,6 +23,14 @@ Matrix::Matrix(const Matrix &other)
     loadMatrix(other.data());
 }
 
+Matrix& Matrix::operator=(const Matrix &other)
+{
+    if (this != &other) {
+        loadMatrix(other.data());
+    }
+    return *this;
+}
+
 fl3 Matrix::multiplyPoint(const fl3 &pt) const
 {
     fl3 output;
@@ -371,6 +379,19 @@ void Matrix::frustum(const float left, const float right, const float bottom, co
     entries_[15] = 0.0f;
 }
 
+void Matrix::perspectiveFovLH(const float fovy, const float ratio, const float nearp, const float farp)
+{
+    const float yscale = 1.0f / tan(fovy * 0.5f);
+
+    setIdentityMatrix(entries_);
+    entries_[0] = yscale / ratio;
+    entries_[5] = yscale;
+    entries_[10] = farp / (farp - nearp);
+    entries_[11] = 1.0f;
+    entries_[14] = -nearp * farp / (farp - nearp);
+    entries_[15] = 0.0f;
+}
+
 const float* Matrix::data() const
 {
     return entries_;
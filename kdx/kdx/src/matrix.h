@@ -12,6 +12,7 @@ class Matrix
 public:
     Matrix();
     Matrix(const Matrix &other);
+    Matrix& operator=(const Matrix &other);
 
     // basic matrix math for convenient non-GPU calculations
     fl3 multiplyPoint(const fl3 &pt) const;
@@ -44,6 +45,9 @@ public:
     void perspective(const float fov, const float ratio, const float nearp, const float farp);
     void ortho(const float left, const float right, const float bottom, const float top, const float nearp=-1.0f, const float farp=1.0f);
     void frustum(const float left, const float right, const float bottom, const float top, const float nearp, const float farp);
+    // same matrix as D3DXMatrixPerspectiveFovLH (fovy in radians, depth mapped to [0, 1])
+    // since the storage here is column-major for column vectors, data() can be used wherever a D3DXMATRIX is expected and vice versa
+    void perspectiveFovLH(const float fovy, const float ratio, const float nearp, const float farp);
 
     const float* data() const;
     void print();
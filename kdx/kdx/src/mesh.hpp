@@ -1,21 +1,36 @@
 #ifndef MESH_H
 #define MESH_H
 
-#include "dxbase.h"
+#include "geometryarena.h"
+#include "renderdevice.h"
+#include "utils.h"
+#include <assert.h>
+#include <stdint.h>
 #include <vector>
 
 // use template specialization to get enums corresponding to index buffer types
-// used for calls to IASetIndexBuffer
+// used for calls to setIndexBuffer
 template<typename T> struct IndexTypeToEnum {};
-template<> struct IndexTypeToEnum<UINT8> { enum { value = DXGI_FORMAT_R8_UINT }; };
-template<> struct IndexTypeToEnum<UINT16> { enum { value = DXGI_FORMAT_R16_UINT }; };
-template<> struct IndexTypeToEnum<UINT32> { enum { value = DXGI_FORMAT_R32_UINT }; };
+template<> struct IndexTypeToEnum<uint8_t> { enum { value = FORMAT_R8_UINT }; };
+template<> struct IndexTypeToEnum<uint16_t> { enum { value = FORMAT_R16_UINT }; };
+template<> struct IndexTypeToEnum<uint32_t> { enum { value = FORMAT_R32_UINT }; };
+
+// position of any of the vertex structs, for the cpu-side queries over mesh geometry
+inline const fl3& vertexPosition(const fl3 &vert) { return vert; }
+template<class VERT_TYPE>
+inline const fl3& vertexPosition(const VERT_TYPE &vert) { return vert.pos; }
 
 template<typename IND_TYPE>
 class Mesh {
 public:
-	Mesh(D3D11_PRIMITIVE_TOPOLOGY topology) : topology_(topology), indexcount_(0), inds_() {}
-	virtual ~Mesh() { indexbuffer_->Release(); }
+	Mesh(PRIMITIVE_TOPOLOGY topology) : indexbuffer_(0), indexcount_(0), topology_(topology), inds_(), arena_(0), allocation_(0) {}
+	virtual ~Mesh()
+	{
+		if (arena_) {
+			arena_->free(allocation_);
+		}
+		delete indexbuffer_;
+	}
 
 	Mesh& addInd(const IND_TYPE &newind)
 	{
@@ -29,50 +44,95 @@ public:
 		return *this;
 	}
 
-	void finalize(ID3D11Device &dev)
+	void finalize(RenderDevice &dev)
 	{
 		finalizeVertices(dev);
-		indexcount_ = inds_.size();
+		indexcount_ = (unsigned int) inds_.size();
 		// generate the index buffer object
-		D3D11_BUFFER_DESC ibufdesc;
-		ZeroMemory(&ibufdesc, sizeof(D3D11_BUFFER_DESC));
+		BufferDesc ibufdesc;
+		ibufdesc.usage = USAGE_DEFAULT; // WORKNOTE: if we use map+memcpy, this needs to be dynamic
+		ibufdesc.byteWidth = sizeof(IND_TYPE) * indexcount_;
+		ibufdesc.bindFlags = BIND_INDEX_BUFFER;
+
+		indexbuffer_ = dev.createBuffer(ibufdesc, &inds_[0]); // WORKQUESTION: better to do this with initial data in createbuffer or use map+memcp?
+	}
 
-		ibufdesc.Usage = D3D11_USAGE_DEFAULT;
-		ibufdesc.ByteWidth = sizeof(IND_TYPE) * indexcount_;
-		ibufdesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibufdesc.CPUAccessFlags = 0; // WORKNOTE: if we use map+memcpy, this needs to be CPU_ACCESS_WRITE
-		ibufdesc.MiscFlags = 0;
+	// puts the vertices and indices into ranges of the arena's buffers instead of buffers of the mesh's own, the draws
+	// bind the arena and only pass their offsets. the arena has to outlive the mesh
+	// when the arena can't take the geometry, the mesh gets buffers of its own like finalize(dev)
+	void finalize(RenderDevice &dev, GeometryArena &arena)
+	{
+		indexcount_ = (unsigned int) inds_.size();
+		allocation_ = allocateGeometry(arena);
+		if (allocation_ == GEOMETRY_ARENA_INVALID) {
+			assert(!"geometry arena allocation failed");
+			finalize(dev);
+			return;
+		}
+		arena_ = &arena;
+	}
 
-		D3D11_SUBRESOURCE_DATA subr;
-		ZeroMemory(&subr, sizeof(D3D11_SUBRESOURCE_DATA));
+	// cpu-side copies of the geometry, kept after finalize for building acceleration structures
+	const std::vector<IND_TYPE>& getInds() const { return inds_; }
+	virtual void getPositions(std::vector<fl3> &positions) const = 0;
 
-		subr.pSysMem = &inds_[0];
-		dev.CreateBuffer(&ibufdesc, &subr, &indexbuffer_); // WORKQUESTION: better to do this with initial data in createbuffer or use map+memcp?
+	virtual void draw(RenderDevice &, RenderContext &context)
+	{
+		if (arena_) {
+			// the arena keeps its cpu copy when an upload fails, the next use tries again
+			if (!arena_->use(context)) {
+				assert(!"geometry arena upload failed, draw dropped");
+				return;
+			}
+			const GeometryRange &range = arena_->getRange(allocation_);
+			context.setPrimitiveTopology(topology_);
+			context.drawIndexed(indexcount_, range.startIndex, range.baseVertex);
+			return;
+		}
+		setVertexBuffers(context);
+		context.setIndexBuffer(indexbuffer_, (RENDER_FORMAT) IndexTypeToEnum<IND_TYPE>::value, 0);
+		context.setPrimitiveTopology(topology_);
+		context.drawIndexed(indexcount_, 0, 0);
 	}
 
-	virtual void draw(ID3D11Device &dev, ID3D11DeviceContext &devcon)
+	// instanceCount copies of the mesh, the instance buffer and a layout with per-instance elements are bound by the caller
+	virtual void drawInstanced(RenderDevice &, RenderContext &context, unsigned int instanceCount, unsigned int startInstance)
 	{
-		setVertexBuffers(devcon);
-		devcon.IASetIndexBuffer(indexbuffer_, (DXGI_FORMAT) IndexTypeToEnum<IND_TYPE>::value, 0);
-		devcon.IASetPrimitiveTopology(topology_);
-		devcon.DrawIndexed(indexcount_, 0, 0);
+		if (arena_) {
+			if (!arena_->use(context)) {
+				assert(!"geometry arena upload failed, draw dropped");
+				return;
+			}
+			const GeometryRange &range = arena_->getRange(allocation_);
+			context.setPrimitiveTopology(topology_);
+			context.drawIndexedInstanced(indexcount_, instanceCount, range.startIndex, range.baseVertex, startInstance);
+			return;
+		}
+		setVertexBuffers(context);
+		context.setIndexBuffer(indexbuffer_, (RENDER_FORMAT) IndexTypeToEnum<IND_TYPE>::value, 0);
+		context.setPrimitiveTopology(topology_);
+		context.drawIndexedInstanced(indexcount_, instanceCount, 0, 0, startInstance);
 	}
 protected:
-	virtual void finalizeVertices(ID3D11Device &dev) = 0;
-	inline virtual void setVertexBuffers(ID3D11DeviceContext &devcon) = 0;
+	virtual void finalizeVertices(RenderDevice &dev) = 0;
+	virtual unsigned int allocateGeometry(GeometryArena &arena) = 0;
+	inline virtual void setVertexBuffers(RenderContext &context) = 0;
 
-	ID3D11Buffer *indexbuffer_;
-	UINT indexcount_;
-	D3D11_PRIMITIVE_TOPOLOGY topology_;
+	RenderBuffer *indexbuffer_;
+	unsigned int indexcount_;
+	PRIMITIVE_TOPOLOGY topology_;
 	std::vector<IND_TYPE> inds_;
+	// set when the geometry lives in an arena, allocation_ is its handle there
+	GeometryArena *arena_;
+	unsigned int allocation_;
 };
 
 template<class VERT_TYPE, typename IND_TYPE>
 class InterleavedMesh : public Mesh<IND_TYPE>
 {
 public:
-	InterleavedMesh(D3D11_PRIMITIVE_TOPOLOGY topology) : Mesh<IND_TYPE>(topology) {}
-	virtual ~InterleavedMesh() { vertexbuffer_->Release(); }
+	InterleavedMesh(PRIMITIVE_TOPOLOGY topology) : Mesh<IND_TYPE>(topology), vertexbuffer_(0) {}
+	virtual ~InterleavedMesh() { delete vertexbuffer_; }
 
 	InterleavedMesh& addVert(const VERT_TYPE &newvert)
 	{
@@ -86,33 +146,38 @@ public:
 		return *this;
 	}
 
+	void getPositions(std::vector<fl3> &positions) const
+	{
+		positions.resize(verts_.size());
+		for (size_t i = 0; i < verts_.size(); i++) {
+			positions[i] = vertexPosition(verts_[i]);
+		}
+	}
+
 private:
-	void finalizeVertices(ID3D11Device &dev)
+	void finalizeVertices(RenderDevice &dev)
+	{
+		BufferDesc vbufdesc;
+		vbufdesc.usage = USAGE_DEFAULT;
+		vbufdesc.byteWidth = sizeof(VERT_TYPE) * verts_.size();
+		vbufdesc.bindFlags = BIND_VERTEX_BUFFER;
+
+		vertexbuffer_ = dev.createBuffer(vbufdesc, &verts_[0]);
+	}
+
+	unsigned int allocateGeometry(GeometryArena &arena)
 	{
-		D3D11_BUFFER_DESC vbufdesc;
-		ZeroMemory(&vbufdesc, sizeof(D3D11_BUFFER_DESC));
-
-		vbufdesc.Usage = D3D11_USAGE_DEFAULT;
-		vbufdesc.ByteWidth = sizeof(VERT_TYPE) * verts_.size();
-		vbufdesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		vbufdesc.CPUAccessFlags = 0;
-		vbufdesc.MiscFlags = 0;
-		
-		D3D11_SUBRESOURCE_DATA subr;
-		ZeroMemory(&subr, sizeof(D3D11_SUBRESOURCE_DATA));
-
-		subr.pSysMem = &verts_[0];
-		dev.CreateBuffer(&vbufdesc, &subr, &vertexbuffer_);
+		const std::vector<IND_TYPE> &inds = this->inds_;
+		return arena.allocate(verts_.empty() ? 0 : &verts_[0], (unsigned int) verts_.size(), sizeof(VERT_TYPE),
+			inds.empty() ? 0 : &inds[0], (unsigned int) inds.size(), (RENDER_FORMAT) IndexTypeToEnum<IND_TYPE>::value);
 	}
 
-	inline void setVertexBuffers(ID3D11DeviceContext &devcon)
+	inline void setVertexBuffers(RenderContext &context)
 	{
-		UINT stride = sizeof(VERT_TYPE);
-		UINT offset = 0;
-		devcon.IASetVertexBuffers(0, 1, &vertexbuffer_, &stride, &offset);
+		context.setVertexBuffer(vertexbuffer_, sizeof(VERT_TYPE), 0);
 	}
 
-	ID3D11Buffer *vertexbuffer_; // one vertex buffer for interleaved vertices
+	RenderBuffer *vertexbuffer_; // one vertex buffer for interleaved vertices
 	std::vector<VERT_TYPE> verts_;
 };
 
@@ -0,0 +1,272 @@
+#include "normalencoding.h"
+#include <math.h>
+#include <emmintrin.h>
+
+// smallest 8 * (1 - z) the spheremap divides by, keeps the pole pointing away from the camera finite
+#define SPHEREMAP_EPSILON 1e-12f
+
+static const NormalEncodingInfo EncodingInfos[NORMAL_ENCODING_COUNT] = {
+	{ "oct16", "R8G8_SNORM", 16, 2 },
+	{ "oct24", "R8G8B8A8_UNORM", 24, 4 },
+	{ "oct32", "R16G16_SNORM", 32, 4 },
+	{ "spheremap16", "R8G8_SNORM", 16, 2 },
+	{ "spheremap24", "R8G8B8A8_UNORM", 24, 4 },
+	{ "spheremap32", "R16G16_SNORM", 32, 4 },
+	{ "xyz32", "R10G10B10A2_UNORM", 30, 4 }
+};
+
+const NormalEncodingInfo& GetNormalEncodingInfo(NORMAL_ENCODING encoding)
+{
+	return EncodingInfos[encoding];
+}
+
+static inline bool isOctahedral(NORMAL_ENCODING encoding)
+{
+	return encoding <= NORMAL_ENCODING_OCT32;
+}
+
+// the scalar code mirrors the sse code operation for operation, so both give the same bits:
+// min/max with the operand order of minps/maxps, rounding half away from zero by adding +-0.5 and truncating,
+// and real divisions and square roots instead of the rcp/rsqrt approximations
+static inline float minps(float a, float b) { return a < b ? a : b; }
+static inline float maxps(float a, float b) { return a > b ? a : b; }
+static inline float clampUnit(float v) { return maxps(minps(v, 1.f), -1.f); }
+static inline int roundHalfAway(float v) { return (int) (v + (v >= 0.f ? 0.5f : -0.5f)); }
+static inline float signNotZero(float v) { return v >= 0.f ? 1.f : -1.f; }
+
+// the two coordinates of a normal in [-1, 1]
+static inline void project(NORMAL_ENCODING encoding, const fl3 &n, float &ex, float &ey)
+{
+	if (isOctahedral(encoding)) {
+		const float s = 1.f / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+		ex = n.x * s;
+		ey = n.y * s;
+		if (n.z < 0.f) {
+			const float fx = (1.f - fabsf(ey)) * signNotZero(ex);
+			const float fy = (1.f - fabsf(ex)) * signNotZero(ey);
+			ex = fx;
+			ey = fy;
+		}
+	} else {
+		// around -z, the direction towards the camera in LH view space, scaled from the radius 0.5 disc to [-1, 1]
+		const float f = 2.f / sqrtf(maxps(8.f - 8.f * n.z, SPHEREMAP_EPSILON));
+		ex = n.x * f;
+		ey = n.y * f;
+	}
+	ex = clampUnit(ex);
+	ey = clampUnit(ey);
+}
+
+static inline fl3 unproject(NORMAL_ENCODING encoding, float ex, float ey)
+{
+	float x, y, z;
+	if (isOctahedral(encoding)) {
+		x = ex;
+		y = ey;
+		z = 1.f - fabsf(ex) - fabsf(ey);
+		if (z < 0.f) {
+			x = (1.f - fabsf(ey)) * signNotZero(ex);
+			y = (1.f - fabsf(ex)) * signNotZero(ey);
+		}
+	} else {
+		const float fx = 2.f * ex, fy = 2.f * ey;
+		const float f = fx * fx + fy * fy;
+		const float g = sqrtf(maxps(1.f - 0.25f * f, 0.f));
+		x = fx * g;
+		y = fy * g;
+		z = 0.5f * f - 1.f;
+	}
+	const float inv = 1.f / sqrtf(x * x + y * y + z * z);
+	return fl3(x * inv, y * inv, z * inv);
+}
+
+// the render target bits of the two coordinates: snorm for 16 and 32 bits, 2 x 12 bit unorm for 24
+static inline uint32_t quantize(int bits, float ex, float ey)
+{
+	if (bits == 16) {
+		return ((uint32_t) roundHalfAway(ex * 127.f) & 0xff) | ((uint32_t) roundHalfAway(ey * 127.f) & 0xff) << 8;
+	}
+	if (bits == 32) {
+		return ((uint32_t) roundHalfAway(ex * 32767.f) & 0xffff) | (uint32_t) roundHalfAway(ey * 32767.f) << 16;
+	}
+	return (uint32_t) roundHalfAway((ex * 0.5f + 0.5f) * 4095.f) | (uint32_t) roundHalfAway((ey * 0.5f + 0.5f) * 4095.f) << 12;
+}
+
+// snorm decodes like d3d: the most negative value is clamped to -1
+static inline void dequantize(int bits, uint32_t packed, float &ex, float &ey)
+{
+	if (bits == 16) {
+		ex = maxps((float) (int8_t) (packed & 0xff) * (1.f / 127.f), -1.f);
+		ey = maxps((float) (int8_t) (packed >> 8 & 0xff) * (1.f / 127.f), -1.f);
+	} else if (bits == 32) {
+		ex = maxps((float) (int16_t) (packed & 0xffff) * (1.f / 32767.f), -1.f);
+		ey = maxps((float) (int16_t) (packed >> 16) * (1.f / 32767.f), -1.f);
+	} else {
+		ex = (float) (packed & 0xfff) * (2.f / 4095.f) - 1.f;
+		ey = (float) (packed >> 12 & 0xfff) * (2.f / 4095.f) - 1.f;
+	}
+}
+
+uint32_t encodeNormal(NORMAL_ENCODING encoding, const fl3 &n)
+{
+	if (encoding == NORMAL_ENCODING_XYZ32) {
+		uint32_t packed = 0;
+		for (int i = 0; i < 3; i++) {
+			packed |= (uint32_t) roundHalfAway((clampUnit(n[i]) * 0.5f + 0.5f) * 1023.f) << (10 * i);
+		}
+		return packed;
+	}
+	float ex, ey;
+	project(encoding, n, ex, ey);
+	return quantize(EncodingInfos[encoding].bits, ex, ey);
+}
+
+fl3 decodeNormal(NORMAL_ENCODING encoding, uint32_t packed)
+{
+	if (encoding == NORMAL_ENCODING_XYZ32) {
+		float v[3];
+		for (int i = 0; i < 3; i++) {
+			v[i] = (float) (packed >> (10 * i) & 0x3ff) * (2.f / 1023.f) - 1.f;
+		}
+		const float inv = 1.f / sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		return fl3(v[0] * inv, v[1] * inv, v[2] * inv);
+	}
+	float ex, ey;
+	dequantize(EncodingInfos[encoding].bits, packed, ex, ey);
+	return unproject(encoding, ex, ey);
+}
+
+// sse2 halves of the above, on 4 normals in structure of arrays form
+static inline __m128 absps(__m128 v) { return _mm_andnot_ps(_mm_set1_ps(-0.f), v); }
+static inline __m128 selectps(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+static inline __m128 clampUnit4(__m128 v) { return _mm_max_ps(_mm_min_ps(v, _mm_set1_ps(1.f)), _mm_set1_ps(-1.f)); }
+static inline __m128 signNotZero4(__m128 v) { return selectps(_mm_cmpge_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f), _mm_set1_ps(-1.f)); }
+
+static inline __m128i roundHalfAway4(__m128 v)
+{
+	const __m128 half = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(_mm_cmplt_ps(v, _mm_setzero_ps()), _mm_set1_ps(-0.f)));
+	return _mm_cvttps_epi32(_mm_add_ps(v, half));
+}
+
+static inline void project4(NORMAL_ENCODING encoding, __m128 x, __m128 y, __m128 z, __m128 &ex, __m128 &ey)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	if (isOctahedral(encoding)) {
+		const __m128 s = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(absps(x), absps(y)), absps(z)));
+		ex = _mm_mul_ps(x, s);
+		ey = _mm_mul_ps(y, s);
+		const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+		const __m128 fx = _mm_mul_ps(_mm_sub_ps(one, absps(ey)), signNotZero4(ex));
+		const __m128 fy = _mm_mul_ps(_mm_sub_ps(one, absps(ex)), signNotZero4(ey));
+		ex = selectps(lower, fx, ex);
+		ey = selectps(lower, fy, ey);
+	} else {
+		const __m128 eight = _mm_set1_ps(8.f);
+		const __m128 f = _mm_div_ps(_mm_set1_ps(2.f), _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(eight, _mm_mul_ps(eight, z)), _mm_set1_ps(SPHEREMAP_EPSILON))));
+		ex = _mm_mul_ps(x, f);
+		ey = _mm_mul_ps(y, f);
+	}
+	ex = clampUnit4(ex);
+	ey = clampUnit4(ey);
+}
+
+static inline void unproject4(NORMAL_ENCODING encoding, __m128 ex, __m128 ey, __m128 &x, __m128 &y, __m128 &z)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	if (isOctahedral(encoding)) {
+		z = _mm_sub_ps(_mm_sub_ps(one, absps(ex)), absps(ey));
+		const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+		x = selectps(lower, _mm_mul_ps(_mm_sub_ps(one, absps(ey)), signNotZero4(ex)), ex);
+		y = selectps(lower, _mm_mul_ps(_mm_sub_ps(one, absps(ex)), signNotZero4(ey)), ey);
+	} else {
+		const __m128 fx = _mm_mul_ps(_mm_set1_ps(2.f), ex), fy = _mm_mul_ps(_mm_set1_ps(2.f), ey);
+		const __m128 f = _mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy));
+		const __m128 g = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(0.25f), f)), _mm_setzero_ps()));
+		x = _mm_mul_ps(fx, g);
+		y = _mm_mul_ps(fy, g);
+		z = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(0.5f), f), one);
+	}
+	const __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+	x = _mm_mul_ps(x, inv);
+	y = _mm_mul_ps(y, inv);
+	z = _mm_mul_ps(z, inv);
+}
+
+static inline __m128i quantize4(int bits, __m128 ex, __m128 ey)
+{
+	if (bits == 16) {
+		const __m128i mask = _mm_set1_epi32(0xff);
+		const __m128 scale = _mm_set1_ps(127.f);
+		return _mm_or_si128(_mm_and_si128(roundHalfAway4(_mm_mul_ps(ex, scale)), mask),
+			_mm_slli_epi32(_mm_and_si128(roundHalfAway4(_mm_mul_ps(ey, scale)), mask), 8));
+	}
+	if (bits == 32) {
+		const __m128 scale = _mm_set1_ps(32767.f);
+		return _mm_or_si128(_mm_and_si128(roundHalfAway4(_mm_mul_ps(ex, scale)), _mm_set1_epi32(0xffff)),
+			_mm_slli_epi32(roundHalfAway4(_mm_mul_ps(ey, scale)), 16));
+	}
+	const __m128 half = _mm_set1_ps(0.5f), scale = _mm_set1_ps(4095.f);
+	return _mm_or_si128(roundHalfAway4(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(ex, half), half), scale)),
+		_mm_slli_epi32(roundHalfAway4(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(ey, half), half), scale)), 12));
+}
+
+static inline void dequantize4(int bits, __m128i packed, __m128 &ex, __m128 &ey)
+{
+	if (bits == 16) {
+		const __m128 scale = _mm_set1_ps(1.f / 127.f), minusOne = _mm_set1_ps(-1.f);
+		ex = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 24), 24)), scale), minusOne);
+		ey = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 16), 24)), scale), minusOne);
+	} else if (bits == 32) {
+		const __m128 scale = _mm_set1_ps(1.f / 32767.f), minusOne = _mm_set1_ps(-1.f);
+		ex = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 16), 16)), scale), minusOne);
+		ey = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(packed, 16)), scale), minusOne);
+	} else {
+		const __m128i mask = _mm_set1_epi32(0xfff);
+		const __m128 scale = _mm_set1_ps(2.f / 4095.f), one = _mm_set1_ps(1.f);
+		ex = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, mask)), scale), one);
+		ey = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 12), mask)), scale), one);
+	}
+}
+
+void encodeNormals(NORMAL_ENCODING encoding, const fl3 *normals, uint32_t *packed, size_t count)
+{
+	size_t i = 0;
+	if (encoding != NORMAL_ENCODING_XYZ32) {
+		const int bits = EncodingInfos[encoding].bits;
+		for (; i + 4 <= count; i += 4) {
+			const fl3 *n = normals + i;
+			const __m128 x = _mm_setr_ps(n[0].x, n[1].x, n[2].x, n[3].x);
+			const __m128 y = _mm_setr_ps(n[0].y, n[1].y, n[2].y, n[3].y);
+			const __m128 z = _mm_setr_ps(n[0].z, n[1].z, n[2].z, n[3].z);
+			__m128 ex, ey;
+			project4(encoding, x, y, z, ex, ey);
+			_mm_storeu_si128((__m128i *) (packed + i), quantize4(bits, ex, ey));
+		}
+	}
+	for (; i < count; i++) {
+		packed[i] = encodeNormal(encoding, normals[i]);
+	}
+}
+
+void decodeNormals(NORMAL_ENCODING encoding, const uint32_t *packed, fl3 *normals, size_t count)
+{
+	size_t i = 0;
+	if (encoding != NORMAL_ENCODING_XYZ32) {
+		const int bits = EncodingInfos[encoding].bits;
+		for (; i + 4 <= count; i += 4) {
+			__m128 ex, ey, x, y, z;
+			dequantize4(bits, _mm_loadu_si128((const __m128i *) (packed + i)), ex, ey);
+			unproject4(encoding, ex, ey, x, y, z);
+			float xs[4], ys[4], zs[4];
+			_mm_storeu_ps(xs, x);
+			_mm_storeu_ps(ys, y);
+			_mm_storeu_ps(zs, z);
+			for (int k = 0; k < 4; k++) {
+				normals[i + k] = fl3(xs[k], ys[k], zs[k]);
+			}
+		}
+	}
+	for (; i < count; i++) {
+		normals[i] = decodeNormal(encoding, packed[i]);
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef NORMALENCODING_H
+#define NORMALENCODING_H
+
+#include "utils.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// packed normal formats for the prepass target, the cpu side of samples/ao/normalencoding.hlsli
+// a packed normal is the bits of one texel of the render target format, in the low bits of a uint32_t
+//
+// octahedral: the normal is projected onto the octahedron |x| + |y| + |z| = 1 and the lower half folded over the
+// diagonals, giving two coordinates in [-1, 1] that cover the whole sphere with nearly uniform precision
+// spheremap: lambert azimuthal equal-area projection around -z, only for view space normals, the precision
+// goes to the direction pointing away from the camera (which is never visible) and decodes badly near it
+enum NORMAL_ENCODING {
+	NORMAL_ENCODING_OCT16 = 0, // R8G8_SNORM
+	NORMAL_ENCODING_OCT24, // 2 x 12 bit unorm in the rgb of R8G8B8A8_UNORM, alpha left free
+	NORMAL_ENCODING_OCT32, // R16G16_SNORM
+	NORMAL_ENCODING_SPHEREMAP16, // R8G8_SNORM
+	NORMAL_ENCODING_SPHEREMAP24, // as OCT24
+	NORMAL_ENCODING_SPHEREMAP32, // R16G16_SNORM
+	NORMAL_ENCODING_XYZ32, // n * 0.5 + 0.5 in R10G10B10A2_UNORM, the straightforward 32 bit format, for comparison
+	NORMAL_ENCODING_COUNT
+};
+
+struct NormalEncodingInfo {
+	const char *name;
+	const char *format; // dxgi format of the render target, without the DXGI_FORMAT_ prefix
+	int bits; // bits the encoding uses
+	int bytesPerPixel; // texel size of the format
+};
+
+const NormalEncodingInfo& GetNormalEncodingInfo(NORMAL_ENCODING encoding);
+
+// n has to be normalized (zero normals, like the cleared prepass, come back as some unit vector)
+uint32_t encodeNormal(NORMAL_ENCODING encoding, const fl3 &n);
+fl3 decodeNormal(NORMAL_ENCODING encoding, uint32_t packed);
+
+// sse2 versions over arrays, 4 normals at a time, bit identical to the single normal functions
+void encodeNormals(NORMAL_ENCODING encoding, const fl3 *normals, uint32_t *packed, size_t count);
+void decodeNormals(NORMAL_ENCODING encoding, const uint32_t *packed, fl3 *normals, size_t count);
+
+#endif // NORMALENCODING_H
@@ -0,0 +1,115 @@
+#include "normalreconstruction.h"
+#include "lineardepth.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+
+// rows handed to a worker at a time
+#define NORMAL_ROW_GRAIN 16
+
+// view space positions of the depth buffer's pixel centers, same reconstruction as AoSampler::position
+class NormalPositions {
+public:
+	NormalPositions(const FloatImage &depth, const Matrix &invProj, const FloatImage *viewZ) : depth_(depth), viewZ_(viewZ)
+	{
+		memcpy(invProj_, invProj.data(), sizeof(invProj_));
+		LinearDepth::GetRayCoefficients(invProj, rays_);
+		uScale_ = 1.f / depth.getWidth();
+		vScale_ = 1.f / depth.getHeight();
+	}
+
+	fl3 at(int x, int y) const
+	{
+		const float u = (x + 0.5f) * uScale_, v = (y + 0.5f) * vScale_;
+		if (viewZ_) {
+			const float z = viewZ_->at(x, y);
+			return fl3((rays_[0] * u + rays_[1]) * z, (rays_[2] * v + rays_[3]) * z, z);
+		}
+		const float *m = invProj_;
+		const float nx = 2.f * u - 1.f;
+		const float ny = 1.f - 2.f * v;
+		const float z = depth_.at(x, y);
+		const float invw = 1.f / (m[3] * nx + m[7] * ny + m[11] * z + m[15]);
+		return fl3((m[0] * nx + m[4] * ny + m[8] * z + m[12]) * invw,
+			(m[1] * nx + m[5] * ny + m[9] * z + m[13]) * invw,
+			(m[2] * nx + m[6] * ny + m[10] * z + m[14]) * invw);
+	}
+
+private:
+	const FloatImage &depth_;
+	const FloatImage *viewZ_;
+	float invProj_[16];
+	float rays_[4];
+	float uScale_, vScale_;
+};
+
+// which neighbour along one axis the tangent is taken towards, -1 or 1
+// d points at the center's depth, stride steps along the axis, i is the center's index on it out of count
+static inline int chooseSide(NORMAL_TAPS taps, const float *d, int stride, int i, int count)
+{
+	if (i == 0) {
+		return 1;
+	}
+	if (i == count - 1) {
+		return -1;
+	}
+	const float center = d[0], prev = d[-stride], next = d[stride];
+	// the far plane is no surface, only take it when both sides are
+	if (prev >= 1.f || next >= 1.f) {
+		return prev >= 1.f ? 1 : -1;
+	}
+	if (taps == NORMAL_TAPS_5 && i >= 2 && i + 2 < count) {
+		const float prevError = fabsf(2.f * prev - d[-2 * stride] - center);
+		const float nextError = fabsf(2.f * next - d[2 * stride] - center);
+		return nextError < prevError ? 1 : -1;
+	}
+	return fabsf(next - center) < fabsf(prev - center) ? 1 : -1;
+}
+
+NormalReconstruction::NormalReconstruction()
+{
+
+}
+
+NormalReconstruction::~NormalReconstruction()
+{
+
+}
+
+void NormalReconstruction::build(const FloatImage &depth, const Matrix &invProj, NORMAL_TAPS taps, const FloatImage *viewZ)
+{
+	const int width = depth.getWidth();
+	const int height = depth.getHeight();
+	if (normals_.getWidth() != width || normals_.getHeight() != height) {
+		normals_.resize(width, height);
+	}
+	const NormalPositions positions (depth, invProj, viewZ);
+	parallelFor(0, height, NORMAL_ROW_GRAIN, [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			const float *row = depth.row(y);
+			fl3 *out = normals_.row(y);
+			for (int x = 0; x < width; x++) {
+				if (row[x] >= 1.f) {
+					out[x] = fl3();
+					continue;
+				}
+				const int sx = chooseSide(taps, row + x, 1, x, width);
+				const int sy = chooseSide(taps, row + x, width, y, height);
+				const fl3 center = positions.at(x, y);
+				// both differences point right and down whichever side they were taken on
+				const fl3 right = (positions.at(x + sx, y) - center) * (float) sx;
+				const fl3 down = (positions.at(x, y + sy) - center) * (float) sy;
+				fl3 n = cross(right, down);
+				const float len = sqrtf(dot(n, n));
+				if (len <= 0.f) {
+					// both neighbours on the same point, face the camera
+					n = -center;
+					normalize(n);
+				} else {
+					n = n / len;
+				}
+				out[x] = dot(n, center) > 0.f ? -n : n;
+			}
+		}
+	});
+}
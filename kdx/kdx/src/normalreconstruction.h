@@ -0,0 +1,39 @@
+#ifndef NORMALRECONSTRUCTION_H
+#define NORMALRECONSTRUCTION_H
+
+#include "image.hpp"
+#include "matrix.h"
+
+// neighbours per axis the reconstruction looks at
+enum NORMAL_TAPS {
+	NORMAL_TAPS_3 = 3, // center and the pixels either side, the side closer in depth wins
+	NORMAL_TAPS_5 = 5 // two pixels either side, the side that extrapolates to the center's depth wins
+};
+
+// view space normals from the depth buffer alone, so the prepass doesn't need a normal target
+// the normal is the cross product of a horizontal and a vertical difference of reconstructed positions,
+// each taken towards the neighbour on the same surface as the center: a plain central difference would average
+// the two sides of every silhouette and give a ring of bent normals around each object
+//
+// post-projection depth is linear in screen space across a plane, so with 5 taps a side whose two pixels predict
+// the center's depth by linear extrapolation is on the center's plane, which also picks right next to thin features
+// and creases where the closest neighbour is on the wrong surface (the 3 tap choice)
+//
+// normals face the camera (negative view z for LH view space), pixels at the far plane get a zero normal like the
+// cleared prepass target
+class NormalReconstruction {
+public:
+	NormalReconstruction();
+	virtual ~NormalReconstruction();
+
+	// depth is post-projection [0, 1], invProj the inverse of the projection it was rendered with
+	// viewZ is optional (LinearDepth of the same depth), positions then come from the ray factors instead of invProj
+	void build(const FloatImage &depth, const Matrix &invProj, NORMAL_TAPS taps, const FloatImage *viewZ = 0);
+
+	const Image<fl3>& getNormals() const { return normals_; }
+
+private:
+	Image<fl3> normals_;
+};
+
+#endif // NORMALRECONSTRUCTION_H
@@ -1,11 +1,18 @@
 #include "obj.h"
+#include "dxbase.h"
 #include <assert.h>
 #include <string>
 #include "sampler.h"
+#include "bvh.h"
 
-Obj::Obj(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename) : currentcombo_(0), min_(), max_()
+Obj::Obj(RenderDevice &dev, RenderContext &context, const wchar_t *filename, MaterialTable *table) : currentcombo_(0), min_(), max_(),
+	materialtable_(table), ownedtable_(0)
 {
-	loadFile(dev, devcon, filename);
+	if (!materialtable_) {
+		ownedtable_ = new MaterialTable();
+		materialtable_ = ownedtable_;
+	}
+	loadFile(dev, context, filename);
 }
 
 Obj::~Obj()
@@ -13,37 +20,117 @@ Obj::~Obj()
 	for (std::map<std::wstring, std::pair<ObjMesh *, ObjMaterial *>>::iterator iter = meshes_.begin(); iter != meshes_.end(); iter++) {
 		delete iter->second.first;
 	}
+	// after the meshes, they free their ranges of these
+	for (std::map<unsigned int, GeometryArena *>::iterator iter = arenas_.begin(); iter != arenas_.end(); iter++) {
+		delete iter->second;
+	}
 	for (std::map<std::wstring, ObjMaterial *>::iterator iter = materials_.begin(); iter != materials_.end(); iter++) {
 		delete iter->second;
 	}
 	for (std::map<std::wstring, Texture *>::iterator iter = textures_.begin(); iter != textures_.end(); iter++) {
 		delete iter->second;
 	}
+	delete ownedtable_;
 }
 
-void Obj::draw(ID3D11Device &dev, ID3D11DeviceContext &devcon)
+void Obj::draw(RenderDevice &dev, RenderContext &context)
 {
-	 for (std::map<std::wstring, std::pair<ObjMesh *, ObjMaterial *>>::const_iterator iter = meshes_.begin(); iter != meshes_.end(); iter++) {
-		 ObjMaterial &curmat = *(iter->second.second);
-		 // set constant buffer (input slot 1)
-		 devcon.PSSetConstantBuffers(1, 1, &curmat.materialbuffer);
+	// WORKNOTE: this used to walk meshes_, alphabetical by group name, which switched materials and textures
+	// about as often as possible. sorted, every material is bound once per draw call
+	queue_.clear();
+	enqueue(queue_, 0, 0, 0);
+	queue_.sort();
+	for (size_t i = 0; i < queue_.size(); i++) {
+		drawMesh(dev, context, queue_.getPayload(i));
+	}
+}
 
-		 // also set textures
-		 curmat.map_Ka->use(devcon, 0);
-		 curmat.map_Kd->use(devcon, 1);
-		 curmat.map_Ks->use(devcon, 2);
+void Obj::enqueue(RenderQueue &queue, unsigned int pass, unsigned int shader, uint32_t payloadBase) const
+{
+	for (size_t i = 0; i < draws_.size(); i++) {
+		const ObjMaterial *mat = draws_[i].second;
+		const uint64_t key = RenderQueue::MakeKey(pass, shader, mat ? mat->index : 0, mat ? mat->textureset : 0, 0);
+		queue.push(key, payloadBase + (uint32_t) i);
+	}
+}
 
-		 // use default color texture sampler
-		 Sampler::GetDefaultSampler(dev).use(devcon, 0);
+void Obj::drawMesh(RenderDevice &dev, RenderContext &context, unsigned int mesh)
+{
+	bindMaterial(dev, context, *(draws_[mesh].second));
 
-		 // draw the actual mesh
-		 ObjMesh &curmesh = *(iter->second.first);
-		 curmesh.draw(dev, devcon);
-	 }
+	// draw the actual mesh
+	ObjMesh &curmesh = *(draws_[mesh].first);
+	curmesh.draw(dev, context);
 }
 
+void Obj::drawInstanced(RenderDevice &dev, RenderContext &context, const ObjInstanceBuffer &instances)
+{
+	if (instances.getCount() == 0) {
+		return;
+	}
+	// the overrides index the bound part of the table
+	assert(instances.getMaterialCount() <= materialtable_->getBoundCount());
+	instances.use(context);
+	materialtable_->useTable(context, STAGE_PIXEL, 2);
+	queue_.clear();
+	enqueue(queue_, 0, 0, 0);
+	queue_.sort();
+	for (size_t i = 0; i < queue_.size(); i++) {
+		const unsigned int mesh = queue_.getPayload(i);
+		bindMaterial(dev, context, *(draws_[mesh].second));
+		draws_[mesh].first->drawInstanced(dev, context, instances.getCount(), 0);
+	}
+}
+
+void Obj::bindMaterial(RenderDevice &dev, RenderContext &context, const ObjMaterial &material)
+{
+	// set the material's range of the table as the constant buffer (input slot 1)
+	materialtable_->use(context, STAGE_PIXEL, 1, material.index);
+
+	// also set textures
+	material.map_Ka->use(context, 0);
+	material.map_Kd->use(context, 1);
+	material.map_Ks->use(context, 2);
 
-bool Obj::loadFile(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename)
+	// use default color texture sampler
+	Sampler::GetDefaultSampler(dev).use(context, 0);
+}
+
+void Obj::buildDrawList()
+{
+	std::map<std::vector<const Texture *>, unsigned int> texturesets;
+	for (std::map<std::wstring, ObjMaterial *>::iterator it = materials_.begin(); it != materials_.end(); it++) {
+		ObjMaterial *mat = it->second;
+		std::vector<const Texture *> textures;
+		textures.push_back(mat->map_Ka);
+		textures.push_back(mat->map_Kd);
+		textures.push_back(mat->map_Ks);
+		std::map<std::vector<const Texture *>, unsigned int>::iterator set = texturesets.find(textures);
+		if (set == texturesets.end()) {
+			set = texturesets.insert(std::make_pair(textures, (unsigned int) texturesets.size())).first;
+		}
+		mat->index = materialtable_->add(mat->cbuffer);
+		mat->textureset = set->second;
+	}
+	draws_.clear();
+	for (std::map<std::wstring, std::pair<ObjMesh *, ObjMaterial *>>::const_iterator iter = meshes_.begin(); iter != meshes_.end(); iter++) {
+		draws_.push_back(iter->second);
+	}
+}
+
+void Obj::addToBvh(Bvh &bvh, const Matrix &model) const
+{
+	std::vector<fl3> positions;
+	for (std::map<std::wstring, std::pair<ObjMesh *, ObjMaterial *>>::const_iterator iter = meshes_.begin(); iter != meshes_.end(); iter++) {
+		const ObjMesh &mesh = *(iter->second.first);
+		mesh.getPositions(positions);
+		if (!positions.empty() && !mesh.getInds().empty()) {
+			bvh.addTriangles(&positions[0], positions.size(), &mesh.getInds()[0], mesh.getInds().size(), model);
+		}
+	}
+}
+
+bool Obj::loadFile(RenderDevice &dev, RenderContext &context, const wchar_t *filename)
 {
     //printf("trying to load obj file %s\n", filename); fflush(stdout);
 	FILE *pFile = 0;
@@ -78,7 +165,7 @@ bool Obj::loadFile(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filen
 					mtlfile = fullpath.substr(0, slashindex + 1) + (mtlfile);
 				}
 				// insert a new material
-				loadMaterials(dev, devcon, mtlfile.c_str());
+				loadMaterials(dev, context, mtlfile.c_str());
 			} else {
 				printf("found undefined mtlfile %s, which is bad, but continuing\n", buf); fflush(stdout);
 			}
@@ -125,20 +212,20 @@ bool Obj::loadFile(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filen
 			if (texs_.size() == 0 && norms_.size() == 0) {
 				// we only have positions
                 //printf("create new PMesh\n"); fflush(stdout);
-				currentmesh = createPMesh(dev, devcon, pFile);
+				currentmesh = createPMesh(dev, context, pFile);
 			} else if (texs_.size() == 0) {
 				// we have positions and normals
 				//printf("we've read %u verts and %u normals\n", verts_.size(), norms_.size()); fflush(stdout);
                 //printf("create new PNMesh\n"); fflush(stdout);
-				currentmesh = createPNMesh(dev, devcon, pFile);
+				currentmesh = createPNMesh(dev, context, pFile);
 			} else if (norms_.size() == 0) {
 				// we have positions and texcoords
                 //printf("create new PTMesh\n"); fflush(stdout);
-				currentmesh = createPTMesh(dev, devcon, pFile);
+				currentmesh = createPTMesh(dev, context, pFile);
 			} else {
 				// we have all 3
                 //printf("create new PTNMesh\n"); fflush(stdout);
-				currentmesh = createPTNMesh(dev, devcon, pFile);
+				currentmesh = createPTNMesh(dev, context, pFile);
 			}
 			// put it in the map
 			if(meshname.length() == 0) {
@@ -155,6 +242,7 @@ bool Obj::loadFile(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filen
 		}
 		fgetpos(pFile, &lastread);
 	}
+	buildDrawList();
 	// clear temporary stuff
 	verts_.clear();
 	texs_.clear();
@@ -162,10 +250,15 @@ bool Obj::loadFile(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filen
 	inds_.clear();
 	mtlfiles_.clear();
 	combos_.clear();
+	// a shared table is finalized by its owner, once all of its Objs are loaded
+	if (ownedtable_ && !ownedtable_->finalize(dev)) {
+		DxBase::ThrowError(L"failed to create the material table");
+		return false;
+	}
 	return true;
 }
 
-bool Obj::loadMaterials(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename)
+bool Obj::loadMaterials(RenderDevice &dev, RenderContext &context, const wchar_t *filename)
 {
     //printf("trying to load mtl file %s\n", filename); fflush(stdout);
 	FILE *pFile = 0;
@@ -236,7 +329,7 @@ bool Obj::loadMaterials(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR
 			std::wstring fulltexpath = directory + texpath;
 			if (textures_.find(texpath) == textures_.end()) {
 				// insert a new texture
-				textures_[texpath] = new Texture(dev, devcon, fulltexpath.c_str());
+				textures_[texpath] = new Texture(dev, context, fulltexpath.c_str());
 			}
 			currentmat->map_Ka = textures_[texpath];
 		} else if (wcscmp(buf, L"map_Kd") == 0) {
@@ -245,7 +338,7 @@ bool Obj::loadMaterials(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR
 			std::wstring fulltexpath = directory + buf;
 			if (textures_.find(texpath) == textures_.end()) {
 				// insert a new texture
-				textures_[texpath] = new Texture(dev, devcon, fulltexpath.c_str());
+				textures_[texpath] = new Texture(dev, context, fulltexpath.c_str());
 			}
 			currentmat->map_Kd = textures_[texpath];
 		} else if (wcscmp(buf, L"map_Ks") == 0) {
@@ -254,43 +347,34 @@ bool Obj::loadMaterials(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR
 			std::wstring fulltexpath = directory + buf;
 			if (textures_.find(texpath) == textures_.end()) {
 				// insert a new texture
-				textures_[texpath] = new Texture(dev, devcon, fulltexpath.c_str());
+				textures_[texpath] = new Texture(dev, context, fulltexpath.c_str());
 			}
 			currentmat->map_Ks = textures_[texpath];
 		}
 	}
 	
-	// common buffer description
-	D3D11_BUFFER_DESC bufferdesc;
-	ZeroMemory(&bufferdesc, sizeof(D3D11_BUFFER_DESC));
-	bufferdesc.Usage = D3D11_USAGE_DEFAULT;
-	// constant buffer must have size of multiple 16 bytes
-	bufferdesc.ByteWidth = 16 * (sizeof(ObjMaterial) / 16) + (((sizeof(ObjMaterial) % 16) > 0) ? 16 : 0 ); // round up to the nearest 16 byte boundary
-	bufferdesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	bufferdesc.CPUAccessFlags = 0; // WORKNOTE: if we use map+memcpy, this needs to be CPU_ACCESS_WRITE
-	bufferdesc.MiscFlags = 0;
-	bufferdesc.StructureByteStride = 0;
-
-	for (std::map<std::wstring, ObjMaterial *>::iterator it = materials_.begin(); it != materials_.end(); it++) {
-		ObjMaterial *mat = it->second;
-		// make a constant buffer for these material properties
-		D3D11_SUBRESOURCE_DATA subr;
-		ZeroMemory(&subr, sizeof(D3D11_SUBRESOURCE_DATA));
-		subr.pSysMem = &mat->cbuffer;
+	// WORKNOTE: this used to make a constant buffer per material, sized by sizeof(ObjMaterial) (the name, texture and
+	// buffer pointers included) instead of the cbuffer. the constants go into the MaterialTable in buildDrawList now
+	return true;
+}
 
-		HRESULT result = dev.CreateBuffer(&bufferdesc, &subr, &mat->materialbuffer);
-		if (FAILED(result)) {
-			return false;
-		}
+GeometryArena& Obj::getArena(RenderDevice &dev, unsigned int vertexStride)
+{
+	std::map<unsigned int, GeometryArena *>::iterator iter = arenas_.find(vertexStride);
+	if (iter != arenas_.end()) {
+		return *iter->second;
 	}
-	return true;
+	// small to start with, most files are a few thousand vertices
+	GeometryArena *arena = new GeometryArena(dev, vertexStride, FORMAT_R32_UINT, 4096, 12288);
+	arenas_[vertexStride] = arena;
+	return *arena;
 }
 
-Obj::ObjMesh* Obj::createPTNMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file)
+Obj::ObjMesh* Obj::createPTNMesh(RenderDevice &dev, RenderContext &context, FILE *file)
 {
 	//~ printf("creating ptn mesh\n"); fflush(stdout);
 	unsigned int read = 0;
-	InterleavedMesh<PTNvert, UINT32> *mesh = new InterleavedMesh<PTNvert, UINT32>(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<PTNvert, uint32_t> *mesh = new InterleavedMesh<PTNvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
 	currentcombo_ = 0;
 	combos_.clear();
 	// 3 vertex attributes with 3 floats each
@@ -333,17 +417,17 @@ Obj::ObjMesh* Obj::createPTNMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon,
 		}
 		fgetpos(file, &lastpos);
 	}
-	mesh->finalize(dev);
+	mesh->finalize(dev, getArena(dev, sizeof(PTNvert)));
 	// we've read all the faces, so make the mesh
 	return mesh;
 }
 
-Obj::ObjMesh* Obj::createPTMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file)
+Obj::ObjMesh* Obj::createPTMesh(RenderDevice &dev, RenderContext &context, FILE *file)
 {
 	unsigned int read = 0;
 	currentcombo_ = 0;
 	combos_.clear();
-	InterleavedMesh<PTvert, UINT32> *mesh = new InterleavedMesh<PTvert, UINT32>(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<PTvert, uint32_t> *mesh = new InterleavedMesh<PTvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
 	// 2 vertex attributes with 3 floats each
 	fpos_t lastpos;
 	wchar_t buf[512] = L"";
@@ -386,17 +470,17 @@ Obj::ObjMesh* Obj::createPTMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon,
 		fgetpos(file, &lastpos);
 	}
 	//~ printf("read %u faces\n", read); fflush(stdout);
-	mesh->finalize(dev);
+	mesh->finalize(dev, getArena(dev, sizeof(PTvert)));
 	// we've read all the faces, so make the mesh
 	return mesh;
 }
 
-Obj::ObjMesh* Obj::createPNMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file)
+Obj::ObjMesh* Obj::createPNMesh(RenderDevice &dev, RenderContext &context, FILE *file)
 {
 	currentcombo_ = 0;
 	combos_.clear();
     //printf("creating pn mesh\n"); fflush(stdout);
-	InterleavedMesh<PNvert, UINT32> *mesh = new InterleavedMesh<PNvert, UINT32>(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<PNvert, uint32_t> *mesh = new InterleavedMesh<PNvert, uint32_t>(TOPOLOGY_TRIANGLELIST);
 	// 2 vertex attributes with 3 floats each
 	fpos_t lastpos;
 	wchar_t buf[512] = L"";
@@ -435,16 +519,16 @@ Obj::ObjMesh* Obj::createPNMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon,
 		fgetpos(file, &lastpos);
 	}
     //printf("read %u faces\n", faces); fflush(stdout);
-	mesh->finalize(dev);
+	mesh->finalize(dev, getArena(dev, sizeof(PNvert)));
 	// we've read all the faces, so make the mesh
 	return mesh;
 }
 
-Obj::ObjMesh* Obj::createPMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file)
+Obj::ObjMesh* Obj::createPMesh(RenderDevice &dev, RenderContext &context, FILE *file)
 {
 	currentcombo_ = 0;
 	combos_.clear();
-	InterleavedMesh<fl3, UINT32> *mesh = new InterleavedMesh<fl3, UINT32>(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	InterleavedMesh<fl3, uint32_t> *mesh = new InterleavedMesh<fl3, uint32_t>(TOPOLOGY_TRIANGLELIST);
 	// 2 vertex attributes with 3 floats each
 	fpos_t lastpos;
 	wchar_t buf[512] = L"";
@@ -478,7 +562,7 @@ Obj::ObjMesh* Obj::createPMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, F
 		}
 		fgetpos(file, &lastpos);
 	}
-	mesh->finalize(dev);
+	mesh->finalize(dev, getArena(dev, sizeof(fl3)));
 	// we've read all the faces, so make the mesh
 	return mesh;
 }
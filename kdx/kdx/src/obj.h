@@ -1,15 +1,44 @@
 #ifndef OBJ_H
 #define OBJ_H
+#include "materialtable.h"
 #include "mesh.hpp"
+#include "objinstances.h"
+#include "renderqueue.h"
 #include "texture.h"
+#include <stdio.h>
+#include <map>
+#include <string>
+
+class Bvh;
+class Matrix;
 
 // class for representing OBJ models
 class Obj {
 public:
-	Obj(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename); // allowing wide characters for non-english filenames
+	// WORKNOTE: the parsing uses the msvc wide character file functions, only the drawing goes through the device
+	// the materials go into table, shared by all the Objs drawn together and finalized once they're loaded, or into a
+	// table of the Obj's own when it's null
+	Obj(RenderDevice &dev, RenderContext &context, const wchar_t *filename, MaterialTable *table = 0); // allowing wide characters for non-english filenames
 	virtual ~Obj();
 
-	void draw(ID3D11Device &dev, ID3D11DeviceContext &devcon);
+	// draws the meshes sorted by material and texture set, through a RenderQueue
+	void draw(RenderDevice &dev, RenderContext &context);
+	// records one draw per mesh into a shared queue, the payload is payloadBase plus the mesh index for drawMesh
+	// WORKNOTE: the texture set ids in the keys are this Obj's own, the material ids are only shared with the other Objs
+	// of its MaterialTable
+	void enqueue(RenderQueue &queue, unsigned int pass, unsigned int shader, uint32_t payloadBase) const;
+	// binds the mesh's material and draws it, repeated binds of the same material are filtered by the StateCache
+	void drawMesh(RenderDevice &dev, RenderContext &context, unsigned int mesh);
+	// draws every instance in instances with one drawIndexedInstanced per mesh, sorted like draw
+	// the shaders and a layout with ObjInstanceElements are bound by the caller (prepassinstanced.hlsl or
+	// objrenderinstanced.hlsl), the material table goes into pixel shader slot 2 for the material overrides
+	void drawInstanced(RenderDevice &dev, RenderContext &context, const ObjInstanceBuffer &instances);
+	// the bounding box of the model, what instances are culled by
+	const fl3& getMin() const { return min_; }
+	const fl3& getMax() const { return max_; }
+	unsigned int getMeshCount() const { return (unsigned int) draws_.size(); }
+	// adds the triangles of every mesh, transformed by model, to bvh (which still needs a build)
+	void addToBvh(Bvh &bvh, const Matrix &model) const;
 
 private:
 	// bounding box
@@ -17,35 +46,7 @@ private:
 
 	// struct for materials
 	struct ObjMaterial {
-		virtual ~ObjMaterial() { materialbuffer->Release(); }
-		struct ObjConstantBuffer {
-			FLOAT Ns; // specular coefficient
-			FLOAT Ni; // index of refraction
-			union {
-				FLOAT d, Tr; // transparency (can have both notations)
-			};
-			FLOAT padding0;
-			fl3 Tf; // transmission filter (allows only certain colors through)
-			
-
-			UINT32 illum; // illumination model
-			// 0 means constant illumination (color = Kd)
-			// 1 means lambertian model (diffuse and ambient only)
-			// 2 means lambert + blinn-phong (diffuse, specular, and ambient)
-			// there's more at http://en.wikipedia.org/wiki/Wavefront_.obj_file
-			// but these are the basics
-
-			// we need padding to make vectors not straddle 16 byte boundaries
-			// http://msdn.microsoft.com/en-us/library/windows/desktop/bb509632%28v=vs.85%29.aspx
-			fl3 Ka; // ambient color
-			FLOAT padding1;
-			fl3 Kd; // diffuse color
-			FLOAT padding2;
-			fl3 Ks; // specular color
-			FLOAT padding3;
-			fl3 Ke; // emissive color
-			FLOAT padding4;
-		} cbuffer;
+		MaterialConstants cbuffer;
 		std::wstring name;
 
 		// eventually want textures here
@@ -54,43 +55,61 @@ private:
 		Texture *map_Ks;
 		// WORKNOTE: might want to redo this to make resource and sampler arrays so we can bind all at once
 
-		// also want handles for whatever d3d structures (buffers, etc)
-		ID3D11Buffer *materialbuffer;
+		// the material's index in the MaterialTable, also its sort key id
+		unsigned int index;
+		// dense id for the sort keys, materials with the same three textures share a texture set
+		unsigned int textureset;
 	};
 
 	// container for the mesh/geometry data itself
 	// one Obj can have multiple meshes
-	typedef Mesh<UINT32> ObjMesh;
+	typedef Mesh<uint32_t> ObjMesh;
+
+	bool loadFile(RenderDevice &dev, RenderContext &context, const wchar_t *filename);
+	bool loadMaterials(RenderDevice &dev, RenderContext &context, const wchar_t *filename);
 
-	bool loadFile(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename);
-	bool loadMaterials(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename);
+	// binds the material of a mesh (constants, textures and sampler)
+	void bindMaterial(RenderDevice &dev, RenderContext &context, const ObjMaterial &material);
+
+	// the arena of the Obj's meshes with this vertex size, made on first use
+	GeometryArena& getArena(RenderDevice &dev, unsigned int vertexStride);
 
 	// functions to create a mesh out of the mesh-specific parts of the file
-	ObjMesh* createPTNMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file);
-	ObjMesh* createPTMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file);
-	ObjMesh* createPNMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file);
-	ObjMesh* createPMesh(ID3D11Device &dev, ID3D11DeviceContext &devcon, FILE *file);
+	ObjMesh* createPTNMesh(RenderDevice &dev, RenderContext &context, FILE *file);
+	ObjMesh* createPTMesh(RenderDevice &dev, RenderContext &context, FILE *file);
+	ObjMesh* createPNMesh(RenderDevice &dev, RenderContext &context, FILE *file);
+	ObjMesh* createPMesh(RenderDevice &dev, RenderContext &context, FILE *file);
+	// adds the materials to the table, assigns the texture set ids and lists the meshes for enqueue/drawMesh
+	void buildDrawList();
 	
 	// intermediate vectors for storing vertices, texcoords, normals
 	std::vector<fl3> verts_;
 	std::vector<fl3> texs_;
 	std::vector<fl3> norms_;
 	// faces/indices
-	std::vector<UINT32> inds_;
+	std::vector<uint32_t> inds_;
 	
 	// temporary variables for parsing materials
 	std::map<std::wstring, bool> mtlfiles_;
 	// textures can be shared for multiple materials, so a map to keep track of them
 	std::map<std::wstring, Texture *> textures_;
 	// temporary map of which v/t/n combos have been assigned to which index
-	std::map<int3, UINT32> combos_;
-	UINT32 currentcombo_;
+	std::map<int3, uint32_t> combos_;
+	uint32_t currentcombo_;
 		
 	// map of materials by addressable name
 	std::map<std::wstring, ObjMaterial *> materials_;
-	// uniform buffers for these materials
-		
+	// the constants of these materials, ownedtable_ is set when the Obj has a table of its own
+	MaterialTable *materialtable_;
+	MaterialTable *ownedtable_;
+
 	// map for storing the final meshes and associated materials
 	std::map<std::wstring, std::pair<ObjMesh *, ObjMaterial *>> meshes_;
+	// the same meshes by index, in the map's (alphabetical) order
+	std::vector<std::pair<ObjMesh *, ObjMaterial *>> draws_;
+	// the meshes' geometry by vertex size, so the groups of a file share one vertex and index buffer per layout (PTvert
+	// and PNvert meshes share one too, the buffers only care about the stride)
+	std::map<unsigned int, GeometryArena *> arenas_;
+	RenderQueue queue_;
 };
 #endif // OBJ_H
\ No newline at end of file
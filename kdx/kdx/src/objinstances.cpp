@@ -0,0 +1,161 @@
+#include "objinstances.h"
+#include "materialtable.h"
+#include "matrix.h"
+#include <math.h>
+
+const InputElement ObjInstanceElements[OBJ_INSTANCE_ELEMENTS] =
+{
+	{"TRANSFORM", 0, FORMAT_R32G32B32A32_FLOAT, 0, true},
+	{"TRANSFORM", 1, FORMAT_R32G32B32A32_FLOAT, 16, true},
+	{"TRANSFORM", 2, FORMAT_R32G32B32A32_FLOAT, 32, true},
+	{"MATERIAL", 0, FORMAT_R32_UINT, 48, true}
+};
+
+/*static*/ ObjInstance ObjInstance::FromMatrix(const Matrix &model, uint32_t material)
+{
+	ObjInstance instance;
+	const float *m = model.data();
+	for (int c = 0; c < 3; c++) {
+		for (int r = 0; r < 4; r++) {
+			instance.transform[c][r] = m[r * 4 + c];
+		}
+	}
+	instance.material = material;
+	return instance;
+}
+
+ObjInstanceStats::ObjInstanceStats() : submitted(0), visible(0), grows(0), droppedOverrides(0)
+{
+
+}
+
+ObjInstanceBuffer::ObjInstanceBuffer(RenderDevice &dev, unsigned int capacity) : buffer_(0), capacity_(0), count_(0), materialcount_(0)
+{
+	BufferDesc desc;
+	desc.byteWidth = capacity * sizeof(ObjInstance);
+	desc.usage = USAGE_DYNAMIC;
+	desc.bindFlags = BIND_VERTEX_BUFFER;
+	buffer_ = dev.createBuffer(desc, 0);
+	if (buffer_) {
+		capacity_ = capacity;
+	}
+}
+
+ObjInstanceBuffer::~ObjInstanceBuffer()
+{
+	delete buffer_;
+}
+
+/*static*/ void ObjInstanceBuffer::CullInstances(const ObjInstance *instances, size_t count, const fl3 &min, const fl3 &max,
+	const Matrix &view, const Matrix &proj, std::vector<ObjInstance> &visible)
+{
+	// view * proj for row vectors, then the frustum planes as combinations of its columns (z in [0, 1] like d3d)
+	const float *v = view.data();
+	const float *p = proj.data();
+	float vp[16];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			vp[r * 4 + c] = v[r * 4] * p[c] + v[r * 4 + 1] * p[4 + c] + v[r * 4 + 2] * p[8 + c] + v[r * 4 + 3] * p[12 + c];
+		}
+	}
+	float planes[6][4];
+	for (int r = 0; r < 4; r++) {
+		const float x = vp[r * 4], y = vp[r * 4 + 1], z = vp[r * 4 + 2], w = vp[r * 4 + 3];
+		planes[0][r] = w + x;
+		planes[1][r] = w - x;
+		planes[2][r] = w + y;
+		planes[3][r] = w - y;
+		planes[4][r] = z;
+		planes[5][r] = w - z;
+	}
+
+	const float center[3] = { 0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z) };
+	const float extent[3] = { 0.5f * (max.x - min.x), 0.5f * (max.y - min.y), 0.5f * (max.z - min.z) };
+	for (size_t i = 0; i < count; i++) {
+		const float (*t)[4] = instances[i].transform;
+		// the box around the transformed box, in world space
+		float worldCenter[3], worldExtent[3];
+		for (int c = 0; c < 3; c++) {
+			worldCenter[c] = center[0] * t[c][0] + center[1] * t[c][1] + center[2] * t[c][2] + t[c][3];
+			worldExtent[c] = extent[0] * fabsf(t[c][0]) + extent[1] * fabsf(t[c][1]) + extent[2] * fabsf(t[c][2]);
+		}
+		bool inside = true;
+		for (int k = 0; k < 6 && inside; k++) {
+			const float distance = planes[k][0] * worldCenter[0] + planes[k][1] * worldCenter[1] + planes[k][2] * worldCenter[2] + planes[k][3];
+			const float radius = fabsf(planes[k][0]) * worldExtent[0] + fabsf(planes[k][1]) * worldExtent[1] + fabsf(planes[k][2]) * worldExtent[2];
+			inside = distance + radius >= 0.f;
+		}
+		if (inside) {
+			visible.push_back(instances[i]);
+		}
+	}
+}
+
+unsigned int ObjInstanceBuffer::update(RenderDevice &dev, RenderContext &context, const ObjInstance *instances, size_t count,
+	const fl3 &min, const fl3 &max, const Matrix &view, const Matrix &proj)
+{
+	visible_.clear();
+	CullInstances(instances, count, min, max, view, proj, visible_);
+	stats_ = ObjInstanceStats();
+	stats_.submitted = (unsigned int) count;
+	upload(dev, context, visible_.empty() ? 0 : &visible_[0], visible_.size());
+	return count_;
+}
+
+unsigned int ObjInstanceBuffer::update(RenderDevice &dev, RenderContext &context, const ObjInstance *instances, size_t count)
+{
+	stats_ = ObjInstanceStats();
+	stats_.submitted = (unsigned int) count;
+	upload(dev, context, instances, count);
+	return count_;
+}
+
+bool ObjInstanceBuffer::upload(RenderDevice &dev, RenderContext &context, const ObjInstance *instances, size_t count)
+{
+	count_ = 0;
+	materialcount_ = 0;
+	for (size_t i = 0; i < count; i++) {
+		const uint32_t material = instances[i].material;
+		if (material == OBJ_NO_MATERIAL_OVERRIDE) {
+			continue;
+		}
+		if (material >= MATERIAL_TABLE_BOUND_SIZE) {
+			// the culled instances are in visible_ already, the others are copied there to drop the override
+			if (visible_.empty() || instances != &visible_[0]) {
+				visible_.assign(instances, instances + count);
+				instances = &visible_[0];
+			}
+			visible_[i].material = OBJ_NO_MATERIAL_OVERRIDE;
+			stats_.droppedOverrides++;
+		} else if (material >= materialcount_) {
+			materialcount_ = material + 1;
+		}
+	}
+	if (count > capacity_) {
+		// grow by half again so a slowly growing count doesn't recreate it every frame
+		const size_t capacity = count + count / 2;
+		BufferDesc desc;
+		desc.byteWidth = capacity * sizeof(ObjInstance);
+		desc.usage = USAGE_DYNAMIC;
+		desc.bindFlags = BIND_VERTEX_BUFFER;
+		RenderBuffer *buffer = dev.createBuffer(desc, 0);
+		if (!buffer) {
+			return false;
+		}
+		delete buffer_;
+		buffer_ = buffer;
+		capacity_ = (unsigned int) capacity;
+		stats_.grows++;
+	}
+	if (count > 0) {
+		context.updateBuffer(buffer_, instances, count * sizeof(ObjInstance));
+	}
+	count_ = (unsigned int) count;
+	stats_.visible = count_;
+	return true;
+}
+
+void ObjInstanceBuffer::use(RenderContext &context) const
+{
+	context.setInstanceBuffer(buffer_, sizeof(ObjInstance), 0);
+}
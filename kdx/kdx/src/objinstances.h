@@ -0,0 +1,82 @@
+#ifndef OBJINSTANCES_H
+#define OBJINSTANCES_H
+
+#include "renderdevice.h"
+#include "utils.h"
+#include <vector>
+
+class Matrix;
+
+// per-instance data of instanced Obj drawing (Obj::drawInstanced), what prepassinstanced.hlsl and
+// objrenderinstanced.hlsl read through the TRANSFORM and MATERIAL elements
+// the instances are culled against the camera frustum on the cpu before they're uploaded, so the gpu only gets the
+// ones that can be on screen
+
+// keeps the materials of the Obj's meshes
+#define OBJ_NO_MATERIAL_OVERRIDE 0xffffffff
+#define OBJ_INSTANCE_ELEMENTS 4
+
+struct ObjInstance {
+	// the first three columns of the instance's model matrix (the fourth is always 0, 0, 0, 1), so the shaders can
+	// transform with one dot product per component
+	float transform[3][4];
+	// index into the MaterialTable of a material that replaces every mesh's, or OBJ_NO_MATERIAL_OVERRIDE
+	// the shaders only see the first MATERIAL_TABLE_BOUND_SIZE materials, uploads drop overrides past them
+	uint32_t material;
+
+	// model as D3DX builds it (Matrix::data() layout), rotation and uniform scale only for the normals to be right
+	static ObjInstance FromMatrix(const Matrix &model, uint32_t material = OBJ_NO_MATERIAL_OVERRIDE);
+};
+
+// the per-instance elements of ObjInstance, append them to a mesh layout's own
+extern const InputElement ObjInstanceElements[OBJ_INSTANCE_ELEMENTS];
+
+struct ObjInstanceStats {
+	ObjInstanceStats();
+
+	unsigned int submitted;
+	unsigned int visible;
+	// the buffer was too small and got recreated
+	unsigned int grows;
+	// material overrides outside what MaterialTable::useTable binds, uploaded without them
+	unsigned int droppedOverrides;
+};
+
+// the instances of one Obj, in a dynamic vertex buffer that is rewritten every update
+class ObjInstanceBuffer {
+public:
+	ObjInstanceBuffer(RenderDevice &dev, unsigned int capacity = 1024);
+	virtual ~ObjInstanceBuffer();
+
+	// uploads the instances whose transformed bounds (min, max in model space) can be inside the frustum of view and
+	// proj, the matrices as D3DX builds them (Matrix::data() layout). returns the number uploaded
+	unsigned int update(RenderDevice &dev, RenderContext &context, const ObjInstance *instances, size_t count,
+		const fl3 &min, const fl3 &max, const Matrix &view, const Matrix &proj);
+	// uploads all of them
+	unsigned int update(RenderDevice &dev, RenderContext &context, const ObjInstance *instances, size_t count);
+	// binds the buffer as the instance stream
+	void use(RenderContext &context) const;
+
+	unsigned int getCount() const { return count_; }
+	// one past the highest material override uploaded, 0 without any
+	unsigned int getMaterialCount() const { return materialcount_; }
+	// counters of the last update
+	const ObjInstanceStats& getStats() const { return stats_; }
+
+	// appends the instances that pass the frustum test to visible, the box of each is transformed to an axis aligned
+	// one around its center first, which keeps some that are just outside
+	static void CullInstances(const ObjInstance *instances, size_t count, const fl3 &min, const fl3 &max,
+		const Matrix &view, const Matrix &proj, std::vector<ObjInstance> &visible);
+
+private:
+	bool upload(RenderDevice &dev, RenderContext &context, const ObjInstance *instances, size_t count);
+
+	RenderBuffer *buffer_;
+	unsigned int capacity_;
+	unsigned int count_;
+	unsigned int materialcount_;
+	std::vector<ObjInstance> visible_;
+	ObjInstanceStats stats_;
+};
+
+#endif // OBJINSTANCES_H
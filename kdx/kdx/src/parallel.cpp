@@ -0,0 +1,120 @@
+#include "parallel.h"
+
+// set while a thread is executing chunks, so nested parallelFor calls run inline instead of deadlocking
+static thread_local bool InsideJob = false;
+// parked value for the chunk counter between jobs, so a worker waking late can't claim a chunk of the next job early
+static const int NoChunks = 1 << 30;
+
+ThreadPool::ThreadPool(unsigned int numThreads) : quit_(false), job_(0), jobBegin_(0), jobEnd_(0), jobGrain_(1), jobChunks_(0), nextChunk_(NoChunks), chunksLeft_(0), generation_(0)
+{
+	if (numThreads == 0) {
+		numThreads = std::thread::hardware_concurrency();
+	}
+	if (numThreads == 0) {
+		numThreads = 1;
+	}
+	// the calling thread counts as one of the workers
+	for (unsigned int i = 1; i < numThreads; i++) {
+		workers_.push_back(std::thread(&ThreadPool::workerMain, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	wake_.notify_all();
+	for (size_t i = 0; i < workers_.size(); i++) {
+		workers_[i].join();
+	}
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &func)
+{
+	if (end <= begin) {
+		return;
+	}
+	if (grain < 1) {
+		grain = 1;
+	}
+	const int numChunks = (end - begin + grain - 1) / grain;
+	if (InsideJob || workers_.empty() || numChunks == 1) {
+		for (int b = begin; b < end; b += grain) {
+			func(b, (end - b < grain) ? end : b + grain);
+		}
+		return;
+	}
+
+	// only one job in flight at a time
+	std::lock_guard<std::mutex> submit(submitMutex_);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &func;
+		jobBegin_ = begin;
+		jobEnd_ = end;
+		jobGrain_ = grain;
+		jobChunks_ = numChunks;
+		chunksLeft_ = numChunks;
+		nextChunk_ = 0;
+		generation_++;
+	}
+	wake_.notify_all();
+
+	InsideJob = true;
+	runChunks();
+	InsideJob = false;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (chunksLeft_ > 0) {
+		done_.wait(lock);
+	}
+	nextChunk_ = NoChunks;
+	job_ = 0;
+}
+
+void ThreadPool::workerMain()
+{
+	unsigned int seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (!quit_ && generation_ == seen) {
+				wake_.wait(lock);
+			}
+			if (quit_) {
+				return;
+			}
+			seen = generation_;
+		}
+		InsideJob = true;
+		runChunks();
+		InsideJob = false;
+	}
+}
+
+void ThreadPool::runChunks()
+{
+	for (;;) {
+		const int chunk = nextChunk_++;
+		if (chunk >= jobChunks_) {
+			break;
+		}
+		const int b = jobBegin_ + chunk * jobGrain_;
+		const int e = (jobEnd_ - b < jobGrain_) ? jobEnd_ : b + jobGrain_;
+		(*job_)(b, e);
+		if (--chunksLeft_ == 0) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_.notify_all();
+		}
+	}
+}
+
+/*static*/ ThreadPool& ThreadPool::GetDefaultPool()
+{
+	// created once on the first call even when several threads make it at the same time (a function-local static is
+	// initialized thread safely), never destroyed so jobs running at exit don't lose their pool
+	static ThreadPool *pool = new ThreadPool();
+	return *pool;
+}
@@ -0,0 +1,55 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// simple persistent worker pool for the cpu-side image and geometry passes
+// workers sleep on a condition variable between jobs, so per-frame dispatches don't pay thread creation
+class ThreadPool {
+public:
+	// 0 threads means one per hardware thread
+	explicit ThreadPool(unsigned int numThreads = 0);
+	virtual ~ThreadPool();
+
+	// runs func(chunkBegin, chunkEnd) over [begin, end) split into chunks of at most grain indices
+	// the calling thread works on chunks too and the call returns once every chunk has finished
+	// WORKNOTE: calling parallelFor from inside a job runs the nested range inline on the calling worker
+	void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &func);
+
+	unsigned int getNumThreads() const { return (unsigned int) workers_.size() + 1; }
+
+private:
+	void workerMain();
+	void runChunks();
+
+	std::vector<std::thread> workers_;
+	std::mutex submitMutex_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	bool quit_;
+
+	// current job
+	const std::function<void(int, int)> *job_;
+	int jobBegin_, jobEnd_, jobGrain_;
+	std::atomic<int> jobChunks_;
+	std::atomic<int> nextChunk_;
+	std::atomic<int> chunksLeft_;
+	unsigned int generation_;
+
+public:
+	static ThreadPool& GetDefaultPool();
+};
+
+// convenience wrapper around the default pool
+inline void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &func)
+{
+	ThreadPool::GetDefaultPool().parallelFor(begin, end, grain, func);
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,513 @@
+#include "rasterizer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+// screen tiles, each one is rasterized start to finish by a single worker
+#define RAST_TILE_SIZE 64
+// triangles per setup/binning job
+#define RAST_SETUP_GRAIN 2048
+// vertices per transform job
+#define RAST_TRANSFORM_GRAIN 4096
+// 28.4 fixed point like the d3d rasterizer (which has 8 subpixel bits, 4 keep the tile-local edge values in 32 bits)
+#define RAST_SUBPIXEL_BITS 4
+#define RAST_SUBPIXEL (1 << RAST_SUBPIXEL_BITS)
+// x and y are clipped to +-guardband * w in clip space, which bounds the fixed point coordinates for up to 4K targets
+#define RAST_GUARDBAND 4.0f
+// a convex polygon clipped against 6 planes has at most 9 vertices
+#define RAST_MAX_CLIPPED 9
+
+Rasterizer::Rasterizer() : cullmode_(CULL_BACK), quantizedepth_(true), writenormals_(true), tilesx_(0), tilesy_(0), binsUsed_(0)
+{
+	Matrix identity;
+	memcpy(mvp_, identity.data(), sizeof(mvp_));
+	memcpy(modelview_, identity.data(), sizeof(modelview_));
+	memset(&stats_, 0, sizeof(Stats));
+}
+
+Rasterizer::~Rasterizer()
+{
+
+}
+
+void Rasterizer::resize(int width, int height)
+{
+	normals_.resize(width, height);
+	depth_.resize(width, height, 1.f);
+	tilesx_ = (width + RAST_TILE_SIZE - 1) / RAST_TILE_SIZE;
+	tilesy_ = (height + RAST_TILE_SIZE - 1) / RAST_TILE_SIZE;
+	// bins are sized for the tile count, so they have to be rebuilt
+	bins_.clear();
+}
+
+void Rasterizer::beginFrame()
+{
+	draws_.clear();
+}
+
+void Rasterizer::setTransform(const Matrix &model, const Matrix &view, const Matrix &proj)
+{
+	// row-vector d3dx convention is model * view * proj, which is proj * view * model for column vectors
+	Matrix mvp (proj);
+	mvp.multMatrix(view);
+	mvp.multMatrix(model);
+	memcpy(mvp_, mvp.data(), sizeof(mvp_));
+	Matrix modelview (view);
+	modelview.multMatrix(model);
+	memcpy(modelview_, modelview.data(), sizeof(modelview_));
+}
+
+void Rasterizer::draw(const PTNvert *verts, size_t vertcount, const uint8_t *inds, size_t indexcount)
+{
+	addDraw(verts, vertcount, inds, 1, indexcount);
+}
+
+void Rasterizer::draw(const PTNvert *verts, size_t vertcount, const uint16_t *inds, size_t indexcount)
+{
+	addDraw(verts, vertcount, inds, 2, indexcount);
+}
+
+void Rasterizer::draw(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount)
+{
+	addDraw(verts, vertcount, inds, 4, indexcount);
+}
+
+void Rasterizer::addDraw(const PTNvert *verts, size_t vertcount, const void *inds, int indexSize, size_t indexcount)
+{
+	DrawCall call;
+	call.verts = verts;
+	call.vertcount = vertcount;
+	call.inds = inds;
+	call.indexSize = indexSize;
+	call.indexcount = indexcount - indexcount % 3;
+	memcpy(call.mvp, mvp_, sizeof(mvp_));
+	memcpy(call.modelview, modelview_, sizeof(modelview_));
+	call.firstVertex = draws_.empty() ? 0 : draws_.back().firstVertex + draws_.back().vertcount;
+	call.firstTriangle = draws_.empty() ? 0 : draws_.back().firstTriangle + draws_.back().indexcount / 3;
+	draws_.push_back(call);
+}
+
+void Rasterizer::endFrame()
+{
+	memset(&stats_, 0, sizeof(Stats));
+	stats_.tiles = tilesx_ * tilesy_;
+	if (stats_.tiles == 0) {
+		return;
+	}
+
+	size_t triangles = 0;
+	if (!draws_.empty()) {
+		triangles = draws_.back().firstTriangle + draws_.back().indexcount / 3;
+		clipverts_.resize(draws_.back().firstVertex + draws_.back().vertcount);
+	}
+	stats_.trianglesSubmitted = (uint32_t) triangles;
+
+	transformVertices();
+
+	// setup and binning, one bin per job
+	binsUsed_ = (triangles + RAST_SETUP_GRAIN - 1) / RAST_SETUP_GRAIN;
+	if (bins_.size() < binsUsed_) {
+		bins_.resize(binsUsed_);
+	}
+	parallelFor(0, (int) binsUsed_, 1, [&](int b0, int b1) {
+		for (int b = b0; b < b1; b++) {
+			const size_t first = (size_t) b * RAST_SETUP_GRAIN;
+			setupTriangles(first, std::min(first + RAST_SETUP_GRAIN, triangles), bins_[b]);
+		}
+	});
+	for (size_t b = 0; b < binsUsed_; b++) {
+		stats_.trianglesRasterized += (uint32_t) bins_[b].tris.size();
+		for (size_t t = 0; t < bins_[b].tiles.size(); t++) {
+			stats_.binEntries += (uint32_t) bins_[b].tiles[t].size();
+		}
+	}
+
+	// tiles are independent, so each one is cleared and rasterized by one worker while it is in cache
+	parallelFor(0, tilesx_ * tilesy_, 1, [&](int t0, int t1) {
+		for (int t = t0; t < t1; t++) {
+			rasterizeTile(t);
+		}
+	});
+}
+
+void Rasterizer::transformVertices()
+{
+	// flatten the draws into one vertex range so the transform is spread evenly over the workers
+	const int vertcount = (int) clipverts_.size();
+	parallelFor(0, vertcount, RAST_TRANSFORM_GRAIN, [&](int v0, int v1) {
+		size_t d = 0;
+		while (draws_[d].firstVertex + draws_[d].vertcount <= (size_t) v0) {
+			d++;
+		}
+		for (int v = v0; v < v1; v++) {
+			while ((size_t) v >= draws_[d].firstVertex + draws_[d].vertcount) {
+				d++;
+			}
+			const DrawCall &call = draws_[d];
+			const float *m = call.mvp;
+			const PTNvert &in = call.verts[v - call.firstVertex];
+			ClipVert &out = clipverts_[v];
+			// same as the mul(pos, model/view/proj) chain in prepass.hlsl with pos.w = 1
+			out.x = m[0] * in.pos.x + m[4] * in.pos.y + m[8] * in.pos.z + m[12];
+			out.y = m[1] * in.pos.x + m[5] * in.pos.y + m[9] * in.pos.z + m[13];
+			out.z = m[2] * in.pos.x + m[6] * in.pos.y + m[10] * in.pos.z + m[14];
+			out.w = m[3] * in.pos.x + m[7] * in.pos.y + m[11] * in.pos.z + m[15];
+			// the prepass' view space normal, model and view are rotations (plus uniform scale) there too
+			const float *n = call.modelview;
+			out.norm.x = n[0] * in.norm.x + n[4] * in.norm.y + n[8] * in.norm.z;
+			out.norm.y = n[1] * in.norm.x + n[5] * in.norm.y + n[9] * in.norm.z;
+			out.norm.z = n[2] * in.norm.x + n[6] * in.norm.y + n[10] * in.norm.z;
+		}
+	});
+}
+
+static inline size_t fetchIndex(const void *inds, int indexSize, size_t i)
+{
+	switch (indexSize) {
+	case 1:
+		return ((const uint8_t *) inds)[i];
+	case 2:
+		return ((const uint16_t *) inds)[i];
+	default:
+		return ((const uint32_t *) inds)[i];
+	}
+}
+
+// signed distance of a clip space vertex to each of the clip planes, inside is >= 0
+static inline float planeDistance(const float *v, int plane)
+{
+	const float x = v[0], y = v[1], z = v[2], w = v[3];
+	switch (plane) {
+	case 0: return z; // near, d3d depth starts at 0
+	case 1: return w - z; // far
+	case 2: return x + RAST_GUARDBAND * w;
+	case 3: return RAST_GUARDBAND * w - x;
+	case 4: return y + RAST_GUARDBAND * w;
+	default: return RAST_GUARDBAND * w - y;
+	}
+}
+
+void Rasterizer::setupTriangles(size_t first, size_t last, Bin &bin)
+{
+	bin.tris.clear();
+	if (bin.tiles.size() != (size_t) (tilesx_ * tilesy_)) {
+		bin.tiles.resize(tilesx_ * tilesy_);
+	}
+	for (size_t t = 0; t < bin.tiles.size(); t++) {
+		bin.tiles[t].clear();
+	}
+
+	// find the draw containing the first triangle
+	size_t d = 0;
+	while (draws_[d].firstTriangle + draws_[d].indexcount / 3 <= first) {
+		d++;
+	}
+	for (size_t t = first; t < last; t++) {
+		while (t >= draws_[d].firstTriangle + draws_[d].indexcount / 3) {
+			d++;
+		}
+		const DrawCall &call = draws_[d];
+		const size_t local = (t - call.firstTriangle) * 3;
+		ClipVert tri[3];
+		unsigned int outcodes[3];
+		unsigned int clipmask = 0;
+		for (int i = 0; i < 3; i++) {
+			tri[i] = clipverts_[call.firstVertex + fetchIndex(call.inds, call.indexSize, local + i)];
+			outcodes[i] = 0;
+			for (int p = 0; p < 6; p++) {
+				if (planeDistance(&tri[i].x, p) < 0.f) {
+					outcodes[i] |= 1 << p;
+				}
+			}
+			clipmask |= outcodes[i];
+		}
+		if (outcodes[0] & outcodes[1] & outcodes[2]) {
+			// completely outside one plane
+			continue;
+		}
+		if (clipmask == 0) {
+			setupClipped(tri, 3, bin);
+			continue;
+		}
+
+		// sutherland-hodgman against the planes that are actually crossed
+		ClipVert polys[2][RAST_MAX_CLIPPED];
+		int count = 3;
+		int cur = 0;
+		memcpy(polys[0], tri, sizeof(tri));
+		for (int p = 0; p < 6 && count > 0; p++) {
+			if (!(clipmask & (1 << p))) {
+				continue;
+			}
+			const ClipVert *in = polys[cur];
+			ClipVert *out = polys[cur ^ 1];
+			int outcount = 0;
+			for (int i = 0; i < count; i++) {
+				const ClipVert &a = in[i];
+				const ClipVert &b = in[(i + 1) % count];
+				const float da = planeDistance(&a.x, p);
+				const float db = planeDistance(&b.x, p);
+				if (da >= 0.f) {
+					out[outcount++] = a;
+				}
+				if ((da >= 0.f) != (db >= 0.f)) {
+					const float s = da / (da - db);
+					ClipVert &v = out[outcount++];
+					v.x = a.x + s * (b.x - a.x);
+					v.y = a.y + s * (b.y - a.y);
+					v.z = a.z + s * (b.z - a.z);
+					v.w = a.w + s * (b.w - a.w);
+					v.norm = a.norm + (b.norm - a.norm) * s;
+				}
+			}
+			count = outcount;
+			cur ^= 1;
+		}
+		if (count >= 3) {
+			setupClipped(polys[cur], count, bin);
+		}
+	}
+}
+
+void Rasterizer::setupClipped(const ClipVert *poly, int count, Bin &bin)
+{
+	const int width = normals_.getWidth();
+	const int height = normals_.getHeight();
+
+	// viewport transform, y flipped since d3d viewports have the origin in the top left
+	int32_t fx[RAST_MAX_CLIPPED], fy[RAST_MAX_CLIPPED];
+	float sx[RAST_MAX_CLIPPED], sy[RAST_MAX_CLIPPED], sz[RAST_MAX_CLIPPED], sinvw[RAST_MAX_CLIPPED];
+	fl3 snorm[RAST_MAX_CLIPPED];
+	for (int i = 0; i < count; i++) {
+		const float invw = 1.f / poly[i].w;
+		const float px = (poly[i].x * invw * 0.5f + 0.5f) * width;
+		const float py = (0.5f - poly[i].y * invw * 0.5f) * height;
+		fx[i] = (int32_t) floor(px * RAST_SUBPIXEL + 0.5f);
+		fy[i] = (int32_t) floor(py * RAST_SUBPIXEL + 0.5f);
+		// attributes are interpolated from the snapped positions
+		sx[i] = fx[i] * (1.f / RAST_SUBPIXEL);
+		sy[i] = fy[i] * (1.f / RAST_SUBPIXEL);
+		sz[i] = poly[i].z * invw;
+		sinvw[i] = invw;
+		snorm[i] = poly[i].norm * invw;
+	}
+
+	// fan triangulation of the clipped polygon
+	for (int k = 1; k + 1 < count; k++) {
+		int v[3] = { 0, k, k + 1 };
+		int64_t area = (int64_t) (fx[v[1]] - fx[v[0]]) * (fy[v[2]] - fy[v[0]]) - (int64_t) (fx[v[2]] - fx[v[0]]) * (fy[v[1]] - fy[v[0]]);
+		if (area == 0) {
+			continue;
+		}
+		// positive area is clockwise on screen, which is the d3d front face
+		if ((cullmode_ == CULL_BACK && area < 0) || (cullmode_ == CULL_FRONT && area > 0)) {
+			continue;
+		}
+		if (area < 0) {
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		Triangle tri;
+		int32_t minfx = fx[v[0]], maxfx = fx[v[0]], minfy = fy[v[0]], maxfy = fy[v[0]];
+		for (int i = 1; i < 3; i++) {
+			minfx = std::min(minfx, fx[v[i]]);
+			maxfx = std::max(maxfx, fx[v[i]]);
+			minfy = std::min(minfy, fy[v[i]]);
+			maxfy = std::max(maxfy, fy[v[i]]);
+		}
+		// pixels whose centers (x * 16 + 8) fall inside the bounds
+		tri.minx = std::max(0, (minfx - RAST_SUBPIXEL / 2 + RAST_SUBPIXEL - 1) >> RAST_SUBPIXEL_BITS);
+		tri.miny = std::max(0, (minfy - RAST_SUBPIXEL / 2 + RAST_SUBPIXEL - 1) >> RAST_SUBPIXEL_BITS);
+		tri.maxx = std::min(width - 1, (maxfx - RAST_SUBPIXEL / 2) >> RAST_SUBPIXEL_BITS);
+		tri.maxy = std::min(height - 1, (maxfy - RAST_SUBPIXEL / 2) >> RAST_SUBPIXEL_BITS);
+		if (tri.minx > tri.maxx || tri.miny > tri.maxy) {
+			continue;
+		}
+
+		// edge functions E(p) = A * px + B * py + C, positive inside
+		for (int i = 0; i < 3; i++) {
+			const int a = v[i], b = v[(i + 1) % 3];
+			tri.edgeA[i] = fy[a] - fy[b];
+			tri.edgeB[i] = fx[b] - fx[a];
+			tri.edgeC[i] = -((int64_t) tri.edgeA[i] * fx[a] + (int64_t) tri.edgeB[i] * fy[a]);
+			// top-left rule: pixels exactly on an edge are only drawn for top and left edges
+			const bool topleft = (tri.edgeA[i] == 0 && tri.edgeB[i] > 0) || tri.edgeA[i] > 0;
+			if (!topleft) {
+				tri.edgeC[i] -= 1;
+			}
+		}
+
+		// attribute planes over pixel coordinates
+		const float x0 = sx[v[0]], y0 = sy[v[0]];
+		const float dx1 = sx[v[1]] - x0, dy1 = sy[v[1]] - y0;
+		const float dx2 = sx[v[2]] - x0, dy2 = sy[v[2]] - y0;
+		const float invarea = 1.f / (dx1 * dy2 - dx2 * dy1);
+		#define RAST_PLANE(plane, u0, u1, u2) { \
+			const float du1 = (u1) - (u0), du2 = (u2) - (u0); \
+			const float dudx = (du1 * dy2 - du2 * dy1) * invarea; \
+			const float dudy = (du2 * dx1 - du1 * dx2) * invarea; \
+			plane[0] = (u0) - dudx * x0 - dudy * y0; plane[1] = dudx; plane[2] = dudy; }
+		RAST_PLANE(tri.z, sz[v[0]], sz[v[1]], sz[v[2]]);
+		RAST_PLANE(tri.invw, sinvw[v[0]], sinvw[v[1]], sinvw[v[2]]);
+		for (int c = 0; c < 3; c++) {
+			RAST_PLANE(tri.norm[c], snorm[v[0]][c], snorm[v[1]][c], snorm[v[2]][c]);
+		}
+		#undef RAST_PLANE
+
+		// bin into every tile the bounds touch, rasterizeTile rejects the ones the triangle misses
+		const uint32_t index = (uint32_t) bin.tris.size();
+		bin.tris.push_back(tri);
+		for (int ty = tri.miny / RAST_TILE_SIZE; ty <= tri.maxy / RAST_TILE_SIZE; ty++) {
+			for (int tx = tri.minx / RAST_TILE_SIZE; tx <= tri.maxx / RAST_TILE_SIZE; tx++) {
+				bin.tiles[ty * tilesx_ + tx].push_back(index);
+			}
+		}
+	}
+}
+
+void Rasterizer::rasterizeTile(int tile)
+{
+	const int width = normals_.getWidth();
+	const int height = normals_.getHeight();
+	const int tx0 = (tile % tilesx_) * RAST_TILE_SIZE;
+	const int ty0 = (tile / tilesx_) * RAST_TILE_SIZE;
+	const int tx1 = std::min(tx0 + RAST_TILE_SIZE, width) - 1;
+	const int ty1 = std::min(ty0 + RAST_TILE_SIZE, height) - 1;
+
+	// clear, same as the clear of the prepass framebuffer
+	for (int y = ty0; y <= ty1; y++) {
+		float *depth = depth_.row(y);
+		for (int x = tx0; x <= tx1; x++) {
+			depth[x] = 1.f;
+		}
+		if (writenormals_) {
+			fl3 *norm = normals_.row(y);
+			for (int x = tx0; x <= tx1; x++) {
+				norm[x] = fl3();
+			}
+		}
+	}
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128i laneIndex = _mm_setr_epi32(0, 1, 2, 3);
+
+	for (size_t b = 0; b < binsUsed_; b++) {
+		const Bin &bin = bins_[b];
+		const std::vector<uint32_t> &list = bin.tiles[tile];
+		for (size_t i = 0; i < list.size(); i++) {
+			const Triangle &tri = bin.tris[list[i]];
+			const int x0 = std::max(tri.minx, tx0);
+			const int y0 = std::max(tri.miny, ty0);
+			const int x1 = std::min(tri.maxx, tx1);
+			const int y1 = std::min(tri.maxy, ty1);
+			if (x0 > x1 || y0 > y1) {
+				continue;
+			}
+
+			// classify each edge against the corners of the covered rectangle
+			// edges that contain the whole rectangle drop out, edges that cross it keep a 32 bit value
+			// (the crossing bounds |E| to about 2 * 2^19 * 64 * 16 inside the tile)
+			int32_t e0[3], stepx[3], stepy[3];
+			bool outside = false;
+			for (int e = 0; e < 3; e++) {
+				const int64_t A = tri.edgeA[e], B = tri.edgeB[e];
+				const int64_t cx0 = (int64_t) x0 * RAST_SUBPIXEL + RAST_SUBPIXEL / 2;
+				const int64_t cy0 = (int64_t) y0 * RAST_SUBPIXEL + RAST_SUBPIXEL / 2;
+				const int64_t cx1 = (int64_t) x1 * RAST_SUBPIXEL + RAST_SUBPIXEL / 2;
+				const int64_t cy1 = (int64_t) y1 * RAST_SUBPIXEL + RAST_SUBPIXEL / 2;
+				const int64_t origin = A * cx0 + B * cy0 + tri.edgeC[e];
+				const int64_t ex = A * (cx1 - cx0), ey = B * (cy1 - cy0);
+				const int64_t lo = origin + std::min<int64_t>(ex, 0) + std::min<int64_t>(ey, 0);
+				const int64_t hi = origin + std::max<int64_t>(ex, 0) + std::max<int64_t>(ey, 0);
+				if (hi < 0) {
+					outside = true;
+					break;
+				}
+				if (lo >= 0) {
+					e0[e] = 0;
+					stepx[e] = 0;
+					stepy[e] = 0;
+				} else {
+					e0[e] = (int32_t) origin;
+					stepx[e] = (int32_t) (A * RAST_SUBPIXEL);
+					stepy[e] = (int32_t) (B * RAST_SUBPIXEL);
+				}
+			}
+			if (outside) {
+				continue;
+			}
+
+			const __m128i step4x[3] = {
+				_mm_set1_epi32(stepx[0] * 4), _mm_set1_epi32(stepx[1] * 4), _mm_set1_epi32(stepx[2] * 4)
+			};
+			__m128i rowStart[3];
+			for (int e = 0; e < 3; e++) {
+				rowStart[e] = _mm_setr_epi32(e0[e], e0[e] + stepx[e], e0[e] + 2 * stepx[e], e0[e] + 3 * stepx[e]);
+			}
+
+			const __m128 zdx4 = _mm_set1_ps(tri.z[1] * 4.f);
+			for (int y = y0; y <= y1; y++) {
+				float *depthRow = depth_.row(y);
+				fl3 *normRow = normals_.row(y);
+				const float fy = y + 0.5f;
+				__m128i edge[3] = { rowStart[0], rowStart[1], rowStart[2] };
+				__m128 z = _mm_add_ps(_mm_set1_ps(tri.z[0] + tri.z[2] * fy), _mm_mul_ps(_mm_set1_ps(tri.z[1]), _mm_add_ps(_mm_set1_ps((float) x0), laneOffsets)));
+				for (int x = x0; x <= x1; x += 4) {
+					// a lane is inside when none of the edge values is negative
+					const __m128i anyneg = _mm_or_si128(_mm_or_si128(edge[0], edge[1]), edge[2]);
+					__m128i inside = _mm_cmpgt_epi32(_mm_setzero_si128(), anyneg);
+					inside = _mm_andnot_si128(inside, _mm_cmplt_epi32(_mm_add_epi32(laneIndex, _mm_set1_epi32(x)), _mm_set1_epi32(x1 + 1)));
+					int mask = _mm_movemask_ps(_mm_castsi128_ps(inside));
+					if (mask) {
+						if (x + 3 <= x1) {
+							const __m128 old = _mm_loadu_ps(depthRow + x);
+							const __m128 pass = _mm_and_ps(_mm_cmplt_ps(z, old), _mm_castsi128_ps(inside));
+							mask = _mm_movemask_ps(pass);
+							_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+						} else {
+							// partial block at the right edge of the tile
+							float zl[4];
+							_mm_storeu_ps(zl, z);
+							for (int l = 0; l < 4; l++) {
+								if ((mask & (1 << l)) && zl[l] < depthRow[x + l]) {
+									depthRow[x + l] = zl[l];
+								} else {
+									mask &= ~(1 << l);
+								}
+							}
+						}
+						// perspective correct normals for the lanes that passed the depth test
+						while (mask && writenormals_) {
+							const int l = mask & 1 ? 0 : (mask & 2 ? 1 : (mask & 4 ? 2 : 3));
+							mask &= ~(1 << l);
+							const float fx = x + l + 0.5f;
+							const float w = 1.f / (tri.invw[0] + tri.invw[1] * fx + tri.invw[2] * fy);
+							fl3 &n = normRow[x + l];
+							n.x = (tri.norm[0][0] + tri.norm[0][1] * fx + tri.norm[0][2] * fy) * w;
+							n.y = (tri.norm[1][0] + tri.norm[1][1] * fx + tri.norm[1][2] * fy) * w;
+							n.z = (tri.norm[2][0] + tri.norm[2][1] * fx + tri.norm[2][2] * fy) * w;
+						}
+					}
+					edge[0] = _mm_add_epi32(edge[0], step4x[0]);
+					edge[1] = _mm_add_epi32(edge[1], step4x[1]);
+					edge[2] = _mm_add_epi32(edge[2], step4x[2]);
+					z = _mm_add_ps(z, zdx4);
+				}
+				for (int e = 0; e < 3; e++) {
+					rowStart[e] = _mm_add_epi32(rowStart[e], _mm_set1_epi32(stepy[e]));
+				}
+			}
+		}
+	}
+
+	if (quantizedepth_) {
+		// round to the 16 bit unorm values the D16 prepass target stores
+		for (int y = ty0; y <= ty1; y++) {
+			float *depth = depth_.row(y);
+			for (int x = tx0; x <= tx1; x++) {
+				depth[x] = floor(depth[x] * 65535.f + 0.5f) * (1.f / 65535.f);
+			}
+		}
+	}
+}
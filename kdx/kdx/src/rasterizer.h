@@ -0,0 +1,119 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "image.hpp"
+#include "matrix.h"
+#include <stdint.h>
+#include <vector>
+
+// tile-binned software rasterizer that does the same job as samples/ao/prepass.hlsl:
+// transform by model * view * proj, depth test (LESS) and write the interpolated view space normal (model * view,
+// not normalized) and the depth
+// so the ao passes can run without a d3d device
+//
+// matrices use the D3DX layout (see Matrix::perspectiveFovLH), rasterization follows the d3d11 defaults the samples
+// rely on: clockwise front faces with back face culling, top-left fill rule, depth range [0, 1] clipped at near and far
+class Rasterizer {
+public:
+	enum CULL_MODE {
+		CULL_NONE = 0,
+		CULL_BACK = 1,
+		CULL_FRONT = 2
+	};
+
+	// counters for the last endFrame
+	struct Stats {
+		uint32_t trianglesSubmitted;
+		uint32_t trianglesRasterized; // after culling and clipping, clipped triangles can split in up to 3
+		uint32_t binEntries; // triangle/tile pairs
+		uint32_t tiles;
+	};
+
+	Rasterizer();
+	virtual ~Rasterizer();
+
+	void resize(int width, int height);
+	void setCullMode(CULL_MODE mode) { cullmode_ = mode; }
+	// round depth to D16_UNORM precision like the prepass depth target, on by default
+	void setDepthQuantization(bool quantize) { quantizedepth_ = quantize; }
+	// off for a depth only prepass (normals reconstructed with NormalReconstruction), getNormals is left untouched then
+	void setNormalOutput(bool write) { writenormals_ = write; }
+
+	// starts recording draws, the buffers are cleared (normal 0, depth 1) while the tiles are rasterized
+	void beginFrame();
+	// transform for the following draws, same matrices as the Matrices cbuffer in prepass.hlsl
+	void setTransform(const Matrix &model, const Matrix &view, const Matrix &proj);
+	// queues an indexed triangle list (e.g. the contents of an InterleavedMesh<PTNvert, ...>)
+	// the vertex and index arrays are only read in endFrame, so they have to stay alive until then
+	void draw(const PTNvert *verts, size_t vertcount, const uint8_t *inds, size_t indexcount);
+	void draw(const PTNvert *verts, size_t vertcount, const uint16_t *inds, size_t indexcount);
+	void draw(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount);
+	// transforms, bins and rasterizes everything queued since beginFrame
+	void endFrame();
+
+	// outputs, same contents as the prepass color target and depth buffer
+	const Image<fl3>& getNormals() const { return normals_; }
+	const FloatImage& getDepth() const { return depth_; }
+	const Stats& getStats() const { return stats_; }
+
+	int getWidth() const { return normals_.getWidth(); }
+	int getHeight() const { return normals_.getHeight(); }
+
+private:
+	struct DrawCall {
+		const PTNvert *verts;
+		size_t vertcount;
+		const void *inds;
+		int indexSize;
+		size_t indexcount;
+		float mvp[16];
+		float modelview[16]; // for the normals
+		size_t firstVertex; // into clipverts_
+		size_t firstTriangle;
+	};
+
+	struct ClipVert {
+		float x, y, z, w;
+		fl3 norm;
+	};
+
+	// per screen-space triangle setup, edges are in 28.4 fixed point relative to the pixel grid
+	struct Triangle {
+		int32_t edgeA[3], edgeB[3];
+		int64_t edgeC[3]; // includes the fill rule bias
+		float z[3]; // z/w plane: z = z[0] + z[1] * x + z[2] * y, x and y in pixels
+		float invw[3]; // 1/w plane for perspective correct attributes
+		float norm[3][3]; // n/w planes per component
+		int minx, miny, maxx, maxy; // pixel bounds, inclusive
+	};
+
+	// output of one setup job: its triangles and which tiles each of them touches
+	// kept per job so the binning needs no locks and tiles still see triangles in submission order
+	struct Bin {
+		std::vector<Triangle> tris;
+		std::vector<std::vector<uint32_t> > tiles;
+	};
+
+	void addDraw(const PTNvert *verts, size_t vertcount, const void *inds, int indexSize, size_t indexcount);
+	void transformVertices();
+	void setupTriangles(size_t first, size_t last, Bin &bin);
+	void setupClipped(const ClipVert *poly, int count, Bin &bin);
+	void rasterizeTile(int tile);
+
+	Image<fl3> normals_;
+	FloatImage depth_;
+	CULL_MODE cullmode_;
+	bool quantizedepth_;
+	bool writenormals_;
+	int tilesx_, tilesy_;
+
+	float mvp_[16];
+	float modelview_[16];
+	std::vector<DrawCall> draws_;
+	std::vector<ClipVert> clipverts_;
+	std::vector<Bin> bins_;
+	size_t binsUsed_;
+	Stats stats_;
+};
+
+#endif // RASTERIZER_H
@@ -0,0 +1,166 @@
+#include "raykernels.h"
+#include "cpufeatures.h"
+#include <math.h>
+#include <emmintrin.h>
+
+// parallel edges and grazing hits are treated as misses below this determinant, same as the bvh
+#define RAY_DETERMINANT_EPSILON 1e-12f
+
+void RayPacket8::load(const fl3 *origins, const fl3 *dirs, const float *tmaxs, int count)
+{
+	for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+		const bool used = i < count;
+		const fl3 o = used ? origins[i] : fl3(0.f, 0.f, 0.f);
+		const fl3 d = used ? dirs[i] : fl3(1.f, 1.f, 1.f);
+		ox[i] = o.x; oy[i] = o.y; oz[i] = o.z;
+		dx[i] = d.x; dy[i] = d.y; dz[i] = d.z;
+		idx[i] = 1.f / d.x; idy[i] = 1.f / d.y; idz[i] = 1.f / d.z;
+		tmax[i] = used ? tmaxs[i] : -1.f;
+	}
+}
+
+void TrianglePacket8::load(const fl3 *v0, const fl3 *v1, const fl3 *v2, int count)
+{
+	for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+		const bool used = i < count;
+		const fl3 a = used ? v0[i] : fl3(0.f, 0.f, 0.f);
+		const fl3 e1 = used ? v1[i] - v0[i] : fl3(0.f, 0.f, 0.f);
+		const fl3 e2 = used ? v2[i] - v0[i] : fl3(0.f, 0.f, 0.f);
+		v0x[i] = a.x; v0y[i] = a.y; v0z[i] = a.z;
+		e1x[i] = e1.x; e1y[i] = e1.y; e1z[i] = e1.z;
+		e2x[i] = e2.x; e2y[i] = e2.y; e2z[i] = e2.z;
+	}
+}
+
+// min and max with the operand order of minps/maxps, so a nan (a ray parallel to a slab starting on its plane)
+// drops that slab in every version alike instead of depending on the instruction set
+static inline float minps(float a, float b) { return a < b ? a : b; }
+static inline float maxps(float a, float b) { return a > b ? a : b; }
+
+static int intersectBoxScalar(const RayPacket8 &rays, const fl3 &min, const fl3 &max, float *tnear)
+{
+	int mask = 0;
+	for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+		const float tx0 = (min.x - rays.ox[i]) * rays.idx[i], tx1 = (max.x - rays.ox[i]) * rays.idx[i];
+		const float ty0 = (min.y - rays.oy[i]) * rays.idy[i], ty1 = (max.y - rays.oy[i]) * rays.idy[i];
+		const float tz0 = (min.z - rays.oz[i]) * rays.idz[i], tz1 = (max.z - rays.oz[i]) * rays.idz[i];
+		const float t0 = maxps(maxps(minps(tx0, tx1), minps(ty0, ty1)), maxps(minps(tz0, tz1), 0.f));
+		const float t1 = minps(minps(maxps(tx0, tx1), maxps(ty0, ty1)), minps(maxps(tz0, tz1), rays.tmax[i]));
+		tnear[i] = t0;
+		mask |= (t0 <= t1) << i;
+	}
+	return mask;
+}
+
+static int intersectTrianglesScalar(const fl3 &origin, const fl3 &dir, float tmax, const TrianglePacket8 &tris, TriangleHits8 &hits)
+{
+	int mask = 0;
+	for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+		// moller-trumbore, written out per component in the order the vector versions use
+		const float px = dir.y * tris.e2z[i] - dir.z * tris.e2y[i];
+		const float py = dir.z * tris.e2x[i] - dir.x * tris.e2z[i];
+		const float pz = dir.x * tris.e2y[i] - dir.y * tris.e2x[i];
+		const float det = tris.e1x[i] * px + tris.e1y[i] * py + tris.e1z[i] * pz;
+		const float invDet = 1.f / det;
+		const float sx = origin.x - tris.v0x[i], sy = origin.y - tris.v0y[i], sz = origin.z - tris.v0z[i];
+		const float u = (sx * px + sy * py + sz * pz) * invDet;
+		const float qx = sy * tris.e1z[i] - sz * tris.e1y[i];
+		const float qy = sz * tris.e1x[i] - sx * tris.e1z[i];
+		const float qz = sx * tris.e1y[i] - sy * tris.e1x[i];
+		const float v = (dir.x * qx + dir.y * qy + dir.z * qz) * invDet;
+		const float t = (tris.e2x[i] * qx + tris.e2y[i] * qy + tris.e2z[i] * qz) * invDet;
+		hits.t[i] = t;
+		hits.u[i] = u;
+		hits.v[i] = v;
+		const bool hit = fabsf(det) >= RAY_DETERMINANT_EPSILON && u >= 0.f && u <= 1.f && v >= 0.f && u + v <= 1.f
+			&& t > 0.f && t < tmax;
+		mask |= hit << i;
+	}
+	return mask;
+}
+
+// the sse versions run the 8 lanes as two 4-wide halves
+static inline int intersectBox4(const RayPacket8 &rays, int base, const __m128 bmin[3], const __m128 bmax[3], float *tnear)
+{
+	const __m128 ox = _mm_loadu_ps(rays.ox + base), oy = _mm_loadu_ps(rays.oy + base), oz = _mm_loadu_ps(rays.oz + base);
+	const __m128 idx = _mm_loadu_ps(rays.idx + base), idy = _mm_loadu_ps(rays.idy + base), idz = _mm_loadu_ps(rays.idz + base);
+	const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(bmin[0], ox), idx), tx1 = _mm_mul_ps(_mm_sub_ps(bmax[0], ox), idx);
+	const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(bmin[1], oy), idy), ty1 = _mm_mul_ps(_mm_sub_ps(bmax[1], oy), idy);
+	const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(bmin[2], oz), idz), tz1 = _mm_mul_ps(_mm_sub_ps(bmax[2], oz), idz);
+	const __m128 t0 = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_setzero_ps()));
+	const __m128 t1 = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+		_mm_min_ps(_mm_max_ps(tz0, tz1), _mm_loadu_ps(rays.tmax + base)));
+	_mm_storeu_ps(tnear + base, t0);
+	return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+}
+
+static int intersectBoxSse(const RayPacket8 &rays, const fl3 &min, const fl3 &max, float *tnear)
+{
+	const __m128 bmin[3] = { _mm_set1_ps(min.x), _mm_set1_ps(min.y), _mm_set1_ps(min.z) };
+	const __m128 bmax[3] = { _mm_set1_ps(max.x), _mm_set1_ps(max.y), _mm_set1_ps(max.z) };
+	return intersectBox4(rays, 0, bmin, bmax, tnear) | intersectBox4(rays, 4, bmin, bmax, tnear) << 4;
+}
+
+static inline int intersectTriangles4(const __m128 o[3], const __m128 d[3], __m128 tmax, const TrianglePacket8 &tris, int base,
+	TriangleHits8 &hits)
+{
+	const __m128 e1x = _mm_loadu_ps(tris.e1x + base), e1y = _mm_loadu_ps(tris.e1y + base), e1z = _mm_loadu_ps(tris.e1z + base);
+	const __m128 e2x = _mm_loadu_ps(tris.e2x + base), e2y = _mm_loadu_ps(tris.e2y + base), e2z = _mm_loadu_ps(tris.e2z + base);
+	const __m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+	const __m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+	const __m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+	const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	// a real division rather than rcpps, the approximation moves hits across edges and the results apart from the scalar code
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 invDet = _mm_div_ps(one, det);
+	const __m128 sx = _mm_sub_ps(o[0], _mm_loadu_ps(tris.v0x + base));
+	const __m128 sy = _mm_sub_ps(o[1], _mm_loadu_ps(tris.v0y + base));
+	const __m128 sz = _mm_sub_ps(o[2], _mm_loadu_ps(tris.v0z + base));
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+	const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), invDet);
+	const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+	_mm_storeu_ps(hits.t + base, t);
+	_mm_storeu_ps(hits.u + base, u);
+	_mm_storeu_ps(hits.v + base, v);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.f), det);
+	__m128 mask = _mm_cmpge_ps(absDet, _mm_set1_ps(RAY_DETERMINANT_EPSILON));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, tmax)));
+	return _mm_movemask_ps(mask);
+}
+
+static int intersectTrianglesSse(const fl3 &origin, const fl3 &dir, float tmax, const TrianglePacket8 &tris, TriangleHits8 &hits)
+{
+	const __m128 o[3] = { _mm_set1_ps(origin.x), _mm_set1_ps(origin.y), _mm_set1_ps(origin.z) };
+	const __m128 d[3] = { _mm_set1_ps(dir.x), _mm_set1_ps(dir.y), _mm_set1_ps(dir.z) };
+	const __m128 tmax4 = _mm_set1_ps(tmax);
+	return intersectTriangles4(o, d, tmax4, tris, 0, hits) | intersectTriangles4(o, d, tmax4, tris, 4, hits) << 4;
+}
+
+static const RayKernels ScalarKernels = { RAY_KERNEL_SCALAR, "scalar", intersectBoxScalar, intersectTrianglesScalar };
+static const RayKernels SseKernels = { RAY_KERNEL_SSE, "sse", intersectBoxSse, intersectTrianglesSse };
+
+const RayKernels* GetRayKernels(RAY_KERNEL_ISA isa)
+{
+	switch (isa) {
+	case RAY_KERNEL_SCALAR:
+		return &ScalarKernels;
+	case RAY_KERNEL_SSE:
+		return &SseKernels;
+	case RAY_KERNEL_AVX2:
+		return CpuHasAvx2() ? GetAvx2RayKernels() : 0;
+	}
+	return 0;
+}
+
+const RayKernels& GetRayKernels()
+{
+	static const RayKernels *best = GetRayKernels(RAY_KERNEL_AVX2) ? GetRayKernels(RAY_KERNEL_AVX2) : &SseKernels;
+	return *best;
+}
@@ -0,0 +1,68 @@
+#ifndef RAYKERNELS_H
+#define RAYKERNELS_H
+
+#include "utils.h"
+#include <stdint.h>
+
+// 8-wide intersection kernels for the cpu ray queries: 8 rays against one box, one ray against 8 triangles
+// the lanes are structure of arrays, the load helpers fill them from fl3 arrays (or take the single ray as fl3)
+// every kernel exists as scalar, sse (two 4-wide halves) and avx2 code doing the same operations in the same order,
+// so the results are bit identical as long as the compiler doesn't fuse multiply-adds (msvc /fp:precise doesn't),
+// GetRayKernels picks the best one the cpu supports
+// the packets have no alignment requirement (the kernels use unaligned loads), so they can live in std::vector
+//
+// semantics match Bvh: a box is hit when the slab interval overlaps [0, tmax], a triangle (moller-trumbore) when
+// the determinant isn't tiny, both barycentrics and their sum are within [0, 1] and t is in (0, tmax)
+
+#define RAY_PACKET_SIZE 8
+
+struct RayPacket8 {
+	float ox[RAY_PACKET_SIZE], oy[RAY_PACKET_SIZE], oz[RAY_PACKET_SIZE];
+	float dx[RAY_PACKET_SIZE], dy[RAY_PACKET_SIZE], dz[RAY_PACKET_SIZE];
+	float idx[RAY_PACKET_SIZE], idy[RAY_PACKET_SIZE], idz[RAY_PACKET_SIZE]; // reciprocal directions for the slab tests
+	float tmax[RAY_PACKET_SIZE];
+
+	// count rays (up to 8) from fl3 arrays, unused lanes get tmax -1 so they never hit
+	void load(const fl3 *origins, const fl3 *dirs, const float *tmaxs, int count);
+};
+
+struct TrianglePacket8 {
+	float v0x[RAY_PACKET_SIZE], v0y[RAY_PACKET_SIZE], v0z[RAY_PACKET_SIZE];
+	float e1x[RAY_PACKET_SIZE], e1y[RAY_PACKET_SIZE], e1z[RAY_PACKET_SIZE];
+	float e2x[RAY_PACKET_SIZE], e2y[RAY_PACKET_SIZE], e2z[RAY_PACKET_SIZE];
+
+	// count triangles (up to 8) given as corner arrays, unused lanes are degenerate and never hit
+	void load(const fl3 *v0, const fl3 *v1, const fl3 *v2, int count);
+};
+
+// per lane results of the triangle kernel, only meaningful in lanes set in the returned mask
+struct TriangleHits8 {
+	float t[RAY_PACKET_SIZE];
+	float u[RAY_PACKET_SIZE];
+	float v[RAY_PACKET_SIZE];
+};
+
+enum RAY_KERNEL_ISA {
+	RAY_KERNEL_SCALAR = 0,
+	RAY_KERNEL_SSE = 1,
+	RAY_KERNEL_AVX2 = 2
+};
+
+struct RayKernels {
+	RAY_KERNEL_ISA isa;
+	const char *name;
+	// bit i is set when ray i hits the box, tnear receives the entry distances (clamped to 0)
+	int (*intersectBox)(const RayPacket8 &rays, const fl3 &min, const fl3 &max, float *tnear);
+	// bit i is set when the ray hits triangle i
+	int (*intersectTriangles)(const fl3 &origin, const fl3 &dir, float tmax, const TrianglePacket8 &tris, TriangleHits8 &hits);
+};
+
+// the kernels for an instruction set, 0 if it wasn't compiled in or the cpu lacks it
+const RayKernels* GetRayKernels(RAY_KERNEL_ISA isa);
+// the widest available set
+const RayKernels& GetRayKernels();
+
+// defined in raykernelsavx2.cpp, which is built with avx2 code generation (0 when the compiler didn't have it on)
+const RayKernels* GetAvx2RayKernels();
+
+#endif // RAYKERNELS_H
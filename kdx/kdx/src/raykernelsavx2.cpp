@@ -0,0 +1,79 @@
+#include "raykernels.h"
+
+// the only file built with avx2 code generation (/arch:AVX2), the rest of kdx has to run on sse2 cpus,
+// GetRayKernels checks the cpu before handing these out
+// WORKNOTE: without the flag the kernels compile away and the sse ones are used everywhere
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// see raykernels.cpp for the scalar versions these follow operation for operation
+#define RAY_DETERMINANT_EPSILON 1e-12f
+
+static int intersectBoxAvx2(const RayPacket8 &rays, const fl3 &min, const fl3 &max, float *tnear)
+{
+	const __m256 ox = _mm256_loadu_ps(rays.ox), oy = _mm256_loadu_ps(rays.oy), oz = _mm256_loadu_ps(rays.oz);
+	const __m256 idx = _mm256_loadu_ps(rays.idx), idy = _mm256_loadu_ps(rays.idy), idz = _mm256_loadu_ps(rays.idz);
+	const __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(min.x), ox), idx);
+	const __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(max.x), ox), idx);
+	const __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(min.y), oy), idy);
+	const __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(max.y), oy), idy);
+	const __m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(min.z), oz), idz);
+	const __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(max.z), oz), idz);
+	const __m256 t0 = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)),
+		_mm256_max_ps(_mm256_min_ps(tz0, tz1), _mm256_setzero_ps()));
+	const __m256 t1 = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1)),
+		_mm256_min_ps(_mm256_max_ps(tz0, tz1), _mm256_loadu_ps(rays.tmax)));
+	_mm256_storeu_ps(tnear, t0);
+	return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ));
+}
+
+static int intersectTrianglesAvx2(const fl3 &origin, const fl3 &dir, float tmax, const TrianglePacket8 &tris, TriangleHits8 &hits)
+{
+	const __m256 dx = _mm256_set1_ps(dir.x), dy = _mm256_set1_ps(dir.y), dz = _mm256_set1_ps(dir.z);
+	const __m256 e1x = _mm256_loadu_ps(tris.e1x), e1y = _mm256_loadu_ps(tris.e1y), e1z = _mm256_loadu_ps(tris.e1z);
+	const __m256 e2x = _mm256_loadu_ps(tris.e2x), e2y = _mm256_loadu_ps(tris.e2y), e2z = _mm256_loadu_ps(tris.e2z);
+	// no fma, fused products round differently and would make the results depend on the instruction set
+	const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+	const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+	const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+	const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 invDet = _mm256_div_ps(one, det);
+	const __m256 sx = _mm256_sub_ps(_mm256_set1_ps(origin.x), _mm256_loadu_ps(tris.v0x));
+	const __m256 sy = _mm256_sub_ps(_mm256_set1_ps(origin.y), _mm256_loadu_ps(tris.v0y));
+	const __m256 sz = _mm256_sub_ps(_mm256_set1_ps(origin.z), _mm256_loadu_ps(tris.v0z));
+	const __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), invDet);
+	const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+	const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+	const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+	const __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+	const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+	_mm256_storeu_ps(hits.t, t);
+	_mm256_storeu_ps(hits.u, u);
+	_mm256_storeu_ps(hits.v, v);
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 absDet = _mm256_andnot_ps(_mm256_set1_ps(-0.f), det);
+	__m256 mask = _mm256_cmp_ps(absDet, _mm256_set1_ps(RAY_DETERMINANT_EPSILON), _CMP_GE_OQ);
+	mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+	mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+	mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tmax), _CMP_LT_OQ)));
+	return _mm256_movemask_ps(mask);
+}
+
+static const RayKernels Avx2Kernels = { RAY_KERNEL_AVX2, "avx2", intersectBoxAvx2, intersectTrianglesAvx2 };
+
+const RayKernels* GetAvx2RayKernels()
+{
+	return &Avx2Kernels;
+}
+
+#else
+
+const RayKernels* GetAvx2RayKernels()
+{
+	return 0;
+}
+
+#endif // __AVX2__
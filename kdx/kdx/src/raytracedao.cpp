@@ -0,0 +1,108 @@
+#include "raytracedao.h"
+#include "parallel.h"
+#include "sampling.h"
+#include <math.h>
+#include <atomic>
+
+// rows handed to a worker at a time
+#define TRACE_ROW_GRAIN 4
+// hemisphere rays start this far off the surface along the geometric normal, in world units
+#define TRACE_SURFACE_OFFSET 1e-3f
+
+RayTracedAo::RayTracedAo() : raysPerPixel_(16), maxDistance_(0.5f), seed_(0)
+{
+	stats_.cameraRays = 0;
+	stats_.aoRays = 0;
+}
+
+RayTracedAo::~RayTracedAo()
+{
+
+}
+
+void RayTracedAo::clear()
+{
+	bvh_.clear();
+	normals_.clear();
+}
+
+void RayTracedAo::addMesh(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model)
+{
+	bvh_.addTriangles(verts, vertcount, inds, indexcount, model);
+	for (size_t i = 0; i + 2 < indexcount; i += 3) {
+		for (int k = 0; k < 3; k++) {
+			fl3 n = model.multiplyVector(verts[inds[i + k]].norm);
+			normalize(n);
+			normals_.push_back(n);
+		}
+	}
+}
+
+void RayTracedAo::build()
+{
+	bvh_.build();
+}
+
+void RayTracedAo::render(const Matrix &view, const Matrix &proj, int width, int height, FloatImage &out)
+{
+	if (out.getWidth() != width || out.getHeight() != height) {
+		out.resize(width, height);
+	}
+	// camera rays run from the near to the far plane through each pixel center
+	Matrix viewProj = proj;
+	viewProj.multMatrix(view);
+	Matrix invViewProj;
+	viewProj.getInverse(invViewProj);
+
+	const int rays = raysPerPixel_;
+	std::atomic<uint64_t> cameraRays (0), aoRays (0);
+	parallelFor(0, height, TRACE_ROW_GRAIN, [&](int y0, int y1) {
+		uint64_t rowAoRays = 0;
+		for (int y = y0; y < y1; y++) {
+			const float ny = 1.f - 2.f * (y + 0.5f) / height;
+			for (int x = 0; x < width; x++) {
+				const float nx = 2.f * (x + 0.5f) / width - 1.f;
+				const fl3 nearPoint = invViewProj.multiplyPoint(fl3(nx, ny, 0.f));
+				const fl3 dir = invViewProj.multiplyPoint(fl3(nx, ny, 1.f)) - nearPoint;
+				Bvh::Hit hit;
+				if (!bvh_.intersect(nearPoint, dir, 1.f, hit)) {
+					out.at(x, y) = 1.f;
+					continue;
+				}
+
+				// geometric normal for the ray offset, interpolated one for the hemisphere, both facing the camera
+				const fl3 *n = &normals_[3 * hit.triangle];
+				fl3 shading = n[0] * (1.f - hit.u - hit.v) + n[1] * hit.u + n[2] * hit.v;
+				normalize(shading);
+				fl3 geometric = bvh_.getNormal(hit.triangle);
+				if (dot(geometric, dir) > 0.f) {
+					geometric = -geometric;
+				}
+				if (dot(shading, dir) > 0.f) {
+					shading = -shading;
+				}
+				const fl3 origin = nearPoint + dir * hit.t + geometric * TRACE_SURFACE_OFFSET;
+				fl3 tangent, bitangent;
+				tangentFrame(shading, tangent, bitangent);
+
+				// hammersley points with a per pixel toroidal shift (cranley-patterson rotation)
+				const uint32_t h = hashCoords(x, y, seed_);
+				const float shiftA = toUnitFloat(h), shiftB = toUnitFloat(h * 0x9e3779b9u);
+				int escaped = 0;
+				for (int i = 0; i < rays; i++) {
+					const fl3 sample = cosineHemisphere(i, rays, shiftA, shiftB, shading, tangent, bitangent);
+					// samples under the geometric surface (interpolated normals bend away from it) are blocked by it
+					if (dot(sample, geometric) > 0.f && !bvh_.occluded(origin, sample, maxDistance_)) {
+						escaped++;
+					}
+				}
+				out.at(x, y) = (float) escaped / rays;
+				rowAoRays += rays;
+			}
+		}
+		cameraRays += (uint64_t) (y1 - y0) * width;
+		aoRays += rowAoRays;
+	});
+	stats_.cameraRays = cameraRays;
+	stats_.aoRays = aoRays;
+}
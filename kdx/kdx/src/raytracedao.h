@@ -0,0 +1,52 @@
+#ifndef RAYTRACEDAO_H
+#define RAYTRACEDAO_H
+
+#include "bvh.h"
+#include "image.hpp"
+#include <stdint.h>
+
+// ground truth ao for a camera view, ray traced against the scene geometry instead of reconstructed from depth
+// every pixel traces a camera ray, then cosine weighted hemisphere rays around the interpolated vertex normal
+// (the normal the prepass writes) and stores the fraction that escapes within maxDistance,
+// so the output has the same meaning and format as the screen space passes (R32, 1 is unoccluded)
+class RayTracedAo {
+public:
+	struct Stats {
+		uint64_t cameraRays;
+		uint64_t aoRays;
+	};
+
+	RayTracedAo();
+	virtual ~RayTracedAo();
+
+	// geometry, same arguments as Rasterizer::draw plus the model matrix
+	// WORKNOTE: normals go through the model matrix as directions, so only rigid transforms and uniform scales are right
+	void clear();
+	void addMesh(const PTNvert *verts, size_t vertcount, const uint32_t *inds, size_t indexcount, const Matrix &model);
+	void build();
+
+	// traces a width x height view through view and proj into out, pixels without geometry are unoccluded
+	void render(const Matrix &view, const Matrix &proj, int width, int height, FloatImage &out);
+
+	// hemisphere rays per pixel, stratified and rotated per pixel so the noise has no pattern
+	void setRaysPerPixel(int rays) { raysPerPixel_ = rays; }
+	// world space reach of an occluder, AoParams::samplingRadius is the comparable hbao setting
+	void setMaxDistance(float distance) { maxDistance_ = distance; }
+	// different seeds give independent noise, for checking the reference has converged
+	void setSeed(uint32_t seed) { seed_ = seed; }
+
+	const Bvh& getBvh() const { return bvh_; }
+	const Stats& getStats() const { return stats_; }
+
+private:
+	Bvh bvh_;
+	// three per triangle, in the order the bvh numbers them
+	std::vector<fl3> normals_;
+
+	int raysPerPixel_;
+	float maxDistance_;
+	uint32_t seed_;
+	Stats stats_;
+};
+
+#endif // RAYTRACEDAO_H
@@ -0,0 +1,67 @@
+#include "renderdevice.h"
+#include "sampler.h"
+#include <atomic>
+
+RenderResource::RenderResource()
+{
+	// 0 stays free for "nothing bound" in StateCache
+	static std::atomic<unsigned int> nextId (1);
+	id_ = nextId++;
+}
+
+RenderDevice::RenderDevice() : defaultsampler_(0)
+{
+
+}
+
+RenderDevice::~RenderDevice()
+{
+	delete defaultsampler_;
+}
+
+unsigned int formatSize(RENDER_FORMAT format)
+{
+	switch (format) {
+	case FORMAT_R32G32B32A32_FLOAT:
+		return 16;
+	case FORMAT_R32G32B32_FLOAT:
+		return 12;
+	case FORMAT_R32G32_FLOAT:
+	case FORMAT_R16G16B16A16_FLOAT:
+		return 8;
+	case FORMAT_R32_FLOAT:
+	case FORMAT_R16G16_FLOAT:
+	case FORMAT_R16G16_SNORM:
+	case FORMAT_R8G8B8A8_UNORM:
+	case FORMAT_R32_UINT:
+	case FORMAT_D24_UNORM_S8_UINT:
+	case FORMAT_D32_FLOAT:
+		return 4;
+	case FORMAT_R16_FLOAT:
+	case FORMAT_R16_UNORM:
+	case FORMAT_R8G8_SNORM:
+	case FORMAT_R16_UINT:
+	case FORMAT_D16_UNORM:
+		return 2;
+	case FORMAT_R8_UINT:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+size_t textureMemory(const TextureDesc &desc)
+{
+	size_t total = 0;
+	unsigned int width = desc.width, height = desc.height;
+	// 0 mip levels is the full chain, like d3d11
+	for (unsigned int level = 0; desc.mipLevels == 0 || level < desc.mipLevels; level++) {
+		total += (size_t) width * height;
+		if (width == 1 && height == 1) {
+			break;
+		}
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return total * formatSize(desc.format) * (desc.numSamples ? desc.numSamples : 1);
+}
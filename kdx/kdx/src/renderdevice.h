@@ -0,0 +1,299 @@
+#ifndef RENDERDEVICE_H
+#define RENDERDEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Sampler;
+class StateCache;
+
+// thin device/context layer under Mesh, Framebuffer, Texture, Sampler, Shader and Obj
+// it covers what those classes and the samples use of d3d11 (buffers, 2d textures and their views, shaders, input
+// layouts, the binds and the draw/dispatch calls) with the same semantics, so dx11device.h maps it call for call and
+// cpudevice.h runs the same frames on the cpu through a software rasterizer and c++ ports of the shaders
+//
+// resources are created by the device and released by deleting them
+
+// texel and index formats, the subset of DXGI_FORMAT in use
+enum RENDER_FORMAT {
+	FORMAT_UNKNOWN = 0,
+	FORMAT_R32G32B32A32_FLOAT,
+	FORMAT_R32G32B32_FLOAT,
+	FORMAT_R32G32_FLOAT,
+	FORMAT_R32_FLOAT,
+	FORMAT_R16G16B16A16_FLOAT,
+	FORMAT_R16G16_FLOAT,
+	FORMAT_R16_FLOAT,
+	FORMAT_R16G16_SNORM,
+	FORMAT_R16_UNORM,
+	FORMAT_R8G8B8A8_UNORM,
+	FORMAT_R8G8_SNORM,
+	FORMAT_R8_UINT,
+	FORMAT_R16_UINT,
+	FORMAT_R32_UINT,
+	// depth formats, depth textures that are also shader resources read their depth through the red channel
+	FORMAT_D16_UNORM,
+	FORMAT_D24_UNORM_S8_UINT,
+	FORMAT_D32_FLOAT
+};
+
+// same values as D3D11_BIND_FLAG
+enum RENDER_BIND {
+	BIND_VERTEX_BUFFER = 0x1,
+	BIND_INDEX_BUFFER = 0x2,
+	BIND_CONSTANT_BUFFER = 0x4,
+	BIND_SHADER_RESOURCE = 0x8,
+	BIND_RENDER_TARGET = 0x20,
+	BIND_DEPTH_STENCIL = 0x40,
+	BIND_UNORDERED_ACCESS = 0x80
+};
+
+enum RENDER_USAGE {
+	USAGE_DEFAULT = 0, // gpu memory, updated with updateBuffer through UpdateSubresource
+	USAGE_IMMUTABLE, // initial data only
+	USAGE_DYNAMIC // updated every frame, updateBuffer maps with discard
+};
+
+enum SHADER_STAGE {
+	STAGE_VERTEX = 0,
+	STAGE_PIXEL,
+	STAGE_COMPUTE,
+	NUM_SHADER_STAGES
+};
+
+enum PRIMITIVE_TOPOLOGY {
+	TOPOLOGY_TRIANGLELIST = 0,
+	TOPOLOGY_TRIANGLESTRIP
+};
+
+enum RENDER_COMPARISON {
+	COMPARISON_NEVER = 0,
+	COMPARISON_LESS,
+	COMPARISON_EQUAL,
+	COMPARISON_LESS_EQUAL,
+	COMPARISON_GREATER,
+	COMPARISON_NOT_EQUAL,
+	COMPARISON_GREATER_EQUAL,
+	COMPARISON_ALWAYS
+};
+
+// min, mag and mip filter together
+enum RENDER_FILTER {
+	FILTER_POINT = 0,
+	FILTER_LINEAR
+};
+
+enum RENDER_ADDRESS {
+	ADDRESS_WRAP = 0,
+	ADDRESS_MIRROR,
+	ADDRESS_CLAMP
+};
+
+// placement of constant buffer ranges (16 constants of 16 bytes)
+#define CONSTANT_RANGE_ALIGNMENT 256
+
+struct BufferDesc {
+	BufferDesc() : byteWidth(0), usage(USAGE_DEFAULT), bindFlags(0) {}
+
+	size_t byteWidth;
+	RENDER_USAGE usage;
+	unsigned int bindFlags;
+};
+
+struct TextureDesc {
+	TextureDesc() : width(0), height(0), mipLevels(1), numSamples(1), format(FORMAT_UNKNOWN), bindFlags(0) {}
+
+	unsigned int width, height;
+	unsigned int mipLevels;
+	unsigned int numSamples;
+	RENDER_FORMAT format;
+	// views are created for what the flags ask for, a depth texture that is also a shader resource is typeless
+	// underneath with a depth view and a color view (see Dx11Device::GetDepthResourceFormat)
+	unsigned int bindFlags;
+};
+
+struct SamplerDesc {
+	SamplerDesc() : filter(FILTER_LINEAR), addressU(ADDRESS_WRAP), addressV(ADDRESS_WRAP), addressW(ADDRESS_WRAP) {}
+
+	RENDER_FILTER filter;
+	RENDER_ADDRESS addressU, addressV, addressW;
+};
+
+struct DepthStateDesc {
+	DepthStateDesc() : depthEnable(true), depthWrite(true), depthFunc(COMPARISON_LESS) {}
+
+	bool depthEnable;
+	bool depthWrite;
+	RENDER_COMPARISON depthFunc;
+};
+
+// one per-vertex attribute of the single interleaved vertex buffer the meshes use, or with perInstance set one
+// attribute of the instance buffer (setInstanceBuffer), which steps once per instance instead
+struct InputElement {
+	const char *semantic;
+	unsigned int semanticIndex;
+	RENDER_FORMAT format;
+	unsigned int offset;
+	bool perInstance;
+};
+
+struct Viewport {
+	float x, y;
+	float width, height;
+	float minDepth, maxDepth;
+};
+
+// bytes per texel of a format, per index for the index formats
+unsigned int formatSize(RENDER_FORMAT format);
+// memory a texture takes, all mips and samples (what the driver allocates can be more, for alignment)
+size_t textureMemory(const TextureDesc &desc);
+
+// every backend object has an id, unique for the lifetime of the program (addresses get reused after a delete)
+class RenderResource {
+public:
+	virtual ~RenderResource() {}
+	unsigned int getId() const { return id_; }
+protected:
+	RenderResource();
+private:
+	unsigned int id_;
+};
+
+// backend objects, each backend derives its own and casts back when they are bound
+class RenderBuffer : public RenderResource {
+public:
+	virtual ~RenderBuffer() {}
+	const BufferDesc& getDesc() const { return desc_; }
+protected:
+	RenderBuffer(const BufferDesc &desc) : desc_(desc) {}
+	BufferDesc desc_;
+};
+
+class RenderTexture : public RenderResource {
+public:
+	virtual ~RenderTexture() {}
+	const TextureDesc& getDesc() const { return desc_; }
+protected:
+	RenderTexture(const TextureDesc &desc) : desc_(desc) {}
+	TextureDesc desc_;
+};
+
+class RenderSampler : public RenderResource {
+public:
+	virtual ~RenderSampler() {}
+protected:
+	RenderSampler() {}
+};
+
+class RenderShader : public RenderResource {
+public:
+	virtual ~RenderShader() {}
+	SHADER_STAGE getStage() const { return stage_; }
+protected:
+	RenderShader(SHADER_STAGE stage) : stage_(stage) {}
+	SHADER_STAGE stage_;
+};
+
+class RenderInputLayout : public RenderResource {
+public:
+	virtual ~RenderInputLayout() {}
+protected:
+	RenderInputLayout() {}
+};
+
+class RenderDepthState : public RenderResource {
+public:
+	virtual ~RenderDepthState() {}
+protected:
+	RenderDepthState() {}
+};
+
+// immediate context, the binds and draws of ID3D11DeviceContext
+// the array binds take null entries (or a null array) to unbind
+class RenderContext {
+public:
+	virtual ~RenderContext() {}
+
+	// output merger, depth can be null
+	virtual void setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth) = 0;
+	virtual void setViewport(const Viewport &viewport) = 0;
+	// null goes back to the default (depth test LESS with writes)
+	virtual void setDepthState(RenderDepthState *state) = 0;
+	virtual void clearRenderTarget(RenderTexture *target, const float color[4]) = 0;
+	virtual void clearDepth(RenderTexture *depth, float value) = 0;
+
+	// shaders and what they read, per stage like the VS/PS/CSSet* calls
+	virtual void setShader(SHADER_STAGE stage, RenderShader *shader) = 0;
+	virtual void setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers) = 0;
+	// size bytes of a constant buffer from offset on as the cbuffer in slot, like d3d11.1's *SetConstantBuffers1
+	// offset and size are multiples of 256 (CONSTANT_RANGE_ALIGNMENT)
+	virtual void setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size) = 0;
+	virtual void setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures) = 0;
+	virtual void setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers) = 0;
+	// compute shader only, like CSSetUnorderedAccessViews
+	virtual void setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures) = 0;
+
+	// input assembler
+	virtual void setInputLayout(RenderInputLayout *layout) = 0;
+	virtual void setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset) = 0;
+	// the per-instance stream of instanced draws (input slot 1)
+	virtual void setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset) = 0;
+	virtual void setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset) = 0;
+	virtual void setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology) = 0;
+
+	// replaces the first size bytes of the buffer, a map with discard for dynamic buffers
+	virtual void updateBuffer(RenderBuffer *buffer, const void *data, size_t size) = 0;
+	// writes into a dynamic buffer at offset without discarding the rest (a map with no overwrite), the gpu must be done
+	// with that range already (see RenderDevice::signalFence). a default buffer gets an UpdateSubresource of the range
+	virtual void writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size) = 0;
+	// same size and format, like CopyResource
+	virtual void copyTexture(RenderTexture *dst, RenderTexture *src) = 0;
+	virtual void generateMips(RenderTexture *texture) = 0;
+
+	virtual void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	// the indexed draw instanceCount times, instance i reads element startInstance + i of the instance buffer
+	virtual void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+	virtual void dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) = 0;
+};
+
+class RenderDevice {
+public:
+	virtual ~RenderDevice();
+
+	// initialData can be null for buffers that are updated before their first use
+	virtual RenderBuffer* createBuffer(const BufferDesc &desc, const void *initialData) = 0;
+	virtual RenderTexture* createTexture(const TextureDesc &desc) = 0;
+	// an image file as a shader resource with a full mip chain (filled by generateMips), 0 if it can't be loaded
+	virtual RenderTexture* loadTexture(const wchar_t *filename) = 0;
+	virtual RenderSampler* createSampler(const SamplerDesc &desc) = 0;
+	virtual RenderDepthState* createDepthState(const DepthStateDesc &desc) = 0;
+	// the stage's entry point of a shader file (VertexMain, PixelMain or ComputeMain), 0 on failure
+	virtual RenderShader* createShader(SHADER_STAGE stage, const wchar_t *filename) = 0;
+	// the elements have to match the inputs of vertexShader
+	virtual RenderInputLayout* createInputLayout(const InputElement *elements, unsigned int count, RenderShader *vertexShader) = 0;
+
+	// the context everything binds through, a StateCache in front of the backend's context that drops redundant binds
+	virtual RenderContext& getContext() = 0;
+	virtual StateCache& getStateCache() = 0;
+
+	// fences mark a point in the work submitted so far, once one is completed the gpu is done with everything before it
+	// signalFence returns increasing values from 1 on, so a fence is completed when it's <= getCompletedFence
+	virtual uint64_t signalFence() = 0;
+	virtual uint64_t getCompletedFence() = 0;
+	// blocks until the fence is completed
+	virtual void waitForFence(uint64_t fence) = 0;
+
+	// the default framebuffer (the swap chain's, or the cpu device's own), owned by the device
+	virtual RenderTexture* getBackBuffer() = 0;
+	virtual RenderTexture* getDepthBuffer() = 0;
+
+protected:
+	RenderDevice();
+
+private:
+	// shared linear/wrap sampler, see Sampler::GetDefaultSampler
+	Sampler *defaultsampler_;
+	friend class Sampler;
+};
+
+#endif // RENDERDEVICE_H
@@ -0,0 +1,77 @@
+#include "renderqueue.h"
+#include <math.h>
+#include <string.h>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+RenderQueue::RenderQueue()
+{
+
+}
+
+RenderQueue::~RenderQueue()
+{
+
+}
+
+/*static*/ uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int textures, unsigned int depth)
+{
+	return ((uint64_t) (pass & 0xf) << 60) | ((uint64_t) (shader & 0xfff) << 48) | ((uint64_t) (material & 0xffff) << 32) |
+		((uint64_t) (textures & 0xffff) << 16) | (uint64_t) (depth & 0xffff);
+}
+
+/*static*/ unsigned int RenderQueue::DepthBucket(float viewZ, float nearZ, float farZ, bool reverse)
+{
+	float t = 0.f;
+	if (viewZ > nearZ) {
+		t = logf(viewZ / nearZ) / logf(farZ / nearZ);
+	}
+	t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+	const unsigned int bucket = (unsigned int) (t * 65535.f + 0.5f);
+	return reverse ? 65535 - bucket : bucket;
+}
+
+void RenderQueue::sort()
+{
+	const size_t count = items_.size();
+	if (count < 2) {
+		return;
+	}
+	// histograms of all digits in one read of the keys
+	size_t histograms[RADIX_PASSES][RADIX_BUCKETS];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++) {
+		const uint64_t key = items_[i].key;
+		for (int pass = 0; pass < RADIX_PASSES; pass++) {
+			histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+		}
+	}
+
+	scratch_.resize(count);
+	Item *src = &items_[0], *dst = &scratch_[0];
+	for (int pass = 0; pass < RADIX_PASSES; pass++) {
+		const int shift = pass * RADIX_BITS;
+		size_t *histogram = histograms[pass];
+		// a digit all keys share doesn't reorder anything (unused fields, small ids in wide fields)
+		if (histogram[(src[0].key >> shift) & (RADIX_BUCKETS - 1)] == count) {
+			continue;
+		}
+		size_t offset = 0;
+		for (int b = 0; b < RADIX_BUCKETS; b++) {
+			const size_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; i++) {
+			dst[histogram[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+		}
+		Item *swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != &items_[0]) {
+		items_.swap(scratch_);
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// draws recorded as a 64 bit sort key and a payload, sorted once per frame and then submitted in key order
+// the key puts what is most expensive to switch in the high bits, so consecutive draws share as much state as possible:
+//
+//   63..60 pass | 59..48 shader | 47..32 material | 31..16 texture set | 15..0 depth bucket
+//
+// the ids are the caller's (small dense indices work best), fields wider than their bits are truncated
+// the sort is stable, draws with equal keys keep the order they were recorded in
+// the payload says what to draw, usually an index into the caller's own list of draws
+
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_SHADER_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_TEXTURE_BITS 16
+#define RENDER_KEY_DEPTH_BITS 16
+
+class RenderQueue {
+public:
+	RenderQueue();
+	virtual ~RenderQueue();
+
+	void clear() { items_.clear(); }
+	void push(uint64_t key, uint32_t payload)
+	{
+		Item item = { key, payload };
+		items_.push_back(item);
+	}
+	// lsd radix sort by key, one 8 bit digit per pass, skipping the digits every key has in common
+	void sort();
+
+	size_t size() const { return items_.size(); }
+	uint64_t getKey(size_t i) const { return items_[i].key; }
+	uint32_t getPayload(size_t i) const { return items_[i].payload; }
+
+	static uint64_t MakeKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int textures, unsigned int depth);
+	static unsigned int GetPass(uint64_t key) { return (unsigned int) (key >> 60); }
+	static unsigned int GetShader(uint64_t key) { return (unsigned int) (key >> 48) & 0xfff; }
+	static unsigned int GetMaterial(uint64_t key) { return (unsigned int) (key >> 32) & 0xffff; }
+	static unsigned int GetTextures(uint64_t key) { return (unsigned int) (key >> 16) & 0xffff; }
+	static unsigned int GetDepth(uint64_t key) { return (unsigned int) key & 0xffff; }
+
+	// 16 bit depth bucket of a view space z between nearZ and farZ, front to back (back to front with reverse for
+	// blended passes). buckets are spaced logarithmically, so they stay fine close to the camera
+	static unsigned int DepthBucket(float viewZ, float nearZ, float farZ, bool reverse = false);
+
+private:
+	struct Item {
+		uint64_t key;
+		uint32_t payload;
+	};
+
+	std::vector<Item> items_;
+	std::vector<Item> scratch_;
+};
+
+#endif // RENDERQUEUE_H
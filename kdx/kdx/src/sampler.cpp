@@ -3,9 +3,9 @@
 #include <assert.h>
 
 // reference counter for resource management
-static std::map<ID3D11SamplerState*, unsigned short> RefCount;
+static std::map<RenderSampler*, unsigned short> RefCount;
 
-Sampler::Sampler(ID3D11Device &dev, D3D11_SAMPLER_DESC &desc) : sampler_(0)
+Sampler::Sampler(RenderDevice &dev, const SamplerDesc &desc) : sampler_(0)
 {
 	if (init(dev, desc)) {
 		assert(RefCount.count(sampler_) == 0);
@@ -15,7 +15,7 @@ Sampler::Sampler(ID3D11Device &dev, D3D11_SAMPLER_DESC &desc) : sampler_(0)
 	}
 }
 
-Sampler::Sampler(const Sampler &other)
+Sampler::Sampler(const Sampler &other) : sampler_(other.sampler_)
 {
 	assert(RefCount.count(sampler_) == 1);
 	RefCount[sampler_]++;
@@ -26,37 +26,33 @@ Sampler::~Sampler()
 	assert(RefCount.count(sampler_) == 1);
 	assert(RefCount[sampler_] > 0);
 	if (--RefCount[sampler_] == 0) {
-		sampler_->Release();
+		RefCount.erase(sampler_);
+		delete sampler_;
 	}
 }
 
-void Sampler::use(ID3D11DeviceContext &devcon, UINT slot)
+void Sampler::use(RenderContext &context, unsigned int slot)
 {
-	devcon.PSSetSamplers(slot, 1, &sampler_);
+	context.setSamplers(STAGE_PIXEL, slot, 1, &sampler_);
 }
 
-bool Sampler::init(ID3D11Device &dev, D3D11_SAMPLER_DESC &desc)
+bool Sampler::init(RenderDevice &dev, const SamplerDesc &desc)
 {
-	HRESULT result = dev.CreateSamplerState(&desc, &sampler_);
-	return !FAILED(result);
+	sampler_ = dev.createSampler(desc);
+	return sampler_ != 0;
 }
 
-static Sampler *DefaultSampler = 0;
-
-/*static*/ Sampler& Sampler::GetDefaultSampler(ID3D11Device &dev)
+/*static*/ Sampler& Sampler::GetDefaultSampler(RenderDevice &dev)
 {
-	if (!DefaultSampler) {
-		D3D11_SAMPLER_DESC samplerdesc;
-		ZeroMemory(&samplerdesc, sizeof(D3D11_SAMPLER_DESC));
-		samplerdesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-		samplerdesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-		samplerdesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-		samplerdesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-		samplerdesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-		samplerdesc.MinLOD = 0;
-		samplerdesc.MaxLOD = D3D11_FLOAT32_MAX;
-
-		DefaultSampler = new Sampler(dev, samplerdesc);
+	// WORKNOTE: kept by the device rather than in a static here, the cpu benchmarks create and destroy several devices
+	if (!dev.defaultsampler_) {
+		SamplerDesc samplerdesc;
+		samplerdesc.filter = FILTER_LINEAR;
+		samplerdesc.addressU = ADDRESS_WRAP;
+		samplerdesc.addressV = ADDRESS_WRAP;
+		samplerdesc.addressW = ADDRESS_WRAP;
+
+		dev.defaultsampler_ = new Sampler(dev, samplerdesc);
 	}
-	return *DefaultSampler;
+	return *dev.defaultsampler_;
 }
\ No newline at end of file
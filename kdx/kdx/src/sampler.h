@@ -1,21 +1,22 @@
 #ifndef SAMPLER_H
 #define SAMPLER_H
 
-#include <D3D11.h>
+#include "renderdevice.h"
 
 class Sampler {
 public:
-	Sampler(ID3D11Device &dev, D3D11_SAMPLER_DESC &desc);
+	Sampler(RenderDevice &dev, const SamplerDesc &desc);
 	Sampler(const Sampler &other);
 	virtual ~Sampler();
 
-	void use(ID3D11DeviceContext &devcon, UINT slot);
+	void use(RenderContext &context, unsigned int slot);
 private:
-	bool init(ID3D11Device &dev, D3D11_SAMPLER_DESC &desc);
+	bool init(RenderDevice &dev, const SamplerDesc &desc);
 
-	ID3D11SamplerState *sampler_;
+	RenderSampler *sampler_;
 
 public:
-	static Sampler& GetDefaultSampler(ID3D11Device &dev);
+	// linear filtering with wrap addressing, one per device
+	static Sampler& GetDefaultSampler(RenderDevice &dev);
 };
 #endif // SAMPLER_H
\ No newline at end of file
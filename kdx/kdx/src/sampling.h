@@ -0,0 +1,64 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "constants.h"
+#include "utils.h"
+#include <stdint.h>
+#include <algorithm>
+
+// sample generation shared by the cpu ray tracing passes (reference ao, baking)
+
+// well mixed hash of two coordinates and a seed, the start of a pixel's or vertex's random sequence
+inline uint32_t hashCoords(uint32_t x, uint32_t y, uint32_t seed)
+{
+	uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+// top 24 bits as a float in [0, 1)
+inline float toUnitFloat(uint32_t bits)
+{
+	return (bits >> 8) * (1.f / 16777216.f);
+}
+
+// van der corput sequence, the second dimension of a hammersley set
+inline float radicalInverse(uint32_t i)
+{
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x00ff00ffu) << 8) | ((i & 0xff00ff00u) >> 8);
+	i = ((i & 0x0f0f0f0fu) << 4) | ((i & 0xf0f0f0f0u) >> 4);
+	i = ((i & 0x33333333u) << 2) | ((i & 0xccccccccu) >> 2);
+	i = ((i & 0x55555555u) << 1) | ((i & 0xaaaaaaaau) >> 1);
+	return toUnitFloat(i);
+}
+
+// tangent frame around a unit normal without branches on the axis (Duff et al. 2017)
+inline void tangentFrame(const fl3 &n, fl3 &t, fl3 &b)
+{
+	const float sign = n.z >= 0.f ? 1.f : -1.f;
+	const float a = -1.f / (sign + n.z);
+	const float c = n.x * n.y * a;
+	t = fl3(1.f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+	b = fl3(c, sign + n.y * n.y * a, -n.y);
+}
+
+// cosine weighted hemisphere around n (with tangents t and b), sample i of count
+// the set is a hammersley set toroidally shifted by (shiftA, shiftB), different shifts per pixel decorrelate the noise
+inline fl3 cosineHemisphere(int i, int count, float shiftA, float shiftB, const fl3 &n, const fl3 &t, const fl3 &b)
+{
+	float u = (i + 0.5f) / count + shiftA;
+	float v = radicalInverse(i) + shiftB;
+	u -= u >= 1.f ? 1.f : 0.f;
+	v -= v >= 1.f ? 1.f : 0.f;
+	// uniform on the disk, projected up onto the hemisphere
+	const float r = sqrtf(u);
+	const float phi = 2.f * M_PI * v;
+	return t * (r * cosf(phi)) + b * (r * sinf(phi)) + n * sqrtf(std::max(0.f, 1.f - u));
+}
+
+#endif // SAMPLING_H
@@ -1,15 +1,11 @@
 #ifndef SHADER_H
 #define SHADER_H
-#include <Windows.h>
 
-struct ID3D10Blob;
-struct ID3D11Device;
-struct ID3D11VertexShader;
-struct ID3D11PixelShader;
-struct ID3D11ComputeShader;
-struct ID3D11InputLayout;
-struct D3D11_INPUT_ELEMENT_DESC;
+#include "renderdevice.h"
 
+// shaders are compiled (or, on the cpu device, looked up) by the device, see RenderDevice::createShader
+// the d3d device loads them from its ShaderCache when nothing they're compiled from changed
+// the error reporting of a failed d3d compile is in Dx11Device
 class Shader {
 public:
 	enum SHADER_TYPES {
@@ -19,49 +15,32 @@ public:
 		TESSELLATION_SHADER = 0x08,
 		COMPUTE_SHADER = 0x10
 	};
-private:
-	static void OutputShaderErrorMessage(ID3D10Blob **errorMessage);
 public:
-	Shader(ID3D11Device &device, LPCWSTR filename);
-private:
-	virtual HRESULT compileFromFile(LPCWSTR filename, ID3D10Blob **errorMessage) = 0;
-	virtual HRESULT initShader(ID3D11Device &device) = 0;
+	Shader(RenderDevice &device, const wchar_t *filename);
+	virtual ~Shader();
+	RenderShader* get() { return shader_; }
 protected:
-	bool init(ID3D11Device &device, LPCWSTR filename);
-	ID3D10Blob *buffer_;
+	bool init(RenderDevice &device, SHADER_STAGE stage, const wchar_t *filename);
+	RenderShader *shader_;
 };
 
 class VertexShader : public Shader {
 public:
-	VertexShader(ID3D11Device &device, LPCWSTR filename);
+	VertexShader(RenderDevice &device, const wchar_t *filename);
 	virtual ~VertexShader();
-	ID3D11VertexShader *get() { return shader_; }
-	ID3D11InputLayout* setInputLayout(ID3D11Device &device, D3D11_INPUT_ELEMENT_DESC *desc, UINT numElements);
-private:
-	virtual HRESULT compileFromFile(LPCWSTR filename, ID3D10Blob **errorMessage);
-	virtual HRESULT initShader(ID3D11Device &device);
-	ID3D11VertexShader *shader_;
+	// the caller deletes the layout
+	RenderInputLayout* setInputLayout(RenderDevice &device, const InputElement *desc, unsigned int numElements);
 };
 
 class PixelShader : public Shader {
 public:
-	PixelShader(ID3D11Device &device, LPCWSTR filename);
+	PixelShader(RenderDevice &device, const wchar_t *filename);
 	virtual ~PixelShader();
-	ID3D11PixelShader *get() { return shader_; }
-private:
-	virtual HRESULT compileFromFile(LPCWSTR filename, ID3D10Blob **errorMessage);
-	virtual HRESULT initShader(ID3D11Device &device);
-	ID3D11PixelShader *shader_;
 };
 
 class ComputeShader : public Shader {
 public:
-	ComputeShader(ID3D11Device &device, LPCWSTR filename);
+	ComputeShader(RenderDevice &device, const wchar_t *filename);
 	virtual ~ComputeShader();
-	ID3D11ComputeShader *get() { return shader_; }
-private:
-	virtual HRESULT compileFromFile(LPCWSTR filename, ID3D10Blob **errorMessage);
-	virtual HRESULT initShader(ID3D11Device &device);
-	ID3D11ComputeShader *shader_;
 };
 #endif // SHADER_H
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "shadercache.h"
+#include <stdio.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define SHADER_CACHE_MAGIC 0x5348444bu // "KDHS"
+// bump when the file layout or what goes into the key changes
+#define SHADER_CACHE_VERSION 1
+// the offset basis of the check hash, anything but fnv's own
+#define SHADER_CACHE_CHECK_BASIS 0x84222325cbf29ce4ull
+
+struct ShaderCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t check;
+	uint64_t bytecodeHash;
+	uint64_t size;
+};
+
+// fnv-1a, 64 bit
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// with the terminator, so "ab" "c" and "a" "bc" hash differently
+static uint64_t hashString(const std::string &string, uint64_t hash)
+{
+	return hashBytes(string.c_str(), string.size() + 1, hash);
+}
+
+ShaderCacheStats::ShaderCacheStats() : hits(0), misses(0), failed(0), stored(0), rejected(0)
+{
+
+}
+
+ShaderCache::ShaderCache(ShaderCompiler &compiler, const char *directory) : compiler_(compiler), directory_(directory)
+{
+	if (!directory_.empty() && directory_[directory_.size() - 1] != '/' && directory_[directory_.size() - 1] != '\\') {
+		directory_ += '/';
+	}
+	MakeDirectory(directory);
+}
+
+ShaderCache::~ShaderCache()
+{
+
+}
+
+/*static*/ bool ShaderCache::MakeDirectory(const char *path)
+{
+#ifdef _WIN32
+	return _mkdir(path) == 0 || errno == EEXIST;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+/*static*/ void ShaderCache::Hash(const std::string &compilerVersion, const ShaderCompileRequest &request, const std::string &source,
+	const std::vector<std::string> &includes, uint64_t &key, uint64_t &check)
+{
+	const uint64_t bases[2] = { 0xcbf29ce484222325ull, SHADER_CACHE_CHECK_BASIS };
+	uint64_t hashes[2];
+	for (int i = 0; i < 2; i++) {
+		uint64_t hash = bases[i];
+		const uint32_t version = SHADER_CACHE_VERSION;
+		hash = hashBytes(&version, sizeof(version), hash);
+		hash = hashString(compilerVersion, hash);
+		hash = hashString(request.entryPoint, hash);
+		hash = hashString(request.profile, hash);
+		const uint32_t flags = request.flags;
+		hash = hashBytes(&flags, sizeof(flags), hash);
+		// the defines are in the source already, but a define nothing uses still makes a different request
+		for (size_t d = 0; d < request.defines.size(); d++) {
+			hash = hashString(request.defines[d].name, hash);
+			hash = hashString(request.defines[d].value, hash);
+		}
+		const uint32_t counts[2] = { (uint32_t) request.defines.size(), (uint32_t) includes.size() };
+		hash = hashBytes(counts, sizeof(counts), hash);
+		for (size_t n = 0; n < includes.size(); n++) {
+			hash = hashString(includes[n], hash);
+		}
+		hashes[i] = hashString(source, hash);
+	}
+	key = hashes[0];
+	check = hashes[1];
+}
+
+std::string ShaderCache::getPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cso", (unsigned long long) key);
+	return directory_ + name;
+}
+
+bool ShaderCache::load(uint64_t key, uint64_t check, std::vector<uint8_t> &bytecode)
+{
+	FILE *file = fopen(getPath(key).c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	ShaderCacheHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC && header.version == SHADER_CACHE_VERSION
+		&& header.key == key && header.check == check && header.size > 0 && header.size < (1u << 30);
+	if (ok) {
+		bytecode.resize((size_t) header.size);
+		ok = fread(&bytecode[0], 1, bytecode.size(), file) == bytecode.size()
+			&& hashBytes(&bytecode[0], bytecode.size(), 0xcbf29ce484222325ull) == header.bytecodeHash;
+	}
+	fclose(file);
+	if (!ok) {
+		bytecode.clear();
+		stats_.rejected++;
+	}
+	return ok;
+}
+
+bool ShaderCache::store(uint64_t key, uint64_t check, const std::vector<uint8_t> &bytecode)
+{
+	// written next to it and renamed, so a file with the key's name is always whole
+	const std::string path = getPath(key);
+	const std::string temp = path + ".tmp";
+	FILE *file = fopen(temp.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	ShaderCacheHeader header;
+	header.magic = SHADER_CACHE_MAGIC;
+	header.version = SHADER_CACHE_VERSION;
+	header.key = key;
+	header.check = check;
+	header.bytecodeHash = hashBytes(&bytecode[0], bytecode.size(), 0xcbf29ce484222325ull);
+	header.size = bytecode.size();
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(&bytecode[0], 1, bytecode.size(), file) == bytecode.size();
+	ok = fclose(file) == 0 && ok;
+	// WORKNOTE: rename doesn't replace an existing file on windows
+	remove(path.c_str());
+	if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+		remove(temp.c_str());
+		return false;
+	}
+	stats_.stored++;
+	return true;
+}
+
+bool ShaderCache::get(const ShaderCompileRequest &request, std::vector<uint8_t> &bytecode, std::string &errors)
+{
+	std::string source;
+	std::vector<std::string> includes;
+	if (!compiler_.preprocess(request, source, includes, errors)) {
+		stats_.failed++;
+		return false;
+	}
+	uint64_t key, check;
+	Hash(compiler_.getVersion(), request, source, includes, key, check);
+	if (load(key, check, bytecode)) {
+		stats_.hits++;
+		return true;
+	}
+	stats_.misses++;
+	if (!compiler_.compile(request, source, bytecode, errors) || bytecode.empty()) {
+		stats_.failed++;
+		return false;
+	}
+	// a cache that can't be written only costs the next start its compile
+	store(key, check, bytecode);
+	return true;
+}
@@ -0,0 +1,56 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include "shadercompiler.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// compiled shaders on disk, content addressed: the key is a hash of the preprocessed source (which has the includes
+// in it), the resolved paths of the included files, the entry point, the profile, the defines, the compile flags and the
+// compiler's version, and the bytecode is stored in a file named after it. a request whose key has a file is loaded
+// with no compile, so editing a shader or anything it includes is a miss and everything else a hit, there's nothing to
+// invalidate
+// WORKNOTE: preprocessing still runs on every request, it's what the key is made of, but it's a small part of a compile
+
+struct ShaderCacheStats {
+	ShaderCacheStats();
+
+	unsigned int hits;
+	unsigned int misses;
+	// the compiles of the misses that failed, nothing is stored for them
+	unsigned int failed;
+	// files written, and files that were there for the key but truncated or for other key material (a hash collision)
+	unsigned int stored;
+	unsigned int rejected;
+};
+
+class ShaderCache {
+public:
+	// directory is created if it isn't there
+	ShaderCache(ShaderCompiler &compiler, const char *directory);
+	virtual ~ShaderCache();
+
+	// the bytecode of request from its file, or compiled and stored when there is none
+	// false with the compiler's messages in errors when it can't be preprocessed or compiled
+	bool get(const ShaderCompileRequest &request, std::vector<uint8_t> &bytecode, std::string &errors);
+
+	const ShaderCacheStats& getStats() const { return stats_; }
+	// the file a key's bytecode is stored in
+	std::string getPath(uint64_t key) const;
+
+	// the key, and the check that is stored next to the bytecode (another hash of the same key material)
+	static void Hash(const std::string &compilerVersion, const ShaderCompileRequest &request, const std::string &source,
+		const std::vector<std::string> &includes, uint64_t &key, uint64_t &check);
+	static bool MakeDirectory(const char *path);
+
+private:
+	bool load(uint64_t key, uint64_t check, std::vector<uint8_t> &bytecode);
+	bool store(uint64_t key, uint64_t check, const std::vector<uint8_t> &bytecode);
+
+	ShaderCompiler &compiler_;
+	std::string directory_;
+	ShaderCacheStats stats_;
+};
+
+#endif // SHADERCACHE_H
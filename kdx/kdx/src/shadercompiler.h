@@ -0,0 +1,43 @@
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// what a shader is compiled from, everything in here is part of a ShaderCache key
+struct ShaderDefine {
+	std::string name;
+	std::string value;
+};
+
+struct ShaderCompileRequest {
+	ShaderCompileRequest() : flags(0) {}
+
+	std::wstring filename;
+	std::string entryPoint;
+	std::string profile;
+	std::vector<ShaderDefine> defines;
+	// the D3D10_SHADER_* flags of the compile
+	unsigned int flags;
+};
+
+// a shader compiler split into its two steps, so the ShaderCache can key on the preprocessed source and only compile
+// on a miss. Dx11ShaderCompiler is d3dx's, anything else (a stub that doesn't know hlsl) works the same for the cache
+class ShaderCompiler {
+public:
+	virtual ~ShaderCompiler() {}
+
+	// the compiler and its version, part of the cache key so a new compiler doesn't load the old one's bytecode
+	virtual std::string getVersion() const = 0;
+	// the source with the includes and defines expanded, includes gets the path of every file that was opened for it,
+	// each include resolved relative to the file that includes it
+	// false with the messages in errors when the file or one of its includes can't be read
+	virtual bool preprocess(const ShaderCompileRequest &request, std::string &source, std::vector<std::string> &includes,
+		std::string &errors) = 0;
+	// compiles the preprocessed source of request to bytecode, false with the messages in errors when that fails
+	virtual bool compile(const ShaderCompileRequest &request, const std::string &source, std::vector<uint8_t> &bytecode,
+		std::string &errors) = 0;
+};
+
+#endif // SHADERCOMPILER_H
@@ -0,0 +1,454 @@
+#include "statecache.h"
+#include <string.h>
+
+// shadow value of a slot whose contents aren't known, never a resource id
+#define UNKNOWN_ID 0xffffffffu
+
+static unsigned int idOf(const RenderResource *resource)
+{
+	return resource ? resource->getId() : 0;
+}
+
+// the slots of an array bind that differ from the shadow, false when the whole call is redundant
+template<typename T>
+static bool changedRange(const unsigned int *shadow, unsigned int slot, unsigned int count, T *const *items,
+	unsigned int &first, unsigned int &last)
+{
+	first = count;
+	last = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		if (shadow[slot + i] != idOf(items ? items[i] : 0)) {
+			first = first < i ? first : i;
+			last = i + 1;
+		}
+	}
+	return first < last;
+}
+
+StateCacheStats::StateCacheStats() : other(0)
+{
+	memset(issued, 0, sizeof(issued));
+	memset(filtered, 0, sizeof(filtered));
+}
+
+unsigned int StateCacheStats::getIssued() const
+{
+	unsigned int total = 0;
+	for (int i = 0; i < STATE_CALL_COUNT; i++) {
+		total += issued[i];
+	}
+	return total;
+}
+
+unsigned int StateCacheStats::getFiltered() const
+{
+	unsigned int total = 0;
+	for (int i = 0; i < STATE_CALL_COUNT; i++) {
+		total += filtered[i];
+	}
+	return total;
+}
+
+StateCache::StateCache(RenderContext &context) : context_(context), enabled_(true)
+{
+	invalidate();
+}
+
+StateCache::~StateCache()
+{
+
+}
+
+void StateCache::invalidate()
+{
+	numtargets_ = UNKNOWN_ID;
+	for (int i = 0; i < STATE_CACHE_SLOTS; i++) {
+		targets_[i] = UNKNOWN_ID;
+	}
+	for (int i = 0; i < STATE_CACHE_UAV_SLOTS; i++) {
+		uavs_[i] = UNKNOWN_ID;
+	}
+	depth_ = UNKNOWN_ID;
+	viewportknown_ = false;
+	depthstate_ = UNKNOWN_ID;
+	for (int stage = 0; stage < NUM_SHADER_STAGES; stage++) {
+		shaders_[stage] = UNKNOWN_ID;
+		for (int i = 0; i < STATE_CACHE_SLOTS; i++) {
+			constantbuffers_[stage][i] = UNKNOWN_ID;
+			constantoffsets_[stage][i] = 0;
+			constantsizes_[stage][i] = 0;
+			resources_[stage][i] = UNKNOWN_ID;
+			samplers_[stage][i] = UNKNOWN_ID;
+		}
+	}
+	inputlayout_ = UNKNOWN_ID;
+	vertexbuffer_ = UNKNOWN_ID;
+	instancebuffer_ = UNKNOWN_ID;
+	indexbuffer_ = UNKNOWN_ID;
+	topologyknown_ = false;
+}
+
+void StateCache::setEnabled(bool enabled)
+{
+	enabled_ = enabled;
+	invalidate();
+}
+
+void StateCache::endFrame()
+{
+	framestats_ = stats_;
+	stats_ = StateCacheStats();
+}
+
+void StateCache::record(STATE_CALL call, bool issued)
+{
+	if (issued) {
+		stats_.issued[call]++;
+	} else {
+		stats_.filtered[call]++;
+	}
+}
+
+bool StateCache::isOutput(unsigned int id) const
+{
+	if (id == 0) {
+		return false;
+	}
+	if (depth_ == id || depth_ == UNKNOWN_ID || numtargets_ == UNKNOWN_ID) {
+		return true;
+	}
+	for (unsigned int i = 0; i < numtargets_; i++) {
+		if (targets_[i] == id || targets_[i] == UNKNOWN_ID) {
+			return true;
+		}
+	}
+	for (int i = 0; i < STATE_CACHE_UAV_SLOTS; i++) {
+		if (uavs_[i] == id || uavs_[i] == UNKNOWN_ID) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void StateCache::unbindInputs(const unsigned int *ids, unsigned int count)
+{
+	for (unsigned int n = 0; n < count; n++) {
+		if (ids[n] == 0) {
+			continue;
+		}
+		for (int stage = 0; stage < NUM_SHADER_STAGES; stage++) {
+			for (int i = 0; i < STATE_CACHE_SLOTS; i++) {
+				if (resources_[stage][i] == ids[n]) {
+					resources_[stage][i] = UNKNOWN_ID;
+				}
+			}
+		}
+	}
+}
+
+void StateCache::setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth)
+{
+	unsigned int ids[STATE_CACHE_SLOTS + 1];
+	bool same = enabled_ && count <= STATE_CACHE_SLOTS && count == numtargets_ && idOf(depth) == depth_;
+	for (unsigned int i = 0; i < count && i < STATE_CACHE_SLOTS; i++) {
+		ids[i] = idOf(targets ? targets[i] : 0);
+		same = same && ids[i] == targets_[i];
+	}
+	record(STATE_RENDER_TARGETS, !same);
+	if (same) {
+		return;
+	}
+	context_.setRenderTargets(count, targets, depth);
+	if (count > STATE_CACHE_SLOTS) {
+		invalidate();
+		return;
+	}
+	numtargets_ = count;
+	memcpy(targets_, ids, count * sizeof(unsigned int));
+	depth_ = idOf(depth);
+	// the new outputs are unbound from every input slot, and from the compute uavs
+	ids[count] = depth_;
+	unbindInputs(ids, count + 1);
+	for (unsigned int n = 0; n <= count; n++) {
+		for (int i = 0; i < STATE_CACHE_UAV_SLOTS; i++) {
+			if (ids[n] != 0 && uavs_[i] == ids[n]) {
+				uavs_[i] = UNKNOWN_ID;
+			}
+		}
+	}
+}
+
+void StateCache::setViewport(const Viewport &viewport)
+{
+	const bool same = enabled_ && viewportknown_ && memcmp(&viewport, &viewport_, sizeof(Viewport)) == 0;
+	record(STATE_VIEWPORT, !same);
+	if (!same) {
+		context_.setViewport(viewport);
+		viewport_ = viewport;
+		viewportknown_ = true;
+	}
+}
+
+void StateCache::setDepthState(RenderDepthState *state)
+{
+	const bool same = enabled_ && idOf(state) == depthstate_;
+	record(STATE_DEPTH_STATE, !same);
+	if (!same) {
+		context_.setDepthState(state);
+		depthstate_ = idOf(state);
+	}
+}
+
+void StateCache::clearRenderTarget(RenderTexture *target, const float color[4])
+{
+	stats_.other++;
+	context_.clearRenderTarget(target, color);
+}
+
+void StateCache::clearDepth(RenderTexture *depth, float value)
+{
+	stats_.other++;
+	context_.clearDepth(depth, value);
+}
+
+void StateCache::setShader(SHADER_STAGE stage, RenderShader *shader)
+{
+	const bool same = enabled_ && idOf(shader) == shaders_[stage];
+	record(STATE_SHADER, !same);
+	if (!same) {
+		context_.setShader(stage, shader);
+		shaders_[stage] = idOf(shader);
+	}
+}
+
+void StateCache::setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers)
+{
+	unsigned int first, last;
+	if (!enabled_ || slot + count > STATE_CACHE_SLOTS) {
+		record(STATE_CONSTANT_BUFFERS, true);
+		context_.setConstantBuffers(stage, slot, count, buffers);
+		for (unsigned int i = slot; i < slot + count && i < STATE_CACHE_SLOTS; i++) {
+			constantbuffers_[stage][i] = UNKNOWN_ID;
+			constantsizes_[stage][i] = 0;
+		}
+		return;
+	}
+	// a slot holding a range of the same buffer still has to be rebound to get the whole buffer
+	for (unsigned int i = slot; i < slot + count; i++) {
+		if (constantsizes_[stage][i] != 0) {
+			constantbuffers_[stage][i] = UNKNOWN_ID;
+			constantsizes_[stage][i] = 0;
+		}
+	}
+	const bool changed = changedRange(constantbuffers_[stage], slot, count, buffers, first, last);
+	record(STATE_CONSTANT_BUFFERS, changed);
+	if (changed) {
+		context_.setConstantBuffers(stage, slot + first, last - first, buffers ? buffers + first : 0);
+		for (unsigned int i = first; i < last; i++) {
+			constantbuffers_[stage][slot + i] = idOf(buffers ? buffers[i] : 0);
+		}
+	}
+}
+
+void StateCache::setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size)
+{
+	if (!enabled_ || slot >= STATE_CACHE_SLOTS) {
+		record(STATE_CONSTANT_BUFFERS, true);
+		context_.setConstantBufferRange(stage, slot, buffer, offset, size);
+		if (slot < STATE_CACHE_SLOTS) {
+			constantbuffers_[stage][slot] = UNKNOWN_ID;
+		}
+		return;
+	}
+	const unsigned int id = idOf(buffer);
+	const bool same = constantbuffers_[stage][slot] == id && constantoffsets_[stage][slot] == offset && constantsizes_[stage][slot] == size;
+	record(STATE_CONSTANT_BUFFERS, !same);
+	if (!same) {
+		context_.setConstantBufferRange(stage, slot, buffer, offset, size);
+		constantbuffers_[stage][slot] = id;
+		constantoffsets_[stage][slot] = offset;
+		constantsizes_[stage][slot] = size;
+	}
+}
+
+void StateCache::setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures)
+{
+	unsigned int first, last;
+	if (!enabled_ || slot + count > STATE_CACHE_SLOTS) {
+		record(STATE_SHADER_RESOURCES, true);
+		context_.setShaderResources(stage, slot, count, textures);
+		for (unsigned int i = slot; i < slot + count && i < STATE_CACHE_SLOTS; i++) {
+			resources_[stage][i] = UNKNOWN_ID;
+		}
+		return;
+	}
+	const bool changed = changedRange(resources_[stage], slot, count, textures, first, last);
+	record(STATE_SHADER_RESOURCES, changed);
+	if (changed) {
+		context_.setShaderResources(stage, slot + first, last - first, textures ? textures + first : 0);
+		for (unsigned int i = first; i < last; i++) {
+			// a texture that is bound as an output doesn't make it to the slot on d3d11
+			const unsigned int id = idOf(textures ? textures[i] : 0);
+			resources_[stage][slot + i] = isOutput(id) ? UNKNOWN_ID : id;
+		}
+	}
+}
+
+void StateCache::setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers)
+{
+	unsigned int first, last;
+	if (!enabled_ || slot + count > STATE_CACHE_SLOTS) {
+		record(STATE_SAMPLERS, true);
+		context_.setSamplers(stage, slot, count, samplers);
+		for (unsigned int i = slot; i < slot + count && i < STATE_CACHE_SLOTS; i++) {
+			samplers_[stage][i] = UNKNOWN_ID;
+		}
+		return;
+	}
+	const bool changed = changedRange(samplers_[stage], slot, count, samplers, first, last);
+	record(STATE_SAMPLERS, changed);
+	if (changed) {
+		context_.setSamplers(stage, slot + first, last - first, samplers ? samplers + first : 0);
+		for (unsigned int i = first; i < last; i++) {
+			samplers_[stage][slot + i] = idOf(samplers ? samplers[i] : 0);
+		}
+	}
+}
+
+void StateCache::setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures)
+{
+	unsigned int first, last;
+	if (!enabled_ || slot + count > STATE_CACHE_UAV_SLOTS) {
+		record(STATE_UAVS, true);
+		context_.setUnorderedAccessViews(slot, count, textures);
+		for (unsigned int i = slot; i < slot + count && i < STATE_CACHE_UAV_SLOTS; i++) {
+			uavs_[i] = UNKNOWN_ID;
+		}
+		return;
+	}
+	const bool changed = changedRange(uavs_, slot, count, textures, first, last);
+	record(STATE_UAVS, changed);
+	if (changed) {
+		context_.setUnorderedAccessViews(slot + first, last - first, textures ? textures + first : 0);
+		unsigned int ids[STATE_CACHE_UAV_SLOTS];
+		for (unsigned int i = first; i < last; i++) {
+			ids[i - first] = idOf(textures ? textures[i] : 0);
+			uavs_[slot + i] = ids[i - first];
+		}
+		unbindInputs(ids, last - first);
+		// and a render target that becomes a uav is no longer known to be bound either
+		for (unsigned int n = 0; n < last - first; n++) {
+			for (unsigned int i = 0; i < STATE_CACHE_SLOTS; i++) {
+				if (ids[n] != 0 && (targets_[i] == ids[n] || depth_ == ids[n])) {
+					numtargets_ = UNKNOWN_ID;
+				}
+			}
+		}
+	}
+}
+
+void StateCache::setInputLayout(RenderInputLayout *layout)
+{
+	const bool same = enabled_ && idOf(layout) == inputlayout_;
+	record(STATE_INPUT_LAYOUT, !same);
+	if (!same) {
+		context_.setInputLayout(layout);
+		inputlayout_ = idOf(layout);
+	}
+}
+
+void StateCache::setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset)
+{
+	const bool same = enabled_ && idOf(buffer) == vertexbuffer_ && stride == vertexstride_ && offset == vertexoffset_;
+	record(STATE_VERTEX_BUFFER, !same);
+	if (!same) {
+		context_.setVertexBuffer(buffer, stride, offset);
+		vertexbuffer_ = idOf(buffer);
+		vertexstride_ = stride;
+		vertexoffset_ = offset;
+	}
+}
+
+void StateCache::setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset)
+{
+	const bool same = enabled_ && idOf(buffer) == instancebuffer_ && stride == instancestride_ && offset == instanceoffset_;
+	record(STATE_INSTANCE_BUFFER, !same);
+	if (!same) {
+		context_.setInstanceBuffer(buffer, stride, offset);
+		instancebuffer_ = idOf(buffer);
+		instancestride_ = stride;
+		instanceoffset_ = offset;
+	}
+}
+
+void StateCache::setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset)
+{
+	const bool same = enabled_ && idOf(buffer) == indexbuffer_ && format == indexformat_ && offset == indexoffset_;
+	record(STATE_INDEX_BUFFER, !same);
+	if (!same) {
+		context_.setIndexBuffer(buffer, format, offset);
+		indexbuffer_ = idOf(buffer);
+		indexformat_ = format;
+		indexoffset_ = offset;
+	}
+}
+
+void StateCache::setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology)
+{
+	const bool same = enabled_ && topologyknown_ && topology == topology_;
+	record(STATE_TOPOLOGY, !same);
+	if (!same) {
+		context_.setPrimitiveTopology(topology);
+		topology_ = topology;
+		topologyknown_ = true;
+	}
+}
+
+void StateCache::updateBuffer(RenderBuffer *buffer, const void *data, size_t size)
+{
+	stats_.other++;
+	context_.updateBuffer(buffer, data, size);
+}
+
+void StateCache::writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size)
+{
+	stats_.other++;
+	context_.writeBuffer(buffer, offset, data, size);
+}
+
+void StateCache::copyTexture(RenderTexture *dst, RenderTexture *src)
+{
+	stats_.other++;
+	context_.copyTexture(dst, src);
+}
+
+void StateCache::generateMips(RenderTexture *texture)
+{
+	stats_.other++;
+	context_.generateMips(texture);
+}
+
+void StateCache::drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	stats_.other++;
+	context_.drawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateCache::drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	stats_.other++;
+	context_.drawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void StateCache::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
+{
+	stats_.other++;
+	context_.dispatch(groupsX, groupsY, groupsZ);
+}
+
+/*static*/ const char* StateCache::GetCallName(STATE_CALL call)
+{
+	static const char *names[STATE_CALL_COUNT] = { "render targets", "viewport", "depth state", "shader", "constant buffers",
+		"shader resources", "samplers", "uavs", "input layout", "vertex buffer", "instance buffer", "index buffer", "topology" };
+	return names[call];
+}
@@ -0,0 +1,134 @@
+#ifndef STATECACHE_H
+#define STATECACHE_H
+
+#include "renderdevice.h"
+
+// redundant state filtering in front of a backend's context
+// it shadows what is bound (render targets, viewport, depth state, shaders, constant buffers, shader resources,
+// samplers, uavs and the input assembler) by resource id and only forwards the binds that change something,
+// array binds are trimmed to the slots that changed. clears, updates, copies, draws and dispatches always go through
+//
+// d3d11 drops input binds of a texture that is bound as an output and unbinds inputs when they get bound as an output,
+// the shadow follows that conservatively: the slots involved become unknown and their next bind is always issued
+//
+// WORKNOTE: anything that binds on the backend directly (DxBase::getDeviceContext) has to call invalidate afterwards
+
+// kinds of state calls, for the counters
+enum STATE_CALL {
+	STATE_RENDER_TARGETS = 0,
+	STATE_VIEWPORT,
+	STATE_DEPTH_STATE,
+	STATE_SHADER,
+	STATE_CONSTANT_BUFFERS,
+	STATE_SHADER_RESOURCES,
+	STATE_SAMPLERS,
+	STATE_UAVS,
+	STATE_INPUT_LAYOUT,
+	STATE_VERTEX_BUFFER,
+	STATE_INSTANCE_BUFFER,
+	STATE_INDEX_BUFFER,
+	STATE_TOPOLOGY,
+	STATE_CALL_COUNT
+};
+
+// slots shadowed per stage and kind of bind, binds above them are passed on unfiltered
+#define STATE_CACHE_SLOTS 16
+// uav slots of a d3d11.0 compute shader, all of them have to be known for the srv hazard checks to pass
+#define STATE_CACHE_UAV_SLOTS 8
+
+struct StateCacheStats {
+	StateCacheStats();
+
+	unsigned int getIssued() const;
+	unsigned int getFiltered() const;
+
+	// state calls passed on to the backend and dropped as redundant, per kind
+	unsigned int issued[STATE_CALL_COUNT];
+	unsigned int filtered[STATE_CALL_COUNT];
+	// everything else that went through (clears, updates, copies, draws, dispatches)
+	unsigned int other;
+};
+
+class StateCache : public RenderContext {
+public:
+	StateCache(RenderContext &context);
+	virtual ~StateCache();
+
+	virtual void setRenderTargets(unsigned int count, RenderTexture *const *targets, RenderTexture *depth);
+	virtual void setViewport(const Viewport &viewport);
+	virtual void setDepthState(RenderDepthState *state);
+	virtual void clearRenderTarget(RenderTexture *target, const float color[4]);
+	virtual void clearDepth(RenderTexture *depth, float value);
+
+	virtual void setShader(SHADER_STAGE stage, RenderShader *shader);
+	virtual void setConstantBuffers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderBuffer *const *buffers);
+	virtual void setConstantBufferRange(SHADER_STAGE stage, unsigned int slot, RenderBuffer *buffer, unsigned int offset, unsigned int size);
+	virtual void setShaderResources(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderTexture *const *textures);
+	virtual void setSamplers(SHADER_STAGE stage, unsigned int slot, unsigned int count, RenderSampler *const *samplers);
+	virtual void setUnorderedAccessViews(unsigned int slot, unsigned int count, RenderTexture *const *textures);
+
+	virtual void setInputLayout(RenderInputLayout *layout);
+	virtual void setVertexBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset);
+	virtual void setInstanceBuffer(RenderBuffer *buffer, unsigned int stride, unsigned int offset);
+	virtual void setIndexBuffer(RenderBuffer *buffer, RENDER_FORMAT format, unsigned int offset);
+	virtual void setPrimitiveTopology(PRIMITIVE_TOPOLOGY topology);
+
+	virtual void updateBuffer(RenderBuffer *buffer, const void *data, size_t size);
+	virtual void writeBuffer(RenderBuffer *buffer, size_t offset, const void *data, size_t size);
+	virtual void copyTexture(RenderTexture *dst, RenderTexture *src);
+	virtual void generateMips(RenderTexture *texture);
+
+	virtual void drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	virtual void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance);
+	virtual void dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
+
+	// forget the shadowed state, the next bind of everything is issued
+	void invalidate();
+	// off passes every call on (still counted as issued), for comparing against the unfiltered stream
+	void setEnabled(bool enabled);
+
+	// counters of the frame so far, and of the last frame once endFrame was called
+	const StateCacheStats& getStats() const { return stats_; }
+	const StateCacheStats& getFrameStats() const { return framestats_; }
+	void endFrame();
+
+	static const char* GetCallName(STATE_CALL call);
+private:
+	// the texture is bound as a render target, depth buffer or uav in the shadow
+	bool isOutput(unsigned int id) const;
+	// texture ids that became outputs, their input slots turn unknown
+	void unbindInputs(const unsigned int *ids, unsigned int count);
+	void record(STATE_CALL call, bool issued);
+
+	RenderContext &context_;
+	bool enabled_;
+
+	unsigned int numtargets_;
+	unsigned int targets_[STATE_CACHE_SLOTS];
+	unsigned int depth_;
+	Viewport viewport_;
+	bool viewportknown_;
+	unsigned int depthstate_;
+
+	unsigned int shaders_[NUM_SHADER_STAGES];
+	unsigned int constantbuffers_[NUM_SHADER_STAGES][STATE_CACHE_SLOTS];
+	// the range of a buffer bound with setConstantBufferRange, size 0 for a whole buffer
+	unsigned int constantoffsets_[NUM_SHADER_STAGES][STATE_CACHE_SLOTS];
+	unsigned int constantsizes_[NUM_SHADER_STAGES][STATE_CACHE_SLOTS];
+	unsigned int resources_[NUM_SHADER_STAGES][STATE_CACHE_SLOTS];
+	unsigned int samplers_[NUM_SHADER_STAGES][STATE_CACHE_SLOTS];
+	unsigned int uavs_[STATE_CACHE_UAV_SLOTS];
+
+	unsigned int inputlayout_;
+	unsigned int vertexbuffer_, vertexstride_, vertexoffset_;
+	unsigned int instancebuffer_, instancestride_, instanceoffset_;
+	unsigned int indexbuffer_, indexoffset_;
+	RENDER_FORMAT indexformat_;
+	PRIMITIVE_TOPOLOGY topology_;
+	bool topologyknown_;
+
+	StateCacheStats stats_;
+	StateCacheStats framestats_;
+};
+
+#endif // STATECACHE_H
@@ -0,0 +1,101 @@
+#include "targetpool.h"
+#include <assert.h>
+
+RenderTargetPoolStats::RenderTargetPoolStats() : hits(0), misses(0), evictions(0), targets(0), targetsInUse(0),
+	bytesResident(0), peakBytesResident(0)
+{
+
+}
+
+RenderTargetPool::RenderTargetPool(RenderDevice &dev, unsigned int maxIdleFrames) : dev_(dev), maxidleframes_(maxIdleFrames)
+{
+
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+	for (std::multimap<Key, FreeTarget>::iterator it = free_.begin(); it != free_.end(); it++) {
+		delete it->second.texture;
+	}
+	for (std::set<RenderTexture *>::iterator it = inuse_.begin(); it != inuse_.end(); it++) {
+		delete *it;
+	}
+}
+
+bool RenderTargetPool::Key::operator<(const Key &other) const
+{
+	if (width != other.width) return width < other.width;
+	if (height != other.height) return height < other.height;
+	if (format != other.format) return format < other.format;
+	if (numSamples != other.numSamples) return numSamples < other.numSamples;
+	if (mipLevels != other.mipLevels) return mipLevels < other.mipLevels;
+	return bindFlags < other.bindFlags;
+}
+
+/*static*/ RenderTargetPool::Key RenderTargetPool::GetKey(const TextureDesc &desc)
+{
+	const Key key = { desc.width, desc.height, desc.format, desc.numSamples, desc.mipLevels, desc.bindFlags };
+	return key;
+}
+
+RenderTexture* RenderTargetPool::acquire(const TextureDesc &desc)
+{
+	RenderTexture *texture = 0;
+	std::multimap<Key, FreeTarget>::iterator it = free_.find(GetKey(desc));
+	if (it != free_.end()) {
+		texture = it->second.texture;
+		free_.erase(it);
+		stats_.hits++;
+	} else {
+		texture = dev_.createTexture(desc);
+		if (!texture) {
+			return 0;
+		}
+		stats_.misses++;
+		stats_.targets++;
+		stats_.bytesResident += textureMemory(desc);
+		stats_.peakBytesResident = stats_.bytesResident > stats_.peakBytesResident ? stats_.bytesResident : stats_.peakBytesResident;
+	}
+	inuse_.insert(texture);
+	stats_.targetsInUse++;
+	return texture;
+}
+
+void RenderTargetPool::release(RenderTexture *texture)
+{
+	const size_t erased = inuse_.erase(texture);
+	assert(erased == 1);
+	(void) erased;
+	FreeTarget target = { texture, 0 };
+	free_.insert(std::make_pair(GetKey(texture->getDesc()), target));
+	stats_.targetsInUse--;
+}
+
+void RenderTargetPool::destroy(RenderTexture *texture)
+{
+	stats_.targets--;
+	stats_.bytesResident -= textureMemory(texture->getDesc());
+	delete texture;
+}
+
+void RenderTargetPool::endFrame()
+{
+	std::multimap<Key, FreeTarget>::iterator it = free_.begin();
+	while (it != free_.end()) {
+		if (++it->second.idleframes > maxidleframes_) {
+			destroy(it->second.texture);
+			stats_.evictions++;
+			it = free_.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+void RenderTargetPool::trim()
+{
+	for (std::multimap<Key, FreeTarget>::iterator it = free_.begin(); it != free_.end(); it++) {
+		destroy(it->second.texture);
+	}
+	free_.clear();
+}
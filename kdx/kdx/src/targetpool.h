@@ -0,0 +1,70 @@
+#ifndef TARGETPOOL_H
+#define TARGETPOOL_H
+
+#include "renderdevice.h"
+#include <map>
+#include <set>
+
+// render targets handed out for a frame and taken back afterwards, so the same few textures get reused instead of
+// created and destroyed every time a graph is compiled or a framebuffer resized
+// targets are matched on (width, height, format, samples, mips, bind flags). a released target that goes unused for
+// more than maxIdleFrames endFrames is deleted, so after a resize the old size lingers for a few frames (and coming
+// back to it costs nothing) and is then dropped
+//
+// WORKNOTE: the pool owns what it hands out, released or not, targets must not be deleted by whoever acquired them
+
+#define TARGET_POOL_IDLE_FRAMES 3
+
+struct RenderTargetPoolStats {
+	RenderTargetPoolStats();
+
+	// acquires served from the pool and ones that had to create a target, targets deleted for being idle
+	unsigned int hits, misses, evictions;
+	// what the pool holds right now
+	unsigned int targets, targetsInUse;
+	size_t bytesResident;
+	size_t peakBytesResident;
+};
+
+class RenderTargetPool {
+public:
+	RenderTargetPool(RenderDevice &dev, unsigned int maxIdleFrames = TARGET_POOL_IDLE_FRAMES);
+	virtual ~RenderTargetPool();
+
+	// a target with the desc that nobody else holds, 0 when a new one was needed and couldn't be created
+	RenderTexture* acquire(const TextureDesc &desc);
+	// gives a target back, it can be handed out again right away
+	void release(RenderTexture *texture);
+
+	// ages the released targets and deletes the ones idle for too long
+	void endFrame();
+	// deletes every released target
+	void trim();
+	void setMaxIdleFrames(unsigned int frames) { maxidleframes_ = frames; }
+
+	// counters since the pool was created
+	const RenderTargetPoolStats& getStats() const { return stats_; }
+
+private:
+	struct Key {
+		unsigned int width, height;
+		RENDER_FORMAT format;
+		unsigned int numSamples, mipLevels, bindFlags;
+		bool operator<(const Key &other) const;
+	};
+	struct FreeTarget {
+		RenderTexture *texture;
+		unsigned int idleframes;
+	};
+
+	static Key GetKey(const TextureDesc &desc);
+	void destroy(RenderTexture *texture);
+
+	RenderDevice &dev_;
+	unsigned int maxidleframes_;
+	std::multimap<Key, FreeTarget> free_;
+	std::set<RenderTexture *> inuse_;
+	RenderTargetPoolStats stats_;
+};
+
+#endif // TARGETPOOL_H
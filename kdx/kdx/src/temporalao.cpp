@@ -0,0 +1,157 @@
+#include "temporalao.h"
+#include "constants.h"
+#include "parallel.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+// rows handed to a worker at a time
+#define TEMPORAL_ROW_GRAIN 8
+
+TemporalAo::TemporalAo() : valid_(false), frame_(0), period_(4), maxFrames_(8), depthTolerance_(0.05f), normalThreshold_(0.9f)
+{
+	memset(prevInvProj_, 0, sizeof(prevInvProj_));
+	memset(&stats_, 0, sizeof(Stats));
+}
+
+TemporalAo::~TemporalAo()
+{
+
+}
+
+void TemporalAo::reset()
+{
+	valid_ = false;
+	frame_ = 0;
+}
+
+float TemporalAo::getRotation(const AoParams &params) const
+{
+	const float sector = 2.f * M_PI / std::max(params.numDirections, 1);
+	return sector * (frame_ % period_) / period_;
+}
+
+void TemporalAo::accumulate(const AoInput &input, const Matrix &view, const Matrix &proj, const FloatImage &ao, FloatImage &out)
+{
+	const int width = ao.getWidth();
+	const int height = ao.getHeight();
+	if (history_.getWidth() != width || history_.getHeight() != height) {
+		history_.resize(width, height);
+		historyFrames_.resize(width, height);
+		nextFrames_.resize(width, height);
+		prevViewZ_.resize(width, height);
+		prevNormals_.resize(width, height);
+		valid_ = false;
+	}
+	if (out.getWidth() != width || out.getHeight() != height) {
+		out.resize(width, height);
+	}
+
+	// this frame's ndc to last frame's clip space, proj * view for column vectors is the d3dx view * proj
+	Matrix viewProj (proj);
+	viewProj.multMatrix(view);
+	Matrix invViewProj;
+	viewProj.getInverse(invViewProj);
+	Matrix reproject (prevViewProj_);
+	reproject.multMatrix(invViewProj);
+	float r[16];
+	memcpy(r, reproject.data(), sizeof(r));
+	float invProj[16];
+	memcpy(invProj, input.invProj.data(), sizeof(invProj));
+
+	std::atomic<uint32_t> accepted (0), rejected (0);
+	const bool valid = valid_;
+	parallelFor(0, height, TEMPORAL_ROW_GRAIN, [&](int y0, int y1) {
+		uint32_t chunkAccepted = 0, chunkRejected = 0;
+		for (int y = y0; y < y1; y++) {
+			const float ny = 1.f - 2.f * (y + 0.5f) / height;
+			for (int x = 0; x < width; x++) {
+				const float z = input.depth->at(x, y);
+				const float current = ao.at(x, y);
+				// nothing was drawn here, there is no surface to keep a history for
+				if (z >= 1.f) {
+					out.at(x, y) = current;
+					nextFrames_.at(x, y) = 0;
+					continue;
+				}
+
+				float total = 0.f, weight = 0.f;
+				int frames = maxFrames_;
+				if (valid) {
+					const float nx = 2.f * (x + 0.5f) / width - 1.f;
+					const float cw = r[3] * nx + r[7] * ny + r[11] * z + r[15];
+					if (cw > 0.f) {
+						const float invcw = 1.f / cw;
+						const float pu = 0.5f * ((r[0] * nx + r[4] * ny + r[8] * z + r[12]) * invcw + 1.f);
+						const float pv = 0.5f * (1.f - (r[1] * nx + r[5] * ny + r[9] * z + r[13]) * invcw);
+						const float expectedZ = viewDepth(prevInvProj_, (r[2] * nx + r[6] * ny + r[10] * z + r[14]) * invcw);
+						const fl3 &n = input.normals->at(x, y);
+
+						// bilinear over the texels that pass the depth and normal tests
+						const float fx = pu * width - 0.5f, fy = pv * height - 0.5f;
+						const int tx = (int) floorf(fx), ty = (int) floorf(fy);
+						const float ax = fx - tx, ay = fy - ty;
+						for (int j = 0; j < 2; j++) {
+							const int sy = ty + j;
+							if (sy < 0 || sy >= height) {
+								continue;
+							}
+							for (int i = 0; i < 2; i++) {
+								const int sx = tx + i;
+								if (sx < 0 || sx >= width) {
+									continue;
+								}
+								if (fabsf(prevViewZ_.at(sx, sy) - expectedZ) > depthTolerance_ * expectedZ) {
+									continue;
+								}
+								const fl3 &pn = prevNormals_.at(sx, sy);
+								if (n.x * pn.x + n.y * pn.y + n.z * pn.z < normalThreshold_) {
+									continue;
+								}
+								const float w = (i ? ax : 1.f - ax) * (j ? ay : 1.f - ay);
+								total += w * history_.at(sx, sy);
+								weight += w;
+								frames = std::min(frames, (int) historyFrames_.at(sx, sy));
+							}
+						}
+					}
+				}
+
+				if (weight > 1e-3f) {
+					// running average over the last maxFrames frames
+					const int count = std::min(frames + 1, maxFrames_);
+					const float previous = total / weight;
+					out.at(x, y) = previous + (current - previous) / count;
+					nextFrames_.at(x, y) = (uint8_t) count;
+					chunkAccepted++;
+				} else {
+					out.at(x, y) = current;
+					nextFrames_.at(x, y) = 1;
+					chunkRejected++;
+				}
+			}
+		}
+		accepted += chunkAccepted;
+		rejected += chunkRejected;
+	});
+
+	// this frame becomes the history
+	memcpy(history_.data(), out.data(), out.getByteSize());
+	memcpy(historyFrames_.data(), nextFrames_.data(), nextFrames_.getByteSize());
+	memcpy(prevNormals_.data(), input.normals->data(), input.normals->getByteSize());
+	parallelFor(0, height, TEMPORAL_ROW_GRAIN, [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			for (int x = 0; x < width; x++) {
+				prevViewZ_.at(x, y) = input.viewZ ? input.viewZ->at(x, y) : viewDepth(invProj, input.depth->at(x, y));
+			}
+		}
+	});
+	prevViewProj_ = viewProj;
+	memcpy(prevInvProj_, invProj, sizeof(prevInvProj_));
+	valid_ = true;
+	frame_++;
+
+	stats_.accepted = accepted;
+	stats_.rejected = rejected;
+}
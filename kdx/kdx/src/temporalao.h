@@ -0,0 +1,64 @@
+#ifndef TEMPORALAO_H
+#define TEMPORALAO_H
+
+#include "ambientocclusion.h"
+#include <stdint.h>
+
+// temporal accumulation for the cpu ao passes
+// keeps last frame's ao, depth, normals and view-projection, reprojects every pixel of the new frame into it
+// through its depth and blends the new ao into what it finds there
+// history is dropped where the reprojected depth or normal doesn't match (disocclusion) or the pixel was off screen
+//
+// the tap pattern is rotated every frame (getRotation), so a few directions per frame add up to many over the history
+class TemporalAo {
+public:
+	struct Stats {
+		uint32_t accepted; // pixels that continued their history
+		uint32_t rejected; // pixels that restarted it
+	};
+
+	TemporalAo();
+	virtual ~TemporalAo();
+
+	// forgets the history, the next accumulate passes its ao through
+	void reset();
+
+	// rotation for this frame's AoParams::rotation, cycles through one direction sector of the pattern
+	// in period frames so the rotated directions interleave with the unrotated ones
+	float getRotation(const AoParams &params) const;
+
+	// blends ao (computed from input with getRotation) into the history and writes the result to out
+	// view and proj are the matrices the prepass in input was rendered with
+	void accumulate(const AoInput &input, const Matrix &view, const Matrix &proj, const FloatImage &ao, FloatImage &out);
+
+	// frames per rotation cycle
+	void setPeriod(int period) { period_ = period; }
+	// a pixel's history never weighs more than maxFrames - 1 frames against the new one
+	void setMaxFrames(int maxFrames) { maxFrames_ = maxFrames; }
+	// relative view depth difference and normal dot product a reprojected sample has to stay within
+	void setDepthTolerance(float tolerance) { depthTolerance_ = tolerance; }
+	void setNormalThreshold(float threshold) { normalThreshold_ = threshold; }
+
+	const Stats& getStats() const { return stats_; }
+
+private:
+	FloatImage history_;
+	Image<uint8_t> historyFrames_;
+	FloatImage prevViewZ_;
+	Image<fl3> prevNormals_;
+	Matrix prevViewProj_;
+	float prevInvProj_[16];
+	bool valid_;
+	unsigned int frame_;
+
+	int period_;
+	int maxFrames_;
+	float depthTolerance_;
+	float normalThreshold_;
+	Stats stats_;
+
+	// frame counts being written, the history itself is the output image until it is copied back
+	Image<uint8_t> nextFrames_;
+};
+
+#endif // TEMPORALAO_H
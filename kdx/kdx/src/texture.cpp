@@ -1,24 +1,24 @@
 #include "texture.h"
 #include <map>
 #include <assert.h>
-#include <D3DX11.h>
+#include <stdio.h>
 
 // reference counter for resource management
-static std::map<ID3D11ShaderResourceView*, unsigned short> RefCount;
+static std::map<RenderTexture*, unsigned short> RefCount;
 
-Texture::Texture(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename, bool mipmap) : resource_(0)
+Texture::Texture(RenderDevice &dev, RenderContext &context, const wchar_t *filename, bool mipmap) : resource_(0)
 {
-	if (init(dev, devcon, filename)) {
-		//printf("successfully loaded texture %s\n", filename); fflush(stdout);
+	if (init(dev, filename)) {
+		//printf("successfully loaded texture %ls\n", filename); fflush(stdout);
 		assert(RefCount.count(resource_) == 0);
 		RefCount[resource_] = 1;
 		assert(RefCount[resource_] == 1);
 		assert(RefCount.count(resource_) == 1);
 		if (mipmap) {
-			devcon.GenerateMips(resource_);
+			context.generateMips(resource_);
 		}
 	} else {
-        printf("failed to load texture %s\n", filename); fflush(stdout);
+        printf("failed to load texture %ls\n", filename); fflush(stdout);
 		assert(0);
 	}
 }
@@ -34,17 +34,18 @@ Texture::~Texture()
 	assert(RefCount.count(resource_) == 1);
 	assert(RefCount[resource_] > 0);
 	if (--RefCount[resource_] == 0) {
-		resource_->Release();
+		RefCount.erase(resource_);
+		delete resource_;
 	}
 }
 
-void Texture::use(ID3D11DeviceContext &devcon, UINT slot)
+void Texture::use(RenderContext &context, unsigned int slot)
 {
-	devcon.PSSetShaderResources(slot, 1, &resource_);
+	context.setShaderResources(STAGE_PIXEL, slot, 1, &resource_);
 }
 
-bool Texture::init(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename)
+bool Texture::init(RenderDevice &dev, const wchar_t *filename)
 {
-	HRESULT result = D3DX11CreateShaderResourceViewFromFile(&dev, filename, NULL, NULL, &resource_, NULL);
-	return !FAILED(result);
+	resource_ = dev.loadTexture(filename);
+	return resource_ != 0;
 }
\ No newline at end of file
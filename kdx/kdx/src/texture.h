@@ -1,20 +1,20 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
-#include <D3D11.h>
+#include "renderdevice.h"
 #include "utils.h"
 
 class Texture {
 public:
-	Texture(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename, bool mipmap = true);
+	Texture(RenderDevice &dev, RenderContext &context, const wchar_t *filename, bool mipmap = true);
 	Texture(const Texture &other);
 	virtual ~Texture();
-	void use(ID3D11DeviceContext &devcon, UINT slot);
+	void use(RenderContext &context, unsigned int slot);
 
 private:
-	bool init(ID3D11Device &dev, ID3D11DeviceContext &devcon, LPCWSTR filename);
+	bool init(RenderDevice &dev, const wchar_t *filename);
 	
-	ID3D11ShaderResourceView *resource_;
+	RenderTexture *resource_;
 };
 
 #endif // TEXTURE_H
\ No newline at end of file
@@ -2,16 +2,20 @@
 #define UTILS_H
 
 #include <math.h>
+#include <string.h>
+// the d3d headers are only needed for the D3DXVECTOR3 conversion, everything else here is also used by the portable cpu code
+#ifdef _WIN32
 #include <D3D11.h>
 #include <D3DX10math.h>
+#endif
 
 // generic vector struct
 template <typename T, int N>
 struct Vector {
 	T data[N];
-	Vector() { memset(data, 0, N); }
-	explicit Vector(const T &constant) { memset(data, T, N); }
-	explicit Vector(const Vector &other) { memcpy(data, other.data, N); }
+	Vector() { for (int i = 0; i < N; i++) { data[i] = T(0); } }
+	explicit Vector(const T &constant) { for (int i = 0; i < N; i++) { data[i] = constant; } }
+	Vector(const Vector &other) { memcpy(data, other.data, N * sizeof(T)); }
 	T& operator[](const int index)
 	{
 		return data[index];
@@ -52,15 +56,18 @@ struct Vector<float, 3> {
 	union {
 		float data[3];
 		struct { float x, y, z; };
-		struct { float s, t, r; };
+		// WORKNOTE: third texcoord is p (as in glsl stp) so it doesn't clash with the r of rgb
+		struct { float s, t, p; };
 		struct { float r, g, b; };
 	};
 	Vector() : x(0), y(0), z(0) {}
 	Vector(const float nx, const float ny, const float nz) : x(nx), y(ny), z(nz) {}
+#ifdef _WIN32
 	Vector(const D3DXVECTOR3 &src)
 	{
 		memcpy(data, &src.x, sizeof(D3DXVECTOR3));
 	}
+#endif
 	float& operator[](const int index)
 	{
 		return data[index];
@@ -94,7 +101,7 @@ struct Vector<int, 3> {
 	union {
 		int data[3];
 		struct { int x, y, z; };
-		struct { int s, t, r; };
+		struct { int s, t, p; };
 		struct { int r, g, b; };
 	};
 	Vector() : x(0), y(0), z(0) {}
@@ -138,7 +145,7 @@ Vector<T, N> operator-(const Vector<T, N> &v)
 	for (int i = 0; i < N; i++) {
 		nv[i] = -v[i];
 	}
-	return v;
+	return nv;
 }
 
 template <typename T, int N>
@@ -166,7 +173,7 @@ Vector<T, N> operator*(const Vector<T, N> &first, const Vector<T, N> &second)
 {
 	Vector<T, N> v;
 	for (int i = 0; i < N; i++) {
-		v[i] = data[i] * other[i];
+		v[i] = first[i] * second[i];
 	}
 	return v;
 }
@@ -178,7 +185,7 @@ Vector<T, N> operator*(const Vector<T, N> &v, const T &scalar)
 	for (int i = 0; i < N; i++) {
 		nv[i] = v[i] * scalar;
 	}
-	return v;
+	return nv;
 }
 
 template <typename T, int N>
@@ -211,7 +218,7 @@ Vector<T, N>& operator*=(Vector<T, N> &v, const T &scalar)
 template <typename T, int N>
 static T dot(const Vector<T, N> &first, const Vector<T, N> &second)
 {
-	T product;
+	T product = 0;
 	for (int i = 0; i < N; i++) {
 		product += first[i] * second[i];
 	}
@@ -279,9 +286,9 @@ Vector<float, N> operator/(const Vector<float, N> &first, const Vector<float, N>
 template <int N>
 Vector<float, N> operator/(const Vector<float, N> &v, const float &scalar)
 {
-	Vector nv;
+	Vector<float, N> nv;
 	for (int i = 0; i < N; i++) {
-		nv[i] = v[i] * scalar;
+		nv[i] = v[i] / scalar;
 	}
 	return nv;
 }